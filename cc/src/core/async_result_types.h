@@ -7,29 +7,32 @@
 #include <cstdint>
 #include "address.h"
 #include "async.h"
+#include "io_throttle.h"
 #include "native_buffer_pool.h"
-
-#ifdef _WIN32
-#include <concurrent_queue.h>
-
-template <typename T>
-using concurrent_queue = concurrency::concurrent_queue<T>;
-#endif
+#include "wakeup_event.h"
 
 namespace FASTER {
 namespace core {
 
+class IoResponseQueue;
+
 class AsyncIOContext : public IAsyncContext {
  public:
   AsyncIOContext(void* faster_, Address address_,
                  IAsyncContext* caller_context_,
-                 concurrent_queue<AsyncIOContext*>* thread_io_responses_,
-                 uint64_t io_id_)
+                 IoResponseQueue* thread_io_responses_,
+                 WakeupEvent* thread_wakeup_, IoWindow* thread_window_, uint64_t io_id_)
     : faster{ faster_ }
     , address{ address_ }
     , caller_context{ caller_context_ }
     , thread_io_responses{ thread_io_responses_ }
-    , io_id{ io_id_ } {
+    , thread_wakeup{ thread_wakeup_ }
+    , thread_window{ thread_window_ }
+    , io_id{ io_id_ }
+    , start_ns{ 0 }
+    , num_reads{ 0 }
+    , bytes_read{ 0 }
+    , next_response{ nullptr } {
   }
   /// No copy constructor.
   AsyncIOContext(const AsyncIOContext& other) = delete;
@@ -39,22 +42,106 @@ class AsyncIOContext : public IAsyncContext {
     , address{ other.address }
     , caller_context{ caller_context_ }
     , thread_io_responses{ other.thread_io_responses }
+    , thread_wakeup{ other.thread_wakeup }
+    , thread_window{ other.thread_window }
     , record{ std::move(other.record) }
-    , io_id{ other.io_id } {
+    , io_id{ other.io_id }
+    , start_ns{ other.start_ns }
+    , num_reads{ other.num_reads }
+    , bytes_read{ other.bytes_read }
+    , next_response{ nullptr } {
   }
  protected:
   Status DeepCopy_Internal(IAsyncContext*& context_copy) final {
     return IAsyncContext::DeepCopy_Internal(*this, caller_context, context_copy);
   }
  public:
+  /// Hands the finished request back to the thread that issued it, waking that thread if it's
+  /// waiting for I/O, and makes room for another request in that thread's I/O window.
+  inline void CompleteIo();
+
   void* faster;
   Address address;
   IAsyncContext* caller_context;
-  concurrent_queue<AsyncIOContext*>* thread_io_responses;
+  IoResponseQueue* thread_io_responses;
+  /// Signaled when the response is pushed onto the issuing thread's queue.
+  WakeupEvent* thread_wakeup;
+  /// The issuing thread's window of requests in flight.
+  IoWindow* thread_window;
   uint64_t io_id;
 
   SectorAlignedMemory record;
+
+  /// For statistics: when the request was issued, and the reads it has taken so far.
+  uint64_t start_ns;
+  uint32_t num_reads;
+  uint64_t bytes_read;
+
+  /// Link in the issuing thread's IoResponseQueue.
+  AsyncIOContext* next_response;
 };
 
+/// The responses to a thread's I/O requests, pushed by whichever threads complete the I/Os, and
+/// popped, in FIFO order, by the issuing thread. The queue is intrusive--linked through the
+/// responses' contexts--so pushing doesn't allocate: producers push onto a lock-free stack, and the
+/// consumer takes the whole stack at once and reverses it.
+class IoResponseQueue {
+ public:
+  IoResponseQueue()
+    : pushed_{ nullptr }
+    , popped_{ nullptr } {
+  }
+
+  inline void Push(AsyncIOContext* context) {
+    AsyncIOContext* head = pushed_.load();
+    do {
+      context->next_response = head;
+    } while(!pushed_.compare_exchange_weak(head, context));
+  }
+
+  /// Consumer only.
+  inline bool TryPop(AsyncIOContext*& context) {
+    if(!popped_) {
+      AsyncIOContext* pushed = pushed_.exchange(nullptr);
+      while(pushed) {
+        AsyncIOContext* next = pushed->next_response;
+        pushed->next_response = popped_;
+        popped_ = pushed;
+        pushed = next;
+      }
+      if(!popped_) {
+        return false;
+      }
+    }
+    context = popped_;
+    popped_ = popped_->next_response;
+    return true;
+  }
+
+  /// Consumer only.
+  inline bool empty() const {
+    return !popped_ && !pushed_.load();
+  }
+
+  /// Consumer only; drops any responses still queued.
+  inline void clear() {
+    pushed_.store(nullptr);
+    popped_ = nullptr;
+  }
+
+ private:
+  std::atomic<AsyncIOContext*> pushed_;
+  /// Responses taken from pushed_, oldest first.
+  AsyncIOContext* popped_;
+};
+
+inline void AsyncIOContext::CompleteIo() {
+  thread_window->Complete(start_ns);
+  // Once pushed, this context belongs to the issuing thread, which may free it at any time.
+  WakeupEvent* wakeup = thread_wakeup;
+  thread_io_responses->Push(this);
+  wakeup->Signal();
+}
+
 }
 } // namespace FASTER::core
\ No newline at end of file
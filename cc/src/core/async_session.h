@@ -0,0 +1,549 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+/// An optional, coroutine-based front-end to FasterKv; requires C++20, and is compiled only when
+/// FASTER_COROUTINES is defined (CMake option FASTER_COROUTINES). E.g.:
+///
+///   Task ReadKeys(AsyncSession<store_t>& session, uint64_t first, uint64_t count) {
+///     for(uint64_t idx = first; idx < first + count; ++idx) {
+///       ReadContext context{ idx };
+///       Status result = co_await session.ReadAsync(context);
+///       ...
+///     }
+///   }
+///
+///   AsyncSession<store_t> session{ store };
+///   for(uint64_t idx = 0; idx < 1000; ++idx) {
+///     session.Spawn(ReadKeys(session, idx * 100, 100));
+///   }
+///   session.Run();
+///
+/// An operation's context is an ordinary local of the coroutine: it needn't derive from
+/// IAsyncContext, and it isn't copied to the heap when the operation goes pending, since the
+/// suspended coroutine's frame keeps it alive. A coroutine whose first parameter is its session
+/// gets its frame from the session's arena.
+#ifdef FASTER_COROUTINES
+
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <vector>
+
+#include "alloc.h"
+#include "async.h"
+#include "constants.h"
+#include "guid.h"
+#include "status.h"
+
+namespace FASTER {
+namespace core {
+
+/// Allocates coroutine frames, for a single thread. Freed frames are kept on per-size free lists
+/// and reused, so a session that keeps thousands of operations in flight stops allocating once it
+/// reaches steady state.
+class FrameArena {
+ public:
+  static constexpr uint32_t kSizeClassBytes = Constants::kCacheLineBytes;
+  /// Frames larger than kNumSizeClasses * kSizeClassBytes come from the global heap.
+  static constexpr uint32_t kNumSizeClasses = 64;
+  static constexpr uint32_t kSlabBytes = 64 * 1024;
+
+  FrameArena()
+    : slab_cursor_{ nullptr }
+    , slab_remaining_{ 0 } {
+    for(uint32_t idx = 0; idx < kNumSizeClasses; ++idx) {
+      free_lists_[idx] = nullptr;
+    }
+  }
+
+  ~FrameArena() {
+    for(uint8_t* slab : slabs_) {
+      aligned_free(slab);
+    }
+  }
+
+  FrameArena(const FrameArena&) = delete;
+  FrameArena& operator=(const FrameArena&) = delete;
+
+  void* Allocate(size_t size) {
+    size_t size_class = (size + kSizeClassBytes - 1) / kSizeClassBytes;
+    if(size_class > kNumSizeClasses) {
+      return ::operator new(size);
+    }
+    FreeFrame*& free_list = free_lists_[size_class - 1];
+    if(free_list) {
+      FreeFrame* frame = free_list;
+      free_list = frame->next;
+      return frame;
+    }
+    size_t bytes = size_class * kSizeClassBytes;
+    if(slab_remaining_ < bytes) {
+      slab_cursor_ = reinterpret_cast<uint8_t*>(aligned_alloc(kSizeClassBytes, kSlabBytes));
+      if(!slab_cursor_) {
+        throw std::bad_alloc{};
+      }
+      slabs_.push_back(slab_cursor_);
+      slab_remaining_ = kSlabBytes;
+    }
+    void* result = slab_cursor_;
+    slab_cursor_ += bytes;
+    slab_remaining_ -= bytes;
+    return result;
+  }
+
+  void Free(void* ptr, size_t size) {
+    size_t size_class = (size + kSizeClassBytes - 1) / kSizeClassBytes;
+    if(size_class > kNumSizeClasses) {
+      ::operator delete(ptr);
+      return;
+    }
+    FreeFrame* frame = reinterpret_cast<FreeFrame*>(ptr);
+    frame->next = free_lists_[size_class - 1];
+    free_lists_[size_class - 1] = frame;
+  }
+
+ private:
+  struct FreeFrame {
+    FreeFrame* next;
+  };
+
+  FreeFrame* free_lists_[kNumSizeClasses];
+  std::vector<uint8_t*> slabs_;
+  uint8_t* slab_cursor_;
+  size_t slab_remaining_;
+};
+
+class TaskScheduler;
+
+/// A coroutine that the session runs to completion; see AsyncSession::Spawn().
+class Task {
+ public:
+  class promise_type {
+   public:
+    /// Each frame starts with a header recording the arena it came from, if any.
+    static constexpr size_t kHeaderBytes = alignof(std::max_align_t);
+
+    /// A coroutine whose first parameter is a session allocates from the session's arena.
+    template <class... Args>
+    static void* operator new(size_t size, TaskScheduler& scheduler, Args&...);
+    static void* operator new(size_t size) {
+      uint8_t* block = reinterpret_cast<uint8_t*>(::operator new(size + kHeaderBytes));
+      *reinterpret_cast<FrameArena**>(block) = nullptr;
+      return block + kHeaderBytes;
+    }
+    static void operator delete(void* ptr, size_t size) {
+      uint8_t* block = reinterpret_cast<uint8_t*>(ptr) - kHeaderBytes;
+      FrameArena* arena = *reinterpret_cast<FrameArena**>(block);
+      if(arena) {
+        arena->Free(block, size + kHeaderBytes);
+      } else {
+        ::operator delete(block);
+      }
+    }
+
+    Task get_return_object() {
+      return Task{ std::coroutine_handle<promise_type>::from_promise(*this) };
+    }
+    std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+    /// The scheduler destroys the frame, once it sees that the coroutine is done.
+    std::suspend_always final_suspend() noexcept {
+      return {};
+    }
+    void return_void() {
+    }
+    void unhandled_exception() {
+      std::terminate();
+    }
+  };
+
+  Task(Task&& other)
+    : handle_{ other.handle_ } {
+    other.handle_ = nullptr;
+  }
+  ~Task() {
+    if(handle_) {
+      // Never spawned.
+      handle_.destroy();
+    }
+  }
+
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+
+ private:
+  explicit Task(std::coroutine_handle<promise_type> handle)
+    : handle_{ handle } {
+  }
+
+  std::coroutine_handle<promise_type> release() {
+    std::coroutine_handle<promise_type> handle = handle_;
+    handle_ = nullptr;
+    return handle;
+  }
+
+  std::coroutine_handle<promise_type> handle_;
+
+  friend class TaskScheduler;
+};
+
+/// Base class for an operation's context, while its coroutine awaits it. Its deep copy is itself:
+/// the context lives in the suspended coroutine's frame until the operation completes.
+class AwaitContext : public IAsyncContext {
+ protected:
+  explicit AwaitContext(TaskScheduler& scheduler_)
+    : scheduler{ &scheduler_ }
+    , result{ Status::Pending }
+    , next{ nullptr } {
+  }
+
+  Status DeepCopy_Internal(IAsyncContext*& context_copy) final {
+    context_copy = this;
+    return Status::Ok;
+  }
+
+ public:
+  /// Called, from CompletePending(), when the operation completes.
+  static void Complete(IAsyncContext* ctxt, Status result);
+
+  TaskScheduler* scheduler;
+  std::coroutine_handle<> handle;
+  Status result;
+  /// Next in the scheduler's ready list.
+  AwaitContext* next;
+};
+
+/// Runs a session's tasks: resumes each task once the operation it awaits completes.
+/// Single-threaded: a session's tasks run only on the thread that owns the session.
+class TaskScheduler {
+ public:
+  TaskScheduler()
+    : num_tasks_{ 0 }
+    , ready_head_{ nullptr }
+    , ready_tail_{ nullptr } {
+  }
+
+  ~TaskScheduler() {
+    assert(num_tasks_ == 0);
+  }
+
+  /// Starts a task; it runs until it first awaits a pending operation.
+  void Spawn(Task task) {
+    ++num_tasks_;
+    Resume(task.release());
+  }
+
+  /// Number of tasks that haven't finished.
+  uint64_t num_tasks() const {
+    return num_tasks_;
+  }
+
+  FrameArena& arena() {
+    return arena_;
+  }
+
+ protected:
+  /// Resumes the tasks whose operations have completed; returns false if none had.
+  bool ResumeReady() {
+    if(!ready_head_) {
+      return false;
+    }
+    // Tasks that complete further operations while running are resumed in the next pass.
+    AwaitContext* context = ready_head_;
+    ready_head_ = ready_tail_ = nullptr;
+    while(context) {
+      AwaitContext* next = context->next;
+      Resume(context->handle);
+      context = next;
+    }
+    return true;
+  }
+
+ private:
+  void Ready(AwaitContext* context) {
+    context->next = nullptr;
+    if(ready_tail_) {
+      ready_tail_->next = context;
+    } else {
+      ready_head_ = context;
+    }
+    ready_tail_ = context;
+  }
+
+  void Resume(std::coroutine_handle<> handle) {
+    handle.resume();
+    if(handle.done()) {
+      handle.destroy();
+      --num_tasks_;
+    }
+  }
+
+  uint64_t num_tasks_;
+  AwaitContext* ready_head_;
+  AwaitContext* ready_tail_;
+  FrameArena arena_;
+
+  friend class AwaitContext;
+};
+
+template <class... Args>
+inline void* Task::promise_type::operator new(size_t size, TaskScheduler& scheduler, Args&...) {
+  FrameArena& arena = scheduler.arena();
+  uint8_t* block = reinterpret_cast<uint8_t*>(arena.Allocate(size + kHeaderBytes));
+  *reinterpret_cast<FrameArena**>(block) = &arena;
+  return block + kHeaderBytes;
+}
+
+inline void AwaitContext::Complete(IAsyncContext* ctxt, Status result) {
+  AwaitContext* context = static_cast<AwaitContext*>(ctxt);
+  context->result = result;
+  context->scheduler->Ready(context);
+}
+
+/// Adapters from the caller's operation contexts to the interface that FasterKv expects.
+template <class RC>
+class AwaitReadContext : public AwaitContext {
+ public:
+  typedef typename RC::key_t key_t;
+  typedef typename RC::value_t value_t;
+
+  AwaitReadContext(TaskScheduler& scheduler_, RC& context)
+    : AwaitContext(scheduler_)
+    , context_{ context } {
+  }
+
+  inline const key_t& key() const {
+    return context_.key();
+  }
+  inline void Get(const value_t& value) {
+    context_.Get(value);
+  }
+  inline void GetAtomic(const value_t& value) {
+    context_.GetAtomic(value);
+  }
+
+ private:
+  RC& context_;
+};
+
+template <class UC>
+class AwaitUpsertContext : public AwaitContext {
+ public:
+  typedef typename UC::key_t key_t;
+  typedef typename UC::value_t value_t;
+
+  AwaitUpsertContext(TaskScheduler& scheduler_, UC& context)
+    : AwaitContext(scheduler_)
+    , context_{ context } {
+  }
+
+  inline const key_t& key() const {
+    return context_.key();
+  }
+  inline uint32_t value_size() const {
+    return context_.value_size();
+  }
+  inline void Put(value_t& value) {
+    context_.Put(value);
+  }
+  inline bool PutAtomic(value_t& value) {
+    return context_.PutAtomic(value);
+  }
+
+ private:
+  UC& context_;
+};
+
+template <class MC>
+class AwaitRmwContext : public AwaitContext {
+ public:
+  typedef typename MC::key_t key_t;
+  typedef typename MC::value_t value_t;
+
+  AwaitRmwContext(TaskScheduler& scheduler_, MC& context)
+    : AwaitContext(scheduler_)
+    , context_{ context } {
+  }
+
+  inline const key_t& key() const {
+    return context_.key();
+  }
+  inline uint32_t value_size() const {
+    return context_.value_size();
+  }
+  inline uint32_t value_size(const value_t& old_value) const {
+    return context_.value_size(old_value);
+  }
+  inline void RmwInitial(value_t& value) {
+    context_.RmwInitial(value);
+  }
+  inline void RmwCopy(const value_t& old_value, value_t& value) {
+    context_.RmwCopy(old_value, value);
+  }
+  inline bool RmwAtomic(value_t& value) {
+    return context_.RmwAtomic(value);
+  }
+
+ private:
+  MC& context_;
+};
+
+template <class DC>
+class AwaitDeleteContext : public AwaitContext {
+ public:
+  typedef typename DC::key_t key_t;
+  typedef typename DC::value_t value_t;
+
+  AwaitDeleteContext(TaskScheduler& scheduler_, DC& context)
+    : AwaitContext(scheduler_)
+    , context_{ context } {
+  }
+
+  inline const key_t& key() const {
+    return context_.key();
+  }
+  inline uint32_t value_size() const {
+    return context_.value_size();
+  }
+
+ private:
+  DC& context_;
+};
+
+/// A session on a FasterKv store, whose operations are awaited by coroutines (Tasks). Starts a
+/// session on the calling thread; the session's tasks, Run(), and the destructor must all run on
+/// that thread.
+template <class F>
+class AsyncSession : public TaskScheduler {
+ public:
+  typedef F faster_t;
+
+  /// Tasks may run many operations without suspending, so the session refreshes its epoch every
+  /// kRefreshInterval operations.
+  static constexpr uint64_t kRefreshInterval = 256;
+
+  /// Awaits an operation: issues it, and suspends the awaiting task only if the operation goes
+  /// pending. Evaluates to the operation's result.
+  template <class C>
+  class Awaiter {
+   public:
+    template <class UC>
+    Awaiter(AsyncSession& session, UC& context)
+      : session_{ session }
+      , context_{ session, context } {
+    }
+
+    bool await_ready() {
+      context_.result = session_.Issue(context_);
+      return context_.result != Status::Pending;
+    }
+    void await_suspend(std::coroutine_handle<> handle) {
+      context_.handle = handle;
+    }
+    Status await_resume() const {
+      return context_.result;
+    }
+
+   private:
+    AsyncSession& session_;
+    C context_;
+  };
+
+  explicit AsyncSession(faster_t& store)
+    : store_{ store }
+    , serial_num_{ 0 } {
+    guid_ = store_.StartSession();
+  }
+
+  ~AsyncSession() {
+    Run();
+    store_.StopSession();
+  }
+
+  AsyncSession(const AsyncSession&) = delete;
+  AsyncSession& operator=(const AsyncSession&) = delete;
+
+  template <class RC>
+  Awaiter<AwaitReadContext<RC>> ReadAsync(RC& context) {
+    return Awaiter<AwaitReadContext<RC>>{ *this, context };
+  }
+  template <class UC>
+  Awaiter<AwaitUpsertContext<UC>> UpsertAsync(UC& context) {
+    return Awaiter<AwaitUpsertContext<UC>>{ *this, context };
+  }
+  template <class MC>
+  Awaiter<AwaitRmwContext<MC>> RmwAsync(MC& context) {
+    return Awaiter<AwaitRmwContext<MC>>{ *this, context };
+  }
+  template <class DC>
+  Awaiter<AwaitDeleteContext<DC>> DeleteAsync(DC& context) {
+    return Awaiter<AwaitDeleteContext<DC>>{ *this, context };
+  }
+
+  /// Completes pending operations and resumes their tasks, until every task has finished.
+  void Run() {
+    while(num_tasks() > 0) {
+      store_.CompletePending(false);
+      if(!ResumeReady()) {
+        store_.WaitForPendingRequests();
+      }
+    }
+  }
+
+  /// Like Run(), but returns after a single pass; returns true if every task has finished.
+  bool Poll() {
+    store_.CompletePending(false);
+    ResumeReady();
+    return num_tasks() == 0;
+  }
+
+  const Guid& guid() const {
+    return guid_;
+  }
+  faster_t& store() {
+    return store_;
+  }
+
+ private:
+  template <class RC>
+  Status Issue(AwaitReadContext<RC>& context) {
+    Refresh();
+    return store_.Read(context, AwaitContext::Complete, ++serial_num_);
+  }
+  template <class UC>
+  Status Issue(AwaitUpsertContext<UC>& context) {
+    Refresh();
+    return store_.Upsert(context, AwaitContext::Complete, ++serial_num_);
+  }
+  template <class MC>
+  Status Issue(AwaitRmwContext<MC>& context) {
+    Refresh();
+    return store_.Rmw(context, AwaitContext::Complete, ++serial_num_);
+  }
+  template <class DC>
+  Status Issue(AwaitDeleteContext<DC>& context) {
+    Refresh();
+    return store_.Delete(context, AwaitContext::Complete, ++serial_num_);
+  }
+
+  inline void Refresh() {
+    if(serial_num_ % kRefreshInterval == kRefreshInterval - 1) {
+      store_.Refresh();
+    }
+  }
+
+  faster_t& store_;
+  Guid guid_;
+  uint64_t serial_num_;
+};
+
+}
+} // namespace FASTER::core
+
+#endif
@@ -3,9 +3,12 @@
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
+#include <cstdio>
 #include <unordered_map>
+#include <vector>
 #include "address.h"
 #include "guid.h"
 #include "malloc_fixed_page_size.h"
@@ -60,17 +63,23 @@ class IndexMetadata {
 };
 static_assert(sizeof(IndexMetadata) == 56, "sizeof(IndexMetadata) != 56");
 
-/// Checkpoint metadata, for the log.
+/// Checkpoint metadata, for the log. Stored as a fixed-size header, starting with a magic number
+/// and a format version, followed by an entry per thread (ID) that the store had room for.
 class LogMetadata {
  public:
-  LogMetadata()
+  static constexpr uint32_t kMagic = 0x474f4c46;  // "FLOG"
+  static constexpr uint32_t kFormatVersion = 1;
+  /// Checkpoints written before the format had a version held a fixed 96 entries.
+  static constexpr uint32_t kUnversionedNumThreads = 96;
+
+  explicit LogMetadata(uint32_t max_num_threads)
     : use_snapshot_file{ false }
     , version{ UINT32_MAX }
     , num_threads{ 0 }
     , flushed_address{ Address::kInvalidAddress }
-    , final_address{ Address::kMaxAddress } {
-    std::memset(guids, 0, sizeof(guids));
-    std::memset(monotonic_serial_nums, 0, sizeof(monotonic_serial_nums));
+    , final_address{ Address::kMaxAddress }
+    , monotonic_serial_nums(max_num_threads)
+    , guids(max_num_threads) {
   }
 
   inline void Initialize(bool use_snapshot_file_, uint32_t version_, Address flushed_address_) {
@@ -79,23 +88,109 @@ class LogMetadata {
     num_threads = 0;
     flushed_address = flushed_address_;
     final_address = Address::kMaxAddress;
-    std::memset(guids, 0, sizeof(guids));
-    std::memset(monotonic_serial_nums, 0, sizeof(monotonic_serial_nums));
+    std::fill(monotonic_serial_nums.begin(), monotonic_serial_nums.end(), 0);
+    std::fill(guids.begin(), guids.end(), Guid{});
   }
   inline void Reset() {
     Initialize(false, UINT32_MAX, Address::kInvalidAddress);
   }
 
+  Status Write(std::FILE* file) const {
+    Header header{ kMagic, kFormatVersion, use_snapshot_file, version, num_threads.load(),
+                   static_cast<uint32_t>(guids.size()), flushed_address, final_address };
+    if(std::fwrite(&header, sizeof(header), 1, file) != 1 ||
+        std::fwrite(monotonic_serial_nums.data(), sizeof(uint64_t), monotonic_serial_nums.size(),
+                    file) != monotonic_serial_nums.size() ||
+        std::fwrite(guids.data(), sizeof(Guid), guids.size(), file) != guids.size()) {
+      return Status::IOError;
+    }
+    return Status::Ok;
+  }
+
+  /// If the checkpoint was taken by a store with room for more threads, the per-thread entries
+  /// grow to match. Reads checkpoints written before the format had a version, too; rejects
+  /// those of a newer format, as Status::Corruption.
+  Status Read(std::FILE* file) {
+    long start = std::ftell(file);
+    Header header;
+    if(std::fread(&header, sizeof(header), 1, file) != 1) {
+      return Status::IOError;
+    }
+    if(header.magic != kMagic) {
+      // An unversioned header is the old in-memory layout, which starts with the (0 or 1)
+      // use_snapshot_file flag, and so never matches the magic number.
+      UnversionedHeader unversioned;
+      if(start < 0 || std::fseek(file, start, SEEK_SET) != 0 ||
+          std::fread(&unversioned, sizeof(unversioned), 1, file) != 1) {
+        return Status::IOError;
+      }
+      if(reinterpret_cast<const uint8_t*>(&unversioned)[0] > 1) {
+        std::fprintf(stderr, "Checkpoint log metadata: unrecognized format\n");
+        return Status::Corruption;
+      }
+      header = Header{ kMagic, 0, unversioned.use_snapshot_file, unversioned.version,
+                       unversioned.num_threads, kUnversionedNumThreads,
+                       unversioned.flushed_address, unversioned.final_address };
+    } else if(header.format_version > kFormatVersion) {
+      std::fprintf(stderr, "Checkpoint log metadata: format version %u is newer than the %u "
+                   "this build reads\n", header.format_version, kFormatVersion);
+      return Status::Corruption;
+    }
+    use_snapshot_file = header.use_snapshot_file;
+    version = header.version;
+    num_threads = header.num_threads;
+    flushed_address = header.flushed_address;
+    final_address = header.final_address;
+    if(header.max_num_threads > Thread::kMaxNumThreads) {
+      return Status::Corruption;
+    }
+    if(header.max_num_threads > guids.size()) {
+      monotonic_serial_nums.resize(header.max_num_threads);
+      guids.resize(header.max_num_threads);
+    }
+    std::fill(monotonic_serial_nums.begin(), monotonic_serial_nums.end(), 0);
+    std::fill(guids.begin(), guids.end(), Guid{});
+    if(std::fread(monotonic_serial_nums.data(), sizeof(uint64_t), header.max_num_threads,
+                  file) != header.max_num_threads ||
+        std::fread(guids.data(), sizeof(Guid), header.max_num_threads, file) !=
+        header.max_num_threads) {
+      return Status::IOError;
+    }
+    return Status::Ok;
+  }
+
   bool use_snapshot_file;
   uint32_t version;
   std::atomic<uint32_t> num_threads;
   Address flushed_address;
   Address final_address;
-  uint64_t monotonic_serial_nums[Thread::kMaxNumThreads];
-  Guid guids[Thread::kMaxNumThreads];
+  /// Indexed by thread ID.
+  std::vector<uint64_t> monotonic_serial_nums;
+  std::vector<Guid> guids;
+
+ private:
+  struct Header {
+    uint32_t magic;
+    uint32_t format_version;
+    bool use_snapshot_file;
+    uint32_t version;
+    uint32_t num_threads;
+    uint32_t max_num_threads;
+    Address flushed_address;
+    Address final_address;
+  };
+  static_assert(sizeof(Header) == 40, "sizeof(Header) != 40");
+
+  /// Format version 0: the header was the start of the metadata's in-memory layout.
+  struct UnversionedHeader {
+    bool use_snapshot_file;
+    uint32_t version;
+    uint32_t num_threads;
+    Address flushed_address;
+    Address final_address;
+  };
+  static_assert(sizeof(UnversionedHeader) == 32, "sizeof(UnversionedHeader) != 32");
 };
-static_assert(sizeof(LogMetadata) == 32 + (24 * Thread::kMaxNumThreads),
-              "sizeof(LogMetadata) != 32 + (24 * Thread::kMaxNumThreads)");
 
 /// State of the active Checkpoint()/Recover() call, including metadata written to disk.
 template <class F>
@@ -105,9 +200,10 @@ class CheckpointState {
   typedef void(*index_persistence_callback_t)(Status result);
   typedef void(*hybrid_log_persistence_callback_t)(Status result, uint64_t persistent_serial_num);
 
-  CheckpointState()
+  explicit CheckpointState(uint32_t max_num_threads)
     : index_checkpoint_started{ false }
     , failed{ false }
+    , log_metadata{ max_num_threads }
     , flush_pending{ UINT32_MAX }
     , index_persistence_callback{ nullptr }
     , hybrid_log_persistence_callback{ nullptr } {
@@ -14,6 +14,10 @@ struct Constants {
 
   /// We issue 256 writes to disk, to checkpoint the hash table.
   static constexpr uint32_t kNumMergeChunks = 256;
+
+  /// A thread that's waiting for I/O sleeps at most this long (in microseconds) before it checks
+  /// on its other work (retries, phase changes).
+  static constexpr uint32_t kIoWaitMicros = 1000;
 };
 
 }
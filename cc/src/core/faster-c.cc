@@ -7,6 +7,13 @@
 #include "device/file_system_disk.h"
 #include "device/null_disk.h"
 
+/// The hash function for the C API's keys. Changing it makes existing stores unrecoverable, so
+/// the default remains the original byte-at-a-time hash; new deployments can build with
+/// -DFASTER_C_KEY_HASH=WordHash (or Crc32cHash) for faster hashing of long keys.
+#ifndef FASTER_C_KEY_HASH
+#define FASTER_C_KEY_HASH MagicHash
+#endif
+
 extern "C" {
 
   void deallocate_vec(uint8_t*, uint64_t);
@@ -40,9 +47,9 @@ extern "C" {
       }
       inline KeyHash GetHash() const {
         if (this->temp_buffer_ != NULL) {
-          return KeyHash(Utility::Hash8BitBytes(temp_buffer_, key_length_));
+          return KeyHash(FASTER_C_KEY_HASH::Hash(temp_buffer_, key_length_));
         }
-        return KeyHash(Utility::Hash8BitBytes(buffer(), key_length_));
+        return KeyHash(FASTER_C_KEY_HASH::Hash(buffer(), key_length_));
       }
 
       /// Comparison operators.
@@ -74,6 +81,7 @@ extern "C" {
   class ReadContext;
   class UpsertContext;
   class RmwContext;
+  class DeleteContext;
 
   class GenLock {
   public:
@@ -155,12 +163,14 @@ extern "C" {
     }
 
     inline uint32_t size() const {
-      return size_;
+      // A tombstone's value is left zero-initialized, but still occupies a bare Value.
+      return size_ == 0 ? sizeof(Value) : size_;
     }
 
     friend class ReadContext;
     friend class UpsertContext;
     friend class RmwContext;
+    friend class DeleteContext;
 
   private:
     AtomicGenLock gen_lock_;
@@ -397,6 +407,38 @@ extern "C" {
     uint64_t new_length_;
   };
 
+  class DeleteContext : public IAsyncContext {
+  public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    DeleteContext(const uint8_t* key, uint64_t key_length)
+      : key_{ key, key_length } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    DeleteContext(const DeleteContext& other)
+      : key_{ other.key_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline uint32_t value_size() const {
+      return sizeof(Value);
+    }
+
+  protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+  private:
+    Key key_;
+  };
+
   enum store_type {
       NULL_DISK,
       FILESYSTEM_DISK,
@@ -496,6 +538,25 @@ extern "C" {
     return static_cast<uint8_t>(result);
   }
 
+  uint8_t faster_delete(faster_t* faster_t, const uint8_t* key, const uint64_t key_length,
+                        const uint64_t monotonic_serial_number) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      CallbackContext<DeleteContext> context { ctxt };
+    };
+
+    DeleteContext context{ key, key_length };
+    Status result;
+    switch (faster_t->type) {
+      case NULL_DISK:
+        result = faster_t->obj.null_store->Delete(context, callback, monotonic_serial_number);
+        break;
+      case FILESYSTEM_DISK:
+        result = faster_t->obj.store->Delete(context, callback, monotonic_serial_number);
+        break;
+    }
+    return static_cast<uint8_t>(result);
+  }
+
   // It is up to the caller to dealloc faster_checkpoint_result*
   // first token, then struct
   faster_checkpoint_result* faster_checkpoint(faster_t* faster_t) {
@@ -5,11 +5,13 @@
 
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cinttypes>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <type_traits>
+#include <vector>
 
 #include "device/file_system_disk.h"
 
@@ -22,14 +24,21 @@
 #include "guid.h"
 #include "hash_table.h"
 #include "internal_contexts.h"
+#include "io_throttle.h"
 #include "key_hash.h"
+#include "log_filters.h"
+#include "log_scan.h"
 #include "malloc_fixed_page_size.h"
+#include "memory_policy.h"
 #include "persistent_memory_malloc.h"
 #include "record.h"
+#include "record_size_predictor.h"
 #include "recovery_status.h"
 #include "state_transitions.h"
+#include "statistics.h"
 #include "status.h"
 #include "utility.h"
+#include "wakeup_event.h"
 
 using namespace std::chrono_literals;
 
@@ -67,7 +76,7 @@ class alignas(Constants::kCacheLineBytes) ThreadContext {
   ExecutionContext contexts_[2];
   uint8_t cur_;
 };
-static_assert(sizeof(ThreadContext) == 448, "sizeof(ThreadContext) != 448");
+static_assert(sizeof(ThreadContext) == 256, "sizeof(ThreadContext) != 256");
 
 /// The FASTER key-value store.
 template <class K, class V, class D>
@@ -90,14 +99,31 @@ class FasterKv {
   typedef AsyncPendingReadContext<key_t> async_pending_read_context_t;
   typedef AsyncPendingUpsertContext<key_t> async_pending_upsert_context_t;
   typedef AsyncPendingRmwContext<key_t> async_pending_rmw_context_t;
+  typedef AsyncPendingDeleteContext<key_t> async_pending_delete_context_t;
 
+  /// "max_num_threads" is the number of threads (more precisely, one more than the highest
+  /// Thread::id()) that may use the store at once; per-thread state is sized to match.
+  /// "log_memory" and "index_memory" say how the hybrid log's in-memory pages and the hash index
+  /// are backed (huge pages, NUMA placement, prefaulting).
   FasterKv(uint64_t table_size, uint64_t log_size, const std::string& filename,
-           double log_mutable_fraction = 0.9)
-    : min_table_size_{ table_size }
+           double log_mutable_fraction = 0.9, bool copy_reads_to_tail = false,
+           uint32_t max_num_threads = Thread::DefaultMaxNumThreads(),
+           const MemoryPolicy& log_memory = MemoryPolicy{},
+           const MemoryPolicy& index_memory = MemoryPolicy{})
+    : epoch_{ max_num_threads }
     , disk{ filename, epoch_ }
-    , hlog{ log_size, epoch_, disk, disk.log(), log_mutable_fraction }
+    , hlog{ log_size, epoch_, disk, disk.log(), log_mutable_fraction, log_memory }
+    , copy_reads_to_tail_{ copy_reads_to_tail }
+    , min_table_size_{ table_size }
     , system_state_{ Action::None, Phase::REST, 1 }
-    , num_pending_ios{ 0 } {
+    , checkpoint_{ max_num_threads }
+    , io_throttle_{ max_num_threads }
+    , thread_contexts_{ max_num_threads }
+    , thread_wakeups_{ max_num_threads }
+    , thread_stats_{ max_num_threads } {
+    if(max_num_threads == 0 || max_num_threads > Thread::kMaxNumThreads) {
+      throw std::invalid_argument{ " Invalid max_num_threads" };
+    }
     if(!Utility::IsPowerOfTwo(table_size)) {
       throw std::invalid_argument{ " Size is not a power of 2" };
     }
@@ -106,8 +132,11 @@ class FasterKv {
     }
 
     resize_info_.version = 0;
+    state_[0].set_memory_policy(index_memory);
+    state_[1].set_memory_policy(index_memory);
     state_[0].Initialize(table_size, disk.log().alignment());
     overflow_buckets_allocator_[0].Initialize(disk.log().alignment(), epoch_);
+    hlog.SetPageReadOnlyCallback(BuildPageFilter, this);
   }
 
   // No copy constructor.
@@ -129,9 +158,27 @@ class FasterKv {
 
   template <class MC>
   inline Status Rmw(MC& context, AsyncCallback callback, uint64_t monotonic_serial_num);
-  /// Delete() not yet implemented!
-  // void Delete(const Key& key, Context& context, uint64_t lsn);
+
+  template <class DC>
+  inline Status Delete(DC& context, AsyncCallback callback, uint64_t monotonic_serial_num);
+
+  /// Batched store interface: performs the operation on each of the "count" contexts, and stores
+  /// its status in "results". Looks up the hash buckets and records of a whole batch of keys before
+  /// performing any of the operations, so that their cache misses overlap.
+  template <class RC>
+  inline void MultiRead(RC* contexts, uint32_t count, AsyncCallback callback,
+                        uint64_t monotonic_serial_num, Status* results);
+
+  template <class UC>
+  inline void MultiUpsert(UC* contexts, uint32_t count, AsyncCallback callback,
+                          uint64_t monotonic_serial_num, Status* results);
+
+  /// Completes this thread's pending operations. With "wait", returns only once they've all
+  /// completed; while only I/O is outstanding, the thread sleeps until an I/O completes.
   inline bool CompletePending(bool wait = false);
+  /// Waits (briefly) for any of this thread's pending operations to make progress; for callers
+  /// that run their own loop around CompletePending().
+  void WaitForPendingRequests();
 
   /// Checkpoint/recovery operations.
   bool Checkpoint(void(*index_persistence_callback)(Status result),
@@ -143,21 +190,57 @@ class FasterKv {
   Status Recover(const Guid& index_token, const Guid& hybrid_log_token, uint32_t& version,
                  std::vector<Guid>& session_ids);
 
+  /// Iterating over the records in a range of the log, e.g.:
+  ///   FasterKv::scan_iterator_t iterator{ store.hlog, store.disk, store.hlog.begin_address.load() };
+  typedef LogScanIterator<key_t, value_t, disk_t> scan_iterator_t;
+
   /// Truncating the head of the log.
   bool ShiftBeginAddress(Address address, GcState::truncate_callback_t truncate_callback,
                          GcState::complete_callback_t complete_callback);
+  /// Copies the live records below "until_address" to the tail of the log, and then truncates the
+  /// log at "until_address".
+  bool Compact(Address until_address, GcState::truncate_callback_t truncate_callback = nullptr,
+               GcState::complete_callback_t complete_callback = nullptr);
 
   /// Make the hash table larger.
   bool GrowIndex(GrowState::callback_t caller_callback);
+  /// Grow the hash table automatically, whenever the average overflow chain gets longer than
+  /// "max_overflow_ratio" buckets; but at most once every "min_interval". Not thread-safe: call
+  /// before starting any sessions.
+  void EnableAutoGrowIndex(double max_overflow_ratio,
+                           std::chrono::milliseconds min_interval = std::chrono::seconds{ 1 },
+                           GrowState::callback_t callback = nullptr);
+  void DisableAutoGrowIndex();
+
+  /// Limit the pending operations with disk reads in flight to "max_thread_ios" per thread, and
+  /// "max_total_ios" across all threads. If "adaptive", each thread's limit adapts to the
+  /// device's latency and throughput, up to "max_thread_ios". Not thread-safe: call before
+  /// starting any sessions.
+  void SetIoLimits(uint32_t max_thread_ios, uint32_t max_total_ios, bool adaptive = true);
+  /// Make the hash table smaller (half the size), e.g., after deleting or truncating many keys.
+  /// If a record that must be moved can't be read from disk, the index keeps its size, and
+  /// "caller_callback" gets the old size.
+  bool ShrinkIndex(GrowState::callback_t caller_callback);
 
   /// Statistics
   inline uint64_t Size() const {
     return hlog.GetTailAddress().control();
   }
+  /// Number of overflow buckets per hash-table bucket.
+  inline double OverflowLoadFactor() const {
+    uint8_t version = resize_info_.version;
+    return static_cast<double>(overflow_buckets_allocator_[version].count().control()) /
+           static_cast<double>(state_[version].size());
+  }
   inline void DumpDistribution() {
     state_[resize_info_.version].DumpDistribution(
       overflow_buckets_allocator_[resize_info_.version]);
   }
+  /// Sums the threads' counters into a snapshot. If "scan_index" is set, also walks the hash
+  /// table to count overflow buckets and chain lengths; that takes time proportional to the
+  /// table's size, and should be done from inside a session (so that a concurrent resize can't
+  /// free the table being scanned).
+  Statistics GetStatistics(bool scan_index = false) const;
 
  private:
   typedef Record<key_t, value_t> record_t;
@@ -173,12 +256,22 @@ class FasterKv {
   template <class C>
   inline OperationStatus InternalRmw(C& pending_context, bool retrying);
 
+  template <class C>
+  inline OperationStatus InternalDelete(C& pending_context);
+
+  template <class C>
+  inline void PrefetchBatch(const C* contexts, uint32_t count) const;
+
   inline OperationStatus InternalRetryPendingRmw(async_pending_rmw_context_t& pending_context);
 
   OperationStatus InternalContinuePendingRead(ExecutionContext& ctx,
       AsyncIOContext& io_context);
   OperationStatus InternalContinuePendingRmw(ExecutionContext& ctx,
       AsyncIOContext& io_context);
+  inline void CopyReadToTail(const async_pending_read_context_t& pending_context,
+                             const record_t* disk_record);
+  inline Status CompactRecord(const record_t& record, Address address,
+                              LogFileReader<disk_t>& reader);
 
   // Find the hash bucket entry, if any, corresponding to the specified hash.
   inline const AtomicHashBucketEntry* FindEntry(KeyHash hash) const;
@@ -189,6 +282,12 @@ class FasterKv {
       HashBucket*& bucket);
   inline Address TraceBackForKeyMatch(const key_t& key, Address from_address,
                                       Address min_offset) const;
+  // Like TraceBackForKeyMatch(), but also follows the chain through records on disk, reading them
+  // synchronously.
+  inline Status TraceBackForKeyMatch(const key_t& key, Address from_address, Address min_offset,
+                                     LogFileReader<disk_t>& reader, Address& match) const;
+  /// Called on refresh, when an automatic grow has been requested.
+  void AutoGrowIndex();
   Address TraceBackForOtherChainStart(uint64_t old_size,  uint64_t new_size, Address from_address,
                                       Address min_address, uint8_t side);
 
@@ -210,9 +309,15 @@ class FasterKv {
   inline Status RetryLater(ExecutionContext& ctx, pending_context_t& pending_context,
                            bool& async);
   inline constexpr uint32_t MinIoRequestSize() const;
+  inline uint32_t FirstReadSize(Address address) const;
+  /// False if the log's filters show that no record in [begin_address, address] holds the key.
+  inline bool MayBeOnDisk(KeyHash hash, Address address) const;
+  static void BuildPageFilter(void* faster, uint32_t page, const uint8_t* buffer);
   inline Status IssueAsyncIoRequest(ExecutionContext& ctx, pending_context_t& pending_context,
                                     bool& async);
 
+  /// "context" must be a deep copy; if the read can't be issued, the request completes with the
+  /// error.
   void AsyncGetFromDisk(Address address, uint32_t num_records, AsyncIOCallback callback,
                         AsyncIOContext& context);
   static void AsyncGetFromDiskCallback(IAsyncContext* ctxt, Status result,
@@ -236,8 +341,10 @@ class FasterKv {
   Status ReadIndexMetadata(const Guid& token);
   Status WriteCprMetadata();
   Status ReadCprMetadata(const Guid& token);
+  Status WriteLogFilters();
+  Status ReadLogFilters(const Guid& token);
   Status WriteCprContext();
-  Status ReadCprContexts(const Guid& token, const Guid* guids);
+  Status ReadCprContexts(const Guid& token, const std::vector<Guid>& guids);
 
   Status RecoverHybridLog();
   Status RecoverHybridLogFromSnapshotFile();
@@ -248,9 +355,19 @@ class FasterKv {
 
   inline void HeavyEnter();
   bool CleanHashTableBuckets();
+  inline void ResizeHashTableBuckets();
   void SplitHashTableBuckets();
+  void MergeHashTableBuckets();
+  void FinishResizeHashTableBuckets();
   void AddHashEntry(HashBucket*& bucket, uint32_t& next_idx, uint8_t version,
                     HashBucketEntry entry);
+  /// Copies the latest record for each key in the chain at "from_address" to the tail of the
+  /// log, chained in front of "to_address"; returns the start of the combined chain.
+  Status RelocateChain(Address from_address, Address to_address, LogFileReader<disk_t>& reader,
+                       Address& new_address);
+  /// Like BlockAllocate(), but for threads that are resizing the hash table, which must not
+  /// Refresh().
+  inline Address BlockAllocateDuringResize(uint32_t record_size);
 
   /// Access the current and previous (thread-local) execution contexts.
   const ExecutionContext& thread_ctx() const {
@@ -263,6 +380,15 @@ class FasterKv {
     return thread_contexts_[Thread::id()].prev();
   }
 
+  /// This thread's statistics counters.
+  ThreadStatistics& thread_stats() const {
+    return thread_stats_[Thread::id()];
+  }
+  /// Signaled when one of this thread's disk reads completes.
+  WakeupEvent& thread_wakeup() {
+    return thread_wakeups_[Thread::id()];
+  }
+
  private:
   LightEpoch epoch_;
 
@@ -271,12 +397,19 @@ class FasterKv {
   hlog_t hlog;
 
  private:
-  static constexpr bool kCopyReadsToTail = false;
   static constexpr uint64_t kGcHashTableChunkSize = 16384;
   static constexpr uint64_t kGrowHashTableChunkSize = 16384;
+  /// Times ShrinkIndex() tries to read a record from disk, before giving up.
+  static constexpr uint32_t kMaxRelocateReadAttempts = 3;
+  /// Number of keys whose hash buckets and records MultiRead() and MultiUpsert() prefetch at once.
+  static constexpr uint32_t kMultiOpBatchSize = 16;
 
   bool fold_over_snapshot = true;
 
+  /// If set, records that Read() fetches from disk are copied to the tail of the log, so that
+  /// subsequent reads of the same key are served from memory.
+  bool copy_reads_to_tail_;
+
   /// Initial size of the table
   uint64_t min_table_size_;
 
@@ -298,12 +431,25 @@ class FasterKv {
   GcState gc_;
   /// Grow (hash table) state.
   GrowState grow_;
+  AutoGrowPolicy auto_grow_;
+
+  /// Limits the disk reads in flight, per thread and in total.
+  IoThrottle io_throttle_;
+  /// Sizes of records read from disk, to size the first read of the next.
+  RecordSizePredictor record_sizes_;
+  /// Bloom filters over the keys of the log's read-only pages.
+  LogFilters log_filters_;
 
-  /// Global count of pending I/Os, used for throttling.
-  std::atomic<uint64_t> num_pending_ios;
+  /// Space for two contexts per thread.
+  ThreadArray<ThreadContext> thread_contexts_;
 
-  /// Space for two contexts per thread, stored inline.
-  ThreadContext thread_contexts_[Thread::kMaxNumThreads];
+  ThreadArray<WakeupEvent> thread_wakeups_;
+
+  /// Statistics: per-thread counters, summed by GetStatistics(), and action durations.
+  mutable ThreadArray<ThreadStatistics> thread_stats_;
+  PhaseTimer checkpoint_timer_;
+  PhaseTimer gc_timer_;
+  PhaseTimer grow_timer_;
 };
 
 // Implementations.
@@ -313,6 +459,9 @@ inline Guid FasterKv<K, V, D>::StartSession() {
   if(state.phase != Phase::REST) {
     throw std::runtime_error{ "Can acquire only in REST phase!" };
   }
+  if(Thread::id() >= thread_contexts_.size()) {
+    throw std::runtime_error{ "Too many threads!" };
+  }
   thread_ctx().Initialize(state.phase, state.version, Guid::Create(), 0);
   Refresh();
   return thread_ctx().guid;
@@ -329,6 +478,9 @@ inline uint64_t FasterKv<K, V, D>::ContinueSession(const Guid& session_id) {
   if(state.phase != Phase::REST) {
     throw std::runtime_error{ "Can continue only in REST phase!" };
   }
+  if(Thread::id() >= thread_contexts_.size()) {
+    throw std::runtime_error{ "Too many threads!" };
+  }
   thread_ctx().Initialize(state.phase, state.version, session_id, iter->second);
   Refresh();
   return iter->second;
@@ -337,9 +489,16 @@ inline uint64_t FasterKv<K, V, D>::ContinueSession(const Guid& session_id) {
 template <class K, class V, class D>
 inline void FasterKv<K, V, D>::Refresh() {
   epoch_.ProtectAndDrain();
+  // Submit any I/Os that this thread has batched.
+  disk.FlushSubmissions();
+  // Don't hold on to a share of the I/O limit that this thread isn't using.
+  io_throttle_.GiveBack(io_throttle_.window());
   // We check if we are in normal mode
   SystemState new_state = system_state_.load();
   if(thread_ctx().phase == Phase::REST && new_state.phase == Phase::REST) {
+    if(auto_grow_.requested.load(std::memory_order_relaxed)) {
+      AutoGrowIndex();
+    }
     return;
   }
   HandleSpecialPhases();
@@ -365,6 +524,7 @@ inline void FasterKv<K, V, D>::StopSession() {
 
   assert(thread_ctx().phase == Phase::REST);
 
+  io_throttle_.Release(io_throttle_.window());
   epoch_.Unprotect();
 }
 
@@ -378,18 +538,14 @@ inline const AtomicHashBucketEntry* FasterKv<K, V, D>::FindEntry(KeyHash hash) c
   while(true) {
     // Search through the bucket looking for our key. Last entry is reserved
     // for the overflow pointer.
-    for(uint32_t entry_idx = 0; entry_idx < HashBucket::kNumEntries; ++entry_idx) {
+    for(uint32_t matches = bucket->TagEntries(hash.tag(), false); matches;
+        matches &= matches - 1) {
+      uint32_t entry_idx = Utility::CountTrailingZeros(matches);
       HashBucketEntry entry = bucket->entries[entry_idx].load();
-      if(entry.unused()) {
-        continue;
-      }
-      if(hash.tag() == entry.tag()) {
+      if(!entry.unused() && hash.tag() == entry.tag() && !entry.tentative()) {
         // Found a matching tag. (So, the input hash matches the entry on 14 tag bits +
-        // log_2(table size) address bits.)
-        if(!entry.tentative()) {
-          // If (final key, return immediately)
-          return &bucket->entries[entry_idx];
-        }
+        // log_2(table size) address bits.) Return immediately.
+        return &bucket->entries[entry_idx];
       }
     }
 
@@ -416,22 +572,24 @@ inline AtomicHashBucketEntry* FasterKv<K, V, D>::FindTentativeEntry(KeyHash hash
   while(true) {
     // Search through the bucket looking for our key. Last entry is reserved
     // for the overflow pointer.
-    for(uint32_t entry_idx = 0; entry_idx < HashBucket::kNumEntries; ++entry_idx) {
+    for(uint32_t matches = bucket->TagEntries(hash.tag(), false); matches;
+        matches &= matches - 1) {
+      uint32_t entry_idx = Utility::CountTrailingZeros(matches);
       HashBucketEntry entry = bucket->entries[entry_idx].load();
-      if(entry.unused()) {
-        if(!atomic_entry) {
-          // Found a free slot; keep track of it, and continue looking for a match.
-          atomic_entry = &bucket->entries[entry_idx];
-        }
-        continue;
-      }
-      if(hash.tag() == entry.tag() && !entry.tentative()) {
+      if(!entry.unused() && hash.tag() == entry.tag() && !entry.tentative()) {
         // Found a match. (So, the input hash matches the entry on 14 tag bits +
         // log_2(table size) address bits.) Return it to caller.
         expected_entry = entry;
         return &bucket->entries[entry_idx];
       }
     }
+    if(!atomic_entry) {
+      uint32_t free_entries = bucket->FreeEntries();
+      if(free_entries) {
+        // Found a free slot; keep track of it, and continue looking for a match.
+        atomic_entry = &bucket->entries[Utility::CountTrailingZeros(free_entries)];
+      }
+    }
     // Go to next bucket in the chain
     HashBucketOverflowEntry overflow_entry = bucket->overflow_entry.load();
     if(overflow_entry.unused()) {
@@ -454,6 +612,11 @@ inline AtomicHashBucketEntry* FasterKv<K, V, D>::FindTentativeEntry(KeyHash hash
         overflow_buckets_allocator_[version].FreeAtEpoch(new_bucket_addr, 0);
       } else {
         // Install succeeded; we have a new bucket on the chain. Return its first slot.
+        if(auto_grow_.enabled() && new_bucket_addr.control() >
+            auto_grow_.max_overflow_ratio * state_[version].size()) {
+          // Chains are getting long; ask the next thread to refresh to grow the index.
+          auto_grow_.requested.store(true, std::memory_order_relaxed);
+        }
         bucket = &overflow_buckets_allocator_[version].Get(new_bucket_addr);
         assert(expected_entry == HashBucketEntry::kInvalidEntry);
         return &bucket->entries[0];
@@ -472,7 +635,8 @@ bool FasterKv<K, V, D>::HasConflictingEntry(KeyHash hash, const HashBucket* buck
     const AtomicHashBucketEntry* atomic_entry) const {
   uint16_t tag = atomic_entry->load().tag();
   while(true) {
-    for(uint32_t entry_idx = 0; entry_idx < HashBucket::kNumEntries; ++entry_idx) {
+    for(uint32_t matches = bucket->TagEntries(tag, true); matches; matches &= matches - 1) {
+      uint32_t entry_idx = Utility::CountTrailingZeros(matches);
       HashBucketEntry entry = bucket->entries[entry_idx].load();
       if(entry != HashBucketEntry::kInvalidEntry &&
           entry.tag() == tag &&
@@ -528,6 +692,9 @@ inline AtomicHashBucketEntry* FasterKv<K, V, D>::FindOrCreateEntry(KeyHash hash,
         atomic_entry->store(expected_entry);
         return atomic_entry;
       }
+    } else {
+      // Another thread took the free slot.
+      thread_stats().cas_failures.Increment();
     }
   }
   assert(false);
@@ -545,6 +712,7 @@ inline Status FasterKv<K, V, D>::Read(RC& context, AsyncCallback callback,
   static_assert(alignof(value_t) == alignof(typename read_context_t::value_t),
                 "alignof(value_t) != alignof(typename read_context_t::value_t)");
 
+  thread_stats().reads.Increment();
   pending_read_context_t pending_context{ context, callback };
   OperationStatus internal_status = InternalRead(pending_context);
   Status status;
@@ -572,6 +740,7 @@ inline Status FasterKv<K, V, D>::Upsert(UC& context, AsyncCallback callback,
   static_assert(alignof(value_t) == alignof(typename upsert_context_t::value_t),
                 "alignof(value_t) != alignof(typename upsert_context_t::value_t)");
 
+  thread_stats().upserts.Increment();
   pending_upsert_context_t pending_context{ context, callback };
   OperationStatus internal_status = InternalUpsert(pending_context);
   Status status;
@@ -597,6 +766,7 @@ inline Status FasterKv<K, V, D>::Rmw(MC& context, AsyncCallback callback,
   static_assert(alignof(value_t) == alignof(typename rmw_context_t::value_t),
                 "alignof(value_t) != alignof(typename rmw_context_t::value_t)");
 
+  thread_stats().rmws.Increment();
   pending_rmw_context_t pending_context{ context, callback };
   OperationStatus internal_status = InternalRmw(pending_context, false);
   Status status;
@@ -610,6 +780,83 @@ inline Status FasterKv<K, V, D>::Rmw(MC& context, AsyncCallback callback,
   return status;
 }
 
+template <class K, class V, class D>
+template <class DC>
+inline Status FasterKv<K, V, D>::Delete(DC& context, AsyncCallback callback,
+                                        uint64_t monotonic_serial_num) {
+  typedef DC delete_context_t;
+  typedef PendingDeleteContext<DC> pending_delete_context_t;
+  static_assert(std::is_base_of<value_t, typename delete_context_t::value_t>::value,
+                "value_t is not a base class of delete_context_t::value_t");
+  static_assert(alignof(value_t) == alignof(typename delete_context_t::value_t),
+                "alignof(value_t) != alignof(typename delete_context_t::value_t)");
+
+  thread_stats().deletes.Increment();
+  pending_delete_context_t pending_context{ context, callback };
+  OperationStatus internal_status = InternalDelete(pending_context);
+  Status status;
+  if(internal_status == OperationStatus::SUCCESS) {
+    status = Status::Ok;
+  } else if(internal_status == OperationStatus::NOT_FOUND) {
+    status = Status::NotFound;
+  } else {
+    bool async;
+    status = HandleOperationStatus(thread_ctx(), pending_context, internal_status, async);
+  }
+  thread_ctx().serial_num = monotonic_serial_num;
+  return status;
+}
+
+template <class K, class V, class D>
+template <class RC>
+inline void FasterKv<K, V, D>::MultiRead(RC* contexts, uint32_t count, AsyncCallback callback,
+    uint64_t monotonic_serial_num, Status* results) {
+  for(uint32_t begin = 0; begin < count; begin += kMultiOpBatchSize) {
+    uint32_t end = count - begin < kMultiOpBatchSize ? count : begin + kMultiOpBatchSize;
+    PrefetchBatch(contexts + begin, end - begin);
+    for(uint32_t idx = begin; idx < end; ++idx) {
+      results[idx] = Read(contexts[idx], callback, monotonic_serial_num);
+    }
+  }
+}
+
+template <class K, class V, class D>
+template <class UC>
+inline void FasterKv<K, V, D>::MultiUpsert(UC* contexts, uint32_t count, AsyncCallback callback,
+    uint64_t monotonic_serial_num, Status* results) {
+  for(uint32_t begin = 0; begin < count; begin += kMultiOpBatchSize) {
+    uint32_t end = count - begin < kMultiOpBatchSize ? count : begin + kMultiOpBatchSize;
+    PrefetchBatch(contexts + begin, end - begin);
+    for(uint32_t idx = begin; idx < end; ++idx) {
+      results[idx] = Upsert(contexts[idx], callback, monotonic_serial_num);
+    }
+  }
+}
+
+template <class K, class V, class D>
+template <class C>
+inline void FasterKv<K, V, D>::PrefetchBatch(const C* contexts, uint32_t count) const {
+  assert(count <= kMultiOpBatchSize);
+  KeyHash hashes[kMultiOpBatchSize];
+  // Hash all the keys, and prefetch their hash buckets.
+  const InternalHashTable<disk_t>& table = state_[resize_info_.version];
+  for(uint32_t idx = 0; idx < count; ++idx) {
+    hashes[idx] = contexts[idx].key().GetHash();
+    Utility::Prefetch(&table.bucket(hashes[idx]));
+  }
+  // Then prefetch the (in-memory) records that the hash bucket entries point to.
+  Address head_address = hlog.head_address.load();
+  for(uint32_t idx = 0; idx < count; ++idx) {
+    const AtomicHashBucketEntry* atomic_entry = FindEntry(hashes[idx]);
+    if(atomic_entry) {
+      Address address = atomic_entry->load().address();
+      if(address >= head_address) {
+        Utility::Prefetch(hlog.Get(address));
+      }
+    }
+  }
+}
+
 template <class K, class V, class D>
 inline bool FasterKv<K, V, D>::CompletePending(bool wait) {
   do {
@@ -633,22 +880,55 @@ inline bool FasterKv<K, V, D>::CompletePending(bool wait) {
     if(done) {
       return true;
     }
+    if(wait) {
+      WaitForPendingRequests();
+    }
   } while(wait);
   return false;
 }
 
+template <class K, class V, class D>
+inline void FasterKv<K, V, D>::WaitForPendingRequests() {
+  if(!thread_ctx().io_responses.empty()) {
+    return;
+  }
+  if(thread_ctx().phase != Phase::REST || !thread_ctx().retry_requests.empty()) {
+    // Waiting on other threads (to finish a checkpoint, say), not just on I/O; nobody signals
+    // that, so wait a bounded time, or until one of this thread's reads completes.
+    thread_wakeup().WaitFor(Constants::kIoWaitMicros);
+    return;
+  }
+  // Handlers that execute completions on the calling thread wait in the kernel, thread-pool
+  // handlers until a completion thread executes a completion; if none of the completions is
+  // ours, wait to be signaled.
+  if(!disk.WaitForCompletion(Constants::kIoWaitMicros)) {
+    thread_wakeup().WaitFor(Constants::kIoWaitMicros);
+  }
+}
+
 template <class K, class V, class D>
 inline void FasterKv<K, V, D>::CompleteIoPendingRequests(ExecutionContext& context) {
   AsyncIOContext* ctxt;
   // Clear this thread's I/O response queue. (Does not clear I/Os issued by this thread that have
   // not yet completed.)
-  while(context.io_responses.try_pop(ctxt)) {
+  while(context.io_responses.TryPop(ctxt)) {
     CallbackContext<AsyncIOContext> io_context{ ctxt };
     CallbackContext<pending_context_t> pending_context{ io_context->caller_context };
     // This I/O is no longer pending, since we popped its response off the queue.
-    auto pending_io = context.pending_ios.find(io_context->io_id);
-    assert(pending_io != context.pending_ios.end());
-    context.pending_ios.erase(pending_io);
+    bool erased = context.pending_ios.Erase(io_context->io_id);
+    assert(erased);
+
+    ThreadStatistics& stats = thread_stats();
+    stats.disk_hits.Increment();
+    stats.io_reads.Add(io_context->num_reads);
+    stats.io_bytes.Add(io_context->bytes_read);
+    stats.io_latency_ns.Add(PhaseTimer::NowNs() - io_context->start_ns);
+
+    if(pending_context->result != Status::Ok) {
+      // The read failed, so there's no record to continue with.
+      pending_context->caller_callback(pending_context->caller_context, pending_context->result);
+      continue;
+    }
 
     // Issue the continue command
     OperationStatus internal_status;
@@ -677,8 +957,8 @@ template <class K, class V, class D>
 inline void FasterKv<K, V, D>::CompleteRetryRequests(ExecutionContext& context) {
   // If we can't complete a request, it will be pushed back onto the deque. Retry each request
   // only once.
-  size_t size = context.retry_requests.size();
-  for(size_t idx = 0; idx < size; ++idx) {
+  uint32_t size = context.retry_requests.size();
+  for(uint32_t idx = 0; idx < size; ++idx) {
     CallbackContext<pending_context_t> pending_context{ context.retry_requests.front() };
     context.retry_requests.pop_front();
     // Issue retry command
@@ -692,6 +972,10 @@ inline void FasterKv<K, V, D>::CompleteRetryRequests(ExecutionContext& context)
       internal_status = InternalUpsert(
                           *static_cast<async_pending_upsert_context_t*>(pending_context.get()));
       break;
+    case OperationType::Delete:
+      internal_status = InternalDelete(
+                          *static_cast<async_pending_delete_context_t*>(pending_context.get()));
+      break;
     default:
       assert(false);
       throw std::runtime_error{ "Cannot happen!" };
@@ -700,6 +984,8 @@ inline void FasterKv<K, V, D>::CompleteRetryRequests(ExecutionContext& context)
     Status result;
     if(internal_status == OperationStatus::SUCCESS) {
       result = Status::Ok;
+    } else if(internal_status == OperationStatus::NOT_FOUND) {
+      result = Status::NotFound;
     } else {
       result = HandleOperationStatus(context, *pending_context.get(), internal_status,
                                      pending_context.async);
@@ -764,12 +1050,20 @@ inline OperationStatus FasterKv<K, V, D>::InternalRead(C& pending_context) const
   if(address >= safe_read_only_address) {
     // Mutable or fuzzy region
     // concurrent read
+    if(reinterpret_cast<const record_t*>(hlog.Get(address))->header.tombstone) {
+      return OperationStatus::NOT_FOUND;
+    }
     pending_context.GetAtomic(hlog.Get(address));
+    thread_stats().mutable_hits.Increment();
     return OperationStatus::SUCCESS;
   } else if(address >= head_address) {
     // Immutable region
     // single-thread read
+    if(reinterpret_cast<const record_t*>(hlog.Get(address))->header.tombstone) {
+      return OperationStatus::NOT_FOUND;
+    }
     pending_context.Get(hlog.Get(address));
+    thread_stats().read_only_hits.Increment();
     return OperationStatus::SUCCESS;
   } else if(address >= begin_address) {
     // Record not available in-memory
@@ -817,7 +1111,8 @@ inline OperationStatus FasterKv<K, V, D>::InternalUpsert(C& pending_context) {
   // The common case
   if(thread_ctx().phase == Phase::REST && address >= read_only_address) {
     record_t* record = reinterpret_cast<record_t*>(hlog.Get(address));
-    if(pending_context.PutAtomic(record)) {
+    if(!record->header.tombstone && pending_context.PutAtomic(record)) {
+      thread_stats().mutable_hits.Increment();
       return OperationStatus::SUCCESS;
     } else {
       // Must retry as RCU.
@@ -887,8 +1182,9 @@ inline OperationStatus FasterKv<K, V, D>::InternalUpsert(C& pending_context) {
     }
     // We acquired the necessary locks, so so we can update the record's bucket atomically.
     record_t* record = reinterpret_cast<record_t*>(hlog.Get(address));
-    if(pending_context.PutAtomic(record)) {
+    if(!record->header.tombstone && pending_context.PutAtomic(record)) {
       // Host successfully replaced record, atomically.
+      thread_stats().mutable_hits.Increment();
       return OperationStatus::SUCCESS;
     } else {
       // Must retry as RCU.
@@ -912,9 +1208,11 @@ create_record:
 
   if(atomic_entry->compare_exchange_strong(expected_entry, updated_entry)) {
     // Installed the new record in the hash table.
+    thread_stats().appends.Increment();
     return OperationStatus::SUCCESS;
   } else {
     // Try again.
+    thread_stats().cas_failures.Increment();
     record->header.invalid = true;
     return InternalUpsert(pending_context);
   }
@@ -961,8 +1259,9 @@ inline OperationStatus FasterKv<K, V, D>::InternalRmw(C& pending_context, bool r
   // The common case.
   if(phase == Phase::REST && address >= read_only_address) {
     record_t* record = reinterpret_cast<record_t*>(hlog.Get(address));
-    if(pending_context.RmwAtomic(record)) {
+    if(!record->header.tombstone && pending_context.RmwAtomic(record)) {
       // In-place RMW succeeded.
+      thread_stats().mutable_hits.Increment();
       return OperationStatus::SUCCESS;
     } else {
       // Must retry as RCU.
@@ -1042,8 +1341,9 @@ inline OperationStatus FasterKv<K, V, D>::InternalRmw(C& pending_context, bool r
     }
     // We acquired the necessary locks, so so we can update the record's bucket atomically.
     record_t* record = reinterpret_cast<record_t*>(hlog.Get(address));
-    if(pending_context.RmwAtomic(record)) {
+    if(!record->header.tombstone && pending_context.RmwAtomic(record)) {
       // In-place RMW succeeded.
+      thread_stats().mutable_hits.Increment();
       return OperationStatus::SUCCESS;
     } else {
       // Must retry as RCU.
@@ -1075,9 +1375,13 @@ inline OperationStatus FasterKv<K, V, D>::InternalRmw(C& pending_context, bool r
   // Create a record and attempt RCU.
 create_record:
   uint32_t record_size;
-  const record_t* old_record;
-  if (address >= head_address) {
+  const record_t* old_record = nullptr;
+  bool old_record_deleted = false;
+  if(address >= head_address) {
     old_record = reinterpret_cast<const record_t*>(hlog.Get(address));
+    old_record_deleted = old_record->header.tombstone;
+  }
+  if(old_record && !old_record_deleted) {
     record_size = record_t::size(key, pending_context.value_size(old_record));
   } else {
     record_size = record_t::size(key, pending_context.value_size());
@@ -1099,7 +1403,9 @@ create_record:
       static_cast<uint16_t>(version), true, false, false,
       expected_entry.address() },
     key };
-  if(address < hlog.begin_address.load()) {
+  if(address < hlog.begin_address.load() || old_record_deleted) {
+    // No previous value, or the key was deleted; (we don't need to read the tombstone, so it's
+    // fine if it was evicted after we allocated the new record).
     pending_context.RmwInitial(new_record);
   } else if(address >= head_address) {
     pending_context.RmwCopy(old_record, new_record);
@@ -1117,9 +1423,14 @@ create_record:
 
   HashBucketEntry updated_entry{ new_address, hash.tag(), false };
   if(atomic_entry->compare_exchange_strong(expected_entry, updated_entry)) {
+    if(old_record && !old_record_deleted) {
+      thread_stats().read_only_hits.Increment();
+    }
+    thread_stats().appends.Increment();
     return OperationStatus::SUCCESS;
   } else {
     // CAS failed; try again.
+    thread_stats().cas_failures.Increment();
     new_record->header.invalid = true;
     if(!retrying) {
       pending_context.go_async(phase, version, address, expected_entry);
@@ -1130,6 +1441,148 @@ create_record:
   }
 }
 
+template <class K, class V, class D>
+template <class C>
+inline OperationStatus FasterKv<K, V, D>::InternalDelete(C& pending_context) {
+  typedef C pending_delete_context_t;
+
+  if(thread_ctx().phase != Phase::REST) {
+    HeavyEnter();
+  }
+
+  const key_t& key = pending_context.key();
+  KeyHash hash = key.GetHash();
+  AtomicHashBucketEntry* atomic_entry = const_cast<AtomicHashBucketEntry*>(FindEntry(hash));
+  if(!atomic_entry) {
+    // No record found, so nothing to delete.
+    return OperationStatus::NOT_FOUND;
+  }
+
+  HashBucketEntry expected_entry = atomic_entry->load();
+  Address address = expected_entry.address();
+  Address begin_address = hlog.begin_address.load();
+  Address head_address = hlog.head_address.load();
+  Address read_only_address = hlog.read_only_address.load();
+  uint64_t latest_record_version = 0;
+
+  if(address >= head_address) {
+    // Multiple keys may share the same hash. Try to find the most recent record with a matching
+    // key that we might be able to delete in place.
+    const record_t* record = reinterpret_cast<const record_t*>(hlog.Get(address));
+    latest_record_version = record->header.checkpoint_version;
+    if(key != record->key()) {
+      address = TraceBackForKeyMatch(key, record->header.previous_address(), head_address);
+    }
+  }
+
+  CheckpointLockGuard lock_guard{ checkpoint_locks_, hash };
+
+  // The common case
+  if(thread_ctx().phase == Phase::REST && address >= read_only_address) {
+    record_t* record = reinterpret_cast<record_t*>(hlog.Get(address));
+    if(address == expected_entry.address() &&
+        record->header.previous_address() < begin_address) {
+      // The record is the only one in its hash chain, so we can elide the chain entirely. (If the
+      // CAS fails, someone else changed the chain; the tombstone below still deletes the key.)
+      atomic_entry->compare_exchange_strong(expected_entry,
+                                            HashBucketEntry{ HashBucketEntry::kInvalidEntry });
+    }
+    record->header.tombstone = true;
+    thread_stats().mutable_hits.Increment();
+    return OperationStatus::SUCCESS;
+  }
+
+  // Acquire necessary locks.
+  switch(thread_ctx().phase) {
+  case Phase::PREPARE:
+    // Working on old version (v).
+    if(!lock_guard.try_lock_old()) {
+      pending_context.go_async(thread_ctx().phase, thread_ctx().version, address, expected_entry);
+      return OperationStatus::CPR_SHIFT_DETECTED;
+    } else {
+      if(latest_record_version > thread_ctx().version) {
+        // CPR shift detected: we are in the "PREPARE" phase, and a record has a version later than
+        // what we've seen.
+        pending_context.go_async(thread_ctx().phase, thread_ctx().version, address,
+                                 expected_entry);
+        return OperationStatus::CPR_SHIFT_DETECTED;
+      }
+    }
+    break;
+  case Phase::IN_PROGRESS:
+    // All other threads are in phase {PREPARE,IN_PROGRESS,WAIT_PENDING}.
+    if(latest_record_version < thread_ctx().version) {
+      // Will create new record or update existing record to new version (v+1).
+      if(!lock_guard.try_lock_new()) {
+        pending_context.go_async(thread_ctx().phase, thread_ctx().version, address,
+                                 expected_entry);
+        return OperationStatus::RETRY_LATER;
+      } else {
+        // Update to new version (v+1) requires RCU.
+        goto create_record;
+      }
+    }
+    break;
+  case Phase::WAIT_PENDING:
+    // All other threads are in phase {IN_PROGRESS,WAIT_PENDING,WAIT_FLUSH}.
+    if(latest_record_version < thread_ctx().version) {
+      if(lock_guard.old_locked()) {
+        pending_context.go_async(thread_ctx().phase, thread_ctx().version, address,
+                                 expected_entry);
+        return OperationStatus::RETRY_LATER;
+      } else {
+        // Update to new version (v+1) requires RCU.
+        goto create_record;
+      }
+    }
+    break;
+  case Phase::WAIT_FLUSH:
+    // All other threads are in phase {WAIT_PENDING,WAIT_FLUSH,PERSISTENCE_CALLBACK}.
+    if(latest_record_version < thread_ctx().version) {
+      goto create_record;
+    }
+    break;
+  default:
+    break;
+  }
+
+  if(address >= read_only_address) {
+    // Mutable region; mark the record deleted in place.
+    if(atomic_entry->load() != expected_entry) {
+      // Some other thread may have RCUed the record before we locked it; try again.
+      return OperationStatus::RETRY_NOW;
+    }
+    record_t* record = reinterpret_cast<record_t*>(hlog.Get(address));
+    record->header.tombstone = true;
+    thread_stats().mutable_hits.Increment();
+    return OperationStatus::SUCCESS;
+  }
+
+  // Create a tombstone record and attempt RCU.
+create_record:
+  uint32_t record_size = record_t::size(key, pending_context.value_size());
+  Address new_address = BlockAllocate(record_size);
+  record_t* record = reinterpret_cast<record_t*>(hlog.Get(new_address));
+  new(record) record_t{
+    RecordInfo{
+      static_cast<uint16_t>(thread_ctx().version), true, true, false,
+      expected_entry.address() },
+    key };
+
+  HashBucketEntry updated_entry{ new_address, hash.tag(), false };
+
+  if(atomic_entry->compare_exchange_strong(expected_entry, updated_entry)) {
+    // Installed the tombstone in the hash table.
+    thread_stats().appends.Increment();
+    return OperationStatus::SUCCESS;
+  } else {
+    // Try again.
+    thread_stats().cas_failures.Increment();
+    record->header.invalid = true;
+    return InternalDelete(pending_context);
+  }
+}
+
 template <class K, class V, class D>
 inline OperationStatus FasterKv<K, V, D>::InternalRetryPendingRmw(
   async_pending_rmw_context_t& pending_context) {
@@ -1155,12 +1608,35 @@ inline Address FasterKv<K, V, D>::TraceBackForKeyMatch(const key_t& key, Address
   return from_address;
 }
 
+template <class K, class V, class D>
+inline Status FasterKv<K, V, D>::TraceBackForKeyMatch(const key_t& key, Address from_address,
+    Address min_offset, LogFileReader<disk_t>& reader, Address& match) const {
+  while(from_address >= min_offset) {
+    const record_t* record;
+    if(from_address >= hlog.head_address.load()) {
+      record = reinterpret_cast<const record_t*>(hlog.Get(from_address));
+    } else {
+      record = reader.template ReadRecord<record_t>(from_address);
+      if(!record) {
+        return Status::IOError;
+      }
+    }
+    if(key == record->key()) {
+      break;
+    }
+    from_address = record->header.previous_address();
+  }
+  match = from_address;
+  return Status::Ok;
+}
+
 template <class K, class V, class D>
 inline Status FasterKv<K, V, D>::HandleOperationStatus(ExecutionContext& ctx,
     pending_context_t& pending_context, OperationStatus internal_status, bool& async) {
   async = false;
   switch(internal_status) {
   case OperationStatus::RETRY_NOW:
+    thread_stats().retries.Increment();
     switch(pending_context.type) {
     case OperationType::Read: {
       async_pending_read_context_t& read_context =
@@ -1180,14 +1656,23 @@ inline Status FasterKv<K, V, D>::HandleOperationStatus(ExecutionContext& ctx,
       internal_status = InternalRmw(rmw_context, false);
       break;
     }
+    case OperationType::Delete: {
+      async_pending_delete_context_t& delete_context =
+        *static_cast<async_pending_delete_context_t*>(&pending_context);
+      internal_status = InternalDelete(delete_context);
+      break;
+    }
     }
 
     if(internal_status == OperationStatus::SUCCESS) {
       return Status::Ok;
+    } else if(internal_status == OperationStatus::NOT_FOUND) {
+      return Status::NotFound;
     } else {
       return HandleOperationStatus(ctx, pending_context, internal_status, async);
     }
   case OperationStatus::RETRY_LATER:
+    thread_stats().retries.Increment();
     if(thread_ctx().phase == Phase::PREPARE) {
       assert(pending_context.type == OperationType::RMW);
       // Can I be marking an operation again and again?
@@ -1257,17 +1742,73 @@ inline constexpr uint32_t FasterKv<K, V, D>::MinIoRequestSize() const {
                alignof(value_t)));
 }
 
+template <class K, class V, class D>
+inline uint32_t FasterKv<K, V, D>::FirstReadSize(Address address) const {
+  // Read as much as most records need, so that the first read usually fetches the whole record;
+  // but don't read past the end of the record's page.
+  uint32_t size = record_sizes_.prediction();
+  uint32_t page_remaining = Address::kMaxOffset + 1 - address.offset();
+  if(size > page_remaining) {
+    size = page_remaining;
+  }
+  return size > MinIoRequestSize() ? size : MinIoRequestSize();
+}
+
+template <class K, class V, class D>
+inline bool FasterKv<K, V, D>::MayBeOnDisk(KeyHash hash, Address address) const {
+  return log_filters_.MayContain(hash, hlog.begin_address.load().page(), address.page());
+}
+
+template <class K, class V, class D>
+void FasterKv<K, V, D>::BuildPageFilter(void* faster, uint32_t page, const uint8_t* buffer) {
+  // Collect the hashes of all the page's keys, including those of invalid records and
+  // tombstones, so that the filter can be sized to fit.
+  std::vector<KeyHash> hashes;
+  for(uint64_t offset = 0; offset < hlog_t::kPageSize;) {
+    const record_t* record = reinterpret_cast<const record_t*>(buffer + offset);
+    if(record->header.IsNull()) {
+      // Unused space, at the beginning or end of a page.
+      offset += sizeof(record->header);
+      continue;
+    }
+    hashes.push_back(record->key().GetHash());
+    offset += record->size();
+  }
+  reinterpret_cast<faster_t*>(faster)->log_filters_.Build(page, hashes);
+}
+
 template <class K, class V, class D>
 inline Status FasterKv<K, V, D>::IssueAsyncIoRequest(ExecutionContext& ctx,
     pending_context_t& pending_context, bool& async) {
   // Issue asynchronous I/O request
   uint64_t io_id = thread_ctx().io_id++;
-  thread_ctx().pending_ios.insert({ io_id, pending_context.key().GetHash() });
+  thread_ctx().pending_ios.Insert(io_id, pending_context.key().GetHash());
   async = true;
+  // Throttling: wait for room in this thread's window of requests in flight.
+  IoWindow& window = io_throttle_.window();
+  while(!io_throttle_.TryOpen(window)) {
+    disk.TryComplete();
+    std::this_thread::yield();
+    epoch_.ProtectAndDrain();
+  }
   AsyncIOContext io_request{ this, pending_context.address, &pending_context,
-                             &thread_ctx().io_responses, io_id };
-  AsyncGetFromDisk(pending_context.address, MinIoRequestSize(), AsyncGetFromDiskCallback,
-                   io_request);
+                             &thread_ctx().io_responses, &thread_wakeup(), &window, io_id };
+  io_request.start_ns = PhaseTimer::NowNs();
+  thread_stats().pending.Increment();
+  if(!MayBeOnDisk(pending_context.key().GetHash(), pending_context.address)) {
+    // No record on disk holds the key; complete the request without reading anything.
+    io_request.address = Address::kInvalidAddress;
+    pending_context.result = Status::Ok;
+    IAsyncContext* io_request_copy;
+    RETURN_NOT_OK(io_request.DeepCopy(io_request_copy));
+    static_cast<AsyncIOContext*>(io_request_copy)->CompleteIo();
+    return Status::Pending;
+  }
+  // Deep-copy the request up front, so that it can be completed even if the read can't be issued.
+  IAsyncContext* io_request_copy;
+  RETURN_NOT_OK(io_request.DeepCopy(io_request_copy));
+  AsyncGetFromDisk(pending_context.address, FirstReadSize(pending_context.address),
+                   AsyncGetFromDiskCallback, *static_cast<AsyncIOContext*>(io_request_copy));
   return Status::Pending;
 }
 
@@ -1291,16 +1832,12 @@ inline Address FasterKv<K, V, D>::BlockAllocate(uint32_t record_size) {
 template <class K, class V, class D>
 void FasterKv<K, V, D>::AsyncGetFromDisk(Address address, uint32_t num_records,
     AsyncIOCallback callback, AsyncIOContext& context) {
-  if(epoch_.IsProtected()) {
-    /// Throttling. (Thread pool, unprotected threads are not throttled.)
-    while(num_pending_ios.load() > 120) {
-      disk.TryComplete();
-      std::this_thread::yield();
-      epoch_.ProtectAndDrain();
-    }
+  Status result = hlog.AsyncGetFromDisk(address, num_records, callback, context);
+  if(result != Status::Ok) {
+    // The read wasn't issued; hand the error back to the issuing thread.
+    static_cast<pending_context_t*>(context.caller_context)->result = result;
+    context.CompleteIo();
   }
-  ++num_pending_ios;
-  hlog.AsyncGetFromDisk(address, num_records, callback, context);
 }
 
 template <class K, class V, class D>
@@ -1311,11 +1848,11 @@ void FasterKv<K, V, D>::AsyncGetFromDiskCallback(IAsyncContext* ctxt, Status res
   /// Context stack is: AsyncIOContext, PendingContext.
   pending_context_t* pending_context = static_cast<pending_context_t*>(context->caller_context);
 
-  /// This I/O is finished.
-  --faster->num_pending_ios;
   /// Always "goes async": context is freed by the issuing thread, when processing thread I/O
   /// responses.
   context.async = true;
+  ++context->num_reads;
+  context->bytes_read += bytes_transferred;
 
   pending_context->result = result;
   if(result == Status::Ok) {
@@ -1337,21 +1874,33 @@ void FasterKv<K, V, D>::AsyncGetFromDiskCallback(IAsyncContext* ctxt, Status res
       faster->AsyncGetFromDisk(context->address, record->disk_size(),
                                AsyncGetFromDiskCallback, *context.get());
       context.async = true;
-    } else if(pending_context->key() == record->key()) {
-      //The keys are same, so I/O is complete
-      context->thread_io_responses->push(context.get());
     } else {
-      //keys are not same. I/O is not complete
-      context->address = record->header.previous_address();
-      if(context->address >= faster->hlog.begin_address.load()) {
-        faster->AsyncGetFromDisk(context->address, faster->MinIoRequestSize(),
-                                 AsyncGetFromDiskCallback, *context.get());
-        context.async = true;
+      faster->record_sizes_.Record(record->disk_size());
+      if(pending_context->key() == record->key()) {
+        //The keys are same, so I/O is complete
+        context->CompleteIo();
       } else {
-        // Record not found, so I/O is complete.
-        context->thread_io_responses->push(context.get());
+        //keys are not same. I/O is not complete
+        context->address = record->header.previous_address();
+        // (Only a thread with epoch protection may consult the log's filters, since garbage
+        // collection frees them.)
+        if(context->address >= faster->hlog.begin_address.load() &&
+            (!faster->epoch_.IsProtected() ||
+             faster->MayBeOnDisk(pending_context->key().GetHash(), context->address))) {
+          faster->AsyncGetFromDisk(context->address, faster->FirstReadSize(context->address),
+                                   AsyncGetFromDiskCallback, *context.get());
+          context.async = true;
+        } else {
+          // Record not found, so I/O is complete.
+          context->address = Address::kInvalidAddress;
+          context->CompleteIo();
+        }
       }
     }
+  } else {
+    // The read failed; release the I/O window's slot, and hand the error back to the issuing
+    // thread.
+    context->CompleteIo();
   }
 }
 
@@ -1362,8 +1911,14 @@ OperationStatus FasterKv<K, V, D>::InternalContinuePendingRead(ExecutionContext&
     async_pending_read_context_t* pending_context = static_cast<async_pending_read_context_t*>(
           io_context.caller_context);
     record_t* record = reinterpret_cast<record_t*>(io_context.record.GetValidPointer());
+    if(record->header.tombstone) {
+      return (thread_ctx().version > context.version) ? OperationStatus::NOT_FOUND_UNMARK :
+             OperationStatus::NOT_FOUND;
+    }
     pending_context->Get(record);
-    assert(!kCopyReadsToTail);
+    if(copy_reads_to_tail_) {
+      CopyReadToTail(*pending_context, record);
+    }
     return (thread_ctx().version > context.version) ? OperationStatus::SUCCESS_UNMARK :
            OperationStatus::SUCCESS;
   } else {
@@ -1372,6 +1927,54 @@ OperationStatus FasterKv<K, V, D>::InternalContinuePendingRead(ExecutionContext&
   }
 }
 
+template <class K, class V, class D>
+inline void FasterKv<K, V, D>::CopyReadToTail(const async_pending_read_context_t& pending_context,
+    const record_t* disk_record) {
+  if(thread_ctx().phase != Phase::REST) {
+    // Don't add records to the log while a checkpoint or other state transition is in progress.
+    return;
+  }
+  const key_t& key = pending_context.key();
+  KeyHash hash = key.GetHash();
+  AtomicHashBucketEntry* atomic_entry = const_cast<AtomicHashBucketEntry*>(FindEntry(hash));
+  if(!atomic_entry) {
+    // The key was deleted while we were reading it from disk.
+    return;
+  }
+  HashBucketEntry expected_entry = atomic_entry->load();
+  if(expected_entry != pending_context.entry) {
+    // The hash chain has changed since we went to disk, so the record we read may be stale.
+    return;
+  }
+
+  uint32_t record_size = disk_record->size();
+  Address new_address = BlockAllocate(record_size);
+  record_t* new_record = reinterpret_cast<record_t*>(hlog.Get(new_address));
+  new(new_record) record_t{
+    RecordInfo{
+      static_cast<uint16_t>(thread_ctx().version), true, false, false,
+      expected_entry.address() },
+    key };
+  // Copy the value, as-is, from the record we read from disk.
+  uint32_t header_size = static_cast<uint32_t>(reinterpret_cast<const uint8_t*>(
+                           &disk_record->value()) - reinterpret_cast<const uint8_t*>(disk_record));
+  std::memcpy(&new_record->value(), &disk_record->value(), disk_record->disk_size() - header_size);
+  if(thread_ctx().phase != Phase::REST) {
+    // Allocating a block may have the side effect of advancing the thread context's phase.
+    new_record->header.invalid = true;
+    return;
+  }
+
+  HashBucketEntry updated_entry{ new_address, hash.tag(), false };
+  if(atomic_entry->compare_exchange_strong(expected_entry, updated_entry)) {
+    thread_stats().appends.Increment();
+  } else {
+    // Someone else updated the hash chain; the copy is no longer needed.
+    thread_stats().cas_failures.Increment();
+    new_record->header.invalid = true;
+  }
+}
+
 template <class K, class V, class D>
 OperationStatus FasterKv<K, V, D>::InternalContinuePendingRmw(ExecutionContext& context,
     AsyncIOContext& io_context) {
@@ -1421,16 +2024,23 @@ OperationStatus FasterKv<K, V, D>::InternalContinuePendingRmw(ExecutionContext&
     // The record we read from disk.
     const record_t* disk_record = reinterpret_cast<const record_t*>(
                                     io_context.record.GetValidPointer());
-    pending_context->RmwCopy(disk_record, new_record);
+    if(disk_record->header.tombstone) {
+      // The key was deleted.
+      pending_context->RmwInitial(new_record);
+    } else {
+      pending_context->RmwCopy(disk_record, new_record);
+    }
   }
 
   HashBucketEntry updated_entry{ new_address, hash.tag(), false };
   if(atomic_entry->compare_exchange_strong(expected_entry, updated_entry)) {
     assert(thread_ctx().version >= context.version);
+    thread_stats().appends.Increment();
     return (thread_ctx().version == context.version) ? OperationStatus::SUCCESS :
            OperationStatus::SUCCESS_UNMARK;
   } else {
     // CAS failed; try again.
+    thread_stats().cas_failures.Increment();
     new_record->header.invalid = true;
     pending_context->continue_async(address, expected_entry);
     return OperationStatus::RETRY_NOW;
@@ -1491,9 +2101,10 @@ Status FasterKv<K, V, D>::WriteCprMetadata() {
   if(!file) {
     return Status::IOError;
   }
-  if(std::fwrite(&checkpoint_.log_metadata, sizeof(checkpoint_.log_metadata), 1, file) != 1) {
+  Status result = checkpoint_.log_metadata.Write(file);
+  if(result != Status::Ok) {
     std::fclose(file);
-    return Status::IOError;
+    return result;
   }
   if(std::fclose(file) != 0) {
     return Status::IOError;
@@ -1510,9 +2121,10 @@ Status FasterKv<K, V, D>::ReadCprMetadata(const Guid& token) {
   if(!file) {
     return Status::IOError;
   }
-  if(std::fread(&checkpoint_.log_metadata, sizeof(checkpoint_.log_metadata), 1, file) != 1) {
+  Status result = checkpoint_.log_metadata.Read(file);
+  if(result != Status::Ok) {
     std::fclose(file);
-    return Status::IOError;
+    return result;
   }
   if(std::fclose(file) != 0) {
     return Status::IOError;
@@ -1520,6 +2132,37 @@ Status FasterKv<K, V, D>::ReadCprMetadata(const Guid& token) {
   return Status::Ok;
 }
 
+template <class K, class V, class D>
+Status FasterKv<K, V, D>::WriteLogFilters() {
+  std::string filename = disk.cpr_checkpoint_path(checkpoint_.hybrid_log_token) + "filters.dat";
+  // (This code will need to be refactored into the disk_t interface, if we want to support
+  // unformatted disks.)
+  std::FILE* file = std::fopen(filename.c_str(), "wb");
+  if(!file) {
+    return Status::IOError;
+  }
+  Status result = log_filters_.Write(file);
+  if(std::fclose(file) != 0 && result == Status::Ok) {
+    result = Status::IOError;
+  }
+  return result;
+}
+
+template <class K, class V, class D>
+Status FasterKv<K, V, D>::ReadLogFilters(const Guid& token) {
+  std::string filename = disk.cpr_checkpoint_path(token) + "filters.dat";
+  std::FILE* file = std::fopen(filename.c_str(), "rb");
+  if(!file) {
+    return Status::IOError;
+  }
+  // The checkpoint's filters cover pages that were already read-only, and so whose contents the
+  // recovered log shares.
+  Status result = log_filters_.Read(file, checkpoint_.index_metadata.log_begin_address.page(),
+                                    checkpoint_.log_metadata.final_address.page());
+  std::fclose(file);
+  return result;
+}
+
 template <class K, class V, class D>
 Status FasterKv<K, V, D>::WriteCprContext() {
   std::string filename = disk.cpr_checkpoint_path(checkpoint_.hybrid_log_token);
@@ -1544,9 +2187,8 @@ Status FasterKv<K, V, D>::WriteCprContext() {
 }
 
 template <class K, class V, class D>
-Status FasterKv<K, V, D>::ReadCprContexts(const Guid& token, const Guid* guids) {
-  for(size_t idx = 0; idx < Thread::kMaxNumThreads; ++idx) {
-    const Guid& guid = guids[idx];
+Status FasterKv<K, V, D>::ReadCprContexts(const Guid& token, const std::vector<Guid>& guids) {
+  for(const Guid& guid : guids) {
     if(guid == Guid{}) {
       continue;
     }
@@ -1709,8 +2351,9 @@ Status FasterKv<K, V, D>::RecoverHybridLog() {
 
   for(uint32_t page = start_page; page < end_page; ++page) {
     while(recovery_status.page_status(page) != PageRecoveryStatus::ReadDone) {
-      disk.TryComplete();
-      std::this_thread::sleep_for(10ms);
+      if(!disk.WaitForCompletion(Constants::kIoWaitMicros)) {
+        std::this_thread::yield();
+      }
     }
 
     // handle start and end at non-page boundaries
@@ -1729,8 +2372,9 @@ Status FasterKv<K, V, D>::RecoverHybridLog() {
   // Wait until all pages have been flushed
   for(uint32_t page = start_page; page < end_page; ++page) {
     while(recovery_status.page_status(page) != PageRecoveryStatus::FlushDone) {
-      disk.TryComplete();
-      std::this_thread::sleep_for(10ms);
+      if(!disk.WaitForCompletion(Constants::kIoWaitMicros)) {
+        std::this_thread::yield();
+      }
     }
   }
   return Status::Ok;
@@ -1794,8 +2438,9 @@ Status FasterKv<K, V, D>::RecoverHybridLogFromSnapshotFile() {
 
   for(uint32_t page = start_page; page < end_page; ++page) {
     while(recovery_status.page_status(page) != PageRecoveryStatus::ReadDone) {
-      disk.TryComplete();
-      std::this_thread::sleep_for(10ms);
+      if(!disk.WaitForCompletion(Constants::kIoWaitMicros)) {
+        std::this_thread::yield();
+      }
     }
 
     // Perform recovery if page in fuzzy portion of the log
@@ -1819,8 +2464,9 @@ Status FasterKv<K, V, D>::RecoverHybridLogFromSnapshotFile() {
   // Wait until all pages have been flushed
   for(uint32_t page = start_page; page < end_page; ++page) {
     while(recovery_status.page_status(page) != PageRecoveryStatus::FlushDone) {
-      disk.TryComplete();
-      std::this_thread::sleep_for(10ms);
+      if(!disk.WaitForCompletion(Constants::kIoWaitMicros)) {
+        std::this_thread::yield();
+      }
     }
   }
   return Status::Ok;
@@ -1881,8 +2527,9 @@ Status FasterKv<K, V, D>::RestoreHybridLog() {
   // Wait until all pages have been read.
   for(uint32_t page = start_page; page < end_page; ++page) {
     while(recovery_status.page_status(page) != PageRecoveryStatus::ReadDone) {
-      disk.TryComplete();
-      std::this_thread::sleep_for(10ms);
+      if(!disk.WaitForCompletion(Constants::kIoWaitMicros)) {
+        std::this_thread::yield();
+      }
     }
   }
   // Skip the null page.
@@ -1905,7 +2552,7 @@ void FasterKv<K, V, D>::HeavyEnter() {
     Refresh();
   }
   if(thread_ctx().phase == Phase::GROW_IN_PROGRESS) {
-    SplitHashTableBuckets();
+    ResizeHashTableBuckets();
   }
 }
 
@@ -2070,6 +2717,215 @@ void FasterKv<K, V, D>::SplitHashTableBuckets() {
       break;
     }
   }
+  FinishResizeHashTableBuckets();
+}
+
+template <class K, class V, class D>
+void FasterKv<K, V, D>::MergeHashTableBuckets() {
+  // This thread won't exit until all hash table buckets have been merged.
+  Address begin_address = hlog.begin_address.load();
+  LogFileReader<disk_t> reader{ disk, *hlog.file };
+  for(uint64_t chunk = grow_.next_chunk++; chunk < grow_.num_chunks; chunk = grow_.next_chunk++) {
+    uint64_t old_size = state_[grow_.old_version].size();
+    uint64_t new_size = state_[grow_.new_version].size();
+    assert(old_size == new_size * 2);
+    // Merge this chunk.
+    uint64_t upper_bound;
+    if(grow_.failed.load()) {
+      // The shrink has been abandoned; don't merge any more buckets.
+      upper_bound = 0;
+    } else if(chunk + 1 < grow_.num_chunks) {
+      // All chunks but the last chunk contain kGrowHashTableChunkSize elements.
+      upper_bound = kGrowHashTableChunkSize;
+    } else {
+      // Last chunk might contain more or fewer elements.
+      upper_bound = new_size - (chunk * kGrowHashTableChunkSize);
+    }
+    for(uint64_t idx = 0; idx < upper_bound; ++idx) {
+      // Merge old buckets i and (i + new_size), which both map to new bucket i.
+      HashBucket* new_bucket = &state_[grow_.new_version].bucket(
+                                 chunk * kGrowHashTableChunkSize + idx);
+      HashBucket* last_bucket = new_bucket;
+      uint32_t new_entry_idx = 0;
+      for(uint64_t side = 0; side < 2; ++side) {
+        HashBucket* old_bucket = &state_[grow_.old_version].bucket(
+                                   side * new_size + chunk * kGrowHashTableChunkSize + idx);
+        while(true) {
+          for(uint32_t old_entry_idx = 0; old_entry_idx < HashBucket::kNumEntries; ++old_entry_idx) {
+            HashBucketEntry old_entry = old_bucket->entries[old_entry_idx].load();
+            if(old_entry.unused() || old_entry.address() < begin_address) {
+              // Nothing to do; an entry whose records were all truncated can be dropped.
+              continue;
+            }
+            AtomicHashBucketEntry* match = nullptr;
+            if(side == 1) {
+              // Look for an entry with the same tag, from the other old bucket.
+              for(HashBucket* bucket = new_bucket; bucket && !match; ) {
+                for(uint32_t entry_idx = 0; entry_idx < HashBucket::kNumEntries; ++entry_idx) {
+                  HashBucketEntry entry = bucket->entries[entry_idx].load();
+                  if(!entry.unused() && entry.tag() == old_entry.tag()) {
+                    match = &bucket->entries[entry_idx];
+                    break;
+                  }
+                }
+                HashBucketOverflowEntry overflow_entry = bucket->overflow_entry.load();
+                bucket = overflow_entry.unused() ? nullptr :
+                         &overflow_buckets_allocator_[grow_.new_version].Get(
+                           overflow_entry.address());
+              }
+            }
+            if(!match) {
+              AddHashEntry(last_bucket, new_entry_idx, grow_.new_version, old_entry);
+              continue;
+            }
+            // Both old buckets have a chain for this tag, but the new bucket can hold only one.
+            HashBucketEntry entry = match->load();
+            Address address;
+            if(RelocateChain(old_entry.address(), entry.address(), reader, address) != Status::Ok) {
+              // Some of the chain's records couldn't be read. Rather than drop them, keep the old
+              // index (whose buckets this thread hasn't modified).
+              grow_.failed.store(true);
+              continue;
+            }
+            match->store(HashBucketEntry{ address, entry.tag(), false });
+          }
+          // Go to next bucket in the chain.
+          HashBucketOverflowEntry overflow_entry = old_bucket->overflow_entry.load();
+          if(overflow_entry.unused()) {
+            // No more buckets in the chain.
+            break;
+          }
+          old_bucket = &overflow_buckets_allocator_[grow_.old_version].Get(
+                         overflow_entry.address());
+        }
+      }
+    }
+    // Done with this chunk.
+    if(--grow_.num_pending_chunks == 0) {
+      if(grow_.failed.load()) {
+        // Go back to the old hash table, and free the new one. (Until all chunks are done, no
+        // thread uses either.)
+        resize_info_.version = grow_.old_version;
+        state_[grow_.new_version].Uninitialize();
+        overflow_buckets_allocator_[grow_.new_version].Uninitialize();
+      } else {
+        // Free the old hash table, along with all of its overflow buckets.
+        state_[grow_.old_version].Uninitialize();
+        overflow_buckets_allocator_[grow_.old_version].Uninitialize();
+      }
+      break;
+    }
+  }
+  FinishResizeHashTableBuckets();
+}
+
+template <class K, class V, class D>
+Status FasterKv<K, V, D>::RelocateChain(Address from_address, Address to_address,
+                                        LogFileReader<disk_t>& reader, Address& new_address) {
+  // Both chains are in decreasing address order. If they share a suffix (e.g., because a
+  // previous GrowIndex() split a chain that went to disk), then stop at the first shared record.
+  Address begin_address = hlog.begin_address.load();
+  auto read_record = [&](Address address) -> const record_t* {
+    if(address >= hlog.head_address.load()) {
+      return reinterpret_cast<const record_t*>(hlog.Get(address));
+    }
+    // Retry a failed read a few times, in case the error was transient.
+    const record_t* record = nullptr;
+    for(uint32_t attempt = 0; attempt < kMaxRelocateReadAttempts && !record; ++attempt) {
+      record = reader.template ReadFullRecord<record_t>(address);
+    }
+    return record;
+  };
+  std::vector<uint8_t*> copies;
+  Address other_address = to_address;
+  while(from_address >= begin_address && from_address != other_address) {
+    if(other_address > from_address) {
+      const record_t* other = read_record(other_address);
+      if(!other) {
+        // Can't tell whether the chains are shared; copy conservatively.
+        other_address = Address::kInvalidAddress;
+        continue;
+      }
+      other_address = other->header.previous_address();
+      continue;
+    }
+    const record_t* record = read_record(from_address);
+    if(!record) {
+      // The rest of the chain can't be copied; fail, rather than lose it.
+      for(uint8_t* copy : copies) {
+        aligned_free(copy);
+      }
+      return Status::IOError;
+    }
+    from_address = record->header.previous_address();
+    if(record->header.invalid) {
+      continue;
+    }
+    bool superseded = false;
+    for(const uint8_t* copy : copies) {
+      if(reinterpret_cast<const record_t*>(copy)->key() == record->key()) {
+        superseded = true;
+        break;
+      }
+    }
+    if(superseded) {
+      continue;
+    }
+    // Copy the record now, since pages may be evicted (and the reader's buffer reused) later.
+    uint8_t* copy = reinterpret_cast<uint8_t*>(aligned_alloc(Constants::kCacheLineBytes,
+                    (record->size() + Constants::kCacheLineBytes - 1) &
+                    ~(Constants::kCacheLineBytes - 1)));
+    std::memcpy(copy, record, record->disk_size());
+    copies.push_back(copy);
+  }
+
+  // Copy the records, oldest first, to the tail of the log. Each key appears only once, so the
+  // records' relative order doesn't matter.
+  Address address = to_address;
+  for(auto it = copies.rbegin(); it != copies.rend(); ++it) {
+    const record_t* record = reinterpret_cast<const record_t*>(*it);
+    Address copy_address = BlockAllocateDuringResize(record->size());
+    record_t* new_record = reinterpret_cast<record_t*>(hlog.Get(copy_address));
+    std::memcpy(new_record, record, record->disk_size());
+    new_record->header = RecordInfo{ static_cast<uint16_t>(thread_ctx().version), true,
+                                     record->header.tombstone != 0, false, address };
+    address = copy_address;
+    aligned_free(*it);
+  }
+  new_address = address;
+  return Status::Ok;
+}
+
+template <class K, class V, class D>
+inline Address FasterKv<K, V, D>::BlockAllocateDuringResize(uint32_t record_size) {
+  uint32_t page;
+  Address retval = hlog.Allocate(record_size, page);
+  while(retval < hlog.read_only_address.load()) {
+    // Refresh() would re-enter the resize phase; just refresh the epoch.
+    epoch_.ProtectAndDrain();
+    // Don't overrun the hlog's tail offset.
+    bool page_closed = (retval == Address::kInvalidAddress);
+    while(page_closed) {
+      page_closed = !hlog.NewPage(page);
+      disk.TryComplete();
+      epoch_.ProtectAndDrain();
+    }
+    retval = hlog.Allocate(record_size, page);
+  }
+  return retval;
+}
+
+template <class K, class V, class D>
+inline void FasterKv<K, V, D>::ResizeHashTableBuckets() {
+  if(grow_.shrink) {
+    MergeHashTableBuckets();
+  } else {
+    SplitHashTableBuckets();
+  }
+}
+
+template <class K, class V, class D>
+void FasterKv<K, V, D>::FinishResizeHashTableBuckets() {
   // Thread has finished growing its part of the hash table.
   thread_ctx().phase = Phase::REST;
   // Thread ack that it has finished growing the hash table.
@@ -2079,7 +2935,10 @@ void FasterKv<K, V, D>::SplitHashTableBuckets() {
                                        thread_ctx().version });
   } else {
     while(system_state_.load().phase == Phase::GROW_IN_PROGRESS) {
-      // Spin until all other threads have finished splitting their chunks.
+      // Spin until all other threads have finished resizing their chunks. Keep refreshing the
+      // epoch: a thread that's relocating chains while shrinking may be waiting for the head
+      // address to advance, so that it can allocate a new page.
+      epoch_.ProtectAndDrain();
       std::this_thread::yield();
     }
   }
@@ -2168,6 +3027,11 @@ bool FasterKv<K, V, D>::GlobalMoveToNextState(SystemState current_state) {
     case Phase::PERSISTENCE_CALLBACK:
       assert(next_state.action != Action::CheckpointIndex);
       // WAIT_FLUSH -> PERSISTENCE_CALLBACK
+      // The log has been flushed, so every page that the checkpoint made read-only now has its
+      // filter.
+      if(WriteLogFilters() != Status::Ok) {
+        checkpoint_.failed = true;
+      }
       break;
     case Phase::REST:
       // PERSISTENCE_CALLBACK -> REST or INDEX_CHKPT -> REST
@@ -2177,6 +3041,7 @@ bool FasterKv<K, V, D>::GlobalMoveToNextState(SystemState current_state) {
         checkpoint_.CheckpointDone();
         // Free checkpoint locks!
         checkpoint_locks_.Free();
+        checkpoint_timer_.Stop();
         // Checkpoint is done--no more work for threads to do.
         system_state_.store(SystemState{ Action::None, Phase::REST, next_state.version });
       } else {
@@ -2192,6 +3057,7 @@ bool FasterKv<K, V, D>::GlobalMoveToNextState(SystemState current_state) {
         // The checkpoint is done; we can reset the contexts now. (Have to reset contexts before
         // another checkpoint can be started.)
         checkpoint_.CheckpointDone();
+        checkpoint_timer_.Stop();
         // Checkpoint is done--no more work for threads to do.
         system_state_.store(SystemState{ Action::None, Phase::REST, next_state.version });
         if(index_persistence_callback) {
@@ -2219,7 +3085,10 @@ bool FasterKv<K, V, D>::GlobalMoveToNextState(SystemState current_state) {
       break;
     case Phase::REST:
       // GC_IN_PROGRESS -> REST
-      // GC is done--no more work for threads to do.
+      // GC is done--no more work for threads to do. Every thread has refreshed its epoch since
+      // the begin address moved, so none is still searching the truncated pages' filters.
+      log_filters_.Truncate(hlog.begin_address.load().page());
+      gc_timer_.Stop();
       if(gc_.complete_callback) {
         gc_.complete_callback();
       }
@@ -2242,8 +3111,10 @@ bool FasterKv<K, V, D>::GlobalMoveToNextState(SystemState current_state) {
       resize_info_.version = grow_.new_version;
       break;
     case Phase::REST:
+      grow_timer_.Stop();
       if(grow_.callback) {
-        grow_.callback(state_[grow_.new_version].size());
+        // (The old size, if a shrink was abandoned.)
+        grow_.callback(state_[resize_info_.version].size());
       }
       system_state_.store(SystemState{ Action::None, Phase::REST, next_state.version });
       break;
@@ -2266,8 +3137,9 @@ void FasterKv<K, V, D>::MarkAllPendingRequests() {
   uint32_t table_version = resize_info_.version;
   uint64_t table_size = state_[table_version].size();
 
-  for(const IAsyncContext* ctxt : thread_ctx().retry_requests) {
-    const pending_context_t* context = static_cast<const pending_context_t*>(ctxt);
+  for(uint32_t idx = 0; idx < thread_ctx().retry_requests.size(); ++idx) {
+    const pending_context_t* context =
+      static_cast<const pending_context_t*>(thread_ctx().retry_requests[idx]);
     // We will succeed, since no other thread can currently advance the entry's version, since this
     // thread hasn't acked "PENDING" phase completion yet.
     bool result = checkpoint_locks_.get_lock(context->key().GetHash()).try_lock_old();
@@ -2276,7 +3148,7 @@ void FasterKv<K, V, D>::MarkAllPendingRequests() {
   for(const auto& pending_io : thread_ctx().pending_ios) {
     // We will succeed, since no other thread can currently advance the entry's version, since this
     // thread hasn't acked "PENDING" phase completion yet.
-    bool result = checkpoint_locks_.get_lock(pending_io.second).try_lock_old();
+    bool result = checkpoint_locks_.get_lock(pending_io.hash).try_lock_old();
     assert(result);
   }
 }
@@ -2480,7 +3352,7 @@ void FasterKv<K, V, D>::HandleSpecialPhases() {
         }
         break;
       case Phase::GROW_IN_PROGRESS:
-        SplitHashTableBuckets();
+        ResizeHashTableBuckets();
         break;
       }
       break;
@@ -2503,6 +3375,7 @@ bool FasterKv<K, V, D>::Checkpoint(void(*index_persistence_callback)(Status resu
     return false;
   }
   // We are going to start a checkpoint.
+  checkpoint_timer_.Start();
   epoch_.ResetPhaseFinished();
   // Initialize all contexts
   token = Guid::Create();
@@ -2539,6 +3412,7 @@ bool FasterKv<K, V, D>::CheckpointIndex(void(*index_persistence_callback)(Status
     return false;
   }
   // We are going to start a checkpoint.
+  checkpoint_timer_.Start();
   epoch_.ResetPhaseFinished();
   // Initialize all contexts
   token = Guid::Create();
@@ -2563,6 +3437,7 @@ bool FasterKv<K, V, D>::CheckpointHybridLog(void(*hybrid_log_persistence_callbac
     return false;
   }
   // We are going to start a checkpoint.
+  checkpoint_timer_.Start();
   epoch_.ResetPhaseFinished();
   // Initialize all contexts
   token = Guid::Create();
@@ -2622,6 +3497,8 @@ Status FasterKv<K, V, D>::Recover(const Guid& index_token, const Guid& hybrid_lo
       BREAK_NOT_OK(RecoverHybridLogFromSnapshotFile());
     }
     BREAK_NOT_OK(RestoreHybridLog());
+    // The pages' filters are an optimization; recover without them, if need be.
+    ReadLogFilters(hybrid_log_token);
   } while(false);
   if(status == Status::Ok) {
     for(const auto& token : checkpoint_.continue_tokens) {
@@ -2646,6 +3523,7 @@ bool FasterKv<K, V, D>::ShiftBeginAddress(Address address,
     // Can't start a GC while an action is already in progress.
     return false;
   }
+  gc_timer_.Start();
   hlog.begin_address.store(address);
   // Each active thread will notify the epoch when all pending I/Os have completed.
   epoch_.ResetPhaseFinished();
@@ -2657,6 +3535,118 @@ bool FasterKv<K, V, D>::ShiftBeginAddress(Address address,
   return true;
 }
 
+template <class K, class V, class D>
+bool FasterKv<K, V, D>::Compact(Address until_address,
+                                GcState::truncate_callback_t truncate_callback,
+                                GcState::complete_callback_t complete_callback) {
+  Address begin_address = hlog.begin_address.load();
+  if(until_address <= begin_address || until_address > hlog.safe_read_only_address.load()) {
+    // Can compact only the read-only part of the log.
+    return false;
+  }
+
+  scan_iterator_t iterator{ hlog, disk, begin_address, until_address };
+  LogFileReader<disk_t> reader{ disk, *hlog.file };
+  // Records served from memory are valid only until the next refresh, and copying a record to
+  // the tail may refresh; so compact out of a private copy of each record.
+  uint8_t* buffer = nullptr;
+  uint32_t buffer_size = 0;
+  bool success = true;
+  Address address;
+  for(uint64_t num_records = 1; ; ++num_records) {
+    if(num_records % 256 == 0) {
+      Refresh();
+    }
+    const record_t* record = iterator.GetNext(address);
+    if(!record) {
+      success = iterator.status() == Status::Ok;
+      break;
+    }
+    if(record->header.tombstone) {
+      // No need to keep a tombstone, since every older record for its key is truncated as well.
+      continue;
+    }
+    if(record->size() > buffer_size) {
+      if(buffer) {
+        aligned_free(buffer);
+      }
+      buffer_size = static_cast<uint32_t>((record->size() + Constants::kCacheLineBytes - 1) &
+                                          ~(Constants::kCacheLineBytes - 1));
+      buffer = reinterpret_cast<uint8_t*>(aligned_alloc(Constants::kCacheLineBytes,
+                                          buffer_size));
+    }
+    std::memcpy(buffer, record, record->size());
+    if(CompactRecord(*reinterpret_cast<const record_t*>(buffer), address, reader) != Status::Ok) {
+      success = false;
+      break;
+    }
+  }
+  if(buffer) {
+    aligned_free(buffer);
+  }
+  if(!success) {
+    return false;
+  }
+
+  // All live records now have copies above the until address, so it's safe to truncate. (Wait
+  // for any checkpoint or other action to finish, first.)
+  while(!ShiftBeginAddress(until_address, truncate_callback, complete_callback)) {
+    CompletePending(false);
+  }
+  return true;
+}
+
+template <class K, class V, class D>
+inline Status FasterKv<K, V, D>::CompactRecord(const record_t& record, Address address,
+    LogFileReader<disk_t>& reader) {
+  const key_t& key = record.key();
+  KeyHash hash = key.GetHash();
+  uint32_t header_size = static_cast<uint32_t>(reinterpret_cast<const uint8_t*>(
+                           &record.value()) - reinterpret_cast<const uint8_t*>(&record));
+  while(true) {
+    // Copy records only while no checkpoint or other action is in progress.
+    while(thread_ctx().phase != Phase::REST) {
+      CompletePending(false);
+    }
+
+    AtomicHashBucketEntry* atomic_entry = const_cast<AtomicHashBucketEntry*>(FindEntry(hash));
+    if(!atomic_entry) {
+      // The key was deleted.
+      return Status::Ok;
+    }
+    HashBucketEntry expected_entry = atomic_entry->load();
+    Address latest_address;
+    RETURN_NOT_OK(TraceBackForKeyMatch(key, expected_entry.address(), address, reader,
+                                       latest_address));
+    if(latest_address != address) {
+      // The record has been superseded by a later record for the same key.
+      return Status::Ok;
+    }
+
+    // The record is live; copy it to the tail of the log.
+    Address new_address = BlockAllocate(record.size());
+    record_t* new_record = reinterpret_cast<record_t*>(hlog.Get(new_address));
+    new(new_record) record_t{
+      RecordInfo{
+        static_cast<uint16_t>(thread_ctx().version), true, false, false,
+        expected_entry.address() },
+      key };
+    std::memcpy(&new_record->value(), &record.value(), record.disk_size() - header_size);
+    if(thread_ctx().phase != Phase::REST) {
+      // Allocating a block may have the side effect of advancing the thread context's phase.
+      new_record->header.invalid = true;
+      continue;
+    }
+
+    HashBucketEntry updated_entry{ new_address, hash.tag(), false };
+    if(atomic_entry->compare_exchange_strong(expected_entry, updated_entry)) {
+      return Status::Ok;
+    }
+    // Someone else updated the hash chain; check whether the record is still live.
+    new_record->header.invalid = true;
+  }
+}
+
 template <class K, class V, class D>
 bool FasterKv<K, V, D>::GrowIndex(GrowState::callback_t caller_callback) {
   SystemState expected = SystemState{ Action::None, Phase::REST, system_state_.load().version };
@@ -2665,6 +3655,7 @@ bool FasterKv<K, V, D>::GrowIndex(GrowState::callback_t caller_callback) {
     // An action is already in progress.
     return false;
   }
+  grow_timer_.Start();
   epoch_.ResetPhaseFinished();
   uint8_t current_version = resize_info_.version;
   assert(current_version == 0 || current_version == 1);
@@ -2684,5 +3675,115 @@ bool FasterKv<K, V, D>::GrowIndex(GrowState::callback_t caller_callback) {
   return true;
 }
 
+template <class K, class V, class D>
+bool FasterKv<K, V, D>::ShrinkIndex(GrowState::callback_t caller_callback) {
+  if(state_[resize_info_.version].size() < 2) {
+    return false;
+  }
+  SystemState expected = SystemState{ Action::None, Phase::REST, system_state_.load().version };
+  if(!system_state_.compare_exchange_strong(expected,
+      SystemState{ Action::GrowIndex, Phase::REST, expected.version })) {
+    // An action is already in progress.
+    return false;
+  }
+  grow_timer_.Start();
+  epoch_.ResetPhaseFinished();
+  uint8_t current_version = resize_info_.version;
+  assert(current_version == 0 || current_version == 1);
+  uint8_t next_version = 1 - current_version;
+  uint64_t new_size = state_[current_version].size() / 2;
+  // Chunks are ranges of the new (smaller) hash table's buckets.
+  uint64_t num_chunks = std::max(new_size / kGrowHashTableChunkSize, (uint64_t)1);
+  grow_.Initialize(caller_callback, current_version, num_chunks, true);
+  // Initialize the next version of our hash table to be half the size of the current version.
+  state_[next_version].Initialize(new_size, disk.log().alignment());
+  overflow_buckets_allocator_[next_version].Initialize(disk.log().alignment(), epoch_);
+
+  SystemState next = SystemState{ Action::GrowIndex, Phase::GROW_PREPARE, expected.version };
+  system_state_.store(next);
+
+  // Let this thread know it should be shrinking the index.
+  Refresh();
+  return true;
+}
+
+template <class K, class V, class D>
+Statistics FasterKv<K, V, D>::GetStatistics(bool scan_index) const {
+  Statistics result;
+  for(uint32_t idx = 0; idx < thread_stats_.size(); ++idx) {
+    result.ops.Add(thread_stats_[idx]);
+  }
+
+  result.begin_address = hlog.begin_address.load().control();
+  result.head_address = hlog.head_address.load().control();
+  result.read_only_address = hlog.read_only_address.load().control();
+  result.tail_address = hlog.GetTailAddress().control();
+  result.pending_ios = io_throttle_.in_flight();
+  result.epoch_actions = epoch_.num_pending_actions();
+  result.epoch_action_overflows = epoch_.num_overflows();
+
+  uint8_t version = resize_info_.version;
+  result.table_size = state_[version].size();
+  result.overflow_buckets_allocated = overflow_buckets_allocator_[version].count().control();
+  if(scan_index && system_state_.load().action != Action::GrowIndex) {
+    result.overflow_buckets = state_[version].ChainLengths(overflow_buckets_allocator_[version],
+                              result.chain_lengths, Statistics::kChainLengthBins);
+    result.index_scanned = true;
+  }
+
+  result.checkpoint = checkpoint_timer_.Get();
+  result.gc = gc_timer_.Get();
+  result.grow = grow_timer_.Get();
+  return result;
+}
+
+template <class K, class V, class D>
+void FasterKv<K, V, D>::EnableAutoGrowIndex(double max_overflow_ratio,
+    std::chrono::milliseconds min_interval, GrowState::callback_t callback) {
+  if(max_overflow_ratio <= 0) {
+    throw std::invalid_argument{ " Overflow ratio must be positive" };
+  }
+  auto_grow_.max_overflow_ratio = max_overflow_ratio;
+  auto_grow_.min_interval = min_interval;
+  auto_grow_.callback = callback;
+  auto_grow_.requested.store(OverflowLoadFactor() > max_overflow_ratio);
+}
+
+template <class K, class V, class D>
+void FasterKv<K, V, D>::DisableAutoGrowIndex() {
+  auto_grow_.max_overflow_ratio = 0;
+  auto_grow_.requested.store(false);
+}
+
+template <class K, class V, class D>
+void FasterKv<K, V, D>::SetIoLimits(uint32_t max_thread_ios, uint32_t max_total_ios,
+                                    bool adaptive) {
+  io_throttle_.Configure(max_thread_ios, max_total_ios, adaptive);
+}
+
+template <class K, class V, class D>
+void FasterKv<K, V, D>::AutoGrowIndex() {
+  if(!auto_grow_.enabled() || !auto_grow_.interval_elapsed()) {
+    // Leave the request set, and try again on a later refresh.
+    return;
+  }
+  if(!auto_grow_.requested.exchange(false)) {
+    // Another thread got here first.
+    return;
+  }
+  if(OverflowLoadFactor() <= auto_grow_.max_overflow_ratio ||
+      state_[resize_info_.version].size() * 2 > INT32_MAX) {
+    // The index has already grown (or can't grow any larger).
+    return;
+  }
+  // GrowIndex() fails if a checkpoint (or any other action) is in progress; so growing never
+  // overlaps with a checkpoint. Retry on a later refresh.
+  if(!GrowIndex(auto_grow_.callback)) {
+    auto_grow_.requested.store(true);
+    return;
+  }
+  auto_grow_.last_grow.store(AutoGrowPolicy::clock_t::now().time_since_epoch().count());
+}
+
 }
-} // namespace FASTER::core
\ No newline at end of file
+} // namespace FASTER::core
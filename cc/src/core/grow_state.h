@@ -5,25 +5,31 @@
 
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 
 namespace FASTER {
 namespace core {
 
-/// State of the active grow-index call.
+/// State of the active grow-index (or shrink-index) call.
 class GrowState {
  public:
   typedef void(*callback_t)(uint64_t new_size);
 
   GrowState()
     : callback{ nullptr }
+    , shrink{ false }
+    , failed{ false }
     , num_pending_chunks{ 0 }
     , old_version{ UINT8_MAX }
     , new_version{ UINT8_MAX } {
   }
 
-  void Initialize(callback_t callback_, uint8_t current_version, uint64_t num_chunks_) {
+  void Initialize(callback_t callback_, uint8_t current_version, uint64_t num_chunks_,
+                  bool shrink_ = false) {
     callback = callback_;
+    shrink = shrink_;
+    failed = false;
     assert(current_version == 0 || current_version == 1);
     old_version = current_version;
     new_version = 1 - current_version;
@@ -33,6 +39,12 @@ class GrowState {
   }
 
   callback_t callback;
+  /// Whether the index is shrinking (merging pairs of buckets), rather than growing (splitting
+  /// buckets).
+  bool shrink;
+  /// Set if a bucket couldn't be resized (because a record couldn't be read from disk); the index
+  /// then keeps its old size.
+  std::atomic<bool> failed;
   uint8_t old_version;
   uint8_t new_version;
   uint64_t num_chunks;
@@ -40,5 +52,42 @@ class GrowState {
   std::atomic<uint64_t> next_chunk;
 };
 
+/// Policy for growing the hash index automatically: the index is doubled once its overflow
+/// buckets outnumber its hash-table buckets by more than "max_overflow_ratio" (i.e., once the
+/// average overflow chain is that long), but no sooner than "min_interval" after the last
+/// automatic grow.
+class AutoGrowPolicy {
+ public:
+  typedef std::chrono::steady_clock clock_t;
+
+  AutoGrowPolicy()
+    : max_overflow_ratio{ 0 }
+    , min_interval{ 0 }
+    , callback{ nullptr }
+    , requested{ false }
+    , last_grow{ 0 } {
+  }
+
+  inline bool enabled() const {
+    return max_overflow_ratio > 0;
+  }
+
+  /// Whether enough time has passed since the last automatic grow to start another.
+  inline bool interval_elapsed() const {
+    int64_t now = clock_t::now().time_since_epoch().count();
+    return now - last_grow.load() >= std::chrono::duration_cast<clock_t::duration>(
+             min_interval).count();
+  }
+
+  double max_overflow_ratio;
+  std::chrono::milliseconds min_interval;
+  GrowState::callback_t callback;
+  /// Set when an operation allocates an overflow bucket past the threshold; the next thread to
+  /// refresh tries to grow the index.
+  std::atomic<bool> requested;
+  /// Time of the last automatic grow, in clock_t ticks.
+  std::atomic<int64_t> last_grow;
+};
+
 }
 } // namespace FASTER::core
@@ -8,6 +8,12 @@
 #include <cstdint>
 #include <thread>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
 #include "address.h"
 #include "constants.h"
 #include "malloc_fixed_page_size.h"
@@ -21,6 +27,9 @@ static_assert(Address::kAddressBits == 48, "Address::kAddressBits != 48");
 struct HashBucketEntry {
   /// Invalid value in the hash table
   static constexpr uint64_t kInvalidEntry = 0;
+  /// Masks of the tag and tentative fields, within control_.
+  static constexpr uint64_t kTagMask = (uint64_t)0x3FFF << 48;
+  static constexpr uint64_t kTentativeMask = (uint64_t)1 << 63;
 
   HashBucketEntry()
     : control_{ 0 } {
@@ -193,6 +202,66 @@ struct alignas(Constants::kCacheLineBytes) HashBucket {
   AtomicHashBucketEntry entries[kNumEntries];
   /// Overflow entry points to next overflow bucket, if any.
   AtomicHashBucketOverflowEntry overflow_entry;
+
+  /// Bit mask covering all entries; bit i of a probe's result corresponds to entries[i].
+  static constexpr uint32_t kEntriesMask = (1 << kNumEntries) - 1;
+
+  /// Returns a mask of the entries for which (entry & mask) == value. Compares the whole bucket
+  /// at once, where SSE2 or AVX2 is available. The entries are read without synchronization, so
+  /// the caller must load() any entry it selects, and check it again. (On x86, these loads aren't
+  /// reordered with an earlier CAS, so a probe that follows a CAS still sees every entry stored
+  /// before it.)
+  inline uint32_t Probe(uint64_t mask, uint64_t value) const {
+#if defined(__AVX2__)
+    const __m256i* words = reinterpret_cast<const __m256i*>(this);
+    __m256i mask_v = _mm256_set1_epi64x(static_cast<int64_t>(mask));
+    __m256i value_v = _mm256_set1_epi64x(static_cast<int64_t>(value));
+    __m256i lo = _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_load_si256(words), mask_v), value_v);
+    __m256i hi = _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_load_si256(words + 1), mask_v),
+                                    value_v);
+    uint32_t result = static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(lo))) |
+                      (static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(hi))) << 4);
+    return result & kEntriesMask;
+#elif defined(__SSE2__) || defined(_M_X64)
+    // SSE2 has no 64-bit compare; compare 32-bit halves, and require both halves to match.
+    const __m128i* words = reinterpret_cast<const __m128i*>(this);
+    __m128i mask_v = _mm_set1_epi64x(static_cast<int64_t>(mask));
+    __m128i value_v = _mm_set1_epi64x(static_cast<int64_t>(value));
+    uint32_t result = 0;
+    for(uint32_t idx = 0; idx < 4; ++idx) {
+      __m128i eq = _mm_cmpeq_epi32(_mm_and_si128(_mm_load_si128(words + idx), mask_v), value_v);
+      eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+      result |= static_cast<uint32_t>(_mm_movemask_pd(_mm_castsi128_pd(eq))) << (2 * idx);
+    }
+    return result & kEntriesMask;
+#else
+    uint32_t result = 0;
+    for(uint32_t entry_idx = 0; entry_idx < kNumEntries; ++entry_idx) {
+      if((entries[entry_idx].load().control_ & mask) == value) {
+        result |= 1 << entry_idx;
+      }
+    }
+    return result;
+#endif
+  }
+
+  /// Mask of the unused entries.
+  inline uint32_t FreeEntries() const {
+    return Probe(UINT64_MAX, HashBucketEntry::kInvalidEntry);
+  }
+
+  /// Mask of the used entries with the specified tag; tentative entries are included only if
+  /// "include_tentative" is set.
+  inline uint32_t TagEntries(uint16_t tag, bool include_tentative) const {
+    uint64_t mask = HashBucketEntry::kTagMask |
+                    (include_tentative ? 0 : HashBucketEntry::kTentativeMask);
+    uint32_t result = Probe(mask, HashBucketEntry{ Address{ 0 }, tag, false }.control_);
+    if(tag == 0) {
+      // Unused entries have tag 0, too.
+      result &= ~FreeEntries();
+    }
+    return result;
+  }
 };
 static_assert(sizeof(HashBucket) == Constants::kCacheLineBytes,
               "sizeof(HashBucket) != Constants::kCacheLineBytes");
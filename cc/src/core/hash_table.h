@@ -9,6 +9,7 @@
 
 #include "hash_bucket.h"
 #include "key_hash.h"
+#include "memory_policy.h"
 
 namespace FASTER {
 namespace core {
@@ -23,6 +24,7 @@ class InternalHashTable {
   InternalHashTable()
     : size_{ 0 }
     , buckets_{ nullptr }
+    , memory_policy_{}
     , disk_{ nullptr }
     , pending_checkpoint_writes_{ 0 }
     , pending_recover_reads_{ 0 }
@@ -34,24 +36,31 @@ class InternalHashTable {
 
   ~InternalHashTable() {
     if(buckets_) {
-      aligned_free(buckets_);
+      memory_policy_.Free(buckets_, size_ * sizeof(HashBucket));
     }
   }
 
+  /// How the buckets are backed; set before the table is first initialized.
+  inline void set_memory_policy(const MemoryPolicy& memory_policy) {
+    assert(buckets_ == nullptr);
+    memory_policy_ = memory_policy;
+  }
+
   inline void Initialize(uint64_t new_size, uint64_t alignment) {
     assert(new_size < INT32_MAX);
     assert(Utility::IsPowerOfTwo(new_size));
     assert(Utility::IsPowerOfTwo(alignment));
     assert(alignment >= Constants::kCacheLineBytes);
     if(size_ != new_size) {
-      size_ = new_size;
       if(buckets_) {
-        aligned_free(buckets_);
+        memory_policy_.Free(buckets_, size_ * sizeof(HashBucket));
       }
-      buckets_ = reinterpret_cast<HashBucket*>(aligned_alloc(alignment,
+      size_ = new_size;
+      buckets_ = reinterpret_cast<HashBucket*>(memory_policy_.Allocate(alignment,
                  size_ * sizeof(HashBucket)));
+    } else {
+      std::memset(buckets_, 0, size_ * sizeof(HashBucket));
     }
-    std::memset(buckets_, 0, size_ * sizeof(HashBucket));
     assert(pending_checkpoint_writes_ == 0);
     assert(pending_recover_reads_ == 0);
     assert(checkpoint_pending_ == false);
@@ -62,7 +71,7 @@ class InternalHashTable {
 
   inline void Uninitialize() {
     if(buckets_) {
-      aligned_free(buckets_);
+      memory_policy_.Free(buckets_, size_ * sizeof(HashBucket));
       buckets_ = nullptr;
     }
     size_ = 0;
@@ -105,6 +114,10 @@ class InternalHashTable {
   inline Status RecoverComplete(bool wait);
 
   void DumpDistribution(MallocFixedPageSize<HashBucket, disk_t>& overflow_buckets_allocator);
+  /// Counts the table buckets whose chains hold 1, 2, ... buckets into histogram[0, 1, ...]; the
+  /// last bin also counts longer chains. Returns the number of overflow buckets in use.
+  uint64_t ChainLengths(const MallocFixedPageSize<HashBucket, disk_t>& overflow_buckets_allocator,
+                        uint64_t* histogram, uint32_t num_bins) const;
 
  private:
   // Checkpointing and recovery.
@@ -128,6 +141,7 @@ class InternalHashTable {
  private:
   uint64_t size_;
   HashBucket* buckets_;
+  MemoryPolicy memory_policy_;
 
   /// State for ongoing checkpoint/recovery.
   disk_t* disk_;
@@ -184,9 +198,10 @@ inline Status InternalHashTable<D>::CheckpointComplete(bool wait) {
   disk_->TryComplete();
   bool complete = !checkpoint_pending_.load();
   while(wait && !complete) {
-    disk_->TryComplete();
+    if(!disk_->WaitForCompletion(Constants::kIoWaitMicros)) {
+      std::this_thread::yield();
+    }
     complete = !checkpoint_pending_.load();
-    std::this_thread::yield();
   }
   if(!complete) {
     return Status::Pending;
@@ -240,9 +255,10 @@ inline Status InternalHashTable<D>::RecoverComplete(bool wait) {
   disk_->TryComplete();
   bool complete = !recover_pending_.load();
   while(wait && !complete) {
-    disk_->TryComplete();
+    if(!disk_->WaitForCompletion(Constants::kIoWaitMicros)) {
+      std::this_thread::yield();
+    }
     complete = !recover_pending_.load();
-    std::this_thread::yield();
   }
   if(!complete) {
     return Status::Pending;
@@ -290,5 +306,26 @@ inline void InternalHashTable<D>::DumpDistribution(
   printf("15+: %" PRIu64 "\n", histogram[15]);
 }
 
+template <class D>
+inline uint64_t InternalHashTable<D>::ChainLengths(
+  const MallocFixedPageSize<HashBucket, disk_t>& overflow_buckets_allocator,
+  uint64_t* histogram, uint32_t num_bins) const {
+  uint64_t table_size = size();
+  uint64_t overflow_buckets = 0;
+  for(uint64_t bucket_idx = 0; bucket_idx < table_size; ++bucket_idx) {
+    const HashBucket* bucket = &buckets_[bucket_idx];
+    uint64_t length = 1;
+    HashBucketOverflowEntry overflow_entry = bucket->overflow_entry.load();
+    while(!overflow_entry.unused()) {
+      ++length;
+      bucket = &overflow_buckets_allocator.Get(overflow_entry.address());
+      overflow_entry = bucket->overflow_entry.load();
+    }
+    overflow_buckets += length - 1;
+    ++histogram[length < num_bins ? length - 1 : num_bins - 1];
+  }
+  return overflow_buckets;
+}
+
 }
 } // namespace FASTER::core
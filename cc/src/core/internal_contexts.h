@@ -7,13 +7,13 @@
 #include <cassert>
 #include <cstdint>
 #include <cstring>
-#include <deque>
-#include <unordered_map>
 #include <string>
 #include "address.h"
+#include "async_result_types.h"
 #include "guid.h"
 #include "hash_bucket.h"
 #include "native_buffer_pool.h"
+#include "pending_queues.h"
 #include "record.h"
 #include "state_transitions.h"
 #include "thread.h"
@@ -326,7 +326,65 @@ class PendingRmwContext : public AsyncPendingRmwContext<typename MC::key_t> {
   }
 };
 
-class AsyncIOContext;
+/// FASTER's internal Delete() context.
+
+/// An internal Delete() context that has gone async and lost its type information.
+template <class K>
+class AsyncPendingDeleteContext : public PendingContext<K> {
+ public:
+  typedef K key_t;
+ protected:
+  AsyncPendingDeleteContext(IAsyncContext& caller_context_, AsyncCallback caller_callback_)
+    : PendingContext<key_t>(OperationType::Delete, caller_context_, caller_callback_) {
+  }
+  /// The deep copy constructor.
+  AsyncPendingDeleteContext(AsyncPendingDeleteContext& other, IAsyncContext* caller_context)
+    : PendingContext<key_t>(other, caller_context) {
+  }
+ public:
+  /// Get value size for the tombstone record. The tombstone's value is left zero-initialized, so
+  /// this must match the size that value_t reports for zero-initialized memory; recovery uses it
+  /// to step over the record.
+  virtual uint32_t value_size() const = 0;
+};
+
+/// A synchronous Delete() context preserves its type information.
+template <class DC>
+class PendingDeleteContext : public AsyncPendingDeleteContext<typename DC::key_t> {
+ public:
+  typedef DC delete_context_t;
+  typedef typename delete_context_t::key_t key_t;
+  typedef typename delete_context_t::value_t value_t;
+  typedef Record<key_t, value_t> record_t;
+
+  PendingDeleteContext(delete_context_t& caller_context_, AsyncCallback caller_callback_)
+    : AsyncPendingDeleteContext<key_t>(caller_context_, caller_callback_) {
+  }
+  /// The deep copy constructor.
+  PendingDeleteContext(PendingDeleteContext& other, IAsyncContext* caller_context_)
+    : AsyncPendingDeleteContext<key_t>(other, caller_context_) {
+  }
+ protected:
+  Status DeepCopy_Internal(IAsyncContext*& context_copy) final {
+    return IAsyncContext::DeepCopy_Internal(*this, PendingContext<key_t>::caller_context,
+                                            context_copy);
+  }
+ private:
+  inline const delete_context_t& delete_context() const {
+    return *static_cast<const delete_context_t*>(PendingContext<key_t>::caller_context);
+  }
+  inline delete_context_t& delete_context() {
+    return *static_cast<delete_context_t*>(PendingContext<key_t>::caller_context);
+  }
+ public:
+  /// Accessors.
+  inline const key_t& key() const final {
+    return delete_context().key();
+  }
+  inline constexpr uint32_t value_size() const final {
+    return delete_context().value_size();
+  }
+};
 
 /// Per-thread execution context. (Just the stuff that's checkpointed to disk.)
 struct PersistentExecContext {
@@ -372,16 +430,16 @@ struct ExecutionContext : public PersistentExecContext {
 
   Phase phase;
 
-  /// Retry request contexts are stored inside the deque.
-  std::deque<IAsyncContext*> retry_requests;
+  /// Retry request contexts are stored inside the queue.
+  RetryQueue retry_requests;
   /// Assign a unique ID to every I/O request.
   uint64_t io_id;
   /// For each pending I/O, maps io_id to the hash of the key being retrieved.
-  std::unordered_map<uint64_t, KeyHash> pending_ios;
+  PendingIoTable pending_ios;
 
   /// The I/O completion thread hands the PendingContext back to the thread that issued the
   /// request.
-  concurrent_queue<AsyncIOContext*> io_responses;
+  IoResponseQueue io_responses;
 };
 
 }
@@ -0,0 +1,236 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+
+#include "constants.h"
+#include "statistics.h"
+#include "thread.h"
+
+namespace FASTER {
+namespace core {
+
+/// One thread's window of pending operations with disk reads in flight. (An operation may take
+/// several reads, one after another, to find its record.) The owning thread opens requests;
+/// whichever thread executes a request's last read closes it.
+class alignas(Constants::kCacheLineBytes) IoWindow {
+ public:
+  IoWindow()
+    : in_flight{ 0 }
+    , completions{ 0 }
+    , latency_ns{ 0 }
+    , size{ 0 }
+    , reserved{ 0 }
+    , min_latency_ns{ 0 }
+    , interval_start_ns{ 0 }
+    , saturated{ false }
+    , waiting{ false } {
+  }
+
+  /// Called when a request, issued at "start_ns" (PhaseTimer::NowNs()), completes.
+  inline void Complete(uint64_t start_ns) {
+    latency_ns.fetch_add(PhaseTimer::NowNs() - start_ns, std::memory_order_relaxed);
+    completions.fetch_add(1, std::memory_order_relaxed);
+    in_flight.fetch_sub(1);
+  }
+
+  std::atomic<uint32_t> in_flight;
+  /// Completions, and their total latency, since the window was last resized.
+  std::atomic<uint32_t> completions;
+  std::atomic<uint64_t> latency_ns;
+
+  /// Accessed only by the owning thread.
+  uint32_t size;
+  /// How much of the total limit this window holds: the requests it may have in flight. Less
+  /// than its size while other threads hold the rest of the total.
+  uint32_t reserved;
+  uint64_t min_latency_ns;
+  uint64_t interval_start_ns;
+  /// Whether the thread had to wait for room in the window, since it was last resized.
+  bool saturated;
+  /// Whether the thread is waiting for any share of the total.
+  bool waiting;
+};
+
+/// Limits the pending operations that have disk reads in flight: per thread, and in total. The
+/// total is enforced by reserving each thread's window out of it, so requests touch only their
+/// own thread's window, and the shared total changes only when a window is resized. A thread
+/// that finds the total all reserved waits; meanwhile, threads whose windows are empty give
+/// their shares back.
+///
+/// When adaptive, each window tracks the device by Little's law: a thread that completes X
+/// requests per second, at an average latency of R seconds, keeps X * R requests in flight. Every
+/// kResizeInterval completions, the window compares the latency it saw with the lowest it has
+/// seen (the device's unloaded latency). While the two stay close, the device isn't queueing, so
+/// a saturated window grows (by its square root); as latency rises, the window shrinks in
+/// proportion. A window that wasn't saturated shrinks toward twice the X * R it actually used,
+/// leaving the rest of the total to other threads.
+class IoThrottle {
+ public:
+  static constexpr uint32_t kDefaultMaxThreadIos = 64;
+  static constexpr uint32_t kDefaultMaxTotalIos = 120;
+  static constexpr uint32_t kInitialWindow = 8;
+  static constexpr uint32_t kResizeInterval = 32;
+
+  explicit IoThrottle(uint32_t max_num_threads)
+    : max_thread_ios_{ kDefaultMaxThreadIos }
+    , max_total_ios_{ kDefaultMaxTotalIos }
+    , adaptive_{ true }
+    , reserved_{ 0 }
+    , waiting_{ 0 }
+    , windows_{ max_num_threads } {
+  }
+
+  /// Not thread-safe: call before starting any sessions.
+  void Configure(uint32_t max_thread_ios, uint32_t max_total_ios, bool adaptive) {
+    max_thread_ios_ = std::max(max_thread_ios, (uint32_t)1);
+    max_total_ios_ = std::max(max_total_ios, (uint32_t)1);
+    adaptive_ = adaptive;
+  }
+
+  inline IoWindow& window() {
+    return windows_[Thread::id()];
+  }
+
+  /// Called by the owning thread; returns false if the window is full.
+  inline bool TryOpen(IoWindow& window) {
+    if(window.size == 0) {
+      // The thread's first request since its session started.
+      window.interval_start_ns = PhaseTimer::NowNs();
+      Resize(window, adaptive_ ? kInitialWindow : max_thread_ios_);
+    } else if(window.completions.load(std::memory_order_relaxed) >= kResizeInterval) {
+      Adapt(window);
+    }
+    if(window.in_flight.load() >= window.reserved) {
+      if(window.reserved < window.size) {
+        // Other threads may have given back some of the total.
+        Reserve(window);
+      }
+      if(window.in_flight.load() >= window.reserved) {
+        window.saturated = true;
+        if(window.reserved == 0 && !window.waiting) {
+          window.waiting = true;
+          ++waiting_;
+        }
+        return false;
+      }
+    }
+    if(window.waiting) {
+      window.waiting = false;
+      --waiting_;
+    }
+    ++window.in_flight;
+    return true;
+  }
+
+  /// Called by the owning thread, from time to time: if its window is empty while other threads
+  /// wait for a share of the total, gives the window's share back.
+  inline void GiveBack(IoWindow& window) {
+    if(window.reserved > 0 && waiting_.load(std::memory_order_relaxed) > 0 &&
+        window.in_flight.load() == 0) {
+      reserved_ -= window.reserved;
+      window.reserved = 0;
+    }
+  }
+
+  /// Called by the owning thread, when its session stops and it has no reads in flight.
+  void Release(IoWindow& window) {
+    assert(window.in_flight.load() == 0);
+    reserved_ -= window.reserved;
+    window.reserved = 0;
+    window.size = 0;
+    if(window.waiting) {
+      window.waiting = false;
+      --waiting_;
+    }
+    window.completions.store(0);
+    window.latency_ns.store(0);
+    window.saturated = false;
+  }
+
+  /// Requests currently in flight, across all threads.
+  uint64_t in_flight() const {
+    uint64_t result = 0;
+    for(uint32_t idx = 0; idx < windows_.size(); ++idx) {
+      result += windows_[idx].in_flight.load();
+    }
+    return result;
+  }
+
+ private:
+  void Adapt(IoWindow& window) {
+    uint64_t now_ns = PhaseTimer::NowNs();
+    uint64_t elapsed_ns = std::max(now_ns - window.interval_start_ns, (uint64_t)1);
+    uint32_t completions = window.completions.exchange(0);
+    uint64_t latency_ns = window.latency_ns.exchange(0);
+    window.interval_start_ns = now_ns;
+    bool saturated = window.saturated;
+    window.saturated = false;
+    if(!adaptive_ || completions == 0) {
+      return;
+    }
+
+    uint64_t avg_latency_ns = std::max(latency_ns / completions, (uint64_t)1);
+    if(window.min_latency_ns == 0 || avg_latency_ns < window.min_latency_ns) {
+      window.min_latency_ns = avg_latency_ns;
+    } else {
+      // Forget the minimum slowly, in case the device has changed.
+      window.min_latency_ns += (avg_latency_ns - window.min_latency_ns) / 64;
+    }
+    double gradient = std::min(std::max(static_cast<double>(window.min_latency_ns) /
+                                         avg_latency_ns, 0.5), 1.0);
+    double target = window.size * gradient;
+    if(saturated) {
+      target += std::sqrt(static_cast<double>(window.size));
+    } else {
+      // Little's law: the average number of requests in flight = total latency / elapsed time.
+      double used = static_cast<double>(latency_ns) / elapsed_ns;
+      target = std::min(target, std::max(2 * used, static_cast<double>(kInitialWindow)));
+    }
+    Resize(window, static_cast<uint32_t>(target + 0.5));
+  }
+
+  void Resize(IoWindow& window, uint32_t size) {
+    window.size = std::min(std::max(size, (uint32_t)1), max_thread_ios_);
+    if(window.size > window.reserved) {
+      Reserve(window);
+    } else {
+      reserved_ -= window.reserved - window.size;
+      window.reserved = window.size;
+    }
+  }
+
+  /// Grows the window's share of the total toward its size, taking as much as is left.
+  void Reserve(IoWindow& window) {
+    uint32_t wanted = window.size - window.reserved;
+    uint32_t reserved = reserved_.load();
+    uint32_t granted;
+    do {
+      uint32_t available = reserved < max_total_ios_ ? max_total_ios_ - reserved : 0;
+      granted = std::min(wanted, available);
+      if(granted == 0) {
+        return;
+      }
+    } while(!reserved_.compare_exchange_weak(reserved, reserved + granted));
+    window.reserved += granted;
+  }
+
+  uint32_t max_thread_ios_;
+  uint32_t max_total_ios_;
+  bool adaptive_;
+  /// Sum of the threads' reservations.
+  std::atomic<uint32_t> reserved_;
+  /// Threads waiting for any share of the total.
+  std::atomic<uint32_t> waiting_;
+
+  ThreadArray<IoWindow> windows_;
+};
+
+}
+} // namespace FASTER::core
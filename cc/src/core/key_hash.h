@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <cassert>
 #include <cstdint>
 #include "utility.h"
 
@@ -23,6 +24,7 @@ struct KeyHash {
 
   KeyHash& operator=(const KeyHash& other) {
     control_ = other.control_;
+    return *this;
   }
 
   /// Truncate the key hash's address to get the page_index into a hash table of specified size.
@@ -38,6 +40,10 @@ struct KeyHash {
     return static_cast<uint16_t>(tag_);
   }
 
+  inline uint64_t control() const {
+    return control_;
+  }
+
  private:
   union {
       struct {
@@ -50,5 +56,30 @@ struct KeyHash {
 };
 static_assert(sizeof(KeyHash) == 8, "sizeof(KeyHash) != 8");
 
+/// Hash functions for keys that are strings of bytes; a key type picks one in its GetHash(). The
+/// hash decides where a key lives in the hash index, and so it is part of a checkpoint: a store
+/// must keep using the hash function it was created with.
+
+/// The original byte-at-a-time hash.
+struct MagicHash {
+  static inline uint64_t Hash(const uint8_t* data, size_t length) {
+    return Utility::Hash8BitBytes(data, length);
+  }
+};
+
+/// Word-at-a-time multiply/rotate hash.
+struct WordHash {
+  static inline uint64_t Hash(const uint8_t* data, size_t length) {
+    return Utility::HashBytesWordwise(data, length);
+  }
+};
+
+/// Hardware CRC32C hash (with a software fallback that computes the same values).
+struct Crc32cHash {
+  static inline uint64_t Hash(const uint8_t* data, size_t length) {
+    return Utility::HashBytesCrc32c(data, length);
+  }
+};
+
 }
 } // namespace FASTER::core
@@ -4,11 +4,11 @@
 #pragma once
 
 #include <atomic>
-#include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <functional>
 #include <memory>
+#include <stdexcept>
 #include <thread>
 
 #include "alloc.h"
@@ -23,20 +23,45 @@ namespace core {
 
 class LightEpoch {
  private:
+  static constexpr uint32_t kNoNode = UINT32_MAX;
+  static constexpr uint32_t kNoEntry = UINT32_MAX;
+
   /// Entry in epoch table
   struct alignas(Constants::kCacheLineBytes) Entry {
     Entry()
       : local_current_epoch{ 0 }
       , reentrant{ 0 }
-      , phase_finished{ Phase::REST } {
+      , phase_finished{ Phase::REST }
+      , node{ kNoNode }
+      , next_in_node{ kNoEntry } {
     }
 
     uint64_t local_current_epoch;
     uint32_t reentrant;
     std::atomic<Phase> phase_finished;
+    /// The NUMA node whose list the entry joined, when its thread first entered the epoch; and the
+    /// next entry in that list.
+    uint32_t node;
+    uint32_t next_in_node;
   };
   static_assert(sizeof(Entry) == 64, "sizeof(Entry) != 64");
 
+  /// Second level of the epoch table: per NUMA node, the list of entries whose threads ran on the
+  /// node, and a lower bound on the epochs that those threads are protecting.
+  struct alignas(Constants::kCacheLineBytes) NodeEntry {
+    NodeEntry()
+      : oldest_epoch{ 0 }
+      , first_entry{ kNoEntry } {
+    }
+
+    /// Refreshed, by scanning the node's entries, only when it holds back the safe-to-reclaim
+    /// epoch. A stale value is still a lower bound: a thread that enters the epoch later does so
+    /// at the current epoch, which is at least the value.
+    std::atomic<uint64_t> oldest_epoch;
+    std::atomic<uint32_t> first_entry;
+  };
+  static_assert(sizeof(NodeEntry) == 64, "sizeof(NodeEntry) != 64");
+
   struct EpochAction {
     typedef void(*callback_t)(IAsyncContext*);
 
@@ -109,27 +134,55 @@ class LightEpoch {
     IAsyncContext* context;
   };
 
+  /// An action that didn't fit in the drain list, queued on the (unbounded) overflow list.
+  struct OverflowAction {
+    OverflowAction(uint64_t epoch_, EpochAction::callback_t callback_, IAsyncContext* context_)
+      : epoch{ epoch_ }
+      , callback{ callback_ }
+      , context{ context_ }
+      , next{ nullptr } {
+    }
+
+    uint64_t epoch;
+    EpochAction::callback_t callback;
+    IAsyncContext* context;
+    OverflowAction* next;
+  };
+
  public:
   /// Default invalid page_index entry.
   static constexpr uint32_t kInvalidIndex = 0;
   /// This thread is not protecting any epoch.
   static constexpr uint64_t kUnprotected = 0;
+  /// Drain list size; actions beyond these go to the overflow list.
+  static constexpr uint32_t kDrainListSize = 256;
+  /// Most NUMA nodes tracked; threads on higher-numbered nodes share nodes' aggregates.
+  static constexpr uint32_t kMaxNumNodes = 64;
 
  private:
   /// Default number of entries in the entries table
-  static constexpr uint32_t kTableSize = Thread::kMaxNumThreads;
-  /// Default drainlist size
-  static constexpr uint32_t kDrainListSize = 256;
+  static constexpr uint32_t kTableSize = Thread::kDefaultMaxNumThreads;
   /// Epoch table
   Entry* table_;
   /// Number of entries in epoch table.
   uint32_t num_entries_;
+  /// One more than the highest entry that a thread has used; scans of the table stop here.
+  std::atomic<uint32_t> num_entries_in_use_;
+  /// Per-node aggregates, of which reclamation scans only the first num_nodes_in_use_.
+  NodeEntry* nodes_;
+  std::atomic<uint32_t> num_nodes_in_use_;
 
   /// List of action, epoch pairs containing actions to performed when an epoch becomes
   /// safe to reclaim.
   EpochAction drain_list_[kDrainListSize];
-  /// Count of drain actions
+  /// Count of drain actions, in the drain list and the overflow list
   std::atomic<uint32_t> drain_count_;
+  /// Actions registered while the drain list was full. Producers push onto the list one action at
+  /// a time; a draining thread takes the whole list, and pushes back the actions that aren't yet
+  /// safe to perform.
+  std::atomic<OverflowAction*> overflow_list_;
+  /// Number of actions that have gone to the overflow list: a measure of drain-list pressure.
+  std::atomic<uint64_t> num_overflows_;
 
  public:
   /// Current system epoch (global state)
@@ -140,8 +193,13 @@ class LightEpoch {
   LightEpoch(uint32_t size = kTableSize)
     : table_{ nullptr }
     , num_entries_{ 0 }
+    , num_entries_in_use_{ 0 }
+    , nodes_{ nullptr }
+    , num_nodes_in_use_{ 0 }
+    , drain_list_{}
     , drain_count_{ 0 }
-    , drain_list_{} {
+    , overflow_list_{ nullptr }
+    , num_overflows_{ 0 } {
     Initialize(size);
   }
 
@@ -149,13 +207,33 @@ class LightEpoch {
     Uninitialize();
   }
 
+  /// Number of threads (IDs) the table has room for.
+  inline uint32_t num_entries() const {
+    return num_entries_;
+  }
+  /// Number of actions waiting for their epochs to become safe to reclaim.
+  inline uint32_t num_pending_actions() const {
+    return drain_count_.load();
+  }
+  /// Number of actions that found the drain list full, since the epoch was created.
+  inline uint64_t num_overflows() const {
+    return num_overflows_.load();
+  }
+
  private:
   void Initialize(uint32_t size) {
     num_entries_ = size;
+    num_entries_in_use_ = 0;
     // do cache-line alignment
     table_ = reinterpret_cast<Entry*>(aligned_alloc(Constants::kCacheLineBytes,
                                       (size + 2) * sizeof(Entry)));
     new(table_) Entry[size + 2];
+    nodes_ = reinterpret_cast<NodeEntry*>(aligned_alloc(Constants::kCacheLineBytes,
+                                          kMaxNumNodes * sizeof(NodeEntry)));
+    for(uint32_t node = 0; node < kMaxNumNodes; ++node) {
+      new(&nodes_[node]) NodeEntry{};
+    }
+    num_nodes_in_use_ = 0;
     current_epoch = 1;
     safe_to_reclaim_epoch = 0;
     for(uint32_t idx = 0; idx < kDrainListSize; ++idx) {
@@ -165,17 +243,56 @@ class LightEpoch {
   }
 
   void Uninitialize() {
+    // Actions still waiting are dropped, as they are in the drain list.
+    OverflowAction* action = overflow_list_.exchange(nullptr);
+    while(action) {
+      OverflowAction* next = action->next;
+      delete action;
+      action = next;
+    }
     aligned_free(table_);
     table_ = nullptr;
     num_entries_ = 0;
+    num_entries_in_use_ = 0;
+    aligned_free(nodes_);
+    nodes_ = nullptr;
+    num_nodes_in_use_ = 0;
     current_epoch = 1;
     safe_to_reclaim_epoch = 0;
   }
 
  public:
+  /// Adds the thread's entry to the part of the table that's scanned, and to the list of the
+  /// NUMA node that the thread is running on; throws if the thread's ID doesn't fit in the table.
+  /// (An entry stays on its first node's list, even if its ID passes to a thread on another node.)
+  void AddEntry(uint32_t entry) {
+    if(entry >= num_entries_) {
+      throw std::runtime_error{ "Too many threads!" };
+    }
+    if(table_[entry].node == kNoNode) {
+      uint32_t node = Thread::NumaNode() % kMaxNumNodes;
+      NodeEntry& node_entry = nodes_[node];
+      uint32_t first_entry = node_entry.first_entry.load();
+      do {
+        table_[entry].next_in_node = first_entry;
+      } while(!node_entry.first_entry.compare_exchange_weak(first_entry, entry));
+      table_[entry].node = node;
+      uint32_t num_nodes = num_nodes_in_use_.load();
+      while(num_nodes <= node && !num_nodes_in_use_.compare_exchange_weak(num_nodes, node + 1)) {
+      }
+    }
+    uint32_t in_use = num_entries_in_use_.load();
+    while(in_use <= entry && !num_entries_in_use_.compare_exchange_weak(in_use, entry + 1)) {
+    }
+  }
+
   /// Enter the thread into the protected code region
   inline uint64_t Protect() {
     uint32_t entry = Thread::id();
+    if(entry >= num_entries_in_use_.load(std::memory_order_relaxed) ||
+        table_[entry].node == kNoNode) {
+      AddEntry(entry);
+    }
     table_[entry].local_current_epoch = current_epoch.load();
     return table_[entry].local_current_epoch;
   }
@@ -184,6 +301,10 @@ class LightEpoch {
   /// Process entries in drain list if possible
   inline uint64_t ProtectAndDrain() {
     uint32_t entry = Thread::id();
+    if(entry >= num_entries_in_use_.load(std::memory_order_relaxed) ||
+        table_[entry].node == kNoNode) {
+      AddEntry(entry);
+    }
     table_[entry].local_current_epoch = current_epoch.load();
     if(drain_count_.load() > 0) {
       Drain(table_[entry].local_current_epoch);
@@ -193,6 +314,10 @@ class LightEpoch {
 
   uint64_t ReentrantProtect() {
     uint32_t entry = Thread::id();
+    if(entry >= num_entries_in_use_.load(std::memory_order_relaxed) ||
+        table_[entry].node == kNoNode) {
+      AddEntry(entry);
+    }
     if(table_[entry].local_current_epoch != kUnprotected)
       return table_[entry].local_current_epoch;
     table_[entry].local_current_epoch = current_epoch.load();
@@ -202,7 +327,8 @@ class LightEpoch {
 
   inline bool IsProtected() {
     uint32_t entry = Thread::id();
-    return table_[entry].local_current_epoch != kUnprotected;
+    return entry < num_entries_in_use_.load() &&
+           table_[entry].local_current_epoch != kUnprotected;
   }
 
   /// Exit the thread from the protected code region.
@@ -229,6 +355,9 @@ class LightEpoch {
         }
       }
     }
+    if(overflow_list_.load() != nullptr) {
+      DrainOverflow();
+    }
   }
 
   /// Increment the current epoch (global system state)
@@ -244,44 +373,102 @@ class LightEpoch {
   /// a trigger action for when older epoch becomes safe to reclaim
   uint64_t BumpCurrentEpoch(EpochAction::callback_t callback, IAsyncContext* context) {
     uint64_t prior_epoch = BumpCurrentEpoch() - 1;
-    uint32_t i = 0, j = 0;
-    while(true) {
-      uint64_t trigger_epoch = drain_list_[i].epoch.load();
+    for(uint32_t idx = 0; idx < kDrainListSize; ++idx) {
+      uint64_t trigger_epoch = drain_list_[idx].epoch.load();
       if(trigger_epoch == EpochAction::kFree) {
-        if(drain_list_[i].TryPush(prior_epoch, callback, context)) {
+        if(drain_list_[idx].TryPush(prior_epoch, callback, context)) {
           ++drain_count_;
-          break;
+          return prior_epoch + 1;
         }
       } else if(trigger_epoch <= safe_to_reclaim_epoch.load()) {
-        if(drain_list_[i].TrySwap(trigger_epoch, prior_epoch, callback, context)) {
-          break;
-        }
-      }
-      if(++i == kDrainListSize) {
-        i = 0;
-        if(++j == 500) {
-          j = 0;
-          std::this_thread::sleep_for(std::chrono::seconds(1));
-          fprintf(stderr, "Slowdown: Unable to add trigger to epoch\n");
+        if(drain_list_[idx].TrySwap(trigger_epoch, prior_epoch, callback, context)) {
+          return prior_epoch + 1;
         }
       }
     }
+    // The drain list is full: rather than wait for a slot, queue the action on the overflow list.
+    ++num_overflows_;
+    ++drain_count_;
+    PushOverflow(new OverflowAction{ prior_epoch, callback, context });
     return prior_epoch + 1;
   }
 
-  /// Compute latest epoch that is safe to reclaim, by scanning the epoch table
+  inline void PushOverflow(OverflowAction* action) {
+    OverflowAction* head = overflow_list_.load();
+    do {
+      action->next = head;
+    } while(!overflow_list_.compare_exchange_weak(head, action));
+  }
+
+  /// Performs the overflow list's actions that are safe to perform. Takes the whole list, so no
+  /// two threads see the same action.
+  void DrainOverflow() {
+    OverflowAction* action = overflow_list_.exchange(nullptr);
+    uint64_t safe_epoch = safe_to_reclaim_epoch.load();
+    while(action) {
+      OverflowAction* next = action->next;
+      if(action->epoch <= safe_epoch) {
+        action->callback(action->context);
+        delete action;
+        --drain_count_;
+      } else {
+        PushOverflow(action);
+      }
+      action = next;
+    }
+  }
+
+  /// Compute latest epoch that is safe to reclaim, by scanning the per-node aggregates. Only a
+  /// node whose aggregate holds the result back has its entries rescanned; so once a node's
+  /// threads have caught up to the current epoch, their (frequently written) entries aren't read
+  /// again until the epoch moves on.
   uint64_t ComputeNewSafeToReclaimEpoch(uint64_t current_epoch_) {
     uint64_t oldest_ongoing_call = current_epoch_;
-    for(uint32_t index = 1; index <= num_entries_; ++index) {
-      uint64_t entry_epoch = table_[index].local_current_epoch;
-      if(entry_epoch != kUnprotected && entry_epoch < oldest_ongoing_call) {
-        oldest_ongoing_call = entry_epoch;
+    uint32_t num_nodes_in_use = num_nodes_in_use_.load();
+    uint64_t refreshed = 0;
+    while(true) {
+      uint32_t oldest_node = kNoNode;
+      uint64_t oldest_node_epoch = oldest_ongoing_call;
+      for(uint32_t node = 0; node < num_nodes_in_use; ++node) {
+        uint64_t node_epoch = nodes_[node].oldest_epoch.load();
+        if(node_epoch < oldest_node_epoch) {
+          oldest_node = node;
+          oldest_node_epoch = node_epoch;
+        }
+      }
+      if(oldest_node == kNoNode) {
+        break;
       }
+      if(refreshed & ((uint64_t)1 << oldest_node)) {
+        // Even up to date, this node's aggregate is the oldest.
+        oldest_ongoing_call = oldest_node_epoch;
+        break;
+      }
+      RefreshNode(oldest_node);
+      refreshed |= (uint64_t)1 << oldest_node;
     }
     safe_to_reclaim_epoch = oldest_ongoing_call - 1;
     return safe_to_reclaim_epoch;
   }
 
+  /// Recompute the node's aggregate from its entries.
+  void RefreshNode(uint32_t node) {
+    NodeEntry& node_entry = nodes_[node];
+    uint64_t oldest_epoch = current_epoch.load();
+    for(uint32_t entry = node_entry.first_entry.load(); entry != kNoEntry;
+        entry = table_[entry].next_in_node) {
+      uint64_t entry_epoch = table_[entry].local_current_epoch;
+      if(entry_epoch != kUnprotected && entry_epoch < oldest_epoch) {
+        oldest_epoch = entry_epoch;
+      }
+    }
+    // A concurrent refresh may have seen later epochs; keep the later bound.
+    uint64_t node_epoch = node_entry.oldest_epoch.load();
+    while(node_epoch < oldest_epoch &&
+          !node_entry.oldest_epoch.compare_exchange_weak(node_epoch, oldest_epoch)) {
+    }
+  }
+
   void SpinWaitForSafeToReclaim(uint64_t current_epoch_, uint64_t safe_to_reclaim_epoch_) {
     do {
       ComputeNewSafeToReclaimEpoch(current_epoch_);
@@ -294,7 +481,8 @@ class LightEpoch {
 
   /// CPR checkpoint functions.
   inline void ResetPhaseFinished() {
-    for(uint32_t idx = 1; idx <= num_entries_; ++idx) {
+    uint32_t num_entries_in_use = num_entries_in_use_.load();
+    for(uint32_t idx = 0; idx < num_entries_in_use; ++idx) {
       assert(table_[idx].phase_finished.load() == Phase::REST ||
              table_[idx].phase_finished.load() == Phase::INDEX_CHKPT ||
              table_[idx].phase_finished.load() == Phase::PERSISTENCE_CALLBACK ||
@@ -308,7 +496,8 @@ class LightEpoch {
     uint32_t entry = Thread::id();
     table_[entry].phase_finished = phase;
     // Check if other threads have reported complete.
-    for(uint32_t idx = 1; idx <= num_entries_; ++idx) {
+    uint32_t num_entries_in_use = num_entries_in_use_.load();
+    for(uint32_t idx = 0; idx < num_entries_in_use; ++idx) {
       Phase entry_phase = table_[idx].phase_finished.load();
       uint64_t entry_epoch = table_[idx].local_current_epoch;
       if(entry_epoch != 0 && entry_phase != phase) {
@@ -0,0 +1,386 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "address.h"
+#include "alloc.h"
+#include "async.h"
+#include "constants.h"
+#include "key_hash.h"
+#include "status.h"
+
+namespace FASTER {
+namespace core {
+
+/// A blocked Bloom filter over key hashes: all of a key's bits fall in one cache-line block, so
+/// a lookup touches one cache line. At 16 bits per key, about 0.1% of lookups are false
+/// positives. (A lookup that searches many filters sums their false positive rates.)
+class BloomFilter {
+ public:
+  static constexpr uint32_t kBitsPerKey = 16;
+  /// Bits set per key; each takes 9 bits of a 64-bit hash.
+  static constexpr uint32_t kNumProbes = 7;
+  static constexpr uint32_t kBlockBits = Constants::kCacheLineBytes * 8;
+  static constexpr uint32_t kWordsPerBlock = kBlockBits / 64;
+
+  explicit BloomFilter(uint32_t num_blocks)
+    : num_blocks_{ num_blocks }
+    , words_{ reinterpret_cast<uint64_t*>(aligned_alloc(Constants::kCacheLineBytes,
+                                          size())) } {
+    std::memset(words_, 0, size());
+  }
+
+  ~BloomFilter() {
+    aligned_free(words_);
+  }
+
+  BloomFilter(const BloomFilter&) = delete;
+  BloomFilter& operator=(const BloomFilter&) = delete;
+
+  /// Number of blocks to allocate, for a filter over "num_keys" keys.
+  static uint32_t NumBlocks(uint64_t num_keys) {
+    uint64_t num_blocks = (num_keys * kBitsPerKey + kBlockBits - 1) / kBlockBits;
+    return num_blocks > 0 ? static_cast<uint32_t>(num_blocks) : 1;
+  }
+  /// Number of keys the filter holds at kBitsPerKey; past that, false positives climb fast.
+  inline uint64_t capacity() const {
+    return static_cast<uint64_t>(num_blocks_) * kBlockBits / kBitsPerKey;
+  }
+
+  inline void Add(KeyHash hash) {
+    uint64_t* block;
+    uint64_t bits;
+    Locate(hash, block, bits);
+    for(uint32_t probe = 0; probe < kNumProbes; ++probe, bits >>= 9) {
+      uint32_t bit = bits & (kBlockBits - 1);
+      block[bit / 64] |= (uint64_t)1 << (bit % 64);
+    }
+  }
+
+  inline bool MayContain(KeyHash hash) const {
+    uint64_t* block;
+    uint64_t bits;
+    Locate(hash, block, bits);
+    for(uint32_t probe = 0; probe < kNumProbes; ++probe, bits >>= 9) {
+      uint32_t bit = bits & (kBlockBits - 1);
+      if((block[bit / 64] & ((uint64_t)1 << (bit % 64))) == 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  inline uint32_t num_blocks() const {
+    return num_blocks_;
+  }
+  /// Size of the filter's bits, in bytes.
+  inline uint64_t size() const {
+    return static_cast<uint64_t>(num_blocks_) * Constants::kCacheLineBytes;
+  }
+  inline const uint64_t* data() const {
+    return words_;
+  }
+  inline uint64_t* data() {
+    return words_;
+  }
+
+ private:
+  /// Mixes the key's hash (whose bits the hash index already uses), and picks a block and the
+  /// bits within it.
+  inline void Locate(KeyHash hash, uint64_t*& block, uint64_t& bits) const {
+    uint64_t mixed = hash.control();
+    mixed ^= mixed >> 33;
+    mixed *= 0xff51afd7ed558ccdULL;
+    mixed ^= mixed >> 33;
+    mixed *= 0xc4ceb9fe1a85ec53ULL;
+    mixed ^= mixed >> 33;
+    uint64_t block_idx = ((mixed >> 32) * num_blocks_) >> 32;
+    block = words_ + block_idx * kWordsPerBlock;
+    bits = mixed;
+  }
+
+  uint32_t num_blocks_;
+  uint64_t* words_;
+};
+
+/// Bloom filters over the keys of the hybrid log's pages, so that a lookup can tell that no page
+/// in a range of the log holds its key, without reading the range from disk. A page's filter is
+/// built once the whole page is read-only, just before it's flushed; a page without a filter (not
+/// yet read-only, or read-only before the store was recovered from a checkpoint without filters)
+/// may hold any key. Once every page of a segment (kSegmentPages consecutive pages) has been
+/// filtered, the segment gets a filter of its own, so a lookup checks one filter per segment
+/// rather than one per page. (Unless the segment's pages held many more keys than its first page
+/// did, in which case its filter would be overfull, and lookups keep checking its pages' filters.)
+class LogFilters {
+ public:
+  /// Filters are indexed by page, through a two-level table.
+  static constexpr uint32_t kChunkBits = 12;
+  static constexpr uint32_t kChunkSize = (uint32_t)1 << kChunkBits;
+  static constexpr uint32_t kNumChunks = (Address::kMaxPage >> kChunkBits) + 1;
+  static constexpr uint32_t kSegmentBits = 6;
+  static constexpr uint32_t kSegmentPages = (uint32_t)1 << kSegmentBits;
+  static constexpr uint32_t kSegmentsPerChunk = kChunkSize / kSegmentPages;
+  /// A lookup checks at most this many filters (enough for the pages of one segment without a
+  /// filter, and as many segments again); past them, the key may be anywhere.
+  static constexpr uint32_t kMaxProbes = 2 * kSegmentPages;
+
+  LogFilters()
+    : truncated_until_{ 0 } {
+    for(uint32_t idx = 0; idx < kNumChunks; ++idx) {
+      chunks_[idx].store(nullptr);
+    }
+  }
+
+  ~LogFilters() {
+    for(uint32_t idx = 0; idx < kNumChunks; ++idx) {
+      Chunk* chunk = chunks_[idx].load();
+      if(chunk) {
+        for(uint32_t entry = 0; entry < kChunkSize; ++entry) {
+          delete chunk->filters[entry].load();
+        }
+        for(uint32_t entry = 0; entry < kSegmentsPerChunk; ++entry) {
+          delete chunk->segments[entry].load();
+          delete chunk->building[entry];
+        }
+        delete chunk;
+      }
+    }
+  }
+
+  /// Builds the filter of a read-only page, from the hashes of all its keys; and, once every page
+  /// of the page's segment has a filter, the segment's filter.
+  void Build(uint32_t page, const std::vector<KeyHash>& hashes) {
+    BloomFilter* filter = new BloomFilter{ BloomFilter::NumBlocks(hashes.size()) };
+    for(KeyHash hash : hashes) {
+      filter->Add(hash);
+    }
+    if(!Set(page, filter)) {
+      // The page was already filtered, and its keys already added to its segment.
+      return;
+    }
+    Chunk& chunk = GetChunk(page);
+    uint32_t segment = (page & (kChunkSize - 1)) >> kSegmentBits;
+    std::lock_guard<std::mutex> lock{ segment_mutex_ };
+    if(chunk.segments[segment].load()) {
+      return;
+    }
+    BloomFilter*& building = chunk.building[segment];
+    if(chunk.pages_built[segment] == 0) {
+      // Size the segment's filter as if all its pages held as many keys as this one.
+      building = new BloomFilter{ BloomFilter::NumBlocks(hashes.size() * kSegmentPages) };
+    }
+    ++chunk.pages_built[segment];
+    chunk.keys_built[segment] += hashes.size();
+    if(!building) {
+      // The segment's filter overflowed; its pages' filters stand in for it.
+      return;
+    }
+    if(chunk.keys_built[segment] > building->capacity()) {
+      delete building;
+      building = nullptr;
+      return;
+    }
+    for(KeyHash hash : hashes) {
+      building->Add(hash);
+    }
+    if(chunk.pages_built[segment] == kSegmentPages) {
+      chunk.segments[segment].store(building);
+      building = nullptr;
+    }
+  }
+
+  /// Takes ownership of "filter". A page's contents don't change once it's read-only, so if the
+  /// page already has a filter, the existing filter is kept (and false is returned).
+  bool Set(uint32_t page, BloomFilter* filter) {
+    std::atomic<BloomFilter*>& entry = GetChunk(page).filters[page & (kChunkSize - 1)];
+    BloomFilter* expected = nullptr;
+    if(!entry.compare_exchange_strong(expected, filter)) {
+      delete filter;
+      return false;
+    }
+    return true;
+  }
+
+  /// False if the filters show that no page in [begin_page, end_page] holds the key.
+  bool MayContain(KeyHash hash, uint32_t begin_page, uint32_t end_page) const {
+    // Search downward, in the order that a hash chain visits the pages: a segment at a time,
+    // where the segment has a filter; otherwise, a page at a time.
+    uint32_t probes = 0;
+    for(uint32_t page = end_page; page >= begin_page && page != UINT32_MAX; --page) {
+      if(++probes > kMaxProbes) {
+        return true;
+      }
+      const Chunk* chunk = chunks_[page >> kChunkBits].load();
+      if(!chunk) {
+        return true;
+      }
+      const BloomFilter* filter =
+        chunk->segments[(page & (kChunkSize - 1)) >> kSegmentBits].load();
+      if(filter) {
+        // Skip to the last page of the previous segment.
+        page &= ~(kSegmentPages - 1);
+      } else {
+        filter = chunk->filters[page & (kChunkSize - 1)].load();
+      }
+      if(!filter || filter->MayContain(hash)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Frees the filters of pages below "begin_page", which garbage collection has truncated. The
+  /// caller must ensure that no thread is still searching those pages.
+  void Truncate(uint32_t begin_page) {
+    for(uint32_t page = truncated_until_; page < begin_page; ++page) {
+      Chunk* chunk = chunks_[page >> kChunkBits].load();
+      if(chunk) {
+        delete chunk->filters[page & (kChunkSize - 1)].exchange(nullptr);
+        if((page & (kSegmentPages - 1)) == kSegmentPages - 1) {
+          // The whole segment is truncated.
+          uint32_t segment = (page & (kChunkSize - 1)) >> kSegmentBits;
+          std::lock_guard<std::mutex> lock{ segment_mutex_ };
+          delete chunk->segments[segment].exchange(nullptr);
+          delete chunk->building[segment];
+          chunk->building[segment] = nullptr;
+        }
+      }
+    }
+    if(begin_page > truncated_until_) {
+      truncated_until_ = begin_page;
+    }
+  }
+
+  /// Writes the filters to a checkpoint file: for each page that has a filter, its page number,
+  /// number of blocks, and bits; then UINT32_MAX; then the same for each segment that has a
+  /// filter, by the segment's first page.
+  Status Write(std::FILE* file) const {
+    RETURN_NOT_OK(WriteFilters(file, false));
+    return WriteFilters(file, true);
+  }
+
+  /// Reads the filters that Write() wrote, keeping those of pages in [begin_page, end_page), and
+  /// of segments that end before end_page.
+  Status Read(std::FILE* file, uint32_t begin_page, uint32_t end_page) {
+    RETURN_NOT_OK(ReadFilters(file, false, begin_page, end_page));
+    return ReadFilters(file, true, begin_page, end_page);
+  }
+
+ private:
+  struct Chunk {
+    Chunk() {
+      for(uint32_t entry = 0; entry < kChunkSize; ++entry) {
+        filters[entry].store(nullptr);
+      }
+      for(uint32_t entry = 0; entry < kSegmentsPerChunk; ++entry) {
+        segments[entry].store(nullptr);
+        building[entry] = nullptr;
+        pages_built[entry] = 0;
+        keys_built[entry] = 0;
+      }
+    }
+
+    std::atomic<BloomFilter*> filters[kChunkSize];
+    /// Filters of segments whose pages all have filters.
+    std::atomic<BloomFilter*> segments[kSegmentsPerChunk];
+    /// Filters of segments still being built (null once overfull), and how many of their pages
+    /// and keys have been added; protected by segment_mutex_.
+    BloomFilter* building[kSegmentsPerChunk];
+    uint32_t pages_built[kSegmentsPerChunk];
+    uint64_t keys_built[kSegmentsPerChunk];
+  };
+
+  Status WriteFilters(std::FILE* file, bool segments) const {
+    uint32_t num_entries = segments ? kSegmentsPerChunk : kChunkSize;
+    for(uint32_t chunk_idx = 0; chunk_idx < kNumChunks; ++chunk_idx) {
+      const Chunk* chunk = chunks_[chunk_idx].load();
+      if(!chunk) {
+        continue;
+      }
+      for(uint32_t entry = 0; entry < num_entries; ++entry) {
+        const BloomFilter* filter = segments ? chunk->segments[entry].load() :
+                                    chunk->filters[entry].load();
+        if(!filter) {
+          continue;
+        }
+        uint32_t page = (chunk_idx << kChunkBits) | (segments ? entry << kSegmentBits : entry);
+        uint32_t header[2] = { page, filter->num_blocks() };
+        if(std::fwrite(header, sizeof(header), 1, file) != 1 ||
+            std::fwrite(filter->data(), filter->size(), 1, file) != 1) {
+          return Status::IOError;
+        }
+      }
+    }
+    uint32_t end = UINT32_MAX;
+    if(std::fwrite(&end, sizeof(end), 1, file) != 1) {
+      return Status::IOError;
+    }
+    return Status::Ok;
+  }
+
+  Status ReadFilters(std::FILE* file, bool segments, uint32_t begin_page, uint32_t end_page) {
+    while(true) {
+      uint32_t page;
+      if(std::fread(&page, sizeof(page), 1, file) != 1) {
+        return Status::IOError;
+      }
+      if(page == UINT32_MAX) {
+        return Status::Ok;
+      }
+      uint32_t num_blocks;
+      if(page > Address::kMaxPage || (segments && (page & (kSegmentPages - 1)) != 0) ||
+          std::fread(&num_blocks, sizeof(num_blocks), 1, file) != 1) {
+        return Status::Corruption;
+      }
+      BloomFilter* filter = new BloomFilter{ num_blocks };
+      if(std::fread(filter->data(), filter->size(), 1, file) != 1) {
+        delete filter;
+        return Status::IOError;
+      }
+      if(!segments && page >= begin_page && page < end_page) {
+        Set(page, filter);
+      } else if(segments && page + kSegmentPages > begin_page &&
+                page + kSegmentPages <= end_page) {
+        // (A segment's filter still covers the segment once its first pages are truncated.)
+        std::atomic<BloomFilter*>& entry =
+          GetChunk(page).segments[(page & (kChunkSize - 1)) >> kSegmentBits];
+        BloomFilter* expected = nullptr;
+        if(!entry.compare_exchange_strong(expected, filter)) {
+          delete filter;
+        }
+      } else {
+        delete filter;
+      }
+    }
+  }
+
+  Chunk& GetChunk(uint32_t page) {
+    std::atomic<Chunk*>& slot = chunks_[page >> kChunkBits];
+    Chunk* chunk = slot.load();
+    if(!chunk) {
+      Chunk* new_chunk = new Chunk{};
+      if(slot.compare_exchange_strong(chunk, new_chunk)) {
+        chunk = new_chunk;
+      } else {
+        delete new_chunk;
+      }
+    }
+    return *chunk;
+  }
+
+  std::atomic<Chunk*> chunks_[kNumChunks];
+  std::mutex segment_mutex_;
+  /// Filters below this page have been freed.
+  uint32_t truncated_until_;
+};
+
+}
+} // namespace FASTER::core
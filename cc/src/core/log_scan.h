@@ -0,0 +1,339 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include "address.h"
+#include "alloc.h"
+#include "async.h"
+#include "persistent_memory_malloc.h"
+#include "record.h"
+#include "status.h"
+
+namespace FASTER {
+namespace core {
+
+/// Synchronous reads from the hybrid log's file, for code (such as log scans) that runs outside
+/// FASTER's pending-I/O machinery. Waits for each read by polling the disk's I/O handler.
+template <class D>
+class LogFileReader {
+ public:
+  typedef D disk_t;
+  typedef typename D::log_file_t log_file_t;
+
+  LogFileReader(disk_t& disk, log_file_t& file)
+    : disk_{ &disk }
+    , file_{ &file }
+    , alignment_{ static_cast<uint32_t>(file.alignment()) }
+    , buffer_{ nullptr }
+    , buffer_size_{ 0 } {
+  }
+
+  ~LogFileReader() {
+    if(buffer_) {
+      aligned_free(buffer_);
+    }
+  }
+
+  /// Reads [offset, offset + length) from the log file into the sector-aligned buffer "dest".
+  Status Read(uint64_t offset, uint8_t* dest, uint32_t length) {
+    class Context : public IAsyncContext {
+     public:
+      Context(std::atomic<bool>& done_, Status& result_)
+        : done{ &done_ }
+        , result{ &result_ } {
+      }
+      /// The deep-copy constructor
+      Context(const Context& other)
+        : done{ other.done }
+        , result{ other.result } {
+      }
+     protected:
+      Status DeepCopy_Internal(IAsyncContext*& context_copy) final {
+        return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+      }
+     public:
+      std::atomic<bool>* done;
+      Status* result;
+    };
+
+    auto callback = [](IAsyncContext* ctxt, Status result, size_t bytes_transferred) {
+      CallbackContext<Context> context{ ctxt };
+      *context->result = result;
+      context->done->store(true);
+    };
+
+    assert(offset % alignment_ == 0);
+    assert(length % alignment_ == 0);
+    std::atomic<bool> done{ false };
+    Status result = Status::Ok;
+    Context context{ done, result };
+    RETURN_NOT_OK(file_->ReadAsync(offset, dest, length, callback, context));
+    while(!done.load()) {
+      disk_->TryComplete();
+    }
+    return result;
+  }
+
+  /// Reads the record at the specified address. Only the record's header and key are guaranteed
+  /// to be valid; the pointer is valid until the next call to ReadRecord().
+  template <class R>
+  const R* ReadRecord(Address address) {
+    uint64_t begin_read = address.control() & ~static_cast<uint64_t>(alignment_ - 1);
+    uint32_t offset = static_cast<uint32_t>(address.control() - begin_read);
+    uint32_t length = AlignUp(offset + R::min_disk_key_size());
+    if(ReadIntoBuffer(begin_read, length) != Status::Ok) {
+      return nullptr;
+    }
+    const R* record = reinterpret_cast<const R*>(buffer_ + offset);
+    uint32_t key_length = AlignUp(offset + record->min_disk_value_size());
+    if(key_length > length) {
+      // Need more bytes, to cover the whole key.
+      if(ReadIntoBuffer(begin_read, key_length) != Status::Ok) {
+        return nullptr;
+      }
+      record = reinterpret_cast<const R*>(buffer_ + offset);
+    }
+    return record;
+  }
+
+  /// Reads the whole record (header, key, and value) at the specified address; the pointer is
+  /// valid until the next call to ReadRecord() or ReadFullRecord().
+  template <class R>
+  const R* ReadFullRecord(Address address) {
+    const R* record = ReadRecord<R>(address);
+    if(!record) {
+      return nullptr;
+    }
+    uint64_t begin_read = address.control() & ~static_cast<uint64_t>(alignment_ - 1);
+    uint32_t offset = static_cast<uint32_t>(address.control() - begin_read);
+    uint32_t length = AlignUp(offset + record->disk_size());
+    if(length > AlignUp(offset + R::min_disk_key_size()) &&
+        length > AlignUp(offset + record->min_disk_value_size())) {
+      // Need more bytes, to cover the whole value.
+      if(ReadIntoBuffer(begin_read, length) != Status::Ok) {
+        return nullptr;
+      }
+      record = reinterpret_cast<const R*>(buffer_ + offset);
+    }
+    return record;
+  }
+
+ private:
+  inline uint32_t AlignUp(uint32_t size) const {
+    return (size + alignment_ - 1) & ~(alignment_ - 1);
+  }
+
+  Status ReadIntoBuffer(uint64_t offset, uint32_t length) {
+    if(length > buffer_size_) {
+      if(buffer_) {
+        aligned_free(buffer_);
+      }
+      buffer_ = reinterpret_cast<uint8_t*>(aligned_alloc(alignment_, length));
+      buffer_size_ = length;
+    }
+    return Read(offset, buffer_, length);
+  }
+
+  disk_t* disk_;
+  log_file_t* file_;
+  uint32_t alignment_;
+
+  /// Buffer for ReadRecord().
+  uint8_t* buffer_;
+  uint32_t buffer_size_;
+};
+
+/// Iterates over the valid records in the range [begin_address, end_address) of the hybrid log.
+/// Pages that are still in memory are served in place, out of the circular buffer; older pages
+/// are read from disk a whole page at a time, reading the next page ahead while the caller
+/// consumes the current one. The caller must hold epoch protection (i.e., be in a session) while
+/// iterating. The scan stops at the safe read-only address, as of the iterator's construction:
+/// above it, records may still be updated in place, and a record that has been allocated but not
+/// yet written reads as empty space.
+template <class K, class V, class D>
+class LogScanIterator {
+ public:
+  typedef K key_t;
+  typedef V value_t;
+  typedef D disk_t;
+  typedef typename D::log_file_t log_file_t;
+  typedef Record<key_t, value_t> record_t;
+  typedef PersistentMemoryMalloc<disk_t> hlog_t;
+
+  static constexpr uint64_t kPageSize = hlog_t::kPageSize;
+
+ private:
+  /// A buffer holding a page read from disk. Two frames alternate, so that the read of the next
+  /// page overlaps with the scan of the current page.
+  struct Frame {
+    Frame()
+      : buffer{ nullptr }
+      , page{ UINT32_MAX }
+      , done{ true }
+      , result{ Status::Ok } {
+    }
+
+    uint8_t* buffer;
+    uint32_t page;
+    std::atomic<bool> done;
+    Status result;
+  };
+
+ public:
+  LogScanIterator(hlog_t& hlog, disk_t& disk, Address begin_address, Address end_address)
+    : hlog_{ &hlog }
+    , disk_{ &disk }
+    , begin_address_{ begin_address }
+    , end_address_{ std::min(end_address, hlog.safe_read_only_address.load()) }
+    // The begin address needn't be a record boundary, so start from the beginning of its page.
+    , current_address_{ begin_address.page(), 0 }
+    , status_{ Status::Ok } {
+  }
+
+  /// Scans from "begin_address" to the end of the log's immutable region. To scan up to the
+  /// current tail, shift the read-only address to the tail first, and wait for it to be safe.
+  LogScanIterator(hlog_t& hlog, disk_t& disk, Address begin_address)
+    : LogScanIterator(hlog, disk, begin_address, hlog.GetTailAddress()) {
+  }
+
+  LogScanIterator(const LogScanIterator&) = delete;
+  LogScanIterator& operator=(const LogScanIterator&) = delete;
+
+  ~LogScanIterator() {
+    for(Frame& frame : frames_) {
+      // Don't free a buffer that an outstanding read is still writing to.
+      WaitForRead(frame);
+      if(frame.buffer) {
+        aligned_free(frame.buffer);
+      }
+    }
+  }
+
+  /// Returns the next valid record and sets "address" to its logical address; returns nullptr
+  /// when the scan is complete (or on an I/O error). A record read from disk is valid until the
+  /// next call; a record served from memory is valid until the caller next refreshes its epoch.
+  const record_t* GetNext(Address& address) {
+    while(current_address_ < end_address_) {
+      const uint8_t* page = GetPage(current_address_.page());
+      if(!page) {
+        return nullptr;
+      }
+      const record_t* record = reinterpret_cast<const record_t*>(page +
+                               current_address_.offset());
+      if(record->header.IsNull()) {
+        // Unused space, at the beginning or end of a page.
+        current_address_ += sizeof(record->header);
+        continue;
+      }
+      address = current_address_;
+      current_address_ += record->size();
+      if(record->header.invalid || address < begin_address_) {
+        continue;
+      }
+      return record;
+    }
+    return nullptr;
+  }
+
+  /// Ok, unless the scan ended early because of an I/O error.
+  inline Status status() const {
+    return status_;
+  }
+
+ private:
+  const uint8_t* GetPage(uint32_t page) {
+    if(Address{ page, 0 } >= hlog_->head_address.load()) {
+      // The page is in memory; since we hold epoch protection, it can't be evicted until the
+      // caller refreshes.
+      return hlog_->Page(page);
+    }
+    Frame& frame = frames_[page % 2];
+    if(frame.page != page) {
+      IssueRead(frame, page);
+    }
+    WaitForRead(frame);
+    if(frame.result != Status::Ok) {
+      status_ = frame.result;
+      return nullptr;
+    }
+    // Read the next page ahead, if it's also on disk and part of the scan.
+    uint32_t next_page = page + 1;
+    Address next_address{ next_page, 0 };
+    if(next_address < end_address_ && next_address < hlog_->head_address.load()) {
+      Frame& next_frame = frames_[next_page % 2];
+      if(next_frame.page != next_page) {
+        IssueRead(next_frame, next_page);
+      }
+    }
+    return frame.buffer;
+  }
+
+  void IssueRead(Frame& frame, uint32_t page) {
+    class Context : public IAsyncContext {
+     public:
+      Context(Frame& frame_)
+        : frame{ &frame_ } {
+      }
+      /// The deep-copy constructor
+      Context(const Context& other)
+        : frame{ other.frame } {
+      }
+     protected:
+      Status DeepCopy_Internal(IAsyncContext*& context_copy) final {
+        return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+      }
+     public:
+      Frame* frame;
+    };
+
+    auto callback = [](IAsyncContext* ctxt, Status result, size_t bytes_transferred) {
+      CallbackContext<Context> context{ ctxt };
+      context->frame->result = result;
+      context->frame->done.store(true);
+    };
+
+    WaitForRead(frame);
+    if(!frame.buffer) {
+      frame.buffer = reinterpret_cast<uint8_t*>(aligned_alloc(hlog_->sector_size, kPageSize));
+    }
+    frame.page = page;
+    // Clear the buffer, so that a device that doesn't persist pages (e.g., NullDisk) yields an
+    // empty page.
+    std::memset(frame.buffer, 0, kPageSize);
+    frame.done.store(false);
+    Context context{ frame };
+    Status result = hlog_->file->ReadAsync(Address{ page, 0 }.control(), frame.buffer,
+                                           static_cast<uint32_t>(kPageSize), callback, context);
+    if(result != Status::Ok) {
+      frame.result = result;
+      frame.done.store(true);
+    }
+  }
+
+  void WaitForRead(const Frame& frame) {
+    while(!frame.done.load()) {
+      disk_->TryComplete();
+    }
+  }
+
+  hlog_t* hlog_;
+  disk_t* disk_;
+
+  Address begin_address_;
+  Address end_address_;
+  Address current_address_;
+
+  Frame frames_[2];
+
+  Status status_;
+};
+
+}
+} // namespace FASTER::core
@@ -20,6 +20,40 @@ namespace lss_memory {
 
 static_assert(sizeof(Header) < kBaseAlignment, "Unexpected header size!");
 
+/// Segments whose allocations have all been freed are kept here for reuse, rather than returned to
+/// the heap; so a mostly-FIFO workload, once warmed up, allocates without calling malloc().
+static constexpr uint32_t kNumSpareSegments = 32;
+static std::atomic<SegmentAllocator*> spare_segments_[kNumSpareSegments];
+
+static SegmentAllocator* NewSegment() {
+  // Threads start their searches at different slots.
+  uint32_t start = Thread::id();
+  for(uint32_t idx = 0; idx < kNumSpareSegments; ++idx) {
+    std::atomic<SegmentAllocator*>& slot = spare_segments_[(start + idx) % kNumSpareSegments];
+    if(slot.load() != nullptr) {
+      SegmentAllocator* segment = slot.exchange(nullptr);
+      if(segment) {
+        return new(segment) SegmentAllocator{};
+      }
+    }
+  }
+  void* segment = aligned_alloc(ThreadAllocator::kCacheLineSize, sizeof(SegmentAllocator));
+  return segment ? new(segment) SegmentAllocator{} : nullptr;
+}
+
+static void DeleteSegment(SegmentAllocator* segment) {
+  segment->~SegmentAllocator();
+  uint32_t start = static_cast<uint32_t>(reinterpret_cast<size_t>(segment) / sizeof(*segment));
+  for(uint32_t idx = 0; idx < kNumSpareSegments; ++idx) {
+    std::atomic<SegmentAllocator*>& slot = spare_segments_[(start + idx) % kNumSpareSegments];
+    SegmentAllocator* expected = nullptr;
+    if(slot.load() == nullptr && slot.compare_exchange_strong(expected, segment)) {
+      return;
+    }
+  }
+  aligned_free(segment);
+}
+
 void SegmentAllocator::Free(void* bytes) {
 #ifdef _DEBUG
   Header* header = reinterpret_cast<Header*>(bytes) - 1;
@@ -38,8 +72,7 @@ void SegmentAllocator::Seal(uint32_t allocations) {
   assert(old_state.frees < allocations);
   if(allocations == old_state.frees + 1) {
     // We were the last to free a block inside this segment, so we must free it.
-    this->~SegmentAllocator();
-    aligned_free(this);
+    DeleteSegment(this);
   }
 }
 
@@ -49,19 +82,16 @@ void SegmentAllocator::Free() {
   assert(old_state.allocations == 0 || old_state.frees < old_state.allocations);
   if(old_state.allocations == old_state.frees + 1) {
     // We were the last to free a block inside this segment, so we must free it.
-    this->~SegmentAllocator();
-    aligned_free(this);
+    DeleteSegment(this);
   }
 }
 
 void* ThreadAllocator::Allocate(uint32_t size) {
   if(!segment_allocator_) {
-    segment_allocator_ = reinterpret_cast<SegmentAllocator*>(aligned_alloc(kCacheLineSize,
-                         sizeof(SegmentAllocator)));
+    segment_allocator_ = NewSegment();
     if(!segment_allocator_) {
       return nullptr;
     }
-    new(segment_allocator_) SegmentAllocator{};
   }
   // Block is 16-byte aligned, after a 2-byte (8-byte in _DEBUG mode) header.
   uint32_t block_size = static_cast<uint32_t>(pad_alignment(size + sizeof(Header),
@@ -94,12 +124,10 @@ void* ThreadAllocator::Allocate(uint32_t size) {
 
 void* ThreadAllocator::AllocateAligned(uint32_t size, uint32_t alignment) {
   if(!segment_allocator_) {
-    segment_allocator_ = reinterpret_cast<SegmentAllocator*>(aligned_alloc(kCacheLineSize,
-                         sizeof(SegmentAllocator)));
+    segment_allocator_ = NewSegment();
     if(!segment_allocator_) {
       return nullptr;
     }
-    new(segment_allocator_) SegmentAllocator{};
   }
   // Alignment must be >= base alignment, and a power of 2.
   assert(alignment >= kBaseAlignment);
@@ -205,9 +205,9 @@ static_assert(sizeof(ThreadAllocator) == 64, "sizeof(ThreadAllocator) != 64.");
 /// continuations.
 class LssAllocator {
  public:
-  /// Maximum number of threads supported. For each possible thread, we reserve an 8-byte
-  /// ThreadAllocator; so the memory required is 8 * (kMaxThreadCount) bytes. For each actual
-  /// thread, we reserve a full SegmentAllocator, of size approximately kSegmentSize.
+  /// Maximum number of threads supported. Each thread's ThreadAllocator is allocated (along with
+  /// those of neighboring thread IDs) on the thread's first allocation; and for each thread that
+  /// allocates, we reserve a full SegmentAllocator, of size approximately kSegmentSize.
   static constexpr size_t kMaxThreadCount = Thread::kMaxNumThreads;
 
   /// Size of each segment (in bytes).
@@ -219,9 +219,6 @@ class LssAllocator {
   /// Initialize the LSS allocator. The real work happens lazily, when a thread calls Allocate()
   /// for the first time.
   LssAllocator() {
-    for(size_t idx = 0; idx < kMaxThreadCount; ++idx) {
-      thread_allocators_[idx] = lss_memory::ThreadAllocator{};
-    }
   }
 
   /// Allocate a memory block of the specified size. Note that size must be < kSegmentSize, since
@@ -239,7 +236,7 @@ class LssAllocator {
  private:
   /// To reduce contention (and avoid needing atomic primitives in the allocation path), we
   /// maintain a unique allocator per thread.
-  lss_memory::ThreadAllocator thread_allocators_[kMaxThreadCount];
+  ThreadTable<lss_memory::ThreadAllocator> thread_allocators_;
 };
 
 /// The global LSS allocator instance.
@@ -282,6 +282,9 @@ class MallocFixedPageSize {
     alignment_ = alignment;
     count_.store(0);
     epoch_ = &epoch;
+    if(free_list_.size() != epoch.num_entries()) {
+      free_list_.Initialize(epoch.num_entries());
+    }
     disk_ = nullptr;
     pending_checkpoint_writes_ = 0;
     pending_recover_reads_ = 0;
@@ -383,7 +386,8 @@ class MallocFixedPageSize {
   std::atomic<bool> recover_pending_;
   std::atomic<bool> recover_failed_;
 
-  FreeList free_list_[Thread::kMaxNumThreads];
+  /// One free list per thread that the epoch has room for.
+  ThreadArray<FreeList> free_list_;
 };
 
 /// Implementations.
@@ -431,9 +435,10 @@ Status MallocFixedPageSize<T, F>::CheckpointComplete(bool wait) {
   disk_->TryComplete();
   bool complete = !checkpoint_pending_.load();
   while(wait && !complete) {
-    disk_->TryComplete();
+    if(!disk_->WaitForCompletion(Constants::kIoWaitMicros)) {
+      std::this_thread::yield();
+    }
     complete = !checkpoint_pending_.load();
-    std::this_thread::yield();
   }
   if(!complete) {
     return Status::Pending;
@@ -499,9 +504,10 @@ Status MallocFixedPageSize<T, F>::RecoverComplete(bool wait) {
   disk_->TryComplete();
   bool complete = !recover_pending_.load();
   while(wait && !complete) {
-    disk_->TryComplete();
+    if(!disk_->WaitForCompletion(Constants::kIoWaitMicros)) {
+      std::this_thread::yield();
+    }
     complete = !recover_pending_.load();
-    std::this_thread::yield();
   }
   if(!complete) {
     return Status::Pending;
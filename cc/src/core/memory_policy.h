@@ -0,0 +1,266 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define _WINSOCKAPI_
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#include "alloc.h"
+
+namespace FASTER {
+namespace core {
+
+/// How the store's large, long-lived buffers--the hybrid log's pages and the hash index--are
+/// backed. By default they come from aligned_alloc(). The other options map them directly from
+/// the OS: on huge pages, to cut the TLB misses of random accesses to multi-GB buffers; placed on
+/// particular NUMA nodes; and faulted in up front, rather than on first touch. Placement and page
+/// size are best effort: if the OS refuses them, the buffer gets default pages and placement.
+class MemoryPolicy {
+ public:
+  enum class PageSize : uint8_t {
+    /// The OS's base pages (or aligned_alloc(), if no other option is set).
+    Default,
+    /// Ask the OS to back the buffer with transparent huge pages (Linux only).
+    Transparent,
+    /// Huge pages from the pool the system administrator reserved (Linux hugetlbfs; Windows large
+    /// pages, which need SeLockMemoryPrivilege). Buffers smaller than 1 GB get 2 MB pages. If the
+    /// pool runs dry, buffers fall back to transparent huge pages.
+    Huge2MB,
+    Huge1GB
+  };
+
+  enum class Numa : uint8_t {
+    /// The OS's default: usually, the node of the thread that first touches each page.
+    Default,
+    /// Spread the buffer's pages across all nodes (Linux only). Suits the hash index, which every
+    /// thread accesses at random.
+    Interleave,
+    /// Place the buffer's pages on node numa_node.
+    Bind
+  };
+
+  static constexpr size_t kBasePageSize = 4096;
+  static constexpr size_t kHugePageSize = (size_t)1 << 21;
+  static constexpr size_t kGiantPageSize = (size_t)1 << 30;
+
+  MemoryPolicy()
+    : page_size{ PageSize::Default }
+    , numa{ Numa::Default }
+    , numa_node{ 0 }
+    , prefault{ false } {
+  }
+
+  MemoryPolicy(PageSize page_size_, Numa numa_ = Numa::Default, uint32_t numa_node_ = 0,
+               bool prefault_ = false)
+    : page_size{ page_size_ }
+    , numa{ numa_ }
+    , numa_node{ numa_node_ }
+    , prefault{ prefault_ } {
+  }
+
+  /// Whether buffers are mapped from the OS, rather than taken from aligned_alloc().
+  inline bool mapped() const {
+    return page_size != PageSize::Default || numa != Numa::Default || prefault;
+  }
+
+  /// Allocates a zeroed buffer of "size" bytes, aligned to "alignment" bytes; returns nullptr if
+  /// the allocation fails. Mapped buffers are page-aligned, so "alignment" must be no more than
+  /// a base page.
+  void* Allocate(size_t alignment, size_t size) const {
+    if(!mapped()) {
+      void* buffer = aligned_alloc(alignment, size);
+      if(buffer) {
+        std::memset(buffer, 0, size);
+      }
+      return buffer;
+    }
+    assert(alignment <= kBasePageSize);
+    size_t length = MappedSize(size);
+    void* buffer = Map(length);
+    if(buffer && prefault) {
+      // Touching the pages doesn't change where they're placed; the policy set by Map() does.
+      volatile uint8_t* bytes = reinterpret_cast<volatile uint8_t*>(buffer);
+      for(size_t offset = 0; offset < length; offset += kBasePageSize) {
+        bytes[offset] = 0;
+      }
+    }
+    return buffer;
+  }
+
+  /// Zeroes a buffer that Allocate() returned, so that it can be reused. Unless the buffer is
+  /// prefaulted, its whole pages are handed back to the OS, which supplies zeroed pages again when
+  /// the buffer is next touched; only the partial pages at the ends of an aligned_alloc() buffer
+  /// are zeroed here. (A 32 MB log page would otherwise take milliseconds to zero.) Otherwise, the
+  /// buffer is zeroed with non-temporal stores, which bypass the cache rather than evict the
+  /// caller's working set.
+  void Clear(void* buffer, size_t size) const {
+#ifndef _WIN32
+    if(!prefault) {
+      // Mapped buffers are whole pages; aligned_alloc() ones share their end pages with the heap.
+      uintptr_t begin = reinterpret_cast<uintptr_t>(buffer);
+      uintptr_t end = begin + (mapped() ? MappedSize(size) : size);
+      uintptr_t pages_begin = (begin + kBasePageSize - 1) & ~(kBasePageSize - 1);
+      uintptr_t pages_end = end & ~(kBasePageSize - 1);
+      if(pages_begin < pages_end && ::madvise(reinterpret_cast<void*>(pages_begin),
+                                              pages_end - pages_begin, MADV_DONTNEED) == 0) {
+        std::memset(buffer, 0, pages_begin - begin);
+        std::memset(reinterpret_cast<void*>(pages_end), 0, end - pages_end);
+        return;
+      }
+    }
+#endif
+    ZeroNonTemporal(buffer, size);
+  }
+
+  /// Frees a buffer that Allocate() returned, given the size it was allocated with.
+  void Free(void* buffer, size_t size) const {
+    if(!mapped()) {
+      aligned_free(buffer);
+      return;
+    }
+#ifdef _WIN32
+    ::VirtualFree(buffer, 0, MEM_RELEASE);
+#else
+    ::munmap(buffer, MappedSize(size));
+#endif
+  }
+
+ private:
+  static void ZeroNonTemporal(void* buffer, size_t size) {
+#if defined(__SSE2__) || defined(_M_X64)
+    if(reinterpret_cast<uintptr_t>(buffer) % 16 == 0 && size % 64 == 0) {
+      __m128i zero = _mm_setzero_si128();
+      __m128i* words = reinterpret_cast<__m128i*>(buffer);
+      for(size_t idx = 0; idx < size / 16; idx += 4) {
+        _mm_stream_si128(words + idx, zero);
+        _mm_stream_si128(words + idx + 1, zero);
+        _mm_stream_si128(words + idx + 2, zero);
+        _mm_stream_si128(words + idx + 3, zero);
+      }
+      // Order the streaming stores before whatever publishes the buffer for reuse.
+      _mm_sfence();
+      return;
+    }
+#endif
+    std::memset(buffer, 0, size);
+  }
+
+  /// Mapped buffers are rounded up to whole pages of the size they asked for, whether or not they
+  /// got them; so Free() can compute the length that Allocate() mapped.
+  inline size_t MappedSize(size_t size) const {
+    size_t unit = kBasePageSize;
+    if(page_size == PageSize::Huge1GB && size >= kGiantPageSize) {
+      unit = kGiantPageSize;
+    } else if(page_size != PageSize::Default) {
+      unit = kHugePageSize;
+    }
+    return (size + unit - 1) & ~(unit - 1);
+  }
+
+#ifdef _WIN32
+  void* Map(size_t length) const {
+    DWORD type = MEM_RESERVE | MEM_COMMIT;
+    void* buffer = nullptr;
+    if(page_size == PageSize::Huge2MB || page_size == PageSize::Huge1GB) {
+      size_t large_page_size = ::GetLargePageMinimum();
+      if(large_page_size > 0 && length % large_page_size == 0) {
+        buffer = AllocateVirtual(length, type | MEM_LARGE_PAGES);
+      }
+    }
+    return buffer ? buffer : AllocateVirtual(length, type);
+  }
+
+  void* AllocateVirtual(size_t length, DWORD type) const {
+    if(numa == Numa::Bind) {
+      return ::VirtualAllocExNuma(::GetCurrentProcess(), nullptr, length, type, PAGE_READWRITE,
+                                  numa_node);
+    }
+    return ::VirtualAlloc(nullptr, length, type, PAGE_READWRITE);
+  }
+#else
+  void* Map(size_t length) const {
+    static constexpr int kHugeShift = 26;
+    static constexpr int kProtection = PROT_READ | PROT_WRITE;
+    static constexpr int kFlags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+    void* buffer = MAP_FAILED;
+    if(page_size == PageSize::Huge2MB || page_size == PageSize::Huge1GB) {
+      // MAP_HUGE_2MB and MAP_HUGE_1GB encode the page size's log in the high bits of the flags.
+      int huge_flags = MAP_HUGETLB | ((page_size == PageSize::Huge1GB &&
+                                       length >= kGiantPageSize ? 30 : 21) << kHugeShift);
+      buffer = ::mmap(nullptr, length, kProtection, kFlags | huge_flags, -1, 0);
+    }
+    if(buffer == MAP_FAILED) {
+      buffer = MapAligned(length, page_size == PageSize::Default ? kBasePageSize :
+                          kHugePageSize);
+      if(!buffer) {
+        return nullptr;
+      }
+      if(page_size != PageSize::Default) {
+        ::madvise(buffer, length, MADV_HUGEPAGE);
+      }
+    }
+    if(numa != Numa::Default) {
+      // mbind() takes a bit mask of nodes; nodes that don't exist are ignored.
+      static constexpr int kMpolBind = 2;
+      static constexpr int kMpolInterleave = 3;
+      uint64_t node_mask = numa == Numa::Interleave ? UINT64_MAX :
+                           numa_node < 64 ? (uint64_t)1 << numa_node : 0;
+      if(node_mask != 0) {
+        ::syscall(SYS_mbind, buffer, length, numa == Numa::Interleave ? kMpolInterleave :
+                  kMpolBind, &node_mask, 64 + 1, 0);
+      }
+    }
+    return buffer;
+  }
+
+  /// Maps "length" bytes at an "alignment"-aligned address, so that the buffer can be backed by
+  /// transparent huge pages from its start.
+  static void* MapAligned(size_t length, size_t alignment) {
+    size_t padded_length = length + alignment - kBasePageSize;
+    void* mapping = ::mmap(nullptr, padded_length, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(mapping == MAP_FAILED) {
+      return nullptr;
+    }
+    uintptr_t begin = reinterpret_cast<uintptr_t>(mapping);
+    uintptr_t aligned = (begin + alignment - 1) & ~(alignment - 1);
+    if(aligned > begin) {
+      ::munmap(mapping, aligned - begin);
+    }
+    uintptr_t end = begin + padded_length;
+    if(end > aligned + length) {
+      ::munmap(reinterpret_cast<void*>(aligned + length), end - aligned - length);
+    }
+    return reinterpret_cast<void*>(aligned);
+  }
+#endif
+
+ public:
+  PageSize page_size;
+  Numa numa;
+  uint32_t numa_node;
+  /// Fault in (and zero) every page when the buffer is allocated. For the hybrid log, this also
+  /// allocates every page of the in-memory buffer when the store is created.
+  bool prefault;
+};
+
+}
+} // namespace FASTER::core
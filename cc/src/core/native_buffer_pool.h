@@ -112,7 +112,23 @@ class NativeSectorAlignedBufferPool {
  public:
   NativeSectorAlignedBufferPool(uint32_t recordSize, uint32_t sectorSize)
     : record_size_{ recordSize }
-    , sector_size_{ sectorSize } {
+    , sector_size_{ sectorSize }
+    , arena_{ nullptr }
+    , arena_size_{ 0 } {
+  }
+
+  ~NativeSectorAlignedBufferPool() {
+    for(uint32_t level = 0; level < kLevels; ++level) {
+      uint8_t* buffer;
+      while(queue_[level].try_pop(buffer)) {
+        if(buffer < arena_ || buffer >= arena_ + arena_size_) {
+          aligned_free(buffer);
+        }
+      }
+    }
+    if(arena_) {
+      aligned_free(arena_);
+    }
   }
 
   inline void Return(uint32_t level, uint8_t* buffer) {
@@ -121,6 +137,18 @@ class NativeSectorAlignedBufferPool {
   }
   inline SectorAlignedMemory Get(uint32_t numRecords);
 
+  /// Allocates "count" buffers for each of the first "num_levels" levels, all from one
+  /// contiguous arena, so that the arena can be registered with the I/O handler once. (Buffers
+  /// that Get() allocates later, when the arena's are all in use, are allocated separately.)
+  inline void Preallocate(uint32_t num_levels, uint32_t count);
+
+  inline uint8_t* arena() const {
+    return arena_;
+  }
+  inline uint64_t arena_size() const {
+    return arena_size_;
+  }
+
  private:
   uint32_t Level(uint32_t sectors) {
     assert(sectors > 0);
@@ -139,6 +167,9 @@ class NativeSectorAlignedBufferPool {
   /// Level 0 caches memory allocations of size (sectorSize); level n+1 caches allocations of size
   /// (sectorSize) * 2^n.
   concurrent_queue<uint8_t*> queue_[kLevels];
+  /// Buffers allocated by Preallocate().
+  uint8_t* arena_;
+  uint64_t arena_size_;
 };
 
 /// Implementations.
@@ -184,5 +215,20 @@ inline SectorAlignedMemory NativeSectorAlignedBufferPool::Get(uint32_t numRecord
   }
 }
 
+inline void NativeSectorAlignedBufferPool::Preallocate(uint32_t num_levels, uint32_t count) {
+  assert(!arena_);
+  assert(num_levels <= kLevels);
+  // Level n's buffers are 2^n sectors each.
+  arena_size_ = static_cast<uint64_t>(sector_size_) * count * ((1 << num_levels) - 1);
+  arena_ = reinterpret_cast<uint8_t*>(aligned_alloc(sector_size_, arena_size_));
+  uint8_t* buffer = arena_;
+  for(uint32_t level = 0; level < num_levels; ++level) {
+    for(uint32_t idx = 0; idx < count; ++idx) {
+      queue_[level].push(buffer);
+      buffer += sector_size_ * (1 << level);
+    }
+  }
+}
+
 }
 } // namespace FASTER::core
\ No newline at end of file
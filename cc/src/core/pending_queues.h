@@ -0,0 +1,248 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include "async.h"
+#include "key_hash.h"
+
+namespace FASTER {
+namespace core {
+
+/// A session's pending operations are tracked by the structures below. Each allocates only when
+/// it grows, and keeps its capacity when it's emptied; so once a session has warmed up, the
+/// pending path doesn't touch the heap.
+
+/// Maps the ID of each pending I/O to the hash of the key being retrieved: an open-addressing
+/// table with linear probing. I/O IDs are issued in sequence, so they make good hashes.
+class PendingIoTable {
+ public:
+  struct Entry {
+    Entry()
+      : io_id{ kEmpty }
+      , hash{} {
+    }
+
+    uint64_t io_id;
+    KeyHash hash;
+  };
+
+  /// Marks an unused entry.
+  static constexpr uint64_t kEmpty = UINT64_MAX;
+  static constexpr uint32_t kInitialCapacity = 64;
+
+  class const_iterator {
+   public:
+    const_iterator(const PendingIoTable& table, uint32_t idx)
+      : table_{ table }
+      , idx_{ idx } {
+      SkipEmpty();
+    }
+
+    inline const Entry& operator*() const {
+      return table_.entries_[idx_];
+    }
+    inline const_iterator& operator++() {
+      ++idx_;
+      SkipEmpty();
+      return *this;
+    }
+    inline bool operator!=(const const_iterator& other) const {
+      return idx_ != other.idx_;
+    }
+
+   private:
+    inline void SkipEmpty() {
+      while(idx_ < table_.capacity_ && table_.entries_[idx_].io_id == kEmpty) {
+        ++idx_;
+      }
+    }
+
+    const PendingIoTable& table_;
+    uint32_t idx_;
+  };
+
+  PendingIoTable()
+    : entries_{ nullptr }
+    , capacity_{ 0 }
+    , size_{ 0 } {
+  }
+
+  ~PendingIoTable() {
+    delete[] entries_;
+  }
+
+  PendingIoTable(const PendingIoTable&) = delete;
+  PendingIoTable& operator=(const PendingIoTable&) = delete;
+
+  inline void Insert(uint64_t io_id, KeyHash hash) {
+    assert(io_id != kEmpty);
+    // Keep the table at most half full, so that probe sequences stay short.
+    if(2 * (size_ + 1) > capacity_) {
+      Grow();
+    }
+    uint32_t idx = Home(io_id);
+    while(entries_[idx].io_id != kEmpty) {
+      idx = (idx + 1) & (capacity_ - 1);
+    }
+    entries_[idx].io_id = io_id;
+    entries_[idx].hash = hash;
+    ++size_;
+  }
+
+  /// Removes the I/O's entry; returns false if there is none.
+  inline bool Erase(uint64_t io_id) {
+    if(size_ == 0) {
+      return false;
+    }
+    uint32_t mask = capacity_ - 1;
+    uint32_t hole = Home(io_id);
+    while(entries_[hole].io_id != io_id) {
+      if(entries_[hole].io_id == kEmpty) {
+        return false;
+      }
+      hole = (hole + 1) & mask;
+    }
+    // Shift later entries of the probe sequence back, rather than leave a tombstone: an entry
+    // can fill the hole if the hole lies between the entry's home and its current position.
+    for(uint32_t idx = (hole + 1) & mask; entries_[idx].io_id != kEmpty; idx = (idx + 1) & mask) {
+      uint32_t home = Home(entries_[idx].io_id);
+      if(((idx - home) & mask) >= ((idx - hole) & mask)) {
+        entries_[hole] = entries_[idx];
+        hole = idx;
+      }
+    }
+    entries_[hole].io_id = kEmpty;
+    --size_;
+    return true;
+  }
+
+  inline void clear() {
+    for(uint32_t idx = 0; idx < capacity_; ++idx) {
+      entries_[idx].io_id = kEmpty;
+    }
+    size_ = 0;
+  }
+
+  inline bool empty() const {
+    return size_ == 0;
+  }
+  inline uint32_t size() const {
+    return size_;
+  }
+
+  inline const_iterator begin() const {
+    return const_iterator{ *this, 0 };
+  }
+  inline const_iterator end() const {
+    return const_iterator{ *this, capacity_ };
+  }
+
+ private:
+  inline uint32_t Home(uint64_t io_id) const {
+    return static_cast<uint32_t>(io_id) & (capacity_ - 1);
+  }
+
+  void Grow() {
+    Entry* old_entries = entries_;
+    uint32_t old_capacity = capacity_;
+    capacity_ = old_capacity == 0 ? kInitialCapacity : 2 * old_capacity;
+    entries_ = new Entry[capacity_];
+    size_ = 0;
+    for(uint32_t idx = 0; idx < old_capacity; ++idx) {
+      if(old_entries[idx].io_id != kEmpty) {
+        Insert(old_entries[idx].io_id, old_entries[idx].hash);
+      }
+    }
+    delete[] old_entries;
+  }
+
+  Entry* entries_;
+  /// A power of two (or 0, before the first insert).
+  uint32_t capacity_;
+  uint32_t size_;
+};
+
+/// FIFO queue of the contexts of operations waiting to be retried: a ring of pointers, which
+/// doubles when it's full.
+class RetryQueue {
+ public:
+  static constexpr uint32_t kInitialCapacity = 64;
+
+  RetryQueue()
+    : items_{ nullptr }
+    , capacity_{ 0 }
+    , head_{ 0 }
+    , size_{ 0 } {
+  }
+
+  ~RetryQueue() {
+    delete[] items_;
+  }
+
+  RetryQueue(const RetryQueue&) = delete;
+  RetryQueue& operator=(const RetryQueue&) = delete;
+
+  inline void push_back(IAsyncContext* context) {
+    if(size_ == capacity_) {
+      Grow();
+    }
+    items_[(head_ + size_) & (capacity_ - 1)] = context;
+    ++size_;
+  }
+
+  inline IAsyncContext* front() const {
+    assert(size_ > 0);
+    return items_[head_];
+  }
+
+  inline void pop_front() {
+    assert(size_ > 0);
+    head_ = (head_ + 1) & (capacity_ - 1);
+    --size_;
+  }
+
+  /// The idx-th oldest context.
+  inline IAsyncContext* operator[](uint32_t idx) const {
+    assert(idx < size_);
+    return items_[(head_ + idx) & (capacity_ - 1)];
+  }
+
+  inline void clear() {
+    head_ = 0;
+    size_ = 0;
+  }
+
+  inline bool empty() const {
+    return size_ == 0;
+  }
+  inline uint32_t size() const {
+    return size_;
+  }
+
+ private:
+  void Grow() {
+    uint32_t new_capacity = capacity_ == 0 ? kInitialCapacity : 2 * capacity_;
+    IAsyncContext** new_items = new IAsyncContext*[new_capacity];
+    for(uint32_t idx = 0; idx < size_; ++idx) {
+      new_items[idx] = (*this)[idx];
+    }
+    delete[] items_;
+    items_ = new_items;
+    capacity_ = new_capacity;
+    head_ = 0;
+  }
+
+  IAsyncContext** items_;
+  /// A power of two (or 0, before the first push).
+  uint32_t capacity_;
+  uint32_t head_;
+  uint32_t size_;
+};
+
+}
+} // namespace FASTER::core
@@ -15,6 +15,7 @@
 #include "async_result_types.h"
 #include "gc_state.h"
 #include "light_epoch.h"
+#include "memory_policy.h"
 #include "native_buffer_pool.h"
 #include "recovery_status.h"
 #include "status.h"
@@ -243,8 +244,20 @@ class PersistentMemoryMalloc {
   /// The first 4 HLOG pages should be below the head (i.e., being flushed to disk).
   static constexpr uint32_t kNumHeadPages = 4;
 
+  /// Contiguous pages are flushed together, with one vectored write of up to this many pages.
+  static constexpr uint32_t kMaxFlushPages = 16;
+
+  /// Read buffers of up to 2^(kPreallocatedReadLevels - 1) sectors come from one arena, holding
+  /// kPreallocatedReadBuffers of each size, which is registered with the disk's I/O handler.
+  static constexpr uint32_t kPreallocatedReadLevels = 4;
+  static constexpr uint32_t kPreallocatedReadBuffers = 32;
+
+  /// Called for each page once all of it is read-only, just before it's flushed.
+  typedef void(*page_read_only_callback_t)(void* context, uint32_t page, const uint8_t* buffer);
+
   PersistentMemoryMalloc(uint64_t log_size, LightEpoch& epoch, disk_t& disk_, log_file_t& file_,
-                         Address start_address, double log_mutable_fraction)
+                         Address start_address, double log_mutable_fraction,
+                         const MemoryPolicy& memory_policy = MemoryPolicy{})
     : sector_size{ static_cast<uint32_t>(file_.alignment()) }
     , epoch_{ &epoch }
     , disk{ &disk_ }
@@ -260,7 +273,10 @@ class PersistentMemoryMalloc {
     , tail_page_offset_{ start_address }
     , buffer_size_{ 0 }
     , pages_{ nullptr }
-    , page_status_{ nullptr } {
+    , page_status_{ nullptr }
+    , page_read_only_callback_{ nullptr }
+    , page_read_only_context_{ nullptr }
+    , memory_policy_{ memory_policy } {
     assert(start_address.page() <= Address::kMaxPage);
 
     if(log_size % kPageSize != 0) {
@@ -289,14 +305,28 @@ class PersistentMemoryMalloc {
 
     page_status_ = new FullPageStatus[buffer_size_];
 
+    read_buffer_pool.Preallocate(kPreallocatedReadLevels, kPreallocatedReadBuffers);
+    // If the handler can't register the arena (it's over the locked-memory limit, say), reads
+    // into it are just issued as plain reads.
+    disk_.RegisterBuffer(read_buffer_pool.arena(), read_buffer_pool.arena_size());
+
     PageOffset tail_page_offset = tail_page_offset_.load();
-    AllocatePage(tail_page_offset.page());
-    AllocatePage(tail_page_offset.page() + 1);
+    if(memory_policy_.prefault) {
+      // Allocate the whole circular buffer now, rather than as the tail first reaches each page.
+      for(uint32_t idx = 0; idx < buffer_size_; ++idx) {
+        AllocatePage(tail_page_offset.page() + idx);
+      }
+    } else {
+      AllocatePage(tail_page_offset.page());
+      AllocatePage(tail_page_offset.page() + 1);
+    }
   }
 
   PersistentMemoryMalloc(uint64_t log_size, LightEpoch& epoch, disk_t& disk_, log_file_t& file_,
-                         double log_mutable_fraction)
-    : PersistentMemoryMalloc(log_size, epoch, disk_, file_, Address{ 0 }, log_mutable_fraction) {
+                         double log_mutable_fraction,
+                         const MemoryPolicy& memory_policy = MemoryPolicy{})
+    : PersistentMemoryMalloc(log_size, epoch, disk_, file_, Address{ 0 }, log_mutable_fraction,
+                             memory_policy) {
     /// Allocate the invalid page. Supports allocations aligned up to kCacheLineBytes.
     uint32_t discard;
     Allocate(Constants::kCacheLineBytes, discard);
@@ -314,7 +344,7 @@ class PersistentMemoryMalloc {
     if(pages_) {
       for(uint32_t idx = 0; idx < buffer_size_; ++idx) {
         if(pages_[idx]) {
-          aligned_free(pages_[idx]);
+          memory_policy_.Free(pages_[idx], kPageSize);
         }
       }
       delete[] pages_;
@@ -371,15 +401,21 @@ class PersistentMemoryMalloc {
   inline bool NewPage(uint32_t old_page);
 
   /// Invoked by users to obtain a record from disk. It uses sector aligned memory to read
-  /// the record efficiently into memory.
-  inline void AsyncGetFromDisk(Address address, uint32_t num_records, AsyncIOCallback callback,
-                               AsyncIOContext& context);
+  /// the record efficiently into memory. Fails if the read couldn't be issued.
+  inline Status AsyncGetFromDisk(Address address, uint32_t num_records, AsyncIOCallback callback,
+                                 AsyncIOContext& context);
 
   /// Used by applications to make the current state of the database immutable quickly
   Address ShiftReadOnlyToTail();
 
   void Truncate(GcState::truncate_callback_t callback);
 
+  /// Not thread-safe: call before the log is used.
+  void SetPageReadOnlyCallback(page_read_only_callback_t callback, void* context) {
+    page_read_only_callback_ = callback;
+    page_read_only_context_ = context;
+  }
+
   /// Action to be performed for when all threads have agreed that a page range is closed.
   class OnPagesClosed_Context : public IAsyncContext {
    public:
@@ -462,6 +498,11 @@ class PersistentMemoryMalloc {
   /// Allocate memory page, in sector aligned form
   inline void AllocatePage(uint32_t index);
 
+  /// Zero a page that is no longer in use, so it can be reopened.
+  inline void ClearPage(uint32_t page) {
+    memory_policy_.Clear(Page(page), kPageSize);
+  }
+
   /// Used by several functions to update the variable to newValue. Ignores if newValue is smaller
   /// than the current value.
   template <typename A, typename T>
@@ -567,6 +608,12 @@ class PersistentMemoryMalloc {
 
   // Global address of the current tail (next element to be allocated from the circular buffer)
   AtomicPageOffset tail_page_offset_;
+
+  page_read_only_callback_t page_read_only_callback_;
+  void* page_read_only_context_;
+
+  /// How the pages are backed.
+  MemoryPolicy memory_policy_;
 };
 
 /// Implementations.
@@ -574,8 +621,7 @@ template <class D>
 inline void PersistentMemoryMalloc<D>::AllocatePage(uint32_t index) {
   index = index % buffer_size_;
   assert(pages_[index] == nullptr);
-  pages_[index] = reinterpret_cast<uint8_t*>(aligned_alloc(sector_size, kPageSize));;
-  std::memset(pages_[index], 0, kPageSize);
+  pages_[index] = reinterpret_cast<uint8_t*>(memory_policy_.Allocate(sector_size, kPageSize));
 
   // Mark the page as accessible.
   page_status_[index].status.store(FlushStatus::Flushed, CloseStatus::Open);
@@ -635,7 +681,7 @@ inline bool PersistentMemoryMalloc<D>::NewPage(uint32_t old_page) {
 }
 
 template <class D>
-inline void PersistentMemoryMalloc<D>::AsyncGetFromDisk(Address address, uint32_t num_records,
+inline Status PersistentMemoryMalloc<D>::AsyncGetFromDisk(Address address, uint32_t num_records,
     AsyncIOCallback callback, AsyncIOContext& context) {
   uint64_t begin_read, end_read;
   uint32_t offset, length;
@@ -645,7 +691,7 @@ inline void PersistentMemoryMalloc<D>::AsyncGetFromDisk(Address address, uint32_
   context.record.available_bytes = length - offset;
   context.record.required_bytes = num_records;
 
-  file->ReadAsync(begin_read, context.record.buffer(), length, callback, context);
+  return file->ReadAsync(begin_read, context.record.buffer(), length, callback, context);
 }
 
 template <class D>
@@ -692,7 +738,7 @@ void PersistentMemoryMalloc<D>::OnPagesClosed(IAsyncContext* ctxt) {
       if(old_status.flush == FlushStatus::Flushed) {
         // We closed the page after it was flushed, so we are responsible for clearing and
         // reopening it.
-        std::memset(context->allocator->Page(idx), 0, kPageSize);
+        context->allocator->ClearPage(idx);
         context->allocator->PageStatus(idx).status.store(FlushStatus::Flushed, CloseStatus::Open);
       }
     }
@@ -714,17 +760,21 @@ void PersistentMemoryMalloc<D>::OnPagesMarkedReadOnly(IAsyncContext* ctxt) {
 template <class D>
 Status PersistentMemoryMalloc<D>::AsyncFlushPages(uint32_t start_page, Address until_address,
     bool serialize_objects) {
+  /// One write covers pages [begin_page, end_page).
   class Context : public IAsyncContext {
    public:
-    Context(alloc_t* allocator_, uint32_t page_, Address until_address_)
+    Context(alloc_t* allocator_, uint32_t begin_page_, uint32_t end_page_,
+            Address until_address_)
       : allocator{ allocator_ }
-      , page{ page_ }
+      , begin_page{ begin_page_ }
+      , end_page{ end_page_ }
       , until_address{ until_address_ } {
     }
     /// The deep-copy constructor
     Context(const Context& other)
       : allocator{ other.allocator }
-      , page{ other.page }
+      , begin_page{ other.begin_page }
+      , end_page{ other.end_page }
       , until_address{ other.until_address } {
     }
    protected:
@@ -733,7 +783,8 @@ Status PersistentMemoryMalloc<D>::AsyncFlushPages(uint32_t start_page, Address u
     }
    public:
     alloc_t* allocator;
-    uint32_t page;
+    uint32_t begin_page;
+    uint32_t end_page;
     Address until_address;
   };
 
@@ -742,23 +793,24 @@ Status PersistentMemoryMalloc<D>::AsyncFlushPages(uint32_t start_page, Address u
     if(result != Status::Ok) {
       fprintf(stderr, "AsyncFlushPages(), error: %u\n", static_cast<uint8_t>(result));
     }
-    context->allocator->PageStatus(context->page).LastFlushedUntilAddress.store(
-      context->until_address);
-    //Set the page status to flushed
-    FlushCloseStatus old_status = context->allocator->PageStatus(context->page).status.load();
-    FlushCloseStatus new_status;
-    do {
-      new_status = FlushCloseStatus{ FlushStatus::Flushed, old_status.close };
-    } while(!context->allocator->PageStatus(context->page).status.compare_exchange_weak(
-              old_status, new_status));
-    if(old_status.close == CloseStatus::Closed) {
-      // We finished flushing the page after it was closed, so we are responsible for clearing and
-      // reopening it.
-      std::memset(context->allocator->Page(context->page), 0, kPageSize);
-      context->allocator->PageStatus(context->page).status.store(FlushStatus::Flushed,
-          CloseStatus::Open);
-    }
-    context->allocator->ShiftFlushedUntilAddress();
+    alloc_t* allocator = context->allocator;
+    for(uint32_t page = context->begin_page; page < context->end_page; ++page) {
+      allocator->PageStatus(page).LastFlushedUntilAddress.store(
+        std::min(Address{ page + 1, 0 }, context->until_address));
+      //Set the page status to flushed
+      FlushCloseStatus old_status = allocator->PageStatus(page).status.load();
+      FlushCloseStatus new_status;
+      do {
+        new_status = FlushCloseStatus{ FlushStatus::Flushed, old_status.close };
+      } while(!allocator->PageStatus(page).status.compare_exchange_weak(old_status, new_status));
+      if(old_status.close == CloseStatus::Closed) {
+        // We finished flushing the page after it was closed, so we are responsible for clearing
+        // and reopening it.
+        allocator->ClearPage(page);
+        allocator->PageStatus(page).status.store(FlushStatus::Flushed, CloseStatus::Open);
+      }
+    }
+    allocator->ShiftFlushedUntilAddress();
   };
 
   uint32_t num_pages = until_address.page() - start_page;
@@ -767,22 +819,40 @@ Status PersistentMemoryMalloc<D>::AsyncFlushPages(uint32_t start_page, Address u
   }
   assert(num_pages > 0);
 
-  for(uint32_t flush_page = start_page; flush_page < start_page + num_pages; ++flush_page) {
-    Address page_start_address{ flush_page, 0 };
-    Address page_end_address{ flush_page + 1, 0 };
-
-    Context context{ this, flush_page, std::min(page_end_address, until_address) };
+  uint32_t end_page = start_page + num_pages;
+  for(uint32_t flush_page = start_page; flush_page < end_page;) {
+    // Coalesce a run of contiguous pages into one write; a run can't cross a segment of the log
+    // file.
+    uint32_t run_end = flush_page + 1;
+    while(run_end < end_page && run_end - flush_page < kMaxFlushPages &&
+          (kPageSize * run_end) % log_file_t::kSegmentSize != 0) {
+      ++run_end;
+    }
 
-    //Set status to in-progress
-    FlushCloseStatus old_status = PageStatus(flush_page).status.load();
-    FlushCloseStatus new_status;
-    do {
-      new_status = FlushCloseStatus{ FlushStatus::InProgress, old_status.close };
-    } while(!PageStatus(flush_page).status.compare_exchange_weak(old_status, new_status));
-    PageStatus(flush_page).LastFlushedUntilAddress.store(0);
+    const void* buffers[kMaxFlushPages];
+    for(uint32_t page = flush_page; page < run_end; ++page) {
+      if(page_read_only_callback_ && until_address >= Address{ page + 1, 0 }) {
+        page_read_only_callback_(page_read_only_context_, page, Page(page));
+      }
+      //Set status to in-progress
+      FlushCloseStatus old_status = PageStatus(page).status.load();
+      FlushCloseStatus new_status;
+      do {
+        new_status = FlushCloseStatus{ FlushStatus::InProgress, old_status.close };
+      } while(!PageStatus(page).status.compare_exchange_weak(old_status, new_status));
+      PageStatus(page).LastFlushedUntilAddress.store(0);
+      buffers[page - flush_page] = Page(page);
+    }
 
-    RETURN_NOT_OK(file->WriteAsync(Page(flush_page), kPageSize * flush_page, kPageSize, callback,
-                                   context));
+    Context context{ this, flush_page, run_end, until_address };
+    if(run_end - flush_page == 1) {
+      RETURN_NOT_OK(file->WriteAsync(Page(flush_page), kPageSize * flush_page, kPageSize,
+                                     callback, context));
+    } else {
+      RETURN_NOT_OK(file->WriteGatherAsync(buffers, run_end - flush_page, kPageSize * flush_page,
+                                           kPageSize, callback, context));
+    }
+    flush_page = run_end;
   }
   return Status::Ok;
 }
@@ -792,12 +862,14 @@ Status PersistentMemoryMalloc<D>::AsyncFlushPagesToFile(uint32_t start_page, Add
     file_t& file, std::atomic<uint32_t>& flush_pending) {
   class Context : public IAsyncContext {
    public:
-    Context(std::atomic<uint32_t>& flush_pending_)
-      : flush_pending{ flush_pending_ } {
+    Context(std::atomic<uint32_t>& flush_pending_, uint32_t num_pages_)
+      : flush_pending{ flush_pending_ }
+      , num_pages{ num_pages_ } {
     }
     /// The deep-copy constructor
     Context(Context& other)
-      : flush_pending{ other.flush_pending } {
+      : flush_pending{ other.flush_pending }
+      , num_pages{ other.num_pages } {
     }
    protected:
     Status DeepCopy_Internal(IAsyncContext*& context_copy) final {
@@ -805,6 +877,8 @@ Status PersistentMemoryMalloc<D>::AsyncFlushPagesToFile(uint32_t start_page, Add
     }
    public:
     std::atomic<uint32_t>& flush_pending;
+    /// Pages covered by this write.
+    uint32_t num_pages;
   };
 
   auto callback = [](IAsyncContext* ctxt, Status result, size_t bytes_transferred) {
@@ -812,8 +886,8 @@ Status PersistentMemoryMalloc<D>::AsyncFlushPagesToFile(uint32_t start_page, Add
     if(result != Status::Ok) {
       fprintf(stderr, "AsyncFlushPagesToFile(), error: %u\n", static_cast<uint8_t>(result));
     }
-    assert(context->flush_pending > 0);
-    --context->flush_pending;
+    assert(context->flush_pending >= context->num_pages);
+    context->flush_pending -= context->num_pages;
   };
 
   uint32_t num_pages = until_address.page() - start_page;
@@ -823,12 +897,27 @@ Status PersistentMemoryMalloc<D>::AsyncFlushPagesToFile(uint32_t start_page, Add
   assert(num_pages > 0);
   flush_pending = num_pages;
 
-  for(uint32_t flush_page = start_page; flush_page < start_page + num_pages; ++flush_page) {
-    Address page_start_address{ flush_page, 0 };
-    Address page_end_address{ flush_page + 1, 0 };
-    Context context{ flush_pending };
-    RETURN_NOT_OK(file.WriteAsync(Page(flush_page), kPageSize * (flush_page - start_page),
-                                  kPageSize, callback, context));
+  uint32_t end_page = start_page + num_pages;
+  for(uint32_t flush_page = start_page; flush_page < end_page;) {
+    // Coalesce contiguous pages into one write.
+    uint32_t run_pages = end_page - flush_page;
+    if(run_pages > kMaxFlushPages) {
+      run_pages = kMaxFlushPages;
+    }
+    const void* buffers[kMaxFlushPages];
+    for(uint32_t idx = 0; idx < run_pages; ++idx) {
+      buffers[idx] = Page(flush_page + idx);
+    }
+    Context context{ flush_pending, run_pages };
+    if(run_pages == 1) {
+      RETURN_NOT_OK(file.WriteAsync(Page(flush_page), kPageSize * (flush_page - start_page),
+                                    kPageSize, callback, context));
+    } else {
+      RETURN_NOT_OK(file.WriteGatherAsync(buffers, run_pages,
+                                          kPageSize * (flush_page - start_page), kPageSize,
+                                          callback, context));
+    }
+    flush_page += run_pages;
   }
   return Status::Ok;
 }
@@ -882,7 +971,7 @@ Status PersistentMemoryMalloc<D>::AsyncReadPages(F& read_file, uint32_t file_sta
       AllocatePage(read_page);
     } else {
       // Clear an old used page.
-      std::memset(Page(read_page), 0, kPageSize);
+      ClearPage(read_page);
     }
     assert(recovery_status.page_status(read_page) == PageRecoveryStatus::NotStarted);
     recovery_status.page_status(read_page).store(PageRecoveryStatus::IssuedRead);
@@ -0,0 +1,118 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "constants.h"
+#include "thread.h"
+
+namespace FASTER {
+namespace core {
+
+/// Predicts how many bytes to read, to fetch a record from disk in a single read, from a moving
+/// histogram of the sizes of the records read recently. Sizes are binned by sector, since reads
+/// are rounded up to whole sectors anyway. Each thread that completes reads keeps its own
+/// histogram, so recording a size touches only that thread's cache lines; the histograms are
+/// merged only when the prediction is recomputed.
+class RecordSizePredictor {
+ public:
+  static constexpr uint32_t kBinBytes = 512;
+  /// Records of (kNumBins - 1) * kBinBytes bytes or more share the last bin.
+  static constexpr uint32_t kNumBins = 64;
+  /// The prediction covers this percentage of records; the rest take more than one read.
+  static constexpr uint32_t kPercentile = 95;
+  /// A thread recomputes the prediction every kUpdateInterval of its samples; and once its
+  /// histogram holds kMaxSamples, halves its counts, so that older sizes fade out.
+  static constexpr uint32_t kUpdateInterval = 256;
+  static constexpr uint32_t kMaxSamples = 4096;
+
+ private:
+  /// Written only by its own thread; read by whichever thread recomputes the prediction.
+  struct alignas(Constants::kCacheLineBytes) Histogram {
+    Histogram()
+      : samples{ 0 } {
+      for(uint32_t idx = 0; idx < kNumBins; ++idx) {
+        bins[idx].store(0, std::memory_order_relaxed);
+      }
+    }
+
+    std::atomic<uint32_t> bins[kNumBins];
+    /// Samples since the counts were last halved.
+    uint32_t samples;
+  };
+
+ public:
+  RecordSizePredictor()
+    : prediction_{ 0 }
+    , updating_{ false } {
+  }
+
+  /// Size of a record just read from disk.
+  inline void Record(uint32_t size) {
+    Histogram& histogram = histograms_[Thread::id()];
+    uint32_t bin = size / kBinBytes;
+    std::atomic<uint32_t>& count = histogram.bins[bin < kNumBins ? bin : kNumBins - 1];
+    // No other thread writes this histogram, so the increment needn't be atomic.
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if(++histogram.samples % kUpdateInterval == 0) {
+      if(histogram.samples >= kMaxSamples) {
+        for(uint32_t idx = 0; idx < kNumBins; ++idx) {
+          histogram.bins[idx].store(histogram.bins[idx].load(std::memory_order_relaxed) / 2,
+                                    std::memory_order_relaxed);
+        }
+        histogram.samples = kMaxSamples / 2;
+      }
+      Update();
+    }
+  }
+
+  /// Bytes to read, to fetch most records in one read; 0 until there are enough samples.
+  inline uint32_t prediction() const {
+    return prediction_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  void Update() {
+    if(updating_.exchange(true)) {
+      // Another thread is updating the prediction.
+      return;
+    }
+    uint64_t counts[kNumBins] = {};
+    uint64_t total = 0;
+    uint32_t num_ids = Thread::num_ids();
+    for(uint32_t id = 0; id < num_ids; ++id) {
+      const Histogram* histogram = histograms_.Get(id);
+      if(!histogram) {
+        // No thread in this chunk of IDs has recorded a size.
+        id += ThreadTable<Histogram>::kChunkSize - 1 - id % ThreadTable<Histogram>::kChunkSize;
+        continue;
+      }
+      for(uint32_t idx = 0; idx < kNumBins; ++idx) {
+        uint32_t count = histogram->bins[idx].load(std::memory_order_relaxed);
+        counts[idx] += count;
+        total += count;
+      }
+    }
+    uint64_t threshold = (total * kPercentile + 99) / 100;
+    uint64_t cumulative = 0;
+    uint32_t bin = 0;
+    for(; bin < kNumBins - 1; ++bin) {
+      cumulative += counts[bin];
+      if(cumulative >= threshold) {
+        break;
+      }
+    }
+    prediction_.store((bin + 1) * kBinBytes, std::memory_order_relaxed);
+    updating_.store(false);
+  }
+
+  std::atomic<uint32_t> prediction_;
+  std::atomic<bool> updating_;
+  ThreadTable<Histogram> histograms_;
+};
+
+}
+} // namespace FASTER::core
@@ -0,0 +1,224 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "constants.h"
+
+namespace FASTER {
+namespace core {
+
+/// A statistics counter that only its owning thread updates, so an increment is a relaxed load
+/// and store, rather than a locked read-modify-write. Other threads may read it at any time.
+class StatCounter {
+ public:
+  StatCounter()
+    : value_{ 0 } {
+  }
+
+  inline void Increment() {
+    Add(1);
+  }
+  inline void Add(uint64_t delta) {
+    value_.store(value_.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+  }
+  inline uint64_t load() const {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<uint64_t> value_;
+};
+
+/// Counts of operations and of where they were served. Each thread updates its own
+/// OperationCounters<StatCounter>; snapshots sum them into an OperationCounters<uint64_t>.
+template <class T>
+struct OperationCounters {
+  /// Operations issued, by type.
+  T reads;
+  T upserts;
+  T rmws;
+  T deletes;
+
+  /// Operations served in place, in the mutable region of the log.
+  T mutable_hits;
+  /// Reads served from, and RMWs copied from, the in-memory read-only region.
+  T read_only_hits;
+  /// Reads and RMWs that had to fetch their record from disk.
+  T disk_hits;
+  /// New records (and tombstones) appended to the log.
+  T appends;
+
+  /// Operations that went pending, waiting for disk I/O.
+  T pending;
+  /// Operations that had to be retried (RETRY_NOW or RETRY_LATER).
+  T retries;
+  /// Failed compare-and-swaps on hash bucket entries.
+  T cas_failures;
+
+  /// Disk reads issued for pending operations, the bytes they read, and the total time from
+  /// issuing a pending operation's first read to handling its result.
+  T io_reads;
+  T io_bytes;
+  T io_latency_ns;
+
+  template <class U>
+  void Add(const OperationCounters<U>& other) {
+    reads += Value(other.reads);
+    upserts += Value(other.upserts);
+    rmws += Value(other.rmws);
+    deletes += Value(other.deletes);
+    mutable_hits += Value(other.mutable_hits);
+    read_only_hits += Value(other.read_only_hits);
+    disk_hits += Value(other.disk_hits);
+    appends += Value(other.appends);
+    pending += Value(other.pending);
+    retries += Value(other.retries);
+    cas_failures += Value(other.cas_failures);
+    io_reads += Value(other.io_reads);
+    io_bytes += Value(other.io_bytes);
+    io_latency_ns += Value(other.io_latency_ns);
+  }
+
+ private:
+  static inline uint64_t Value(const StatCounter& counter) {
+    return counter.load();
+  }
+  static inline uint64_t Value(uint64_t value) {
+    return value;
+  }
+};
+
+/// One thread's counters, on cache lines of their own.
+class alignas(Constants::kCacheLineBytes) ThreadStatistics :
+  public OperationCounters<StatCounter> {
+};
+
+/// How long a kind of action (checkpoint, GC, or index resize) took.
+struct PhaseStatistics {
+  PhaseStatistics()
+    : count{ 0 }
+    , last_ns{ 0 }
+    , total_ns{ 0 } {
+  }
+
+  uint64_t count;
+  uint64_t last_ns;
+  uint64_t total_ns;
+};
+
+/// Times one kind of action. Only one action runs at a time, so Start() and Stop() never race;
+/// the thread that finishes the action records its duration.
+class PhaseTimer {
+ public:
+  typedef std::chrono::steady_clock clock_t;
+
+  PhaseTimer()
+    : start_ns_{ 0 }
+    , count_{ 0 }
+    , last_ns_{ 0 }
+    , total_ns_{ 0 } {
+  }
+
+  static inline uint64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             clock_t::now().time_since_epoch()).count();
+  }
+
+  inline void Start() {
+    start_ns_.store(NowNs());
+  }
+  inline void Stop() {
+    uint64_t duration = NowNs() - start_ns_.load();
+    last_ns_.store(duration);
+    total_ns_.store(total_ns_.load() + duration);
+    count_.store(count_.load() + 1);
+  }
+
+  PhaseStatistics Get() const {
+    PhaseStatistics result;
+    result.count = count_.load();
+    result.last_ns = last_ns_.load();
+    result.total_ns = total_ns_.load();
+    return result;
+  }
+
+ private:
+  std::atomic<uint64_t> start_ns_;
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> last_ns_;
+  std::atomic<uint64_t> total_ns_;
+};
+
+/// A point-in-time snapshot of the store's statistics, returned by FasterKv::GetStatistics().
+/// The counters are summed over all threads; since threads keep counting while the sum is taken,
+/// they are consistent only to within the operations in flight.
+struct Statistics {
+  /// The histogram's last bin counts chains of kChainLengthBins or more buckets.
+  static constexpr uint32_t kChainLengthBins = 8;
+
+  Statistics()
+    : ops{}
+    , begin_address{ 0 }
+    , head_address{ 0 }
+    , read_only_address{ 0 }
+    , tail_address{ 0 }
+    , pending_ios{ 0 }
+    , epoch_actions{ 0 }
+    , epoch_action_overflows{ 0 }
+    , table_size{ 0 }
+    , overflow_buckets_allocated{ 0 }
+    , index_scanned{ false }
+    , overflow_buckets{ 0 }
+    , chain_lengths{} {
+  }
+
+  /// Bytes of the log on disk only, in memory, and in memory and mutable.
+  inline uint64_t on_disk_bytes() const {
+    return head_address - begin_address;
+  }
+  inline uint64_t in_memory_bytes() const {
+    return tail_address - head_address;
+  }
+  inline uint64_t mutable_bytes() const {
+    return tail_address - read_only_address;
+  }
+
+  OperationCounters<uint64_t> ops;
+
+  /// Hybrid log addresses.
+  uint64_t begin_address;
+  uint64_t head_address;
+  uint64_t read_only_address;
+  uint64_t tail_address;
+  /// Pending operations currently waiting on disk reads, across all threads.
+  uint64_t pending_ios;
+  /// Epoch actions (page flushes, closes, and the like) waiting for their epochs to become safe;
+  /// and the number of actions, since the store was created, that found the epoch's fixed-size
+  /// drain list full and went to its overflow list. A growing overflow count means that actions
+  /// are registered faster than threads refresh their epochs.
+  uint64_t epoch_actions;
+  uint64_t epoch_action_overflows;
+
+  /// Hash index: number of buckets in the table, and number of overflow buckets allocated.
+  uint64_t table_size;
+  uint64_t overflow_buckets_allocated;
+  /// Filled in only if GetStatistics() was asked to scan the index: the number of overflow
+  /// buckets in use, and chain_lengths[n - 1] = number of table buckets whose chain holds n
+  /// buckets (including the table bucket itself).
+  bool index_scanned;
+  uint64_t overflow_buckets;
+  uint64_t chain_lengths[kChainLengthBins];
+
+  /// Durations of completed actions.
+  PhaseStatistics checkpoint;
+  PhaseStatistics gc;
+  PhaseStatistics grow;
+};
+
+}
+} // namespace FASTER::core
@@ -7,7 +7,21 @@
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <new>
 #include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define _WINSOCKAPI_
+#include <Windows.h>
+#else
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "alloc.h"
+#include "constants.h"
 
 /// Turn this on to have Thread::current_num_threads_ keep a count of currently-active threads.
 #undef COUNT_ACTIVE_THREADS
@@ -15,13 +29,17 @@
 namespace FASTER {
 namespace core {
 
-/// Gives every thread a unique, numeric thread ID, and recycles IDs when threads exit.
+/// Gives every thread a unique, numeric thread ID, and recycles IDs when threads exit. A new
+/// thread takes the lowest free ID, so IDs stay dense: while N threads hold IDs, every ID is below
+/// N, no matter how many threads have come and gone. Per-thread tables indexed by ID can therefore
+/// be sized by the number of threads that run at once.
 class Thread {
  public:
-  /// The number of entries in table. Currently, this is fixed at 96 and never changes or grows.
-  /// If the table runs out of entries, then the current implementation will throw a
-  /// std::runtime_error.
-  static constexpr size_t kMaxNumThreads = 96;
+  /// Most IDs that can be in use at once. If all are taken, a new thread's first call to id()
+  /// throws a std::runtime_error.
+  static constexpr uint32_t kMaxNumThreads = 65536;
+  /// Fewest per-thread entries that a store reserves by default; see DefaultMaxNumThreads().
+  static constexpr uint32_t kDefaultMaxNumThreads = 96;
 
  private:
   /// Encapsulates a thread ID, getting a free ID from the Thread class when the thread starts, and
@@ -47,6 +65,34 @@ class Thread {
     return id_.id();
   }
 
+  /// One more than the highest ID handed out so far.
+  inline static uint32_t num_ids() {
+    return num_ids_.load();
+  }
+
+  /// Number of per-thread entries a store reserves, unless told otherwise: enough for every
+  /// hardware thread to run two threads that use the store.
+  static uint32_t DefaultMaxNumThreads() {
+    uint32_t max_num_threads = 2 * std::thread::hardware_concurrency();
+    if(max_num_threads < kDefaultMaxNumThreads) {
+      return kDefaultMaxNumThreads;
+    }
+    return max_num_threads < kMaxNumThreads ? max_num_threads : kMaxNumThreads;
+  }
+
+  /// NUMA node of the processor that the calling thread is running on; 0 if it can't be told.
+  static uint32_t NumaNode() {
+#ifdef _WIN32
+    PROCESSOR_NUMBER processor;
+    GetCurrentProcessorNumberEx(&processor);
+    USHORT node;
+    return GetNumaProcessorNodeEx(&processor, &node) ? node : 0;
+#else
+    unsigned cpu, node;
+    return syscall(SYS_getcpu, &cpu, &node, nullptr) == 0 ? node : 0;
+#endif
+  }
+
  private:
   /// Methods ReserveEntry() and ReleaseEntry() do the real work.
   inline static uint32_t ReserveEntry() {
@@ -54,15 +100,16 @@ class Thread {
     int32_t result = ++current_num_threads_;
     assert(result < kMaxNumThreads);
 #endif
-    uint32_t start = next_index_++;
-    uint32_t end = start + 2 * kMaxNumThreads;
-    for(uint32_t id = start; id < end; ++id) {
+    // Threads start rarely, and the search ends after about as many IDs as there are threads.
+    for(uint32_t id = 0; id < kMaxNumThreads; ++id) {
       bool expected = false;
-      if(id_used_[id % kMaxNumThreads].compare_exchange_strong(expected, true)) {
-        return id % kMaxNumThreads;
+      if(!id_used_[id].load() && id_used_[id].compare_exchange_strong(expected, true)) {
+        uint32_t num_ids = num_ids_.load();
+        while(num_ids <= id && !num_ids_.compare_exchange_weak(num_ids, id + 1)) {
+        }
+        return id;
       }
     }
-    // Already have 64 active threads.
     throw std::runtime_error{ "Too many threads!" };
   }
 
@@ -78,8 +125,8 @@ class Thread {
   /// The current thread's page_index.
   static thread_local ThreadId id_;
 
-  /// Next thread index to consider.
-  static std::atomic<uint32_t> next_index_;
+  /// One more than the highest thread ID handed out so far.
+  static std::atomic<uint32_t> num_ids_;
   /// Which thread IDs have already been taken.
   static std::atomic<bool> id_used_[kMaxNumThreads];
 
@@ -90,6 +137,141 @@ class Thread {
   friend class ThreadId;
 };
 
+/// A store's per-thread state: an array with an entry per thread ID, sized when the store is
+/// created. Each entry gets its own cache line(s).
+template <class T>
+class ThreadArray {
+ public:
+  ThreadArray()
+    : size_{ 0 }
+    , entries_{ nullptr } {
+  }
+
+  explicit ThreadArray(uint32_t size)
+    : ThreadArray() {
+    Initialize(size);
+  }
+
+  ~ThreadArray() {
+    Uninitialize();
+  }
+
+  ThreadArray(const ThreadArray&) = delete;
+  ThreadArray& operator=(const ThreadArray&) = delete;
+
+  void Initialize(uint32_t size) {
+    Uninitialize();
+    size_t bytes = (static_cast<size_t>(size) * sizeof(T) + Constants::kCacheLineBytes - 1) &
+                   ~static_cast<size_t>(Constants::kCacheLineBytes - 1);
+    entries_ = reinterpret_cast<T*>(aligned_alloc(Constants::kCacheLineBytes, bytes));
+    if(!entries_) {
+      throw std::bad_alloc{};
+    }
+    for(uint32_t idx = 0; idx < size; ++idx) {
+      new(&entries_[idx]) T{};
+    }
+    size_ = size;
+  }
+
+  inline uint32_t size() const {
+    return size_;
+  }
+
+  inline T& operator[](uint32_t idx) {
+    assert(idx < size_);
+    return entries_[idx];
+  }
+  inline const T& operator[](uint32_t idx) const {
+    assert(idx < size_);
+    return entries_[idx];
+  }
+
+ private:
+  void Uninitialize() {
+    if(entries_) {
+      for(uint32_t idx = 0; idx < size_; ++idx) {
+        entries_[idx].~T();
+      }
+      aligned_free(entries_);
+    }
+    entries_ = nullptr;
+    size_ = 0;
+  }
+
+  uint32_t size_;
+  T* entries_;
+};
+
+/// Per-thread state that isn't owned by a store, and so can't be sized by the store's number of
+/// threads: a table with an entry per possible thread ID, whose entries are allocated, a chunk at a
+/// time, when a thread first accesses them.
+template <class T>
+class ThreadTable {
+ public:
+  static constexpr uint32_t kChunkSize = 64;
+  static constexpr uint32_t kNumChunks = Thread::kMaxNumThreads / kChunkSize;
+
+  ThreadTable() {
+    for(uint32_t idx = 0; idx < kNumChunks; ++idx) {
+      chunks_[idx].store(nullptr);
+    }
+  }
+
+  ~ThreadTable() {
+    for(uint32_t idx = 0; idx < kNumChunks; ++idx) {
+      T* chunk = chunks_[idx].load();
+      if(chunk) {
+        for(uint32_t entry = 0; entry < kChunkSize; ++entry) {
+          chunk[entry].~T();
+        }
+        aligned_free(chunk);
+      }
+    }
+  }
+
+  ThreadTable(const ThreadTable&) = delete;
+  ThreadTable& operator=(const ThreadTable&) = delete;
+
+  inline T& operator[](uint32_t id) {
+    T* chunk = chunks_[id / kChunkSize].load(std::memory_order_acquire);
+    if(!chunk) {
+      chunk = AllocateChunk(id / kChunkSize);
+    }
+    return chunk[id % kChunkSize];
+  }
+
+  /// Returns nullptr if no thread has accessed the entry.
+  inline T* Get(uint32_t id) const {
+    T* chunk = chunks_[id / kChunkSize].load(std::memory_order_acquire);
+    return chunk ? &chunk[id % kChunkSize] : nullptr;
+  }
+
+ private:
+  T* AllocateChunk(uint32_t chunk_idx) {
+    size_t bytes = (kChunkSize * sizeof(T) + Constants::kCacheLineBytes - 1) &
+                   ~static_cast<size_t>(Constants::kCacheLineBytes - 1);
+    T* chunk = reinterpret_cast<T*>(aligned_alloc(Constants::kCacheLineBytes, bytes));
+    if(!chunk) {
+      throw std::bad_alloc{};
+    }
+    for(uint32_t entry = 0; entry < kChunkSize; ++entry) {
+      new(&chunk[entry]) T{};
+    }
+    T* expected = nullptr;
+    if(!chunks_[chunk_idx].compare_exchange_strong(expected, chunk)) {
+      // Another thread allocated the chunk first.
+      for(uint32_t entry = 0; entry < kChunkSize; ++entry) {
+        chunk[entry].~T();
+      }
+      aligned_free(chunk);
+      chunk = expected;
+    }
+    return chunk;
+  }
+
+  std::atomic<T*> chunks_[kNumChunks];
+};
+
 inline Thread::ThreadId::ThreadId()
   : id_{ kInvalidId } {
   id_ = Thread::ReserveEntry();
@@ -8,11 +8,49 @@
 #include <stdexcept>
 #include <string>
 
+#ifdef _WIN32
+#include <intrin.h>
+#include <xmmintrin.h>
+#endif
+#if defined(__x86_64__) || defined(_M_X64)
+#include <nmmintrin.h>
+#endif
+
+/// The CRC32C hashes use the SSE4.2 crc32 instruction when the CPU has it, whether or not the
+/// build targets SSE4.2; functions that use it are compiled for SSE4.2 alone.
+#if defined(_M_X64)
+#define FASTER_CRC32C_INSTRUCTION
+#define FASTER_TARGET_SSE42
+#elif defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FASTER_CRC32C_INSTRUCTION
+#define FASTER_TARGET_SSE42 __attribute__((target("sse4.2")))
+#endif
+
 namespace FASTER {
 namespace core {
 
 class Utility {
  public:
+  /// Hint to the processor to load the cache line containing "address" into all cache levels.
+  static inline void Prefetch(const void* address) {
+#ifdef _WIN32
+    _mm_prefetch(reinterpret_cast<const char*>(address), _MM_HINT_T0);
+#else
+    __builtin_prefetch(address);
+#endif
+  }
+
+  /// Index of the lowest set bit; "x" must be nonzero.
+  static inline uint32_t CountTrailingZeros(uint32_t x) {
+#ifdef _WIN32
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(__builtin_ctz(x));
+#endif
+  }
+
   static inline uint64_t Rotr64(uint64_t x, std::size_t n) {
     return (((x) >> n) | ((x) << (64 - n)));
   }
@@ -64,9 +102,177 @@ class Utility {
     return Rotr64(kMagicNum * hashState, 6);
   }
 
+  /// Hashes 8 bytes at a time, so it's much faster than Hash8BitBytes() on long keys. The final
+  /// mix spreads every input bit across the whole hash, including the 14-bit tag.
+  static inline uint64_t HashBytesWordwise(const uint8_t* str, size_t len) {
+    const uint64_t kMul0 = 0x87C37B91114253D5;
+    const uint64_t kMul1 = 0x4CF5AD432745937F;
+    uint64_t hashState = len * kMul1;
+
+    size_t idx = 0;
+    for(; idx + sizeof(uint64_t) <= len; idx += sizeof(uint64_t)) {
+      hashState ^= Rotl64(LoadWord(str + idx) * kMul0, 31) * kMul1;
+      hashState = Rotl64(hashState, 27) * 5 + 0x52DCE729;
+    }
+    if(idx < len) {
+      hashState ^= Rotl64(LoadTail(str + idx, len - idx) * kMul0, 31) * kMul1;
+    }
+    return Mix64(hashState);
+  }
+
+  /// Hashes 8 bytes at a time with the CRC32C instruction (SSE4.2), where available; elsewhere,
+  /// computes the same hash in software. Two CRCs, of the input and of its half-swapped words,
+  /// fill the 64 bits.
+  static inline uint64_t HashBytesCrc32c(const uint8_t* str, size_t len) {
+#ifdef FASTER_CRC32C_INSTRUCTION
+    if(HasCrc32cInstruction()) {
+      return HashBytesCrc32cInstruction(str, len);
+    }
+#endif
+    uint32_t crc0 = static_cast<uint32_t>(len);
+    uint32_t crc1 = ~static_cast<uint32_t>(len);
+
+    size_t idx = 0;
+    for(; idx + sizeof(uint64_t) <= len; idx += sizeof(uint64_t)) {
+      uint64_t word = LoadWord(str + idx);
+      crc0 = Crc32cWord(crc0, word);
+      crc1 = Crc32cWord(crc1, Rotl64(word, 32));
+    }
+    if(idx < len) {
+      uint64_t word = LoadTail(str + idx, len - idx);
+      crc0 = Crc32cWord(crc0, word);
+      crc1 = Crc32cWord(crc1, Rotl64(word, 32));
+    }
+    return Mix64((static_cast<uint64_t>(crc1) << 32) | crc0);
+  }
+
+  /// Standard CRC32C (Castagnoli) checksum.
+  static inline uint32_t Crc32c(const uint8_t* str, size_t len, uint32_t crc = 0) {
+#ifdef FASTER_CRC32C_INSTRUCTION
+    if(HasCrc32cInstruction()) {
+      return Crc32cInstruction(str, len, crc);
+    }
+#endif
+    crc = ~crc;
+    size_t idx = 0;
+    for(; idx + sizeof(uint64_t) <= len; idx += sizeof(uint64_t)) {
+      crc = Crc32cWord(crc, LoadWord(str + idx));
+    }
+    for(; idx < len; ++idx) {
+      crc = Crc32cByte(crc, str[idx]);
+    }
+    return ~crc;
+  }
+
+  /// Finalizer from MurmurHash3: every input bit affects every output bit.
+  static inline uint64_t Mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCD;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53;
+    x ^= x >> 33;
+    return x;
+  }
+
+  static inline uint64_t Rotl64(uint64_t x, std::size_t n) {
+    return (((x) << n) | ((x) >> (64 - n)));
+  }
+
   static constexpr inline bool IsPowerOfTwo(uint64_t x) {
     return (x > 0) && ((x & (x - 1)) == 0);
   }
+
+ private:
+  static inline uint64_t LoadWord(const uint8_t* str) {
+    uint64_t word;
+    std::memcpy(&word, str, sizeof(word));
+    return word;
+  }
+  /// Loads the last (len < 8) bytes of a key, zero-padded.
+  static inline uint64_t LoadTail(const uint8_t* str, size_t len) {
+    uint64_t word = 0;
+    std::memcpy(&word, str, len);
+    return word;
+  }
+
+#ifdef FASTER_CRC32C_INSTRUCTION
+  static inline bool HasCrc32cInstruction() {
+#if defined(__SSE4_2__)
+    return true;
+#elif defined(_M_X64)
+    static const bool has_sse42 = []() {
+      int info[4];
+      __cpuid(info, 1);
+      return (info[2] & (1 << 20)) != 0;
+    }();
+    return has_sse42;
+#else
+    static const bool has_sse42 = __builtin_cpu_supports("sse4.2");
+    return has_sse42;
+#endif
+  }
+
+  FASTER_TARGET_SSE42 static uint64_t HashBytesCrc32cInstruction(const uint8_t* str, size_t len) {
+    uint32_t crc0 = static_cast<uint32_t>(len);
+    uint32_t crc1 = ~static_cast<uint32_t>(len);
+
+    size_t idx = 0;
+    for(; idx + sizeof(uint64_t) <= len; idx += sizeof(uint64_t)) {
+      uint64_t word = LoadWord(str + idx);
+      crc0 = static_cast<uint32_t>(_mm_crc32_u64(crc0, word));
+      crc1 = static_cast<uint32_t>(_mm_crc32_u64(crc1, Rotl64(word, 32)));
+    }
+    if(idx < len) {
+      uint64_t word = LoadTail(str + idx, len - idx);
+      crc0 = static_cast<uint32_t>(_mm_crc32_u64(crc0, word));
+      crc1 = static_cast<uint32_t>(_mm_crc32_u64(crc1, Rotl64(word, 32)));
+    }
+    return Mix64((static_cast<uint64_t>(crc1) << 32) | crc0);
+  }
+
+  FASTER_TARGET_SSE42 static uint32_t Crc32cInstruction(const uint8_t* str, size_t len,
+      uint32_t crc) {
+    crc = ~crc;
+    size_t idx = 0;
+    for(; idx + sizeof(uint64_t) <= len; idx += sizeof(uint64_t)) {
+      crc = static_cast<uint32_t>(_mm_crc32_u64(crc, LoadWord(str + idx)));
+    }
+    for(; idx < len; ++idx) {
+      crc = _mm_crc32_u8(crc, str[idx]);
+    }
+    return ~crc;
+  }
+#endif
+
+  /// Software CRC32C, a byte at a time, from a table of the reflected Castagnoli polynomial.
+  static inline uint32_t Crc32cWord(uint32_t crc, uint64_t word) {
+    for(uint32_t idx = 0; idx < sizeof(word); ++idx) {
+      crc = Crc32cByte(crc, static_cast<uint8_t>(word >> (8 * idx)));
+    }
+    return crc;
+  }
+
+  static inline uint32_t Crc32cByte(uint32_t crc, uint8_t byte) {
+    return Crc32cTable()[(crc ^ byte) & 0xFF] ^ (crc >> 8);
+  }
+
+  static const uint32_t* Crc32cTable() {
+    struct Table {
+      Table() {
+        for(uint32_t idx = 0; idx < 256; ++idx) {
+          uint32_t crc = idx;
+          for(uint32_t bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+          }
+          entries[idx] = crc;
+        }
+      }
+
+      uint32_t entries[256];
+    };
+    static const Table table{};
+    return table.entries;
+  }
 };
 
 }
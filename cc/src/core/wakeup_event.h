@@ -0,0 +1,60 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#include "constants.h"
+
+namespace FASTER {
+namespace core {
+
+/// Lets one thread sleep until another thread has work for it. A signal is remembered until the
+/// owning thread next waits, so a signal sent while the owner is busy isn't lost; signaling a
+/// thread that isn't waiting costs only an atomic exchange.
+class alignas(Constants::kCacheLineBytes) WakeupEvent {
+ public:
+  WakeupEvent()
+    : signaled_{ false }
+    , waiting_{ false } {
+  }
+
+  /// Wakes the owning thread, if it's waiting; otherwise, its next wait returns immediately.
+  inline void Signal() {
+    if(!signaled_.exchange(true) && waiting_.load()) {
+      // Take the lock, so that the notification can't slip in between the waiter's check of
+      // "signaled_" and its going to sleep.
+      std::lock_guard<std::mutex> lock{ mutex_ };
+      cv_.notify_one();
+    }
+  }
+
+  /// Called only by the owning thread. Waits until signaled, or until "timeout_us" microseconds
+  /// have passed; returns true if signaled.
+  bool WaitFor(uint32_t timeout_us) {
+    if(signaled_.exchange(false)) {
+      return true;
+    }
+    std::unique_lock<std::mutex> lock{ mutex_ };
+    waiting_.store(true);
+    cv_.wait_for(lock, std::chrono::microseconds{ timeout_us }, [this]() {
+      return signaled_.load();
+    });
+    waiting_.store(false);
+    return signaled_.exchange(false);
+  }
+
+ private:
+  std::atomic<bool> signaled_;
+  std::atomic<bool> waiting_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+};
+
+}
+} // namespace FASTER::core
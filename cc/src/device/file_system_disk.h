@@ -77,6 +77,13 @@ class FileSystemFile {
                     AsyncIOCallback callback, IAsyncContext& context) {
     return file_.Write(dest, length, reinterpret_cast<const uint8_t*>(source), context, callback);
   }
+  /// Writes "count" buffers of "length" bytes each to consecutive offsets starting at "dest", with
+  /// a single completion.
+  Status WriteGatherAsync(const void* const* sources, uint32_t count, uint64_t dest,
+                          uint32_t length, AsyncIOCallback callback, IAsyncContext& context) {
+    return file_.WriteGather(dest, reinterpret_cast<const uint8_t* const*>(sources), count,
+                             length, context, callback);
+  }
 
   size_t alignment() const {
     return file_.device_alignment();
@@ -280,6 +287,24 @@ class FileSystemSegmentedFile {
     }
     return files->file(segment).WriteAsync(source, dest % kSegmentSize, length, callback, context);
   }
+  /// The buffers must all fall in the same segment.
+  Status WriteGatherAsync(const void* const* sources, uint32_t count, uint64_t dest,
+                          uint32_t length, AsyncIOCallback callback, IAsyncContext& context) {
+    uint64_t segment = dest / kSegmentSize;
+    assert(dest % kSegmentSize + static_cast<uint64_t>(count) * length <= kSegmentSize);
+
+    bundle_t* files = files_.load();
+
+    if(!files || !files->exists(segment)) {
+      Status result = OpenSegment(segment);
+      if(result != Status::Ok) {
+        return result;
+      }
+      files = files_.load();
+    }
+    return files->file(segment).WriteGatherAsync(sources, count, dest % kSegmentSize, length,
+           callback, context);
+  }
 
   size_t alignment() const {
     return 512; // For now, assume all disks have 512-bytes alignment.
@@ -435,10 +460,14 @@ class FileSystemDisk {
   }
 
  public:
+  /// "queue_depth" bounds the number of I/Os in flight, on handlers that have a fixed queue. (A
+  /// store builds its disk from just a path and an epoch; to pick a depth for a store, derive a
+  /// disk type whose constructor passes it on.)
   FileSystemDisk(const std::string& root_path, LightEpoch& epoch, bool enablePrivileges = false,
-                 bool unbuffered = true, bool delete_on_close = false)
+                 bool unbuffered = true, bool delete_on_close = false,
+                 uint32_t queue_depth = handler_t::kDefaultQueueDepth)
     : root_path_{ NormalizePath(root_path) }
-    , handler_{ 16 /*max threads*/ }
+    , handler_{ 16 /*max threads*/, queue_depth }
     , default_file_options_{ unbuffered, delete_on_close }
     , log_{ root_path_ + "log.log", default_file_options_, &epoch} {
     Status result = log_.Open(&handler_);
@@ -513,6 +542,20 @@ class FileSystemDisk {
   bool TryComplete() {
     return handler_.TryComplete();
   }
+  /// Like TryComplete(), but waits up to "timeout_us" microseconds for a completion, if the
+  /// handler executes completions on the calling thread; returns false if nothing completed.
+  bool WaitForCompletion(uint32_t timeout_us) {
+    return handler_.WaitForCompletion(timeout_us);
+  }
+  /// Submits the I/Os that this thread's requests are batched into, if the handler batches them.
+  void FlushSubmissions() {
+    handler_.Flush();
+  }
+  /// Registers a long-lived buffer with the handler, if it can read into and write from
+  /// registered buffers more cheaply.
+  Status RegisterBuffer(uint8_t* buffer, uint64_t size) {
+    return handler_.RegisterBuffer(buffer, size);
+  }
 
  private:
   std::string root_path_;
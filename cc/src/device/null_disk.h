@@ -4,8 +4,10 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <string>
+#include <thread>
 
 #include "../core/gc_state.h"
 #include "../core/light_epoch.h"
@@ -22,6 +24,9 @@ struct NullHandler {
 
 class NullFile {
  public:
+  /// The null device isn't divided into segments.
+  static constexpr uint64_t kSegmentSize = UINT64_MAX;
+
   Status Open(NullHandler* handler) {
     return Status::Ok;
   }
@@ -47,6 +52,11 @@ class NullFile {
     callback(&context, Status::Ok, length);
     return Status::Ok;
   }
+  Status WriteGatherAsync(const void* const*, uint32_t count, uint64_t, uint32_t length,
+                          AsyncIOCallback callback, IAsyncContext& context) {
+    callback(&context, Status::Ok, static_cast<size_t>(count) * length);
+    return Status::Ok;
+  }
 
   static size_t alignment() {
     // Align null device to cache line.
@@ -115,6 +125,16 @@ class NullDisk {
   inline static constexpr bool TryComplete() {
     return false;
   }
+  /// Nothing is ever in flight, so there's nothing to wait for but the timeout.
+  inline static bool WaitForCompletion(uint32_t timeout_us) {
+    std::this_thread::sleep_for(std::chrono::microseconds{ timeout_us });
+    return false;
+  }
+  inline static void FlushSubmissions() {
+  }
+  inline static constexpr Status RegisterBuffer(uint8_t*, uint64_t) {
+    return Status::Ok;
+  }
 
  private:
   handler_t handler_;
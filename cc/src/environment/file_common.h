@@ -3,6 +3,11 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
 #include <ostream>
 
 #include "../core/async.h"
@@ -56,5 +61,46 @@ struct FileOptions {
   bool delete_on_close;
 };
 
+/// Lets threads that issued I/Os wait for completions executed on other threads (a thread
+/// pool's, say), instead of spinning. Notifying costs only an atomic increment, unless some
+/// thread is waiting.
+class CompletionEvent {
+ public:
+  CompletionEvent()
+    : num_completed_{ 0 }
+    , num_waiters_{ 0 } {
+  }
+
+  /// Called after executing "count" completions.
+  inline void Notify(uint32_t count) {
+    num_completed_.fetch_add(count);
+    if(num_waiters_.load() > 0) {
+      // Take the lock, so that the notification can't slip in between a waiter's check of
+      // "num_completed_" and its going to sleep.
+      std::lock_guard<std::mutex> lock{ mutex_ };
+      cv_.notify_all();
+    }
+  }
+
+  /// Waits until some completion has executed, or until "timeout_us" microseconds have passed;
+  /// returns true if a completion executed.
+  bool WaitFor(uint32_t timeout_us) {
+    uint64_t num_completed = num_completed_.load();
+    std::unique_lock<std::mutex> lock{ mutex_ };
+    ++num_waiters_;
+    cv_.wait_for(lock, std::chrono::microseconds{ timeout_us }, [&]() {
+      return num_completed_.load() != num_completed;
+    });
+    --num_waiters_;
+    return num_completed_.load() != num_completed;
+  }
+
+ private:
+  std::atomic<uint64_t> num_completed_;
+  std::atomic<uint32_t> num_waiters_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+};
+
 }
 } // namespace FASTER::environment
\ No newline at end of file
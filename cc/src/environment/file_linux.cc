@@ -1,8 +1,12 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT license.
 
+#include <algorithm>
 #include <cstring>
+#include <stdexcept>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <linux/fs.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -89,6 +93,18 @@ Status File::GetDeviceAlignment() {
   return Status::Ok;
 }
 
+void File::PrepareGather(size_t offset, const uint8_t* const* buffers, uint32_t count,
+                         uint32_t length, struct iovec* iov) {
+#ifdef IO_STATISTICS
+  bytes_written_ += static_cast<uint64_t>(count) * length;
+#endif
+  for(uint32_t idx = 0; idx < count; ++idx) {
+    DCHECK_ALIGNMENT(offset + static_cast<size_t>(idx) * length, length, buffers[idx]);
+    iov[idx].iov_base = const_cast<uint8_t*>(buffers[idx]);
+    iov[idx].iov_len = length;
+  }
+}
+
 int File::GetCreateDisposition(FileCreateDisposition create_disposition) {
   switch(create_disposition) {
   case FileCreateDisposition::CreateOrTruncate:
@@ -119,18 +135,103 @@ void QueueIoHandler::IoCompletionCallback(io_context_t ctx, struct iocb* iocb, l
   callback_context->callback(callback_context->caller_context, return_status, bytes_transferred);
 }
 
+Status QueueIoHandler::Submit(struct iocb* iocb) {
+  SubmitBatch& batch = (*batches_)[Thread::id()];
+  batch.lock();
+  while(batch.count.load() == kMaxBatchSize) {
+    Status result = SubmitLocked(batch);
+    if(result != Status::Ok) {
+      batch.unlock();
+      return result;
+    }
+    if(batch.count.load() < kMaxBatchSize) {
+      break;
+    }
+    // The kernel's queue is full. Rather than fail the request (which its caller may have no way
+    // to retry), reap completions until there's room.
+    batch.unlock();
+    if(!Complete(0)) {
+      std::this_thread::yield();
+    }
+    batch.lock();
+  }
+  uint32_t count = batch.count.load();
+  batch.iocbs[count] = iocb;
+  batch.count.store(count + 1);
+  Status result = (count + 1 == kMaxBatchSize) ? SubmitLocked(batch) : Status::Ok;
+  batch.unlock();
+  return result;
+}
+
+Status QueueIoHandler::Flush() {
+  SubmitBatch* batch = batches_->Get(Thread::id());
+  if(!batch || batch->count.load() == 0) {
+    return Status::Ok;
+  }
+  batch->lock();
+  Status result = SubmitLocked(*batch);
+  batch->unlock();
+  return result;
+}
+
+Status QueueIoHandler::SubmitLocked(SubmitBatch& batch) {
+  uint32_t count = batch.count.load();
+  if(count == 0) {
+    return Status::Ok;
+  }
+  int result = ::io_submit(io_object_, count, batch.iocbs);
+  if(result < 0) {
+    // EAGAIN means too many I/Os are in flight; keep the batch, and try again later.
+    return result == -EAGAIN ? Status::Ok : Status::IOError;
+  }
+  // The kernel may have accepted only part of the batch.
+  uint32_t submitted = static_cast<uint32_t>(result);
+  std::memmove(batch.iocbs, batch.iocbs + submitted, (count - submitted) * sizeof(struct iocb*));
+  batch.count.store(count - submitted);
+  return Status::Ok;
+}
+
+void QueueIoHandler::FlushAll() {
+  uint32_t num_ids = Thread::num_ids();
+  for(uint32_t idx = 0; idx < num_ids; ++idx) {
+    SubmitBatch* batch = batches_->Get(idx);
+    if(batch && batch->count.load() > 0 && batch->try_lock()) {
+      SubmitLocked(*batch);
+      batch->unlock();
+    }
+  }
+}
+
 bool QueueIoHandler::TryComplete() {
+  return Complete(0);
+}
+
+bool QueueIoHandler::WaitForCompletion(uint32_t timeout_us) {
+  return Complete(timeout_us);
+}
+
+bool QueueIoHandler::Complete(uint32_t timeout_us) {
+  Flush();
+  if(timeout_us > 0) {
+    // Don't sleep on requests that are still waiting in other threads' batches.
+    FlushAll();
+  }
   struct timespec timeout;
-  std::memset(&timeout, 0, sizeof(timeout));
-  struct io_event events[1];
-  int result = ::io_getevents(io_object_, 1, 1, events, &timeout);
-  if(result == 1) {
-    io_callback_t callback = reinterpret_cast<io_callback_t>(events[0].data);
-    callback(io_object_, events[0].obj, events[0].res, events[0].res2);
-    return true;
-  } else {
+  timeout.tv_sec = timeout_us / 1000000;
+  timeout.tv_nsec = (timeout_us % 1000000) * 1000;
+  struct io_event events[kMaxCompletions];
+  int result = ::io_getevents(io_object_, 1, kMaxCompletions, events, &timeout);
+  if(result <= 0) {
+    // Nothing has completed; make sure that's not because another thread's requests are still
+    // waiting in its batch.
+    FlushAll();
     return false;
   }
+  for(int idx = 0; idx < result; ++idx) {
+    io_callback_t callback = reinterpret_cast<io_callback_t>(events[idx].data);
+    callback(io_object_, events[idx].obj, events[idx].res, events[idx].res2);
+  }
+  return true;
 }
 
 Status QueueFile::Open(FileCreateDisposition create_disposition, const FileOptions& options,
@@ -144,7 +245,7 @@ Status QueueFile::Open(FileCreateDisposition create_disposition, const FileOptio
     return Status::Ok;
   }
 
-  io_object_ = handler->io_object();
+  handler_ = handler;
   return Status::Ok;
 }
 
@@ -182,6 +283,122 @@ Status QueueFile::ScheduleOperation(FileOperationType operationType, uint8_t* bu
   new(io_context.get()) QueueIoHandler::IoCallbackContext(operationType, fd_, offset, length,
       buffer, caller_context_copy, callback);
 
+  RETURN_NOT_OK(handler_->Submit(reinterpret_cast<struct iocb*>(io_context.get())));
+  io_context.release();
+  return Status::Ok;
+}
+
+Status QueueFile::WriteGather(size_t offset, const uint8_t* const* buffers, uint32_t count,
+                              uint32_t length, IAsyncContext& context, AsyncIOCallback callback) {
+  // The iovecs must live until the request completes, so they follow the request's context.
+  auto io_context = alloc_context<QueueIoHandler::IoCallbackContext>(
+                      sizeof(QueueIoHandler::IoCallbackContext) + count * sizeof(struct iovec));
+  if(!io_context.get()) return Status::OutOfMemory;
+  struct iovec* iov = reinterpret_cast<struct iovec*>(io_context.get() + 1);
+  PrepareGather(offset, buffers, count, length, iov);
+
+  IAsyncContext* caller_context_copy;
+  RETURN_NOT_OK(context.DeepCopy(caller_context_copy));
+
+  new(io_context.get()) QueueIoHandler::IoCallbackContext(fd_, offset, iov, count,
+      caller_context_copy, callback);
+
+  RETURN_NOT_OK(handler_->Submit(reinterpret_cast<struct iocb*>(io_context.get())));
+  io_context.release();
+  return Status::Ok;
+}
+
+constexpr size_t ThreadPoolIoHandler::kMaxCompletionThreads;
+
+ThreadPoolIoHandler::ThreadPoolIoHandler(size_t max_threads, uint32_t queue_depth)
+  : io_object_{ 0 }
+  , stop_{ false } {
+  int result = ::io_setup(queue_depth, &io_object_);
+  if(result < 0) {
+    throw std::runtime_error{ "io_setup() failed" };
+  }
+  size_t num_threads = std::max(std::min(max_threads, kMaxCompletionThreads), (size_t)1);
+  for(size_t idx = 0; idx < num_threads; ++idx) {
+    threads_.emplace_back(&ThreadPoolIoHandler::CompletionThread, this);
+  }
+}
+
+ThreadPoolIoHandler::~ThreadPoolIoHandler() {
+  stop_.store(true);
+  for(auto& thread : threads_) {
+    thread.join();
+  }
+  if(io_object_ != 0) {
+    ::io_destroy(io_object_);
+  }
+}
+
+void ThreadPoolIoHandler::CompletionThread() {
+  struct io_event events[kMaxCompletions];
+  while(!stop_.load()) {
+    // Wake up now and then, to check whether the handler is shutting down.
+    struct timespec timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_nsec = 10000000;
+    int result = ::io_getevents(io_object_, 1, kMaxCompletions, events, &timeout);
+    for(int idx = 0; idx < result; ++idx) {
+      io_callback_t callback = reinterpret_cast<io_callback_t>(events[idx].data);
+      callback(io_object_, events[idx].obj, events[idx].res, events[idx].res2);
+    }
+    if(result > 0) {
+      completed_.Notify(result);
+    }
+  }
+}
+
+Status ThreadPoolFile::Open(FileCreateDisposition create_disposition, const FileOptions& options,
+                            ThreadPoolIoHandler* handler, bool* exists) {
+  int flags = 0;
+  if(options.unbuffered) {
+    flags |= O_DIRECT;
+  }
+  RETURN_NOT_OK(File::Open(flags, create_disposition, exists));
+  if(exists && !*exists) {
+    return Status::Ok;
+  }
+
+  io_object_ = handler->io_object();
+  return Status::Ok;
+}
+
+Status ThreadPoolFile::Read(size_t offset, uint32_t length, uint8_t* buffer,
+                            IAsyncContext& context, AsyncIOCallback callback) const {
+  DCHECK_ALIGNMENT(offset, length, buffer);
+#ifdef IO_STATISTICS
+  ++read_count_;
+  bytes_read_ += length;
+#endif
+  return const_cast<ThreadPoolFile*>(this)->ScheduleOperation(FileOperationType::Read, buffer,
+         offset, length, context, callback);
+}
+
+Status ThreadPoolFile::Write(size_t offset, uint32_t length, const uint8_t* buffer,
+                             IAsyncContext& context, AsyncIOCallback callback) {
+  DCHECK_ALIGNMENT(offset, length, buffer);
+#ifdef IO_STATISTICS
+  bytes_written_ += length;
+#endif
+  return ScheduleOperation(FileOperationType::Write, const_cast<uint8_t*>(buffer), offset, length,
+                           context, callback);
+}
+
+Status ThreadPoolFile::ScheduleOperation(FileOperationType operationType, uint8_t* buffer,
+    size_t offset, uint32_t length, IAsyncContext& context, AsyncIOCallback callback) {
+  auto io_context = alloc_context<ThreadPoolIoHandler::IoCallbackContext>(sizeof(
+                      ThreadPoolIoHandler::IoCallbackContext));
+  if(!io_context.get()) return Status::OutOfMemory;
+
+  IAsyncContext* caller_context_copy;
+  RETURN_NOT_OK(context.DeepCopy(caller_context_copy));
+
+  new(io_context.get()) ThreadPoolIoHandler::IoCallbackContext(operationType, fd_, offset,
+      length, buffer, caller_context_copy, callback);
+
   struct iocb* iocbs[1];
   iocbs[0] = reinterpret_cast<struct iocb*>(io_context.get());
 
@@ -194,6 +411,392 @@ Status QueueFile::ScheduleOperation(FileOperationType operationType, uint8_t* bu
   return Status::Ok;
 }
 
+Status ThreadPoolFile::WriteGather(size_t offset, const uint8_t* const* buffers, uint32_t count,
+                                   uint32_t length, IAsyncContext& context,
+                                   AsyncIOCallback callback) {
+  // The iovecs must live until the request completes, so they follow the request's context.
+  auto io_context = alloc_context<ThreadPoolIoHandler::IoCallbackContext>(
+                      sizeof(ThreadPoolIoHandler::IoCallbackContext) + count * sizeof(struct iovec));
+  if(!io_context.get()) return Status::OutOfMemory;
+  struct iovec* iov = reinterpret_cast<struct iovec*>(io_context.get() + 1);
+  PrepareGather(offset, buffers, count, length, iov);
+
+  IAsyncContext* caller_context_copy;
+  RETURN_NOT_OK(context.DeepCopy(caller_context_copy));
+
+  new(io_context.get()) ThreadPoolIoHandler::IoCallbackContext(fd_, offset, iov, count,
+      caller_context_copy, callback);
+
+  struct iocb* iocbs[1];
+  iocbs[0] = reinterpret_cast<struct iocb*>(io_context.get());
+
+  int result = ::io_submit(io_object_, 1, iocbs);
+  if(result != 1) {
+    return Status::IOError;
+  }
+
+  io_context.release();
+  return Status::Ok;
+}
+
+/// The io_uring system calls. (Called directly, so that FASTER doesn't depend on liburing.)
+static inline int io_uring_setup(uint32_t entries, struct io_uring_params* params) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+static inline int io_uring_enter(int ring_fd, uint32_t to_submit, uint32_t min_complete,
+                                 uint32_t flags, const void* arg = nullptr, size_t arg_size = 0) {
+  return static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete,
+                                    flags, arg, arg_size));
+}
+
+static inline int io_uring_register(int ring_fd, uint32_t opcode, const void* arg,
+                                    uint32_t nr_args) {
+  return static_cast<int>(::syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args));
+}
+
+/// The rings' head and tail indexes are shared with the kernel.
+static inline uint32_t load_acquire(const uint32_t* p) {
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void store_release(uint32_t* p, uint32_t value) {
+  __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+constexpr uint32_t UringIoHandler::kMaxCompletions;
+
+UringIoHandler::UringIoHandler(size_t, uint32_t queue_depth)
+  : UringIoHandler() {
+  struct io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  ring_fd_ = io_uring_setup(queue_depth, &params);
+  if(ring_fd_ < 0) {
+    throw std::runtime_error{ "io_uring_setup() failed" };
+  }
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if(single_mmap) {
+    // The submission and completion rings share one mapping.
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+  }
+  void* sq_ring = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+  void* cq_ring = single_mmap ? sq_ring : ::mmap(nullptr, cq_ring_size_,
+                  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+  sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+  wait_timeout_supported_ = (params.features & IORING_FEAT_EXT_ARG) != 0;
+  void* sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring_fd_, IORING_OFF_SQES);
+  // The destructor (which runs, since this constructor delegates) closes the ring, but only
+  // sees the mappings once they've all succeeded; if one failed, unmap the others here.
+  if(sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED) {
+    if(sqes != MAP_FAILED) {
+      ::munmap(sqes, sqes_size_);
+    }
+    if(cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+      ::munmap(cq_ring, cq_ring_size_);
+    }
+    if(sq_ring != MAP_FAILED) {
+      ::munmap(sq_ring, sq_ring_size_);
+    }
+    throw std::runtime_error{ "mmap() of io_uring failed" };
+  }
+  sq_ring_ = reinterpret_cast<uint8_t*>(sq_ring);
+  cq_ring_ = reinterpret_cast<uint8_t*>(cq_ring);
+  sqes_ = reinterpret_cast<struct io_uring_sqe*>(sqes);
+
+  sq_head_ = reinterpret_cast<uint32_t*>(sq_ring_ + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<uint32_t*>(sq_ring_ + params.sq_off.tail);
+  sq_flags_ = reinterpret_cast<uint32_t*>(sq_ring_ + params.sq_off.flags);
+  sq_array_ = reinterpret_cast<uint32_t*>(sq_ring_ + params.sq_off.array);
+  sq_mask_ = *reinterpret_cast<uint32_t*>(sq_ring_ + params.sq_off.ring_mask);
+  sq_entries_ = params.sq_entries;
+
+  cq_head_ = reinterpret_cast<uint32_t*>(cq_ring_ + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<uint32_t*>(cq_ring_ + params.cq_off.tail);
+  cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq_ring_ + params.cq_off.cqes);
+  cq_mask_ = *reinterpret_cast<uint32_t*>(cq_ring_ + params.cq_off.ring_mask);
+}
+
+UringIoHandler::UringIoHandler(UringIoHandler&& other)
+  : ring_fd_{ other.ring_fd_ }
+  , sq_ring_{ other.sq_ring_ }
+  , cq_ring_{ other.cq_ring_ }
+  , sqes_{ other.sqes_ }
+  , sq_ring_size_{ other.sq_ring_size_ }
+  , cq_ring_size_{ other.cq_ring_size_ }
+  , sqes_size_{ other.sqes_size_ }
+  , wait_timeout_supported_{ other.wait_timeout_supported_ }
+  , sq_head_{ other.sq_head_ }
+  , sq_tail_{ other.sq_tail_ }
+  , sq_flags_{ other.sq_flags_ }
+  , sq_array_{ other.sq_array_ }
+  , sq_mask_{ other.sq_mask_ }
+  , sq_entries_{ other.sq_entries_ }
+  , unsubmitted_{ other.unsubmitted_.load() }
+  , cq_head_{ other.cq_head_ }
+  , cq_tail_{ other.cq_tail_ }
+  , cqes_{ other.cqes_ }
+  , cq_mask_{ other.cq_mask_ }
+  , registered_buffers_{ std::move(other.registered_buffers_) } {
+  other.ring_fd_ = -1;
+  other.sq_ring_ = nullptr;
+  other.cq_ring_ = nullptr;
+  other.sqes_ = nullptr;
+}
+
+UringIoHandler::~UringIoHandler() {
+  if(sqes_) {
+    ::munmap(sqes_, sqes_size_);
+  }
+  if(cq_ring_ && cq_ring_ != sq_ring_) {
+    ::munmap(cq_ring_, cq_ring_size_);
+  }
+  if(sq_ring_) {
+    ::munmap(sq_ring_, sq_ring_size_);
+  }
+  if(ring_fd_ != -1) {
+    ::close(ring_fd_);
+  }
+}
+
+Status UringIoHandler::RegisterBuffer(uint8_t* buffer, uint64_t size) {
+  std::lock_guard<std::mutex> lock{ sq_mutex_ };
+  if(!registered_buffers_.empty()) {
+    // The kernel takes the whole set of buffers at once.
+    if(io_uring_register(ring_fd_, IORING_UNREGISTER_BUFFERS, nullptr, 0) < 0) {
+      return Status::IOError;
+    }
+  }
+  struct iovec iov;
+  iov.iov_base = buffer;
+  iov.iov_len = size;
+  registered_buffers_.push_back(iov);
+  if(io_uring_register(ring_fd_, IORING_REGISTER_BUFFERS, registered_buffers_.data(),
+                       static_cast<uint32_t>(registered_buffers_.size())) < 0) {
+    registered_buffers_.clear();
+    return Status::IOError;
+  }
+  return Status::Ok;
+}
+
+Status UringIoHandler::Submit(FileOperationType operation, int fd, uint8_t* buffer,
+                              size_t offset, uint32_t length, IoCallbackContext* context) {
+  std::lock_guard<std::mutex> lock{ sq_mutex_ };
+  uint8_t opcode = (FileOperationType::Read == operation) ? IORING_OP_READ : IORING_OP_WRITE;
+  uint16_t buf_index = 0;
+  for(uint32_t idx = 0; idx < registered_buffers_.size(); ++idx) {
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(registered_buffers_[idx].iov_base);
+    if(buffer >= base && buffer + length <= base + registered_buffers_[idx].iov_len) {
+      opcode = (FileOperationType::Read == operation) ? IORING_OP_READ_FIXED :
+               IORING_OP_WRITE_FIXED;
+      buf_index = static_cast<uint16_t>(idx);
+      break;
+    }
+  }
+  return EnqueueLocked(opcode, buf_index, fd, reinterpret_cast<uint64_t>(buffer), length, offset,
+                       context);
+}
+
+Status UringIoHandler::SubmitWriteGather(int fd, const struct iovec* iov, uint32_t count,
+    size_t offset, IoCallbackContext* context) {
+  std::lock_guard<std::mutex> lock{ sq_mutex_ };
+  return EnqueueLocked(IORING_OP_WRITEV, 0, fd, reinterpret_cast<uint64_t>(iov), count, offset,
+                       context);
+}
+
+Status UringIoHandler::EnqueueLocked(uint8_t opcode, uint16_t buf_index, int fd, uint64_t addr,
+                                     uint32_t length, size_t offset,
+                                     IoCallbackContext* context) {
+  // We are the only producer, so the tail is ours; the kernel advances the head.
+  uint32_t tail = *sq_tail_;
+  if(tail - load_acquire(sq_head_) >= sq_entries_) {
+    // The submission queue is full; hand it to the kernel, to make room.
+    RETURN_NOT_OK(FlushLocked(0));
+    if(tail - load_acquire(sq_head_) >= sq_entries_) {
+      return Status::IOError;
+    }
+  }
+
+  uint32_t index = tail & sq_mask_;
+  struct io_uring_sqe* sqe = &sqes_[index];
+  std::memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = opcode;
+  sqe->buf_index = buf_index;
+  sqe->fd = fd;
+  sqe->addr = addr;
+  sqe->len = length;
+  sqe->off = offset;
+  sqe->user_data = reinterpret_cast<uint64_t>(context);
+  sq_array_[index] = index;
+  store_release(sq_tail_, tail + 1);
+
+  if(unsubmitted_.fetch_add(1) + 1 >= kSubmitBatchSize) {
+    // The request is in the ring, and the kernel will complete it (and free its context), so
+    // the caller mustn't see it fail; if the flush fails, the next Flush() retries it.
+    FlushLocked(0);
+  }
+  return Status::Ok;
+}
+
+Status UringIoHandler::Flush() {
+  if(unsubmitted_.load() == 0 &&
+      (load_acquire(sq_flags_) & IORING_SQ_CQ_OVERFLOW) == 0) {
+    return Status::Ok;
+  }
+  std::lock_guard<std::mutex> lock{ sq_mutex_ };
+  return FlushLocked(IORING_ENTER_GETEVENTS);
+}
+
+Status UringIoHandler::FlushLocked(uint32_t flags) {
+  uint32_t to_submit = unsubmitted_.load();
+  if(to_submit == 0 && flags == 0) {
+    return Status::Ok;
+  }
+  // (With IORING_ENTER_GETEVENTS and min_complete == 0, the call doesn't wait; but it does move
+  // any completions that overflowed the completion queue back onto it.)
+  int result = io_uring_enter(ring_fd_, to_submit, 0, flags);
+  if(result < 0) {
+    // EAGAIN and EBUSY are transient: the kernel is short of resources, or the completion queue
+    // is full. The requests remain queued, for the next flush.
+    return (errno == EAGAIN || errno == EBUSY || errno == EINTR) ? Status::Ok : Status::IOError;
+  }
+  unsubmitted_.fetch_sub(static_cast<uint32_t>(result));
+  return Status::Ok;
+}
+
+bool UringIoHandler::TryComplete() {
+  Flush();
+
+  struct io_uring_cqe cqes[kMaxCompletions];
+  uint32_t count;
+  {
+    std::unique_lock<std::mutex> lock{ cq_mutex_, std::try_to_lock };
+    if(!lock.owns_lock()) {
+      // Another thread is reaping completions.
+      return false;
+    }
+    uint32_t head = *cq_head_;
+    count = std::min(load_acquire(cq_tail_) - head, kMaxCompletions);
+    for(uint32_t idx = 0; idx < count; ++idx) {
+      cqes[idx] = cqes_[(head + idx) & cq_mask_];
+    }
+    // Give the entries back to the kernel before running the callbacks, which may issue more I/O.
+    store_release(cq_head_, head + count);
+  }
+
+  for(uint32_t idx = 0; idx < count; ++idx) {
+    auto callback_context = make_context_unique_ptr<IoCallbackContext>(
+                              reinterpret_cast<IoCallbackContext*>(cqes[idx].user_data));
+    Status return_status;
+    size_t bytes_transferred;
+    if(cqes[idx].res < 0) {
+      return_status = Status::IOError;
+      bytes_transferred = 0;
+    } else {
+      return_status = Status::Ok;
+      bytes_transferred = cqes[idx].res;
+    }
+    callback_context->callback(callback_context->caller_context, return_status,
+                               bytes_transferred);
+  }
+  return count > 0;
+}
+
+bool UringIoHandler::WaitForCompletion(uint32_t timeout_us) {
+  if(TryComplete()) {
+    return true;
+  }
+  if(!wait_timeout_supported_) {
+    return false;
+  }
+  struct __kernel_timespec timeout;
+  timeout.tv_sec = timeout_us / 1000000;
+  timeout.tv_nsec = (timeout_us % 1000000) * 1000;
+  struct io_uring_getevents_arg arg;
+  std::memset(&arg, 0, sizeof(arg));
+  arg.ts = reinterpret_cast<uint64_t>(&timeout);
+  // Sleeps until a completion is posted, or until the timeout (-ETIME).
+  io_uring_enter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg,
+                 sizeof(arg));
+  return TryComplete();
+}
+
+Status UringFile::Open(FileCreateDisposition create_disposition, const FileOptions& options,
+                       UringIoHandler* handler, bool* exists) {
+  int flags = 0;
+  if(options.unbuffered) {
+    flags |= O_DIRECT;
+  }
+  RETURN_NOT_OK(File::Open(flags, create_disposition, exists));
+  if(exists && !*exists) {
+    return Status::Ok;
+  }
+
+  handler_ = handler;
+  return Status::Ok;
+}
+
+Status UringFile::Read(size_t offset, uint32_t length, uint8_t* buffer,
+                       IAsyncContext& context, AsyncIOCallback callback) const {
+  DCHECK_ALIGNMENT(offset, length, buffer);
+#ifdef IO_STATISTICS
+  ++read_count_;
+  bytes_read_ += length;
+#endif
+  return const_cast<UringFile*>(this)->ScheduleOperation(FileOperationType::Read, buffer,
+         offset, length, context, callback);
+}
+
+Status UringFile::Write(size_t offset, uint32_t length, const uint8_t* buffer,
+                        IAsyncContext& context, AsyncIOCallback callback) {
+  DCHECK_ALIGNMENT(offset, length, buffer);
+#ifdef IO_STATISTICS
+  bytes_written_ += length;
+#endif
+  return ScheduleOperation(FileOperationType::Write, const_cast<uint8_t*>(buffer), offset, length,
+                           context, callback);
+}
+
+Status UringFile::ScheduleOperation(FileOperationType operationType, uint8_t* buffer,
+                                    size_t offset, uint32_t length, IAsyncContext& context,
+                                    AsyncIOCallback callback) {
+  auto io_context = alloc_context<UringIoHandler::IoCallbackContext>(sizeof(
+                      UringIoHandler::IoCallbackContext));
+  if(!io_context.get()) return Status::OutOfMemory;
+
+  IAsyncContext* caller_context_copy;
+  RETURN_NOT_OK(context.DeepCopy(caller_context_copy));
+
+  new(io_context.get()) UringIoHandler::IoCallbackContext(caller_context_copy, callback);
+
+  RETURN_NOT_OK(handler_->Submit(operationType, fd_, buffer, offset, length, io_context.get()));
+  io_context.release();
+  return Status::Ok;
+}
+
+Status UringFile::WriteGather(size_t offset, const uint8_t* const* buffers, uint32_t count,
+                              uint32_t length, IAsyncContext& context, AsyncIOCallback callback) {
+  // The iovecs must live until the request completes, so they follow the request's context.
+  auto io_context = alloc_context<UringIoHandler::IoCallbackContext>(
+                      sizeof(UringIoHandler::IoCallbackContext) + count * sizeof(struct iovec));
+  if(!io_context.get()) return Status::OutOfMemory;
+  struct iovec* iov = reinterpret_cast<struct iovec*>(io_context.get() + 1);
+  PrepareGather(offset, buffers, count, length, iov);
+
+  IAsyncContext* caller_context_copy;
+  RETURN_NOT_OK(context.DeepCopy(caller_context_copy));
+
+  new(io_context.get()) UringIoHandler::IoCallbackContext(caller_context_copy, callback);
+
+  RETURN_NOT_OK(handler_->SubmitWriteGather(fd_, iov, count, offset, io_context.get()));
+  io_context.release();
+  return Status::Ok;
+}
+
 #undef DCHECK_ALIGNMENT
 
 }
@@ -5,14 +5,22 @@
 
 #include <atomic>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 #include <libaio.h>
+#include <linux/io_uring.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "../core/async.h"
+#include "../core/constants.h"
 #include "../core/status.h"
+#include "../core/thread.h"
 #include "file_common.h"
 
 namespace FASTER {
@@ -87,6 +95,9 @@ class File {
 
  protected:
   Status Open(int flags, FileCreateDisposition create_disposition, bool* exists = nullptr);
+  /// Fills in "iov" with "count" buffers of "length" bytes each, for a gather write to "offset".
+  void PrepareGather(size_t offset, const uint8_t* const* buffers, uint32_t count,
+                     uint32_t length, struct iovec* iov);
 
  public:
   Status Close();
@@ -141,27 +152,64 @@ class File {
 class QueueFile;
 
 /// The QueueIoHandler class encapsulates completions for async file I/O, where the completions
-/// are put on the AIO completion queue.
+/// are put on the AIO completion queue. Each thread batches the requests it issues, and submits
+/// them with a single io_submit() when the batch fills, or when the thread calls Flush() or
+/// TryComplete(); TryComplete() reaps many completions per io_getevents().
 class QueueIoHandler {
  public:
   typedef QueueFile async_file_t;
+  /// Maximum number of I/Os in flight, unless the constructor is told otherwise.
+  constexpr static uint32_t kDefaultQueueDepth = 128;
 
  private:
-  constexpr static int kMaxEvents = 128;
+  /// Submit a thread's batched requests once this many have queued up.
+  constexpr static uint32_t kMaxBatchSize = 32;
+  /// Reap at most this many completions per call to TryComplete().
+  constexpr static uint32_t kMaxCompletions = 32;
+
+  /// The requests a thread has issued but not yet submitted. Only its own thread adds to a batch;
+  /// but any thread may submit it, so that a batch isn't stranded by a thread that stops polling.
+  struct alignas(Constants::kCacheLineBytes) SubmitBatch {
+    SubmitBatch()
+      : locked{ false }
+      , count{ 0 } {
+    }
+
+    inline bool try_lock() {
+      return !locked.load(std::memory_order_relaxed) && !locked.exchange(true);
+    }
+    inline void lock() {
+      while(!try_lock()) {
+        std::this_thread::yield();
+      }
+    }
+    inline void unlock() {
+      locked.store(false);
+    }
+
+    std::atomic<bool> locked;
+    /// Modified only with the batch locked; but read without the lock, as a hint.
+    std::atomic<uint32_t> count;
+    struct iocb* iocbs[kMaxBatchSize];
+  };
 
  public:
   QueueIoHandler()
-    : io_object_{ 0 } {
+    : io_object_{ 0 }
+    , batches_{} {
   }
-  QueueIoHandler(size_t max_threads)
-    : io_object_{ 0 } {
-    int result = ::io_setup(kMaxEvents, &io_object_);
+  /// "queue_depth" is the maximum number of I/Os in flight.
+  QueueIoHandler(size_t max_threads, uint32_t queue_depth = kDefaultQueueDepth)
+    : io_object_{ 0 }
+    , batches_{ new ThreadTable<SubmitBatch>{} } {
+    int result = ::io_setup(queue_depth, &io_object_);
     assert(result >= 0);
   }
 
   /// Move constructor
-  QueueIoHandler(QueueIoHandler&& other) {
-    io_object_ = other.io_object_;
+  QueueIoHandler(QueueIoHandler&& other)
+    : io_object_{ other.io_object_ }
+    , batches_{ std::move(other.batches_) } {
     other.io_object_ = 0;
   }
 
@@ -185,6 +233,14 @@ class QueueIoHandler {
       }
       ::io_set_callback(&this->parent_iocb, IoCompletionCallback);
     }
+    /// A gather write of the "count" buffers in "iov", which must outlive the request.
+    IoCallbackContext(int fd, size_t offset, const struct iovec* iov, uint32_t count,
+                      IAsyncContext* context_, AsyncIOCallback callback_)
+      : caller_context{ context_ }
+      , callback{ callback_ } {
+      ::io_prep_pwritev(&this->parent_iocb, fd, iov, count, offset);
+      ::io_set_callback(&this->parent_iocb, IoCompletionCallback);
+    }
 
     // WARNING: "parent_iocb" must be the first field in AioCallbackContext. This class is a C-style
     // subclass of "struct iocb".
@@ -199,16 +255,34 @@ class QueueIoHandler {
     AsyncIOCallback callback;
   };
 
-  inline io_context_t io_object() const {
-    return io_object_;
+  /// Adds a request to this thread's batch; the request is submitted with the batch.
+  Status Submit(struct iocb* iocb);
+  /// Submits this thread's batched requests.
+  Status Flush();
+  /// libaio has no registered buffers.
+  inline static constexpr Status RegisterBuffer(uint8_t*, uint64_t) {
+    return Status::Ok;
   }
 
-  /// Try to execute the next IO completion on the queue, if any.
+  /// Submits this thread's batched requests, and then executes the IO completions on the queue,
+  /// if any.
   bool TryComplete();
+  /// Like TryComplete(), but if nothing has completed, waits up to "timeout_us" microseconds for
+  /// a completion.
+  bool WaitForCompletion(uint32_t timeout_us);
 
  private:
+  bool Complete(uint32_t timeout_us);
+  /// Call with the batch locked.
+  Status SubmitLocked(SubmitBatch& batch);
+  /// Submits every thread's batched requests.
+  void FlushAll();
+
   /// The Linux AIO context used for IO completions.
   io_context_t io_object_;
+
+  /// One batch per thread, indexed by Thread::id().
+  std::unique_ptr<ThreadTable<SubmitBatch>> batches_;
 };
 
 /// The QueueFile class encapsulates asynchronous reads and writes, using the specified AIO
@@ -217,21 +291,21 @@ class QueueFile : public File {
  public:
   QueueFile()
     : File()
-    , io_object_{ nullptr } {
+    , handler_{ nullptr } {
   }
   QueueFile(const std::string& filename)
     : File(filename)
-    , io_object_{ nullptr } {
+    , handler_{ nullptr } {
   }
   /// Move constructor
   QueueFile(QueueFile&& other)
     : File(std::move(other))
-    , io_object_{ other.io_object_ } {
+    , handler_{ other.handler_ } {
   }
   /// Move assignment operator.
   QueueFile& operator=(QueueFile&& other) {
     File::operator=(std::move(other));
-    io_object_ = other.io_object_;
+    handler_ = other.handler_;
     return *this;
   }
 
@@ -242,6 +316,117 @@ class QueueFile : public File {
               IAsyncContext& context, AsyncIOCallback callback) const;
   Status Write(size_t offset, uint32_t length, const uint8_t* buffer,
                IAsyncContext& context, AsyncIOCallback callback);
+  /// Writes "count" buffers of "length" bytes each to consecutive offsets, starting at "offset",
+  /// as a single vectored I/O.
+  Status WriteGather(size_t offset, const uint8_t* const* buffers, uint32_t count,
+                     uint32_t length, IAsyncContext& context, AsyncIOCallback callback);
+
+ private:
+  Status ScheduleOperation(FileOperationType operationType, uint8_t* buffer, size_t offset,
+                           uint32_t length, IAsyncContext& context, AsyncIOCallback callback);
+
+  QueueIoHandler* handler_;
+};
+
+class ThreadPoolFile;
+
+/// The ThreadPoolIoHandler class encapsulates completions for async file I/O, which dedicated
+/// completion threads wait for (in io_getevents()) and execute. So I/O latency doesn't depend on
+/// how often the application's threads call TryComplete(); the completion callbacks hand their
+/// results back to the issuing threads, as with the Windows thread pool.
+class ThreadPoolIoHandler {
+ public:
+  typedef ThreadPoolFile async_file_t;
+  /// Maximum number of I/Os in flight, unless the constructor is told otherwise.
+  constexpr static uint32_t kDefaultQueueDepth = 128;
+
+ private:
+  /// Upper bound on the number of completion threads.
+  constexpr static size_t kMaxCompletionThreads = 4;
+  /// Each completion thread executes at most this many completions per wakeup.
+  constexpr static uint32_t kMaxCompletions = 32;
+
+ public:
+  ThreadPoolIoHandler()
+    : io_object_{ 0 }
+    , stop_{ false } {
+  }
+  /// Starts min("max_threads", kMaxCompletionThreads) completion threads.
+  ThreadPoolIoHandler(size_t max_threads, uint32_t queue_depth = kDefaultQueueDepth);
+
+  ThreadPoolIoHandler(const ThreadPoolIoHandler&) = delete;
+
+  ~ThreadPoolIoHandler();
+
+  typedef QueueIoHandler::IoCallbackContext IoCallbackContext;
+
+  inline io_context_t io_object() const {
+    return io_object_;
+  }
+
+  /// Completions are executed on the completion threads.
+  inline static constexpr bool TryComplete() {
+    return false;
+  }
+  /// Waits up to "timeout_us" microseconds for a completion thread to execute a completion.
+  inline bool WaitForCompletion(uint32_t timeout_us) {
+    return completed_.WaitFor(timeout_us);
+  }
+  /// Requests are submitted as they're issued; there's no batch to flush.
+  inline static constexpr Status Flush() {
+    return Status::Ok;
+  }
+  inline static constexpr Status RegisterBuffer(uint8_t*, uint64_t) {
+    return Status::Ok;
+  }
+
+ private:
+  void CompletionThread();
+
+  /// The Linux AIO context used for IO completions.
+  io_context_t io_object_;
+
+  std::atomic<bool> stop_;
+  std::vector<std::thread> threads_;
+  /// Signaled by the completion threads.
+  CompletionEvent completed_;
+};
+
+/// The ThreadPoolFile class encapsulates asynchronous reads and writes, whose completions are
+/// executed on the handler's completion threads.
+class ThreadPoolFile : public File {
+ public:
+  ThreadPoolFile()
+    : File()
+    , io_object_{ nullptr } {
+  }
+  ThreadPoolFile(const std::string& filename)
+    : File(filename)
+    , io_object_{ nullptr } {
+  }
+  /// Move constructor
+  ThreadPoolFile(ThreadPoolFile&& other)
+    : File(std::move(other))
+    , io_object_{ other.io_object_ } {
+  }
+  /// Move assignment operator.
+  ThreadPoolFile& operator=(ThreadPoolFile&& other) {
+    File::operator=(std::move(other));
+    io_object_ = other.io_object_;
+    return *this;
+  }
+
+  Status Open(FileCreateDisposition create_disposition, const FileOptions& options,
+              ThreadPoolIoHandler* handler, bool* exists = nullptr);
+
+  Status Read(size_t offset, uint32_t length, uint8_t* buffer,
+              IAsyncContext& context, AsyncIOCallback callback) const;
+  Status Write(size_t offset, uint32_t length, const uint8_t* buffer,
+               IAsyncContext& context, AsyncIOCallback callback);
+  /// Writes "count" buffers of "length" bytes each to consecutive offsets, starting at "offset",
+  /// as a single vectored I/O.
+  Status WriteGather(size_t offset, const uint8_t* const* buffers, uint32_t count,
+                     uint32_t length, IAsyncContext& context, AsyncIOCallback callback);
 
  private:
   Status ScheduleOperation(FileOperationType operationType, uint8_t* buffer, size_t offset,
@@ -250,5 +435,157 @@ class QueueFile : public File {
   io_context_t io_object_;
 };
 
+class UringFile;
+
+/// The UringIoHandler class encapsulates async file I/O through a Linux io_uring. Requests are
+/// batched in the ring's submission queue, and handed to the kernel with one system call per
+/// batch (or when TryComplete() is called); completions are reaped straight from the completion
+/// queue, which is shared memory, without any system calls.
+class UringIoHandler {
+ public:
+  typedef UringFile async_file_t;
+  /// Maximum number of I/Os in flight, unless the constructor is told otherwise.
+  constexpr static uint32_t kDefaultQueueDepth = 256;
+
+ private:
+  /// Submit the batched requests once this many have queued up.
+  constexpr static uint32_t kSubmitBatchSize = 32;
+  /// Reap at most this many completions per call to TryComplete().
+  constexpr static uint32_t kMaxCompletions = 32;
+
+ public:
+  UringIoHandler()
+    : ring_fd_{ -1 }
+    , sq_ring_{ nullptr }
+    , cq_ring_{ nullptr }
+    , sqes_{ nullptr }
+    , sq_ring_size_{ 0 }
+    , cq_ring_size_{ 0 }
+    , sqes_size_{ 0 }
+    , wait_timeout_supported_{ false }
+    , unsubmitted_{ 0 } {
+  }
+  UringIoHandler(size_t max_threads, uint32_t queue_depth = kDefaultQueueDepth);
+
+  /// Move constructor
+  UringIoHandler(UringIoHandler&& other);
+
+  ~UringIoHandler();
+
+  struct IoCallbackContext {
+    IoCallbackContext(IAsyncContext* context_, AsyncIOCallback callback_)
+      : caller_context{ context_ }
+      , callback{ callback_ } {
+    }
+
+    /// Caller callback context.
+    IAsyncContext* caller_context;
+
+    /// The caller's asynchronous callback function
+    AsyncIOCallback callback;
+  };
+
+  /// Registers a buffer with the kernel, so that reads and writes that fall inside it don't have
+  /// to map the buffer's pages for each I/O. Best called before issuing any I/O: re-registering
+  /// waits for the I/Os in flight.
+  Status RegisterBuffer(uint8_t* buffer, uint64_t size);
+
+  /// Adds a request to the submission queue; the request is submitted with the next batch.
+  Status Submit(FileOperationType operation, int fd, uint8_t* buffer, size_t offset,
+                uint32_t length, IoCallbackContext* context);
+  /// Adds a gather write of the "count" buffers in "iov", which must outlive the request.
+  Status SubmitWriteGather(int fd, const struct iovec* iov, uint32_t count, size_t offset,
+                           IoCallbackContext* context);
+  /// Submits any batched requests to the kernel.
+  Status Flush();
+
+  /// Submits any batched requests, and then executes the I/O completions on the queue, if any.
+  bool TryComplete();
+  /// Like TryComplete(), but if nothing has completed, waits up to "timeout_us" microseconds for
+  /// a completion. (Kernels older than 5.11 can't bound the wait, so there it doesn't wait.)
+  bool WaitForCompletion(uint32_t timeout_us);
+
+ private:
+  /// Call with sq_mutex_ held.
+  Status EnqueueLocked(uint8_t opcode, uint16_t buf_index, int fd, uint64_t addr,
+                       uint32_t length, size_t offset, IoCallbackContext* context);
+  /// Call with sq_mutex_ held.
+  Status FlushLocked(uint32_t flags);
+
+  int ring_fd_;
+
+  /// The rings and the submission queue entries, mapped from the kernel.
+  uint8_t* sq_ring_;
+  uint8_t* cq_ring_;
+  struct io_uring_sqe* sqes_;
+  size_t sq_ring_size_;
+  size_t cq_ring_size_;
+  size_t sqes_size_;
+  /// Whether io_uring_enter() takes a timeout (IORING_FEAT_EXT_ARG).
+  bool wait_timeout_supported_;
+
+  /// Submission queue; protected by sq_mutex_.
+  uint32_t* sq_head_;
+  uint32_t* sq_tail_;
+  uint32_t* sq_flags_;
+  uint32_t* sq_array_;
+  uint32_t sq_mask_;
+  uint32_t sq_entries_;
+  std::mutex sq_mutex_;
+  /// Number of requests queued but not yet submitted.
+  std::atomic<uint32_t> unsubmitted_;
+
+  /// Completion queue; protected by cq_mutex_.
+  uint32_t* cq_head_;
+  uint32_t* cq_tail_;
+  struct io_uring_cqe* cqes_;
+  uint32_t cq_mask_;
+  std::mutex cq_mutex_;
+
+  std::vector<struct iovec> registered_buffers_;
+};
+
+/// The UringFile class encapsulates asynchronous reads and writes, through an io_uring.
+class UringFile : public File {
+ public:
+  UringFile()
+    : File()
+    , handler_{ nullptr } {
+  }
+  UringFile(const std::string& filename)
+    : File(filename)
+    , handler_{ nullptr } {
+  }
+  /// Move constructor
+  UringFile(UringFile&& other)
+    : File(std::move(other))
+    , handler_{ other.handler_ } {
+  }
+  /// Move assignment operator.
+  UringFile& operator=(UringFile&& other) {
+    File::operator=(std::move(other));
+    handler_ = other.handler_;
+    return *this;
+  }
+
+  Status Open(FileCreateDisposition create_disposition, const FileOptions& options,
+              UringIoHandler* handler, bool* exists = nullptr);
+
+  Status Read(size_t offset, uint32_t length, uint8_t* buffer,
+              IAsyncContext& context, AsyncIOCallback callback) const;
+  Status Write(size_t offset, uint32_t length, const uint8_t* buffer,
+               IAsyncContext& context, AsyncIOCallback callback);
+  /// Writes "count" buffers of "length" bytes each to consecutive offsets, starting at "offset",
+  /// as a single vectored I/O.
+  Status WriteGather(size_t offset, const uint8_t* const* buffers, uint32_t count,
+                     uint32_t length, IAsyncContext& context, AsyncIOCallback callback);
+
+ private:
+  Status ScheduleOperation(FileOperationType operationType, uint8_t* buffer, size_t offset,
+                           uint32_t length, IAsyncContext& context, AsyncIOCallback callback);
+
+  UringIoHandler* handler_;
+};
+
 }
 } // namespace FASTER::environment
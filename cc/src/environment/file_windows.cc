@@ -1,6 +1,7 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT license.
 
+#include <atomic>
 #include <cassert>
 #include <iomanip>
 #include <sstream>
@@ -18,6 +19,85 @@ std::string FormatWin32AndHRESULT(DWORD win32_result) {
   return ss.str();
 }
 
+/// The state shared by the writes that make up a gather write.
+struct GatherState {
+  GatherState(uint32_t count, IAsyncContext* caller_context_, AsyncIOCallback callback_,
+              size_t bytes_)
+    : remaining{ count }
+    , failed{ false }
+    , caller_context{ caller_context_ }
+    , callback{ callback_ }
+    , bytes{ bytes_ } {
+  }
+
+  std::atomic<uint32_t> remaining;
+  std::atomic<bool> failed;
+  IAsyncContext* caller_context;
+  AsyncIOCallback callback;
+  size_t bytes;
+};
+
+/// Accounts for "num_writes" finished writes; the last one invokes the caller's callback.
+static void FinishGatherWrites(GatherState* state, uint32_t num_writes, Status result) {
+  if(result != Status::Ok) {
+    state->failed = true;
+  }
+  if(state->remaining.fetch_sub(num_writes) == num_writes) {
+    state->callback(state->caller_context, state->failed ? Status::IOError : Status::Ok,
+                    state->failed ? 0 : state->bytes);
+    delete state;
+  }
+}
+
+/// WriteFileGather() wants one system page per buffer, which FASTER's pages aren't; so a gather
+/// write is issued as one write per buffer, and completes when the last of them does.
+template <class F>
+static Status WriteEachBuffer(F& file, size_t offset, const uint8_t* const* buffers,
+                              uint32_t count, uint32_t length, IAsyncContext& context,
+                              AsyncIOCallback callback) {
+  class Context : public IAsyncContext {
+   public:
+    Context(GatherState* state_)
+      : state{ state_ } {
+    }
+    /// The deep-copy constructor
+    Context(const Context& other)
+      : state{ other.state } {
+    }
+   protected:
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) final {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+   public:
+    GatherState* state;
+  };
+
+  auto write_callback = [](IAsyncContext* ctxt, Status result, size_t bytes_transferred) {
+    CallbackContext<Context> context{ ctxt };
+    FinishGatherWrites(context->state, 1, result);
+  };
+
+  IAsyncContext* caller_context_copy;
+  RETURN_NOT_OK(context.DeepCopy(caller_context_copy));
+  GatherState* state = new GatherState{ count, caller_context_copy, callback,
+                                        static_cast<size_t>(count) * length };
+  for(uint32_t idx = 0; idx < count; ++idx) {
+    Context write_context{ state };
+    Status result = file.Write(offset + static_cast<size_t>(idx) * length, length, buffers[idx],
+                               write_context, write_callback);
+    if(result != Status::Ok) {
+      if(idx == 0) {
+        delete state;
+        return result;
+      }
+      // Some writes are in flight; the callback reports the failure.
+      FinishGatherWrites(state, count - idx, result);
+      break;
+    }
+  }
+  return Status::Ok;
+}
+
 #ifdef _DEBUG
 #define DCHECK_ALIGNMENT(o, l, b) \
 do { \
@@ -114,7 +194,7 @@ DWORD File::GetCreateDisposition(FileCreateDisposition create_disposition) {
 
 void CALLBACK ThreadPoolIoHandler::IoCompletionCallback(PTP_CALLBACK_INSTANCE instance,
     PVOID context, PVOID overlapped, ULONG ioResult, ULONG_PTR bytesTransferred, PTP_IO io) {
-  // context is always nullptr; state is threaded via the OVERLAPPED
+  // context is the handler; per-operation state is threaded via the OVERLAPPED
   auto callback_context = make_context_unique_ptr<IoCallbackContext>(
                             reinterpret_cast<IoCallbackContext*>(overlapped));
 
@@ -127,6 +207,7 @@ void CALLBACK ThreadPoolIoHandler::IoCompletionCallback(PTP_CALLBACK_INSTANCE in
   }
   callback_context->callback(callback_context->caller_context, return_status,
                              static_cast<size_t>(bytesTransferred));
+  reinterpret_cast<ThreadPoolIoHandler*>(context)->completed_.Notify(1);
 }
 
 WindowsPtpThreadPool::WindowsPtpThreadPool(size_t max_threads)
@@ -207,7 +288,7 @@ Status ThreadPoolFile::Open(FileCreateDisposition create_disposition, const File
     return Status::Ok;
   }
 
-  io_object_ = ::CreateThreadpoolIo(file_handle_, handler->IoCompletionCallback, nullptr,
+  io_object_ = ::CreateThreadpoolIo(file_handle_, handler->IoCompletionCallback, handler,
                                     handler->callback_environment());
   if(!io_object_) {
     Close();
@@ -237,6 +318,12 @@ Status ThreadPoolFile::Write(size_t offset, uint32_t length, const uint8_t* buff
                            context, callback);
 }
 
+Status ThreadPoolFile::WriteGather(size_t offset, const uint8_t* const* buffers, uint32_t count,
+                                   uint32_t length, IAsyncContext& context,
+                                   AsyncIOCallback callback) {
+  return WriteEachBuffer(*this, offset, buffers, count, length, context, callback);
+}
+
 Status ThreadPoolFile::ScheduleOperation(FileOperationType operationType, uint8_t* buffer,
     size_t offset, uint32_t length, IAsyncContext& context, AsyncIOCallback callback) {
   auto io_context = alloc_context<ThreadPoolIoHandler::IoCallbackContext>(sizeof(
@@ -274,11 +361,16 @@ Status ThreadPoolFile::ScheduleOperation(FileOperationType operationType, uint8_
 }
 
 bool QueueIoHandler::TryComplete() {
+  return WaitForCompletion(0);
+}
+
+bool QueueIoHandler::WaitForCompletion(uint32_t timeout_us) {
   DWORD bytes_transferred;
   ULONG_PTR completion_key;
   LPOVERLAPPED overlapped = NULL;
+  DWORD timeout_ms = (timeout_us + 999) / 1000;
   bool succeeded = ::GetQueuedCompletionStatus(io_completion_port_, &bytes_transferred,
-                   &completion_key, &overlapped, 0);
+                   &completion_key, &overlapped, timeout_ms);
   if(overlapped) {
     Status return_status;
     if(!succeeded) {
@@ -331,6 +423,11 @@ Status QueueFile::Write(size_t offset, uint32_t length, const uint8_t* buffer,
                            context, callback);
 }
 
+Status QueueFile::WriteGather(size_t offset, const uint8_t* const* buffers, uint32_t count,
+                              uint32_t length, IAsyncContext& context, AsyncIOCallback callback) {
+  return WriteEachBuffer(*this, offset, buffers, count, length, context, callback);
+}
+
 Status QueueFile::ScheduleOperation(FileOperationType operationType, uint8_t* buffer,
                                     size_t offset, uint32_t length, IAsyncContext& context,
                                     AsyncIOCallback callback) {
@@ -221,12 +221,15 @@ class QueueFile;
 class ThreadPoolIoHandler {
  public:
   typedef ThreadPoolFile async_file_t;
+  /// Windows I/O has no fixed queue depth.
+  constexpr static uint32_t kDefaultQueueDepth = 0;
 
   ThreadPoolIoHandler()
     : threadpool_{} {
   }
 
-  ThreadPoolIoHandler(size_t max_threads)
+  /// The thread pool bounds the I/Os in flight by itself, so "queue_depth" is unused.
+  ThreadPoolIoHandler(size_t max_threads, uint32_t queue_depth = kDefaultQueueDepth)
     : threadpool_{ max_threads } {
   }
 
@@ -269,10 +272,23 @@ class ThreadPoolIoHandler {
   inline static constexpr bool TryComplete() {
     return false;
   }
+  /// Completions are executed on the thread pool's threads; waits up to "timeout_us"
+  /// microseconds for one of them to execute a completion.
+  inline bool WaitForCompletion(uint32_t timeout_us) {
+    return completed_.WaitFor(timeout_us);
+  }
+  inline static constexpr Status Flush() {
+    return Status::Ok;
+  }
+  inline static constexpr Status RegisterBuffer(uint8_t*, uint64_t) {
+    return Status::Ok;
+  }
 
  private:
   /// The parent threadpool.
   WindowsPtpThreadPool threadpool_;
+  /// Signaled by the thread pool's threads.
+  CompletionEvent completed_;
 };
 
 /// The QueueIoHandler class encapsulates completions for async file I/O, where the completions
@@ -280,14 +296,17 @@ class ThreadPoolIoHandler {
 class QueueIoHandler {
  public:
   typedef QueueFile async_file_t;
+  /// Windows I/O has no fixed queue depth.
+  constexpr static uint32_t kDefaultQueueDepth = 0;
 
   QueueIoHandler()
     : io_completion_port_{ INVALID_HANDLE_VALUE } {
   }
-  QueueIoHandler(size_t max_threads)
+  /// A completion port doesn't bound the I/Os in flight, so "queue_depth" is unused.
+  QueueIoHandler(size_t max_threads, uint32_t queue_depth = kDefaultQueueDepth)
     : io_completion_port_{ 0 } {
     io_completion_port_ = ::CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0,
-                          (DWORD)Thread::kMaxNumThreads);
+                          (DWORD)Thread::kDefaultMaxNumThreads);
   }
 
   /// Move constructor
@@ -329,6 +348,16 @@ class QueueIoHandler {
   };
 
   bool TryComplete();
+  /// Like TryComplete(), but if nothing has completed, waits up to "timeout_us" microseconds
+  /// (rounded up to milliseconds) for a completion.
+  bool WaitForCompletion(uint32_t timeout_us);
+  /// Requests are submitted as they're issued; there's no batch to flush.
+  inline static constexpr Status Flush() {
+    return Status::Ok;
+  }
+  inline static constexpr Status RegisterBuffer(uint8_t*, uint64_t) {
+    return Status::Ok;
+  }
 
  private:
   /// The completion port to whose queue completions are added.
@@ -369,6 +398,10 @@ class ThreadPoolFile : public File {
               IAsyncContext& context, AsyncIOCallback callback) const;
   Status Write(size_t offset, uint32_t length, const uint8_t* buffer,
                IAsyncContext& context, AsyncIOCallback callback);
+  /// Writes "count" buffers of "length" bytes each to consecutive offsets, starting at "offset";
+  /// the callback is invoked once, when all have been written.
+  Status WriteGather(size_t offset, const uint8_t* const* buffers, uint32_t count,
+                     uint32_t length, IAsyncContext& context, AsyncIOCallback callback);
 
  private:
   Status ScheduleOperation(FileOperationType operationType, uint8_t* buffer, size_t offset,
@@ -405,6 +438,10 @@ class QueueFile : public File {
               IAsyncContext& context, AsyncIOCallback callback) const;
   Status Write(size_t offset, uint32_t length, const uint8_t* buffer,
                IAsyncContext& context, AsyncIOCallback callback);
+  /// Writes "count" buffers of "length" bytes each to consecutive offsets, starting at "offset";
+  /// the callback is invoked once, when all have been written.
+  Status WriteGather(size_t offset, const uint8_t* const* buffers, uint32_t count,
+                     uint32_t length, IAsyncContext& context, AsyncIOCallback callback);
 
  private:
   Status ScheduleOperation(FileOperationType operationType, uint8_t* buffer, size_t offset,
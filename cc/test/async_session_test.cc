@@ -0,0 +1,373 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <experimental/filesystem>
+#include "gtest/gtest.h"
+#include "core/async_session.h"
+#include "core/faster.h"
+#include "device/file_system_disk.h"
+#include "device/null_disk.h"
+
+using namespace FASTER::core;
+
+TEST(AsyncSession, UpsertDeleteRead_InMemory) {
+  class Key {
+   public:
+    Key(uint64_t key)
+      : key_{ key } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      std::hash<uint64_t> hash_fn;
+      return KeyHash{ hash_fn(key_) };
+    }
+
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return key_ == other.key_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return key_ != other.key_;
+    }
+
+   private:
+    uint64_t key_;
+  };
+
+  class Value {
+   public:
+    Value()
+      : value_{ 0 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Value));
+    }
+
+    std::atomic<uint64_t> value_;
+  };
+
+  /// Contexts awaited through an AsyncSession needn't derive from IAsyncContext.
+  class UpsertContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    UpsertContext(uint64_t key, uint64_t value)
+      : key_{ key }
+      , value_{ value } {
+    }
+
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    inline void Put(Value& value) {
+      value.value_ = value_;
+    }
+    inline bool PutAtomic(Value& value) {
+      value.value_.store(value_);
+      return true;
+    }
+
+   private:
+    Key key_;
+    uint64_t value_;
+  };
+
+  class DeleteContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    DeleteContext(uint64_t key)
+      : key_{ key } {
+    }
+
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+
+   private:
+    Key key_;
+  };
+
+  class ReadContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    ReadContext(uint64_t key)
+      : key_{ key }
+      , output{ 0 } {
+    }
+
+    inline const Key& key() const {
+      return key_;
+    }
+    inline void Get(const Value& value) {
+      output = value.value_.load();
+    }
+    inline void GetAtomic(const Value& value) {
+      output = value.value_.load();
+    }
+
+   private:
+    Key key_;
+   public:
+    uint64_t output;
+  };
+
+  typedef FasterKv<Key, Value, FASTER::device::NullDisk> store_t;
+  typedef AsyncSession<store_t> session_t;
+
+  class Tasks {
+   public:
+    static Task UpsertDeleteRead(session_t& session, uint64_t first, uint64_t count,
+                                 std::atomic<uint64_t>& num_done) {
+      for(uint64_t key = first; key < first + count; ++key) {
+        UpsertContext context{ key, key * 3 };
+        Status result = co_await session.UpsertAsync(context);
+        EXPECT_EQ(Status::Ok, result);
+      }
+      for(uint64_t key = first; key < first + count; key += 2) {
+        DeleteContext context{ key };
+        Status result = co_await session.DeleteAsync(context);
+        EXPECT_EQ(Status::Ok, result);
+      }
+      for(uint64_t key = first; key < first + count; ++key) {
+        ReadContext context{ key };
+        Status result = co_await session.ReadAsync(context);
+        if(key % 2 == 0) {
+          EXPECT_EQ(Status::NotFound, result);
+        } else {
+          EXPECT_EQ(Status::Ok, result);
+          EXPECT_EQ(key * 3, context.output);
+        }
+      }
+      ++num_done;
+    }
+  };
+
+  store_t store{ 128, 1073741824, "" };
+
+  static constexpr uint64_t kNumTasks = 256;
+  static constexpr uint64_t kKeysPerTask = 1000;
+  std::atomic<uint64_t> num_done{ 0 };
+  {
+    session_t session{ store };
+    for(uint64_t idx = 0; idx < kNumTasks; ++idx) {
+      session.Spawn(Tasks::UpsertDeleteRead(session, idx * kKeysPerTask, kKeysPerTask,
+                                            num_done));
+    }
+    // Nothing went pending, so every task ran to completion when it was spawned.
+    ASSERT_EQ(0, session.num_tasks());
+    session.Run();
+  }
+  ASSERT_EQ(kNumTasks, num_done.load());
+}
+
+TEST(AsyncSession, UpsertRmwRead_Paging) {
+  class Key {
+   public:
+    Key(uint64_t key)
+      : key_{ key } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      std::hash<uint64_t> hash_fn;
+      return KeyHash{ hash_fn(key_) };
+    }
+
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return key_ == other.key_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return key_ != other.key_;
+    }
+
+   private:
+    uint64_t key_;
+  };
+
+  class Value {
+   public:
+    Value()
+      : count_{ 0 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Value));
+    }
+
+    std::atomic<uint64_t> count_;
+    uint8_t padding_[1016];
+  };
+  static_assert(sizeof(Value) == 1024, "sizeof(Value) != 1024");
+
+  class UpsertContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    UpsertContext(uint64_t key)
+      : key_{ key }
+      , count_{ key } {
+    }
+
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    inline void Put(Value& value) {
+      value.count_ = count_;
+    }
+    inline bool PutAtomic(Value& value) {
+      value.count_.store(count_);
+      return true;
+    }
+
+   private:
+    Key key_;
+    uint64_t count_;
+  };
+
+  class RmwContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    RmwContext(uint64_t key)
+      : key_{ key } {
+    }
+
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    inline static constexpr uint32_t value_size(const Value& old_value) {
+      return sizeof(value_t);
+    }
+    inline void RmwInitial(Value& value) {
+      value.count_ = 1;
+    }
+    inline void RmwCopy(const Value& old_value, Value& value) {
+      value.count_ = old_value.count_.load() + 1;
+    }
+    inline bool RmwAtomic(Value& value) {
+      ++value.count_;
+      return true;
+    }
+
+   private:
+    Key key_;
+  };
+
+  class ReadContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    ReadContext(uint64_t key)
+      : key_{ key }
+      , output{ 0 } {
+    }
+
+    inline const Key& key() const {
+      return key_;
+    }
+    inline void Get(const Value& value) {
+      output = value.count_.load();
+    }
+    inline void GetAtomic(const Value& value) {
+      output = value.count_.load();
+    }
+
+   private:
+    Key key_;
+   public:
+    uint64_t output;
+  };
+
+  typedef FASTER::environment::QueueIoHandler handler_t;
+  typedef FASTER::device::FileSystemDisk<handler_t, 1073741824L> disk_t;
+  typedef FasterKv<Key, Value, disk_t> store_t;
+  typedef AsyncSession<store_t> session_t;
+
+  class Tasks {
+   public:
+    static Task Upsert(session_t& session, uint64_t first, uint64_t count) {
+      for(uint64_t key = first; key < first + count; ++key) {
+        UpsertContext context{ key };
+        Status result = co_await session.UpsertAsync(context);
+        EXPECT_EQ(Status::Ok, result);
+      }
+    }
+    static Task RmwRead(session_t& session, uint64_t first, uint64_t count,
+                        std::atomic<uint64_t>& num_read) {
+      for(uint64_t key = first; key < first + count; ++key) {
+        RmwContext context{ key };
+        Status result = co_await session.RmwAsync(context);
+        EXPECT_EQ(Status::Ok, result);
+      }
+      for(uint64_t key = first; key < first + count; ++key) {
+        ReadContext context{ key };
+        Status result = co_await session.ReadAsync(context);
+        EXPECT_EQ(Status::Ok, result);
+        EXPECT_EQ(key + 1, context.output);
+        ++num_read;
+      }
+    }
+  };
+
+  std::experimental::filesystem::create_directories("logs");
+
+  // 8 pages!
+  store_t store{ 262144, 268435456, "logs", 0.5 };
+
+  static constexpr uint64_t kNumRecords = 250000;
+  static constexpr uint64_t kNumTasks = 1000;
+  static constexpr uint64_t kKeysPerTask = kNumRecords / kNumTasks;
+  std::atomic<uint64_t> num_read{ 0 };
+  {
+    session_t session{ store };
+    session.Spawn(Tasks::Upsert(session, 0, kNumRecords));
+    session.Run();
+
+    // Most of the records are on disk, so the tasks keep many reads in flight at once.
+    for(uint64_t idx = 0; idx < kNumTasks; ++idx) {
+      session.Spawn(Tasks::RmwRead(session, idx * kKeysPerTask, kKeysPerTask, num_read));
+    }
+    ASSERT_GT(session.num_tasks(), 0);
+    session.Run();
+    ASSERT_EQ(0, session.num_tasks());
+  }
+  ASSERT_EQ(kNumRecords, num_read.load());
+  ASSERT_GT(store.GetStatistics().ops.pending, 0);
+
+  std::experimental::filesystem::remove_all("logs");
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
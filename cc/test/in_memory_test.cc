@@ -6,6 +6,7 @@
 #include <deque>
 #include <functional>
 #include <thread>
+#include <vector>
 #include "gtest/gtest.h"
 
 #include "core/faster.h"
@@ -199,6 +200,199 @@ TEST(InMemFaster, UpsertRead) {
   store.StopSession();
 }
 
+TEST(InMemFaster, UpsertRead_MemoryPolicy) {
+  class alignas(2) Key {
+   public:
+    Key(uint8_t key)
+      : key_{ key } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      std::hash<uint8_t> hash_fn;
+      return KeyHash{ hash_fn(key_) };
+    }
+
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return key_ == other.key_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return key_ != other.key_;
+    }
+
+   private:
+    uint8_t key_;
+  };
+
+  class UpsertContext;
+  class ReadContext;
+
+  class Value {
+   public:
+    Value()
+      : value_{ 0 } {
+    }
+    Value(const Value& other)
+      : value_{ other.value_ } {
+    }
+    Value(uint8_t value)
+      : value_{ value } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Value));
+    }
+
+    friend class UpsertContext;
+    friend class ReadContext;
+
+   private:
+    union {
+      uint8_t value_;
+      std::atomic<uint8_t> atomic_value_;
+    };
+  };
+
+  class UpsertContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    UpsertContext(uint8_t key)
+      : key_{ key } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    UpsertContext(const UpsertContext& other)
+      : key_{ other.key_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    /// Non-atomic and atomic Put() methods.
+    inline void Put(Value& value) {
+      value.value_ = 23;
+    }
+    inline bool PutAtomic(Value& value) {
+      value.atomic_value_.store(42);
+      return true;
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+  };
+
+  class ReadContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    ReadContext(uint8_t key)
+      : key_{ key } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    ReadContext(const ReadContext& other)
+      : key_{ other.key_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+
+    inline void Get(const Value& value) {
+      // All reads should be atomic (from the mutable tail).
+      ASSERT_TRUE(false);
+    }
+    inline void GetAtomic(const Value& value) {
+      output = value.atomic_value_.load();
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+   public:
+    uint8_t output;
+  };
+
+  // Huge pages and NUMA placement are best effort, so the store works wherever the test runs.
+  MemoryPolicy log_memory{ MemoryPolicy::PageSize::Huge2MB, MemoryPolicy::Numa::Default, 0,
+                           true };
+  MemoryPolicy index_memory{ MemoryPolicy::PageSize::Transparent,
+                             MemoryPolicy::Numa::Interleave };
+  FasterKv<Key, Value, FASTER::device::NullDisk> store { 128, 268435456, "", 0.9, false,
+      Thread::DefaultMaxNumThreads(), log_memory, index_memory };
+
+  store.StartSession();
+
+  // Insert.
+  for(size_t idx = 0; idx < 256; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // In-memory test.
+      ASSERT_TRUE(false);
+    };
+    UpsertContext context{ static_cast<uint8_t>(idx) };
+    Status result = store.Upsert(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  // Read.
+  for(size_t idx = 0; idx < 256; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // In-memory test.
+      ASSERT_TRUE(false);
+    };
+    ReadContext context{ static_cast<uint8_t>(idx) };
+    Status result = store.Read(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+    // All upserts should have inserts (non-atomic).
+    ASSERT_EQ(23, context.output);
+  }
+  // Update.
+  for(size_t idx = 0; idx < 256; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // In-memory test.
+      ASSERT_TRUE(false);
+    };
+    UpsertContext context{ static_cast<uint8_t>(idx) };
+    Status result = store.Upsert(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  // Read again.
+  for(size_t idx = 0; idx < 256; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // In-memory test.
+      ASSERT_TRUE(false);
+    };
+    ReadContext context{ static_cast<uint8_t>(idx) };
+    Status result = store.Read(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+    // All upserts should have updates (atomic).
+    ASSERT_EQ(42, context.output);
+  }
+
+  store.StopSession();
+}
+
 /// The hash always returns "0," so the FASTER store devolves into a linked list.
 TEST(InMemFaster, UpsertRead_DummyHash) {
   class UpsertContext;
@@ -1322,7 +1516,7 @@ TEST(InMemFaster, Rmw_Concurrent) {
   store.StopSession();
 }
 
-TEST(InMemFaster, Rmw_ResizeValue_Concurrent) {
+TEST(InMemFaster, Rmw_ManyThreads) {
   class Key {
    public:
     Key(uint64_t key)
@@ -1352,56 +1546,272 @@ TEST(InMemFaster, Rmw_ResizeValue_Concurrent) {
   class RmwContext;
   class ReadContext;
 
-  class GenLock {
+  class Value {
    public:
-    GenLock()
-      : control_{ 0 } {
+    Value()
+      : value_{ 0 } {
     }
-    GenLock(uint64_t control)
-      : control_{ control } {
+    Value(const Value& other)
+      : value_{ other.value_ } {
     }
-    inline GenLock& operator=(const GenLock& other) {
-      control_ = other.control_;
-      return *this;
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Value));
     }
 
+    friend class RmwContext;
+    friend class ReadContext;
+
+   private:
     union {
-        struct {
-          uint64_t gen_number : 62;
-          uint64_t locked : 1;
-          uint64_t replaced : 1;
-        };
-        uint64_t control_;
-      };
+      int64_t value_;
+      std::atomic<int64_t> atomic_value_;
+    };
   };
-  static_assert(sizeof(GenLock) == 8, "sizeof(GenLock) != 8");
 
-  class AtomicGenLock {
+  class RmwContext : public IAsyncContext {
    public:
-    AtomicGenLock()
-      : control_{ 0 } {
+    typedef Key key_t;
+    typedef Value value_t;
+
+    RmwContext(uint64_t key, int64_t incr)
+      : key_{ key }
+      , incr_{ incr } {
     }
-    AtomicGenLock(uint64_t control)
-      : control_{ control } {
+
+    /// Copy (and deep-copy) constructor.
+    RmwContext(const RmwContext& other)
+      : key_{ other.key_ }
+      , incr_{ other.incr_ } {
     }
 
-    inline GenLock load() const {
-      return GenLock{ control_.load() };
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
     }
-    inline void store(GenLock desired) {
-      control_.store(desired.control_);
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    inline static constexpr uint32_t value_size(const Value& old_value) {
+      return sizeof(value_t);
     }
 
-    inline bool try_lock(bool& replaced) {
-      replaced = false;
-      GenLock expected{ control_.load() };
-      expected.locked = 0;
-      expected.replaced = 0;
-      GenLock desired{ expected.control_ };
-      desired.locked = 1;
-
-      if(control_.compare_exchange_strong(expected.control_, desired.control_)) {
-        return true;
+    inline void RmwInitial(Value& value) {
+      value.value_ = incr_;
+    }
+    inline void RmwCopy(const Value& old_value, Value& value) {
+      value.value_ = old_value.value_ + incr_;
+    }
+    inline bool RmwAtomic(Value& value) {
+      value.atomic_value_.fetch_add(incr_);
+      return true;
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    int64_t incr_;
+    Key key_;
+  };
+
+  class ReadContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    ReadContext(uint64_t key)
+      : key_{ key } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    ReadContext(const ReadContext& other)
+      : key_{ other.key_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+
+    inline void Get(const Value& value) {
+      // All reads should be atomic (from the mutable tail).
+      ASSERT_TRUE(false);
+    }
+    inline void GetAtomic(const Value& value) {
+      output = value.atomic_value_.load();
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+   public:
+    int64_t output;
+  };
+
+  typedef FasterKv<Key, Value, FASTER::device::NullDisk> store_t;
+
+  // More threads than the store used to allow, all with sessions at once.
+  static constexpr size_t kNumThreads = 160;
+  static constexpr size_t kNumRmws = 2048;
+  static constexpr size_t kRange = 512;
+
+  static std::atomic<size_t> num_started{ 0 };
+  auto rmw_worker = [](store_t* store_, int64_t incr) {
+    store_->StartSession();
+    // IDs are handed out lowest first.
+    ASSERT_LT(Thread::id(), kNumThreads + 1);
+    // Wait until every thread has started its session.
+    ++num_started;
+    while(num_started.load() < kNumThreads) {
+      store_->Refresh();
+      std::this_thread::yield();
+    }
+
+    for(size_t idx = 0; idx < kNumRmws; ++idx) {
+      auto callback = [](IAsyncContext* ctxt, Status result) {
+        // In-memory test.
+        ASSERT_TRUE(false);
+      };
+      RmwContext context{ idx % kRange, incr };
+      Status result = store_->Rmw(context, callback, 1);
+      ASSERT_EQ(Status::Ok, result);
+    }
+
+    store_->StopSession();
+  };
+
+  store_t store{ 256, 1073741824, "", 0.9, false, 256 };
+
+  std::deque<std::thread> threads{};
+  for(int64_t idx = 0; idx < kNumThreads; ++idx) {
+    threads.emplace_back(rmw_worker, &store, 1);
+  }
+  for(auto& thread : threads) {
+    thread.join();
+  }
+
+  store.StartSession();
+  for(size_t idx = 0; idx < kRange; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // In-memory test.
+      ASSERT_TRUE(false);
+    };
+    ReadContext context{ idx };
+    Status result = store.Read(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result) << idx;
+    ASSERT_EQ(kNumThreads * (kNumRmws / kRange), context.output);
+  }
+  store.StopSession();
+
+  // Short-lived threads reuse the IDs of threads that have exited, so they fit in a store with
+  // room for only a few threads.
+  store_t small_store{ 256, 1073741824, "", 0.9, false, 4 };
+  for(size_t idx = 0; idx < 1000; ++idx) {
+    std::thread thread{ [](store_t* store_) {
+        store_->StartSession();
+        ASSERT_LT(Thread::id(), 4);
+        RmwContext context{ 0, 1 };
+        ASSERT_EQ(Status::Ok, store_->Rmw(context, nullptr, 1));
+        store_->StopSession();
+      }, &small_store };
+    thread.join();
+  }
+  small_store.StartSession();
+  ReadContext context{ 0 };
+  ASSERT_EQ(Status::Ok, small_store.Read(context, nullptr, 1));
+  ASSERT_EQ(1000, context.output);
+  small_store.StopSession();
+}
+
+TEST(InMemFaster, Rmw_ResizeValue_Concurrent) {
+  class Key {
+   public:
+    Key(uint64_t key)
+      : key_{ key } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      std::hash<uint64_t> hash_fn;
+      return KeyHash{ hash_fn(key_) };
+    }
+
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return key_ == other.key_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return key_ != other.key_;
+    }
+
+   private:
+    uint64_t key_;
+  };
+
+  class RmwContext;
+  class ReadContext;
+
+  class GenLock {
+   public:
+    GenLock()
+      : control_{ 0 } {
+    }
+    GenLock(uint64_t control)
+      : control_{ control } {
+    }
+    inline GenLock& operator=(const GenLock& other) {
+      control_ = other.control_;
+      return *this;
+    }
+
+    union {
+        struct {
+          uint64_t gen_number : 62;
+          uint64_t locked : 1;
+          uint64_t replaced : 1;
+        };
+        uint64_t control_;
+      };
+  };
+  static_assert(sizeof(GenLock) == 8, "sizeof(GenLock) != 8");
+
+  class AtomicGenLock {
+   public:
+    AtomicGenLock()
+      : control_{ 0 } {
+    }
+    AtomicGenLock(uint64_t control)
+      : control_{ control } {
+    }
+
+    inline GenLock load() const {
+      return GenLock{ control_.load() };
+    }
+    inline void store(GenLock desired) {
+      control_.store(desired.control_);
+    }
+
+    inline bool try_lock(bool& replaced) {
+      replaced = false;
+      GenLock expected{ control_.load() };
+      expected.locked = 0;
+      expected.replaced = 0;
+      GenLock desired{ expected.control_ };
+      desired.locked = 1;
+
+      if(control_.compare_exchange_strong(expected.control_, desired.control_)) {
+        return true;
       }
       if(expected.replaced) {
         replaced = true;
@@ -2148,257 +2558,1754 @@ TEST(InMemFaster, GrowHashTable) {
   store.StopSession();
 }
 
-TEST(InMemFaster, UpsertRead_VariableLengthKey) {
+TEST(InMemFaster, AutoGrowIndex) {
   class Key {
-  public:
-      /// This constructor is called when creating a Context so we keep track of memory containing key
-      Key(const uint16_t* key, const uint64_t key_length)
-              : temp_buffer{ key }
-              , key_length_{ key_length } {
-      }
+   public:
+    Key(uint64_t key)
+      : key_{ key } {
+    }
 
-      /// This constructor is called when record is being allocated so we can freely copy into our buffer
-      Key(const Key& other) {
-        key_length_ = other.key_length_;
-        temp_buffer = NULL;
-        if (other.temp_buffer == NULL) {
-          memcpy(buffer(), other.buffer(), key_length_);
-        } else {
-          memcpy(buffer(), other.temp_buffer, key_length_);
-        }
-      }
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      return KeyHash{ Utility::GetHashCode(key_) };
+    }
 
-      /// This destructor ensures we don't leak memory due to Key objects not allocated on HybridLog
-      ~Key() {
-        if (this->temp_buffer != NULL) {
-          free((void*)temp_buffer);
-        }
-      }
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return key_ == other.key_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return key_ != other.key_;
+    }
 
-      /// Methods and operators required by the (implicit) interface:
-      inline uint32_t size() const {
-        return static_cast<uint32_t>(sizeof(Key) + key_length_);
-      }
-      inline KeyHash GetHash() const {
-        if (this->temp_buffer != NULL) {
-          return KeyHash(Utility::HashBytes(temp_buffer, key_length_));
-        }
-        return KeyHash(Utility::HashBytes(buffer(), key_length_));
-      }
+   private:
+    uint64_t key_;
+  };
 
-      /// Comparison operators.
-      inline bool operator==(const Key& other) const {
-        if (this->key_length_ != other.key_length_) return false;
-        if (this->temp_buffer != NULL) {
-          return memcmp(temp_buffer, other.buffer(), key_length_) == 0;
-        }
-        return memcmp(buffer(), other.buffer(), key_length_) == 0;
-      }
-      inline bool operator!=(const Key& other) const {
-        if (this->key_length_ != other.key_length_) return true;
-        if (this->temp_buffer != NULL) {
-          return memcmp(temp_buffer, other.buffer(), key_length_) != 0;
-        }
-        return memcmp(buffer(), other.buffer(), key_length_) != 0;
-      }
-
-  private:
-      uint64_t key_length_;
-      const uint16_t* temp_buffer;
-
-      inline const uint16_t* buffer() const {
-        return reinterpret_cast<const uint16_t*>(this + 1);
-      }
-      inline uint16_t* buffer() {
-        return reinterpret_cast<uint16_t*>(this + 1);
-      }
-  };
-
-  class UpsertContext;
-  class ReadContext;
+  class UpsertContext;
+  class ReadContext;
 
   class Value {
-  public:
-      Value()
-              : value_{ 0 } {
-      }
-      Value(const Value& other)
-              : value_{ other.value_ } {
-      }
-      Value(uint8_t value)
-              : value_{ value } {
-      }
+   public:
+    Value()
+      : value_{ 0 } {
+    }
 
-      inline static constexpr uint32_t size() {
-        return static_cast<uint32_t>(sizeof(Value));
-      }
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Value));
+    }
 
-      friend class UpsertContext;
-      friend class ReadContext;
+    friend class UpsertContext;
+    friend class ReadContext;
 
-  private:
-      union {
-          uint8_t value_;
-          std::atomic<uint8_t> atomic_value_;
-      };
+   private:
+    union {
+      uint64_t value_;
+      std::atomic<uint64_t> atomic_value_;
+    };
   };
 
   class UpsertContext : public IAsyncContext {
-  public:
-      typedef Key key_t;
-      typedef Value value_t;
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
 
-      UpsertContext(uint16_t* key, uint64_t key_length)
-              : key_{ key, key_length } {
-      }
+    UpsertContext(uint64_t key)
+      : key_{ key }
+      , val_{ key * 3 } {
+    }
 
-      /// Copy (and deep-copy) constructor.
-      UpsertContext(const UpsertContext& other)
-              : key_{ other.key_ } {
-      }
+    /// Copy (and deep-copy) constructor.
+    UpsertContext(const UpsertContext& other)
+      : key_{ other.key_ }
+      , val_{ other.val_ } {
+    }
 
-      /// The implicit and explicit interfaces require a key() accessor.
-      inline const Key& key() const {
-        return key_;
-      }
-      inline static constexpr uint32_t value_size() {
-        return sizeof(value_t);
-      }
-      /// Non-atomic and atomic Put() methods.
-      inline void Put(Value& value) {
-        value.value_ = 23;
-      }
-      inline bool PutAtomic(Value& value) {
-        value.atomic_value_.store(42);
-        return true;
-      }
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    /// Non-atomic and atomic Put() methods.
+    inline void Put(Value& value) {
+      value.value_ = val_;
+    }
+    inline bool PutAtomic(Value& value) {
+      value.atomic_value_.store(val_);
+      return true;
+    }
 
-  protected:
-      /// The explicit interface requires a DeepCopy_Internal() implementation.
-      Status DeepCopy_Internal(IAsyncContext*& context_copy) {
-        return IAsyncContext::DeepCopy_Internal(*this, context_copy);
-      }
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
 
-  private:
-      Key key_;
+   private:
+    Key key_;
+    uint64_t val_;
   };
 
   class ReadContext : public IAsyncContext {
-  public:
-      typedef Key key_t;
-      typedef Value value_t;
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
 
-      ReadContext(uint16_t* key, uint64_t key_length)
-              : key_{ key, key_length } {
-      }
+    ReadContext(uint64_t key)
+      : key_{ key } {
+    }
 
-      /// Copy (and deep-copy) constructor.
-      ReadContext(const ReadContext& other)
-              : key_{ other.key_ } {
-      }
+    /// Copy (and deep-copy) constructor.
+    ReadContext(const ReadContext& other)
+      : key_{ other.key_ } {
+    }
 
-      /// The implicit and explicit interfaces require a key() accessor.
-      inline const Key& key() const {
-        return key_;
-      }
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
 
-      inline void Get(const Value& value) {
-        // All reads should be atomic (from the mutable tail).
-        ASSERT_TRUE(false);
-      }
-      inline void GetAtomic(const Value& value) {
-        output = value.atomic_value_.load();
-      }
+    inline void Get(const Value& value) {
+      output = value.value_;
+    }
+    inline void GetAtomic(const Value& value) {
+      output = value.atomic_value_.load();
+    }
 
-  protected:
-      /// The explicit interface requires a DeepCopy_Internal() implementation.
-      Status DeepCopy_Internal(IAsyncContext*& context_copy) {
-        return IAsyncContext::DeepCopy_Internal(*this, context_copy);
-      }
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
 
-  private:
-      Key key_;
-  public:
-      uint8_t output;
+   private:
+    Key key_;
+   public:
+    uint64_t output;
   };
 
-  FasterKv<Key, Value, FASTER::device::NullDisk> store { 128, 1073741824, "" };
+  static constexpr uint64_t kNumRecords = 100000;
+  static std::atomic<uint64_t> table_size{ 128 };
+
+  FasterKv<Key, Value, FASTER::device::NullDisk> store{ 128, 1073741824, "" };
+  auto grow_callback = [](uint64_t new_size) {
+    ASSERT_GT(new_size, table_size.load());
+    table_size = new_size;
+  };
+  store.EnableAutoGrowIndex(0.5, std::chrono::milliseconds{ 0 }, grow_callback);
 
   store.StartSession();
 
-  // Insert.
-  for(size_t idx = 1; idx < 256; ++idx) {
+  // Insert, far more keys than a 128-bucket table holds; the index grows along the way.
+  for(uint64_t idx = 0; idx < kNumRecords; ++idx) {
     auto callback = [](IAsyncContext* ctxt, Status result) {
-        // In-memory test.
-        ASSERT_TRUE(false);
+      // In-memory test.
+      ASSERT_TRUE(false);
     };
-
-    // Create the key as a variable length array
-    uint16_t* key = (uint16_t*) malloc(idx * sizeof(uint16_t));
-    for (size_t j = 0; j < idx; ++j) {
-      key[j] = 42;
+    if(idx % 256 == 0) {
+      store.Refresh();
     }
-
-    UpsertContext context{ key, idx };
+    UpsertContext context{ idx };
     Status result = store.Upsert(context, callback, 1);
     ASSERT_EQ(Status::Ok, result);
   }
+  // Let any grow still in progress finish.
+  for(uint32_t idx = 0; idx < 1000; ++idx) {
+    store.Refresh();
+  }
+  ASSERT_GE(table_size.load(), kNumRecords / 7 / 2);
+
   // Read.
-  for(size_t idx = 1; idx < 256; ++idx) {
+  for(uint64_t idx = 0; idx < kNumRecords; ++idx) {
     auto callback = [](IAsyncContext* ctxt, Status result) {
-        // In-memory test.
-        ASSERT_TRUE(false);
+      // In-memory test.
+      ASSERT_TRUE(false);
     };
-
-    // Create the key as a variable length array
-    uint16_t* key = (uint16_t*) malloc(idx * sizeof(uint16_t));
-    for (size_t j = 0; j < idx; ++j) {
-      key[j] = 42;
-    }
-
-    ReadContext context{ key, idx };
+    ReadContext context{ idx };
     Status result = store.Read(context, callback, 1);
-    ASSERT_EQ(Status::Ok, result);
-    // All upserts should have inserts (non-atomic).
-    ASSERT_EQ(23, context.output);
+    ASSERT_EQ(Status::Ok, result) << idx;
+    ASSERT_EQ(idx * 3, context.output);
   }
-  // Update.
-  for(size_t idx = 1; idx < 256; ++idx) {
-    auto callback = [](IAsyncContext* ctxt, Status result) {
-        // In-memory test.
-        ASSERT_TRUE(false);
-    };
 
-    // Create the key as a variable length array
-    uint16_t* key = (uint16_t*) malloc(idx * sizeof(uint16_t));
-    for (size_t j = 0; j < idx; ++j) {
-      key[j] = 42;
+  store.StopSession();
+}
+
+TEST(InMemFaster, ShrinkIndex) {
+  class Key {
+   public:
+    Key(uint64_t key)
+      : key_{ key } {
     }
 
-    UpsertContext context{ key, idx };
-    Status result = store.Upsert(context, callback, 1);
-    ASSERT_EQ(Status::Ok, result);
-  }
-  // Read again.
-  for(size_t idx = 1; idx < 256; ++idx) {
-    auto callback = [](IAsyncContext* ctxt, Status result) {
-        // In-memory test.
-        ASSERT_TRUE(false);
-    };
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      // Use only a few distinct tags, so that buckets that get merged hold chains with the same
+      // tag.
+      return KeyHash{ (Utility::GetHashCode(key_) & (((uint64_t)1 << 48) - 1)) |
+                      ((key_ % 5) << 48) };
+    }
 
-    // Create the key as a variable length array
-    uint16_t* key = (uint16_t*) malloc(idx * sizeof(uint16_t));
-    for (size_t j = 0; j < idx; ++j) {
-      key[j] = 42;
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return key_ == other.key_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return key_ != other.key_;
     }
 
-    ReadContext context{ key, idx };
-    Status result = store.Read(context, callback, 1);
-    ASSERT_EQ(Status::Ok, result);
-    // All upserts should have updates (atomic).
-    ASSERT_EQ(42, context.output);
-  }
+   private:
+    uint64_t key_;
+  };
 
+  class UpsertContext;
+  class ReadContext;
+  class DeleteContext;
+
+  class Value {
+   public:
+    Value()
+      : value_{ 0 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Value));
+    }
+
+    friend class UpsertContext;
+    friend class ReadContext;
+    friend class DeleteContext;
+
+   private:
+    union {
+      uint64_t value_;
+      std::atomic<uint64_t> atomic_value_;
+    };
+  };
+
+  class UpsertContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    UpsertContext(uint64_t key)
+      : key_{ key }
+      , val_{ key * 3 } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    UpsertContext(const UpsertContext& other)
+      : key_{ other.key_ }
+      , val_{ other.val_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    /// Non-atomic and atomic Put() methods.
+    inline void Put(Value& value) {
+      value.value_ = val_;
+    }
+    inline bool PutAtomic(Value& value) {
+      value.atomic_value_.store(val_);
+      return true;
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    uint64_t val_;
+  };
+
+  class ReadContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    ReadContext(uint64_t key)
+      : key_{ key } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    ReadContext(const ReadContext& other)
+      : key_{ other.key_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+
+    inline void Get(const Value& value) {
+      output = value.value_;
+    }
+    inline void GetAtomic(const Value& value) {
+      output = value.atomic_value_.load();
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+   public:
+    uint64_t output;
+  };
+
+  class DeleteContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    DeleteContext(uint64_t key)
+      : key_{ key } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    DeleteContext(const DeleteContext& other)
+      : key_{ other.key_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+  };
+
+  static constexpr uint64_t kNumRecords = 20000;
+  static std::atomic<bool> shrink_done{ false };
+  static std::atomic<uint64_t> table_size{ 0 };
+
+  FasterKv<Key, Value, FASTER::device::NullDisk> store{ 8192, 1073741824, "" };
+
+  store.StartSession();
+
+  // Insert, and then delete every other key.
+  for(uint64_t idx = 0; idx < kNumRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // In-memory test.
+      ASSERT_TRUE(false);
+    };
+    UpsertContext context{ idx };
+    Status result = store.Upsert(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  for(uint64_t idx = 0; idx < kNumRecords; idx += 2) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // In-memory test.
+      ASSERT_TRUE(false);
+    };
+    DeleteContext context{ idx };
+    Status result = store.Delete(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+
+  // Shrink the index, from 8192 buckets down to 16; so many buckets that get merged hold chains
+  // with the same tag.
+  auto shrink_callback = [](uint64_t new_size) {
+    table_size = new_size;
+    shrink_done = true;
+  };
+  for(uint64_t expected_size = 4096; expected_size >= 16; expected_size /= 2) {
+    shrink_done = false;
+    ASSERT_TRUE(store.ShrinkIndex(shrink_callback));
+    while(!shrink_done) {
+      store.Refresh();
+      std::this_thread::yield();
+    }
+    ASSERT_EQ(expected_size, table_size.load());
+  }
+
+  // Read.
+  for(uint64_t idx = 0; idx < kNumRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // In-memory test.
+      ASSERT_TRUE(false);
+    };
+    ReadContext context{ idx };
+    Status result = store.Read(context, callback, 1);
+    if(idx % 2 == 0) {
+      ASSERT_EQ(Status::NotFound, result) << idx;
+    } else {
+      ASSERT_EQ(Status::Ok, result) << idx;
+      ASSERT_EQ(idx * 3, context.output);
+    }
+  }
+
+  // The smaller index still supports inserts.
+  for(uint64_t idx = 0; idx < kNumRecords; idx += 2) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // In-memory test.
+      ASSERT_TRUE(false);
+    };
+    UpsertContext context{ idx };
+    Status result = store.Upsert(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  for(uint64_t idx = 0; idx < kNumRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // In-memory test.
+      ASSERT_TRUE(false);
+    };
+    ReadContext context{ idx };
+    Status result = store.Read(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result) << idx;
+    ASSERT_EQ(idx * 3, context.output);
+  }
+
+  store.StopSession();
+}
+
+TEST(InMemFaster, Statistics) {
+  class Key {
+   public:
+    Key(uint64_t key)
+      : key_{ key } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      return KeyHash{ Utility::GetHashCode(key_) };
+    }
+
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return key_ == other.key_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return key_ != other.key_;
+    }
+
+   private:
+    uint64_t key_;
+  };
+
+  class UpsertContext;
+  class ReadContext;
+  class DeleteContext;
+
+  class Value {
+   public:
+    Value()
+      : value_{ 0 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Value));
+    }
+
+    friend class UpsertContext;
+    friend class ReadContext;
+    friend class DeleteContext;
+
+   private:
+    union {
+      uint64_t value_;
+      std::atomic<uint64_t> atomic_value_;
+    };
+  };
+
+  class UpsertContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    UpsertContext(uint64_t key)
+      : key_{ key }
+      , val_{ key * 3 } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    UpsertContext(const UpsertContext& other)
+      : key_{ other.key_ }
+      , val_{ other.val_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    /// Non-atomic and atomic Put() methods.
+    inline void Put(Value& value) {
+      value.value_ = val_;
+    }
+    inline bool PutAtomic(Value& value) {
+      value.atomic_value_.store(val_);
+      return true;
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    uint64_t val_;
+  };
+
+  class ReadContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    ReadContext(uint64_t key)
+      : key_{ key } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    ReadContext(const ReadContext& other)
+      : key_{ other.key_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+
+    inline void Get(const Value& value) {
+      output = value.value_;
+    }
+    inline void GetAtomic(const Value& value) {
+      output = value.atomic_value_.load();
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+   public:
+    uint64_t output;
+  };
+
+  class DeleteContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    DeleteContext(uint64_t key)
+      : key_{ key } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    DeleteContext(const DeleteContext& other)
+      : key_{ other.key_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+  };
+
+  static constexpr uint64_t kNumRecords = 10000;
+
+  FasterKv<Key, Value, FASTER::device::NullDisk> store{ 128, 1073741824, "" };
+
+  store.StartSession();
+
+  auto callback = [](IAsyncContext* ctxt, Status result) {
+    // In-memory test.
+    ASSERT_TRUE(false);
+  };
+  // Insert (appends), then update in place, then read and delete in place.
+  for(uint64_t idx = 0; idx < kNumRecords; ++idx) {
+    UpsertContext context{ idx };
+    ASSERT_EQ(Status::Ok, store.Upsert(context, callback, 1));
+  }
+  for(uint64_t idx = 0; idx < kNumRecords; ++idx) {
+    UpsertContext context{ idx };
+    ASSERT_EQ(Status::Ok, store.Upsert(context, callback, 1));
+  }
+  for(uint64_t idx = 0; idx < kNumRecords; ++idx) {
+    ReadContext context{ idx };
+    ASSERT_EQ(Status::Ok, store.Read(context, callback, 1));
+  }
+  for(uint64_t idx = 0; idx < kNumRecords; idx += 2) {
+    DeleteContext context{ idx };
+    ASSERT_EQ(Status::Ok, store.Delete(context, callback, 1));
+  }
+
+  Statistics stats = store.GetStatistics();
+  ASSERT_EQ(kNumRecords, stats.ops.reads);
+  ASSERT_EQ(2 * kNumRecords, stats.ops.upserts);
+  ASSERT_EQ(0, stats.ops.rmws);
+  ASSERT_EQ(kNumRecords / 2, stats.ops.deletes);
+  ASSERT_EQ(kNumRecords, stats.ops.appends);
+  ASSERT_EQ(kNumRecords + kNumRecords + kNumRecords / 2, stats.ops.mutable_hits);
+  ASSERT_EQ(0, stats.ops.read_only_hits);
+  ASSERT_EQ(0, stats.ops.disk_hits);
+  ASSERT_EQ(0, stats.ops.pending);
+  ASSERT_EQ(0, stats.ops.io_reads);
+  ASSERT_EQ(store.Size(), stats.tail_address);
+  ASSERT_LE(stats.begin_address, stats.head_address);
+  ASSERT_LE(stats.read_only_address, stats.tail_address);
+  ASSERT_EQ(stats.tail_address - stats.read_only_address, stats.mutable_bytes());
+  ASSERT_EQ(128, stats.table_size);
+  ASSERT_FALSE(stats.index_scanned);
+
+  // 10,000 keys in 128 buckets need overflow buckets.
+  stats = store.GetStatistics(true);
+  ASSERT_TRUE(stats.index_scanned);
+  ASSERT_GT(stats.overflow_buckets, 0);
+  ASSERT_LE(stats.overflow_buckets, stats.overflow_buckets_allocated);
+  uint64_t num_buckets = 0;
+  uint64_t num_overflow_buckets = 0;
+  for(uint32_t idx = 0; idx < 8; ++idx) {
+    num_buckets += stats.chain_lengths[idx];
+    num_overflow_buckets += idx * stats.chain_lengths[idx];
+  }
+  ASSERT_EQ(128, num_buckets);
+  ASSERT_EQ(0, stats.chain_lengths[0]);
+  ASSERT_LE(num_overflow_buckets, stats.overflow_buckets);
+
+  // Phase durations.
+  ASSERT_EQ(0, stats.grow.count);
+  ASSERT_TRUE(store.GrowIndex(nullptr));
+  for(uint32_t idx = 0; idx < 1000; ++idx) {
+    store.Refresh();
+  }
+  stats = store.GetStatistics(true);
+  ASSERT_EQ(1, stats.grow.count);
+  ASSERT_GT(stats.grow.last_ns, 0);
+  ASSERT_EQ(stats.grow.last_ns, stats.grow.total_ns);
+  ASSERT_EQ(256, stats.table_size);
+  ASSERT_EQ(0, stats.checkpoint.count);
+  ASSERT_EQ(0, stats.gc.count);
+
+  store.StopSession();
+}
+
+TEST(InMemFaster, UpsertRead_VariableLengthKey) {
+  class Key {
+  public:
+      /// This constructor is called when creating a Context so we keep track of memory containing key
+      Key(const uint16_t* key, const uint64_t key_length)
+              : temp_buffer{ key }
+              , key_length_{ key_length } {
+      }
+
+      /// This constructor is called when record is being allocated so we can freely copy into our buffer
+      Key(const Key& other) {
+        key_length_ = other.key_length_;
+        temp_buffer = NULL;
+        if (other.temp_buffer == NULL) {
+          memcpy(buffer(), other.buffer(), key_length_);
+        } else {
+          memcpy(buffer(), other.temp_buffer, key_length_);
+        }
+      }
+
+      /// This destructor ensures we don't leak memory due to Key objects not allocated on HybridLog
+      ~Key() {
+        if (this->temp_buffer != NULL) {
+          free((void*)temp_buffer);
+        }
+      }
+
+      /// Methods and operators required by the (implicit) interface:
+      inline uint32_t size() const {
+        return static_cast<uint32_t>(sizeof(Key) + key_length_);
+      }
+      inline KeyHash GetHash() const {
+        if (this->temp_buffer != NULL) {
+          return KeyHash(Utility::HashBytes(temp_buffer, key_length_));
+        }
+        return KeyHash(Utility::HashBytes(buffer(), key_length_));
+      }
+
+      /// Comparison operators.
+      inline bool operator==(const Key& other) const {
+        if (this->key_length_ != other.key_length_) return false;
+        if (this->temp_buffer != NULL) {
+          return memcmp(temp_buffer, other.buffer(), key_length_) == 0;
+        }
+        return memcmp(buffer(), other.buffer(), key_length_) == 0;
+      }
+      inline bool operator!=(const Key& other) const {
+        if (this->key_length_ != other.key_length_) return true;
+        if (this->temp_buffer != NULL) {
+          return memcmp(temp_buffer, other.buffer(), key_length_) != 0;
+        }
+        return memcmp(buffer(), other.buffer(), key_length_) != 0;
+      }
+
+  private:
+      uint64_t key_length_;
+      const uint16_t* temp_buffer;
+
+      inline const uint16_t* buffer() const {
+        return reinterpret_cast<const uint16_t*>(this + 1);
+      }
+      inline uint16_t* buffer() {
+        return reinterpret_cast<uint16_t*>(this + 1);
+      }
+  };
+
+  class UpsertContext;
+  class ReadContext;
+
+  class Value {
+  public:
+      Value()
+              : value_{ 0 } {
+      }
+      Value(const Value& other)
+              : value_{ other.value_ } {
+      }
+      Value(uint8_t value)
+              : value_{ value } {
+      }
+
+      inline static constexpr uint32_t size() {
+        return static_cast<uint32_t>(sizeof(Value));
+      }
+
+      friend class UpsertContext;
+      friend class ReadContext;
+
+  private:
+      union {
+          uint8_t value_;
+          std::atomic<uint8_t> atomic_value_;
+      };
+  };
+
+  class UpsertContext : public IAsyncContext {
+  public:
+      typedef Key key_t;
+      typedef Value value_t;
+
+      UpsertContext(uint16_t* key, uint64_t key_length)
+              : key_{ key, key_length } {
+      }
+
+      /// Copy (and deep-copy) constructor.
+      UpsertContext(const UpsertContext& other)
+              : key_{ other.key_ } {
+      }
+
+      /// The implicit and explicit interfaces require a key() accessor.
+      inline const Key& key() const {
+        return key_;
+      }
+      inline static constexpr uint32_t value_size() {
+        return sizeof(value_t);
+      }
+      /// Non-atomic and atomic Put() methods.
+      inline void Put(Value& value) {
+        value.value_ = 23;
+      }
+      inline bool PutAtomic(Value& value) {
+        value.atomic_value_.store(42);
+        return true;
+      }
+
+  protected:
+      /// The explicit interface requires a DeepCopy_Internal() implementation.
+      Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+        return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+      }
+
+  private:
+      Key key_;
+  };
+
+  class ReadContext : public IAsyncContext {
+  public:
+      typedef Key key_t;
+      typedef Value value_t;
+
+      ReadContext(uint16_t* key, uint64_t key_length)
+              : key_{ key, key_length } {
+      }
+
+      /// Copy (and deep-copy) constructor.
+      ReadContext(const ReadContext& other)
+              : key_{ other.key_ } {
+      }
+
+      /// The implicit and explicit interfaces require a key() accessor.
+      inline const Key& key() const {
+        return key_;
+      }
+
+      inline void Get(const Value& value) {
+        // All reads should be atomic (from the mutable tail).
+        ASSERT_TRUE(false);
+      }
+      inline void GetAtomic(const Value& value) {
+        output = value.atomic_value_.load();
+      }
+
+  protected:
+      /// The explicit interface requires a DeepCopy_Internal() implementation.
+      Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+        return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+      }
+
+  private:
+      Key key_;
+  public:
+      uint8_t output;
+  };
+
+  FasterKv<Key, Value, FASTER::device::NullDisk> store { 128, 1073741824, "" };
+
+  store.StartSession();
+
+  // Insert.
+  for(size_t idx = 1; idx < 256; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+        // In-memory test.
+        ASSERT_TRUE(false);
+    };
+
+    // Create the key as a variable length array
+    uint16_t* key = (uint16_t*) malloc(idx * sizeof(uint16_t));
+    for (size_t j = 0; j < idx; ++j) {
+      key[j] = 42;
+    }
+
+    UpsertContext context{ key, idx };
+    Status result = store.Upsert(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  // Read.
+  for(size_t idx = 1; idx < 256; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+        // In-memory test.
+        ASSERT_TRUE(false);
+    };
+
+    // Create the key as a variable length array
+    uint16_t* key = (uint16_t*) malloc(idx * sizeof(uint16_t));
+    for (size_t j = 0; j < idx; ++j) {
+      key[j] = 42;
+    }
+
+    ReadContext context{ key, idx };
+    Status result = store.Read(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+    // All upserts should have inserts (non-atomic).
+    ASSERT_EQ(23, context.output);
+  }
+  // Update.
+  for(size_t idx = 1; idx < 256; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+        // In-memory test.
+        ASSERT_TRUE(false);
+    };
+
+    // Create the key as a variable length array
+    uint16_t* key = (uint16_t*) malloc(idx * sizeof(uint16_t));
+    for (size_t j = 0; j < idx; ++j) {
+      key[j] = 42;
+    }
+
+    UpsertContext context{ key, idx };
+    Status result = store.Upsert(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  // Read again.
+  for(size_t idx = 1; idx < 256; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+        // In-memory test.
+        ASSERT_TRUE(false);
+    };
+
+    // Create the key as a variable length array
+    uint16_t* key = (uint16_t*) malloc(idx * sizeof(uint16_t));
+    for (size_t j = 0; j < idx; ++j) {
+      key[j] = 42;
+    }
+
+    ReadContext context{ key, idx };
+    Status result = store.Read(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+    // All upserts should have updates (atomic).
+    ASSERT_EQ(42, context.output);
+  }
+
+  store.StopSession();
+}
+
+TEST(InMemFaster, UpsertDelete) {
+  class Key {
+   public:
+    Key(uint64_t key)
+      : key_{ key } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      std::hash<uint64_t> hash_fn;
+      return KeyHash{ hash_fn(key_) };
+    }
+
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return key_ == other.key_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return key_ != other.key_;
+    }
+
+   private:
+    uint64_t key_;
+  };
+
+  class UpsertContext;
+  class RmwContext;
+  class ReadContext;
+
+  class Value {
+   public:
+    Value()
+      : value_{ 0 } {
+    }
+    Value(const Value& other)
+      : value_{ other.value_ } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Value));
+    }
+
+    friend class UpsertContext;
+    friend class RmwContext;
+    friend class ReadContext;
+
+   private:
+    union {
+      int32_t value_;
+      std::atomic<int32_t> atomic_value_;
+    };
+  };
+
+  class UpsertContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    UpsertContext(uint64_t key)
+      : key_{ key } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    UpsertContext(const UpsertContext& other)
+      : key_{ other.key_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    /// Non-atomic and atomic Put() methods.
+    inline void Put(Value& value) {
+      value.value_ = 23;
+    }
+    inline bool PutAtomic(Value& value) {
+      value.atomic_value_.store(42);
+      return true;
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+  };
+
+  class RmwContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    RmwContext(uint64_t key, int32_t incr)
+      : key_{ key }
+      , incr_{ incr } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    RmwContext(const RmwContext& other)
+      : key_{ other.key_ }
+      , incr_{ other.incr_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    inline static constexpr uint32_t value_size(const Value& old_value) {
+      return sizeof(value_t);
+    }
+    inline void RmwInitial(Value& value) {
+      value.value_ = incr_;
+    }
+    inline void RmwCopy(const Value& old_value, Value& value) {
+      value.value_ = old_value.value_ + incr_;
+    }
+    inline bool RmwAtomic(Value& value) {
+      value.atomic_value_.fetch_add(incr_);
+      return true;
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    int32_t incr_;
+  };
+
+  class DeleteContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    DeleteContext(uint64_t key)
+      : key_{ key } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    DeleteContext(const DeleteContext& other)
+      : key_{ other.key_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+  };
+
+  class ReadContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    ReadContext(uint64_t key)
+      : key_{ key } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    ReadContext(const ReadContext& other)
+      : key_{ other.key_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+
+    inline void Get(const Value& value) {
+      output = value.value_;
+    }
+    inline void GetAtomic(const Value& value) {
+      output = value.atomic_value_.load();
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+   public:
+    int32_t output;
+  };
+
+  FasterKv<Key, Value, FASTER::device::NullDisk> store{ 128, 1073741824, "" };
+
+  store.StartSession();
+
+  auto callback = [](IAsyncContext* ctxt, Status result) {
+    // In-memory test.
+    ASSERT_TRUE(false);
+  };
+
+  // Delete from an empty store.
+  {
+    DeleteContext context{ 7 };
+    Status result = store.Delete(context, callback, 1);
+    ASSERT_EQ(Status::NotFound, result);
+  }
+  // Insert.
+  for(size_t idx = 0; idx < 256; ++idx) {
+    UpsertContext context{ idx };
+    Status result = store.Upsert(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  // Delete every other key, in place (mutable region).
+  for(size_t idx = 0; idx < 256; idx += 2) {
+    DeleteContext context{ idx };
+    Status result = store.Delete(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  for(size_t idx = 0; idx < 256; ++idx) {
+    ReadContext context{ idx };
+    Status result = store.Read(context, callback, 1);
+    if(idx % 2 == 0) {
+      ASSERT_EQ(Status::NotFound, result);
+    } else {
+      ASSERT_EQ(Status::Ok, result);
+      ASSERT_EQ(23, context.output);
+    }
+  }
+
+  // Make the whole log read-only, so that the next deletes must append tombstones.
+  store.hlog.ShiftReadOnlyToTail();
+  store.Refresh();
+  for(size_t idx = 1; idx < 256; idx += 4) {
+    DeleteContext context{ idx };
+    Status result = store.Delete(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  for(size_t idx = 0; idx < 256; ++idx) {
+    ReadContext context{ idx };
+    Status result = store.Read(context, callback, 1);
+    if(idx % 4 == 3) {
+      ASSERT_EQ(Status::Ok, result);
+      ASSERT_EQ(23, context.output);
+    } else {
+      ASSERT_EQ(Status::NotFound, result);
+    }
+  }
+
+  // RMW starts deleted keys over from their initial value.
+  for(size_t idx = 0; idx < 256; ++idx) {
+    RmwContext context{ idx, 5 };
+    Status result = store.Rmw(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  // Upsert replaces (rather than updates in place) the deleted keys.
+  for(size_t idx = 0; idx < 256; idx += 2) {
+    DeleteContext context{ idx };
+    Status result = store.Delete(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  for(size_t idx = 0; idx < 256; idx += 4) {
+    UpsertContext context{ idx };
+    Status result = store.Upsert(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  for(size_t idx = 0; idx < 256; ++idx) {
+    ReadContext context{ idx };
+    Status result = store.Read(context, callback, 1);
+    if(idx % 4 == 0) {
+      ASSERT_EQ(Status::Ok, result);
+      ASSERT_EQ(23, context.output);
+    } else if(idx % 4 == 1) {
+      ASSERT_EQ(Status::Ok, result);
+      ASSERT_EQ(5, context.output);
+    } else if(idx % 4 == 2) {
+      ASSERT_EQ(Status::NotFound, result);
+    } else {
+      ASSERT_EQ(Status::Ok, result);
+      ASSERT_EQ(28, context.output);
+    }
+  }
+
+  store.StopSession();
+}
+
+TEST(InMemFaster, MultiUpsertMultiRead) {
+  class Key {
+   public:
+    Key(uint64_t key)
+      : key_{ key } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      return KeyHash{ Utility::GetHashCode(key_) };
+    }
+
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return key_ == other.key_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return key_ != other.key_;
+    }
+
+   private:
+    uint64_t key_;
+  };
+
+  class UpsertContext;
+  class ReadContext;
+
+  class Value {
+   public:
+    Value()
+      : value_{ 0 } {
+    }
+    Value(const Value& other)
+      : value_{ other.value_ } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Value));
+    }
+
+    friend class UpsertContext;
+    friend class ReadContext;
+
+   private:
+    union {
+      uint64_t value_;
+      std::atomic<uint64_t> atomic_value_;
+    };
+  };
+
+  class UpsertContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    UpsertContext(uint64_t key, uint64_t value)
+      : key_{ key }
+      , value_{ value } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    UpsertContext(const UpsertContext& other)
+      : key_{ other.key_ }
+      , value_{ other.value_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    /// Non-atomic and atomic Put() methods.
+    inline void Put(Value& value) {
+      value.value_ = value_;
+    }
+    inline bool PutAtomic(Value& value) {
+      value.atomic_value_.store(value_);
+      return true;
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    uint64_t value_;
+  };
+
+  class ReadContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    ReadContext(uint64_t key)
+      : key_{ key }
+      , output{ 0 } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    ReadContext(const ReadContext& other)
+      : key_{ other.key_ }
+      , output{ other.output } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+
+    inline void Get(const Value& value) {
+      // All reads should be atomic (from the mutable tail).
+      ASSERT_TRUE(false);
+    }
+    inline void GetAtomic(const Value& value) {
+      output = value.atomic_value_.load();
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+   public:
+    uint64_t output;
+  };
+
+  FasterKv<Key, Value, FASTER::device::NullDisk> store{ 1024, 1073741824, "" };
+
+  store.StartSession();
+
+  auto callback = [](IAsyncContext* ctxt, Status result) {
+    // In-memory test.
+    ASSERT_TRUE(false);
+  };
+
+  // Not a multiple of the batch size.
+  constexpr uint32_t kNumRecords = 1000;
+  std::vector<Status> results(kNumRecords);
+
+  // Insert.
+  std::vector<UpsertContext> upserts;
+  upserts.reserve(kNumRecords);
+  for(uint32_t idx = 0; idx < kNumRecords; ++idx) {
+    upserts.emplace_back(idx, idx * 3);
+  }
+  store.MultiUpsert(upserts.data(), kNumRecords, callback, 1, results.data());
+  for(uint32_t idx = 0; idx < kNumRecords; ++idx) {
+    ASSERT_EQ(Status::Ok, results[idx]);
+  }
+
+  // Read, including some keys that don't exist.
+  std::vector<ReadContext> reads;
+  reads.reserve(kNumRecords);
+  for(uint32_t idx = 0; idx < kNumRecords; ++idx) {
+    reads.emplace_back(idx * 2);
+  }
+  store.MultiRead(reads.data(), kNumRecords, callback, 2, results.data());
+  for(uint32_t idx = 0; idx < kNumRecords; ++idx) {
+    if(idx * 2 < kNumRecords) {
+      ASSERT_EQ(Status::Ok, results[idx]);
+      ASSERT_EQ(idx * 6, reads[idx].output);
+    } else {
+      ASSERT_EQ(Status::NotFound, results[idx]);
+    }
+  }
+
+  store.StopSession();
+}
+
+/// A disk whose reads all fail; they complete asynchronously, as a real device's would.
+class FailingReadFile : public FASTER::device::NullFile {
+ public:
+  Status ReadAsync(uint64_t source, void* dest, uint32_t length,
+                   AsyncIOCallback callback, IAsyncContext& context) const {
+    IAsyncContext* context_copy;
+    RETURN_NOT_OK(context.DeepCopy(context_copy));
+    callback(context_copy, Status::IOError, 0);
+    return Status::Ok;
+  }
+};
+
+class FailingReadDisk : public FASTER::device::NullDisk {
+ public:
+  typedef FailingReadFile log_file_t;
+
+  FailingReadDisk(const std::string& filename, LightEpoch& epoch)
+    : NullDisk{ filename, epoch } {
+  }
+
+  const log_file_t& log() const {
+    return log_;
+  }
+  log_file_t& log() {
+    return log_;
+  }
+
+ private:
+  log_file_t log_;
+};
+
+TEST(InMemFaster, ReadIoError) {
+  class Key {
+   public:
+    Key(uint64_t key)
+      : key_{ key } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      return KeyHash{ Utility::GetHashCode(key_) };
+    }
+
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return key_ == other.key_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return key_ != other.key_;
+    }
+
+   private:
+    uint64_t key_;
+  };
+
+  class Value {
+   public:
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Value));
+    }
+
+    uint64_t value_;
+    uint8_t padding_[1016];
+  };
+
+  class UpsertContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    UpsertContext(uint64_t key)
+      : key_{ key } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    UpsertContext(const UpsertContext& other)
+      : key_{ other.key_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    /// Non-atomic and atomic Put() methods.
+    inline void Put(Value& value) {
+      value.value_ = 1;
+    }
+    inline bool PutAtomic(Value& value) {
+      value.value_ = 1;
+      return true;
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+  };
+
+  class ReadContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    ReadContext(uint64_t key)
+      : key_{ key } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    ReadContext(const ReadContext& other)
+      : key_{ other.key_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+
+    inline void Get(const Value& value) {
+    }
+    inline void GetAtomic(const Value& value) {
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+  };
+
+  static constexpr uint64_t kNumRecords = 300000;
+  static constexpr uint64_t kNumReads = 200;
+  static std::atomic<uint64_t> num_errors{ 0 };
+  num_errors = 0;
+
+  // 8 pages; the first records are evicted to the (failing) disk.
+  FasterKv<Key, Value, FailingReadDisk> store{ 1024, 268435456, "", 0.5 };
+  // A small, fixed window: failed reads must give back their slots.
+  store.SetIoLimits(4, 4, false);
+
+  store.StartSession();
+  for(uint64_t idx = 0; idx < kNumRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // Upserts don't go to disk.
+      ASSERT_TRUE(false);
+    };
+    if(idx % 256 == 0) {
+      store.Refresh();
+    }
+    UpsertContext context{ idx };
+    Status result = store.Upsert(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+
+  for(uint64_t idx = 0; idx < kNumReads; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      CallbackContext<ReadContext> context{ ctxt };
+      ASSERT_EQ(Status::IOError, result);
+      ++num_errors;
+    };
+    ReadContext context{ idx };
+    Status result = store.Read(context, callback, 1);
+    ASSERT_EQ(Status::Pending, result);
+  }
+  ASSERT_TRUE(store.CompletePending(true));
+  ASSERT_EQ(kNumReads, num_errors.load());
+  ASSERT_EQ(0, store.GetStatistics().pending_ios);
+  store.StopSession();
+}
+
+TEST(InMemFaster, ShrinkIndexReadError) {
+  class Key {
+   public:
+    Key(uint64_t key)
+      : key_{ key } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      // Use only a few distinct tags, so that buckets that get merged hold chains with the same
+      // tag.
+      return KeyHash{ (Utility::GetHashCode(key_) & (((uint64_t)1 << 48) - 1)) |
+                      ((key_ % 5) << 48) };
+    }
+
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return key_ == other.key_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return key_ != other.key_;
+    }
+
+   private:
+    uint64_t key_;
+  };
+
+  class Value {
+   public:
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Value));
+    }
+
+    uint64_t value_;
+    uint8_t padding_[1016];
+  };
+
+  class UpsertContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    UpsertContext(uint64_t key)
+      : key_{ key } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    UpsertContext(const UpsertContext& other)
+      : key_{ other.key_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    /// Non-atomic and atomic Put() methods.
+    inline void Put(Value& value) {
+      value.value_ = 1;
+    }
+    inline bool PutAtomic(Value& value) {
+      value.value_ = 1;
+      return true;
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+  };
+
+  class ReadContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    ReadContext(uint64_t key)
+      : key_{ key } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    ReadContext(const ReadContext& other)
+      : key_{ other.key_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+
+    inline void Get(const Value& value) {
+    }
+    inline void GetAtomic(const Value& value) {
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+  };
+
+  static constexpr uint64_t kNumRecords = 300000;
+  static std::atomic<bool> shrink_done{ false };
+  static std::atomic<uint64_t> table_size{ 0 };
+  shrink_done = false;
+
+  // The first records are evicted to the (failing) disk.
+  FasterKv<Key, Value, FailingReadDisk> store{ 1024, 268435456, "", 0.5 };
+
+  store.StartSession();
+  for(uint64_t idx = 0; idx < kNumRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // Upserts don't go to disk.
+      ASSERT_TRUE(false);
+    };
+    if(idx % 256 == 0) {
+      store.Refresh();
+    }
+    UpsertContext context{ idx };
+    Status result = store.Upsert(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+
+  // Merging chains with the same tag means copying records, some of which can't be read; so the
+  // shrink is abandoned, rather than drop them.
+  auto shrink_callback = [](uint64_t new_size) {
+    table_size = new_size;
+    shrink_done = true;
+  };
+  ASSERT_TRUE(store.ShrinkIndex(shrink_callback));
+  while(!shrink_done) {
+    store.Refresh();
+    std::this_thread::yield();
+  }
+  ASSERT_EQ(1024, table_size.load());
+  ASSERT_EQ(1024, store.GetStatistics().table_size);
+
+  // The records in memory are still reachable, through the old index.
+  for(uint64_t idx = kNumRecords - 1000; idx < kNumRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      ASSERT_TRUE(false);
+    };
+    ReadContext context{ idx };
+    Status result = store.Read(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result) << idx;
+  }
   store.StopSession();
 }
 
@@ -21,6 +21,175 @@ typedef FASTER::environment::QueueIoHandler handler_t;
 
 #undef CLASS
 
+/// A disk whose I/O handler has room for only a few requests in flight.
+class ShallowQueueDisk : public FASTER::device::FileSystemDisk<handler_t, 67108864L> {
+ public:
+  ShallowQueueDisk(const std::string& root_path, LightEpoch& epoch)
+    : FileSystemDisk{ root_path, epoch, false, true, false, 8 } {
+  }
+};
+
+TEST(PagingTest_Queue, UpsertRead_ShallowQueue) {
+  class Key {
+   public:
+    Key(uint64_t key)
+      : key_{ key } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      return KeyHash{ Utility::GetHashCode(key_) };
+    }
+
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return key_ == other.key_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return key_ != other.key_;
+    }
+
+   private:
+    uint64_t key_;
+  };
+
+  class Value {
+   public:
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Value));
+    }
+
+    uint64_t value_;
+    uint8_t padding_[1016];
+  };
+
+  class UpsertContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    UpsertContext(uint64_t key)
+      : key_{ key } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    UpsertContext(const UpsertContext& other)
+      : key_{ other.key_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    /// Non-atomic and atomic Put() methods.
+    inline void Put(Value& value) {
+      value.value_ = 7;
+    }
+    inline bool PutAtomic(Value& value) {
+      value.value_ = 7;
+      return true;
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+  };
+
+  class ReadContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    ReadContext(uint64_t key)
+      : key_{ key } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    ReadContext(const ReadContext& other)
+      : key_{ other.key_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+
+    inline void Get(const Value& value) {
+      ASSERT_EQ(7, value.value_);
+    }
+    inline void GetAtomic(const Value& value) {
+      ASSERT_EQ(7, value.value_);
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+  };
+
+  static constexpr uint64_t kNumRecords = 250000;
+  static std::atomic<uint64_t> records_read{ 0 };
+
+  std::experimental::filesystem::create_directories("logs");
+  {
+    // 8 pages; the first records are evicted to disk.
+    FasterKv<Key, Value, ShallowQueueDisk> store{ 262144, 268435456, "logs", 0.5 };
+    // Far more reads in flight than the handler's queue holds: when the queue is full, requests
+    // must wait for room, rather than fail.
+    store.SetIoLimits(256, 256, false);
+
+    store.StartSession();
+    for(uint64_t idx = 0; idx < kNumRecords; ++idx) {
+      auto callback = [](IAsyncContext* ctxt, Status result) {
+        // Upserts don't go to disk.
+        ASSERT_TRUE(false);
+      };
+      if(idx % 256 == 0) {
+        store.Refresh();
+      }
+      UpsertContext context{ idx };
+      Status result = store.Upsert(context, callback, 1);
+      ASSERT_EQ(Status::Ok, result);
+    }
+
+    for(uint64_t idx = 0; idx < kNumRecords; ++idx) {
+      auto callback = [](IAsyncContext* ctxt, Status result) {
+        CallbackContext<ReadContext> context{ ctxt };
+        ASSERT_EQ(Status::Ok, result);
+        ++records_read;
+      };
+      if(idx % 256 == 0) {
+        store.Refresh();
+      }
+      ReadContext context{ idx };
+      Status result = store.Read(context, callback, 1);
+      if(result == Status::Ok) {
+        ++records_read;
+      } else {
+        ASSERT_EQ(Status::Pending, result);
+      }
+    }
+    ASSERT_TRUE(store.CompletePending(true));
+    ASSERT_EQ(kNumRecords, records_read.load());
+    ASSERT_EQ(0, store.GetStatistics().pending_ios);
+    store.StopSession();
+  }
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -289,6 +289,2559 @@ TEST(CLASS, UpsertRead_Serial) {
   store.StopSession();
 }
 
+TEST(CLASS, UpsertRead_IoLimits) {
+  class Key {
+   public:
+    Key(uint64_t pt1, uint64_t pt2)
+      : pt1_{ pt1 }
+      , pt2_{ pt2 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      std::hash<uint64_t> hash_fn;
+      return KeyHash{ hash_fn(pt1_) };
+    }
+
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return pt1_ == other.pt1_ &&
+             pt2_ == other.pt2_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return pt1_ != other.pt1_ ||
+             pt2_ != other.pt2_;
+    }
+
+   private:
+    uint64_t pt1_;
+    uint64_t pt2_;
+  };
+
+  class UpsertContext;
+  class ReadContext;
+
+  class Value {
+   public:
+    Value()
+      : gen_{ 0 }
+      , value_{ 0 }
+      , length_{ 0 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Value));
+    }
+
+    friend class UpsertContext;
+    friend class ReadContext;
+
+   private:
+    std::atomic<uint64_t> gen_;
+    uint8_t value_[1014];
+    uint16_t length_;
+  };
+  static_assert(sizeof(Value) == 1024, "sizeof(Value) != 1024");
+  static_assert(alignof(Value) == 8, "alignof(Value) != 8");
+
+  class UpsertContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    UpsertContext(const Key& key, uint8_t val)
+      : key_{ key }
+      , val_{ val } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    UpsertContext(const UpsertContext& other)
+      : key_{ other.key_ }
+      , val_{ other.val_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    inline static constexpr uint32_t value_size(const Value& old_value) {
+      return sizeof(value_t);
+    }
+    /// Non-atomic and atomic Put() methods.
+    inline void Put(Value& value) {
+      value.gen_ = 0;
+      std::memset(value.value_, val_, val_);
+      value.length_ = val_;
+    }
+    inline bool PutAtomic(Value& value) {
+      // Get the lock on the value.
+      uint64_t expected_gen;
+      bool success;
+      do {
+        do {
+          // Spin until other the thread releases the lock.
+          expected_gen = value.gen_.load();
+        } while(expected_gen == UINT64_MAX);
+        // Try to get the lock.
+        success = value.gen_.compare_exchange_weak(expected_gen, UINT64_MAX);
+      } while(!success);
+
+      std::memset(value.value_, val_, val_);
+      value.length_ = val_;
+      // Increment the value's generation number.
+      value.gen_.store(expected_gen + 1);
+      return true;
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    uint8_t val_;
+  };
+
+  class ReadContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    ReadContext(Key key, uint8_t expected)
+      : key_{ key }
+      , expected_{ expected } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    ReadContext(const ReadContext& other)
+      : key_{ other.key_ }
+      , expected_{ other.expected_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+
+    inline void Get(const Value& value) {
+      // This is a paging test, so we expect to read stuff from disk.
+      ASSERT_EQ(expected_, value.length_);
+      ASSERT_EQ(expected_, value.value_[expected_ - 5]);
+    }
+    inline void GetAtomic(const Value& value) {
+      uint64_t post_gen = value.gen_.load();
+      uint64_t pre_gen;
+      uint16_t len;
+      uint8_t val;
+      do {
+        // Pre- gen # for this read is last read's post- gen #.
+        pre_gen = post_gen;
+        len = value.length_;
+        val = value.value_[len - 5];
+        post_gen = value.gen_.load();
+      } while(pre_gen != post_gen);
+      ASSERT_EQ(expected_, static_cast<uint8_t>(len));
+      ASSERT_EQ(expected_, val);
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    uint8_t expected_;
+  };
+
+  std::experimental::filesystem::create_directories("logs");
+
+  // 8 pages!
+  FasterKv<Key, Value, disk_t> store{ 262144, 268435456, "logs", 0.5 };
+  // At most 4 reads in flight.
+  store.SetIoLimits(4, 4);
+
+  Guid session_id = store.StartSession();
+
+  constexpr size_t kNumRecords = 250000;
+
+  // Insert.
+  for(size_t idx = 0; idx < kNumRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // Upserts don't go to disk.
+      ASSERT_TRUE(false);
+    };
+
+    if(idx % 256 == 0) {
+      store.Refresh();
+    }
+
+    UpsertContext context{ Key{idx, idx}, 25 };
+    Status result = store.Upsert(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  // Read.
+  static std::atomic<uint64_t> records_read{ 0 };
+  for(size_t idx = 0; idx < kNumRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      CallbackContext<ReadContext> context{ ctxt };
+      ASSERT_EQ(Status::Ok, result);
+      ++records_read;
+    };
+
+    if(idx % 256 == 0) {
+      store.Refresh();
+      ASSERT_LE(store.GetStatistics().pending_ios, 4);
+    }
+
+    ReadContext context{ Key{ idx, idx}, 25 };
+    Status result = store.Read(context, callback, 1);
+    if(result == Status::Ok) {
+      ++records_read;
+    } else {
+      ASSERT_EQ(Status::Pending, result);
+    }
+  }
+
+  ASSERT_LT(records_read.load(), kNumRecords);
+  bool result = store.CompletePending(true);
+  ASSERT_TRUE(result);
+  ASSERT_EQ(kNumRecords, records_read.load());
+  ASSERT_EQ(0, store.GetStatistics().pending_ios);
+
+  store.StopSession();
+}
+
+TEST(CLASS, UpsertRead_IoLimitsConcurrent) {
+  class Key {
+   public:
+    Key(uint64_t pt1, uint64_t pt2)
+      : pt1_{ pt1 }
+      , pt2_{ pt2 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      std::hash<uint64_t> hash_fn;
+      return KeyHash{ hash_fn(pt1_) };
+    }
+
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return pt1_ == other.pt1_ &&
+             pt2_ == other.pt2_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return pt1_ != other.pt1_ ||
+             pt2_ != other.pt2_;
+    }
+
+   private:
+    uint64_t pt1_;
+    uint64_t pt2_;
+  };
+
+  class UpsertContext;
+  class ReadContext;
+
+  class Value {
+   public:
+    Value()
+      : gen_{ 0 }
+      , value_{ 0 }
+      , length_{ 0 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Value));
+    }
+
+    friend class UpsertContext;
+    friend class ReadContext;
+
+   private:
+    std::atomic<uint64_t> gen_;
+    uint8_t value_[1014];
+    uint16_t length_;
+  };
+  static_assert(sizeof(Value) == 1024, "sizeof(Value) != 1024");
+  static_assert(alignof(Value) == 8, "alignof(Value) != 8");
+
+  class UpsertContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    UpsertContext(const Key& key, uint8_t val)
+      : key_{ key }
+      , val_{ val } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    UpsertContext(const UpsertContext& other)
+      : key_{ other.key_ }
+      , val_{ other.val_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    inline static constexpr uint32_t value_size(const Value& old_value) {
+      return sizeof(value_t);
+    }
+    /// Non-atomic and atomic Put() methods.
+    inline void Put(Value& value) {
+      value.gen_ = 0;
+      std::memset(value.value_, val_, val_);
+      value.length_ = val_;
+    }
+    inline bool PutAtomic(Value& value) {
+      // Get the lock on the value.
+      uint64_t expected_gen;
+      bool success;
+      do {
+        do {
+          // Spin until other the thread releases the lock.
+          expected_gen = value.gen_.load();
+        } while(expected_gen == UINT64_MAX);
+        // Try to get the lock.
+        success = value.gen_.compare_exchange_weak(expected_gen, UINT64_MAX);
+      } while(!success);
+
+      std::memset(value.value_, val_, val_);
+      value.length_ = val_;
+      // Increment the value's generation number.
+      value.gen_.store(expected_gen + 1);
+      return true;
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    uint8_t val_;
+  };
+
+  class ReadContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    ReadContext(Key key, uint8_t expected)
+      : key_{ key }
+      , expected_{ expected } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    ReadContext(const ReadContext& other)
+      : key_{ other.key_ }
+      , expected_{ other.expected_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+
+    inline void Get(const Value& value) {
+      // This is a paging test, so we expect to read stuff from disk.
+      ASSERT_EQ(expected_, value.length_);
+      ASSERT_EQ(expected_, value.value_[expected_ - 5]);
+    }
+    inline void GetAtomic(const Value& value) {
+      uint64_t post_gen = value.gen_.load();
+      uint64_t pre_gen;
+      uint16_t len;
+      uint8_t val;
+      do {
+        // Pre- gen # for this read is last read's post- gen #.
+        pre_gen = post_gen;
+        len = value.length_;
+        val = value.value_[len - 5];
+        post_gen = value.gen_.load();
+      } while(pre_gen != post_gen);
+      ASSERT_EQ(expected_, static_cast<uint8_t>(len));
+      ASSERT_EQ(expected_, val);
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    uint8_t expected_;
+  };
+
+  std::experimental::filesystem::create_directories("logs");
+
+  // 8 pages!
+  FasterKv<Key, Value, disk_t> store{ 262144, 268435456, "logs", 0.5 };
+  // More sessions than reads allowed in flight: a session must wait for a share of the total,
+  // rather than exceed it.
+  static constexpr uint32_t kMaxTotalIos = 2;
+  static constexpr size_t kNumThreads = 8;
+  store.SetIoLimits(kMaxTotalIos, kMaxTotalIos, false);
+
+  constexpr size_t kNumRecords = 250000;
+
+  // Insert.
+  store.StartSession();
+  for(size_t idx = 0; idx < kNumRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // Upserts don't go to disk.
+      ASSERT_TRUE(false);
+    };
+
+    if(idx % 256 == 0) {
+      store.Refresh();
+    }
+
+    UpsertContext context{ Key{idx, idx}, 25 };
+    Status result = store.Upsert(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  store.StopSession();
+
+  // Read, from several threads at once.
+  static std::atomic<uint64_t> records_read{ 0 };
+  auto read_worker = [](FasterKv<Key, Value, disk_t>* store_, size_t thread_idx) {
+    store_->StartSession();
+    for(size_t idx = thread_idx; idx < kNumRecords; idx += kNumThreads) {
+      auto callback = [](IAsyncContext* ctxt, Status result) {
+        CallbackContext<ReadContext> context{ ctxt };
+        ASSERT_EQ(Status::Ok, result);
+        ++records_read;
+      };
+
+      if(idx % 256 == thread_idx) {
+        store_->Refresh();
+        ASSERT_LE(store_->GetStatistics().pending_ios, kMaxTotalIos);
+      }
+
+      ReadContext context{ Key{ idx, idx}, 25 };
+      Status result = store_->Read(context, callback, 1);
+      if(result == Status::Ok) {
+        ++records_read;
+      } else {
+        ASSERT_EQ(Status::Pending, result);
+      }
+    }
+    bool result = store_->CompletePending(true);
+    ASSERT_TRUE(result);
+    store_->StopSession();
+  };
+
+  std::deque<std::thread> threads;
+  for(size_t idx = 0; idx < kNumThreads; ++idx) {
+    threads.emplace_back(read_worker, &store, idx);
+  }
+  for(auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(kNumRecords, records_read.load());
+  ASSERT_EQ(0, store.GetStatistics().pending_ios);
+}
+
+TEST(CLASS, UpsertRead_VariableLengthValue) {
+  class Key {
+   public:
+    Key(uint64_t key)
+      : key_{ key } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      std::hash<uint64_t> hash_fn;
+      return KeyHash{ hash_fn(key_) };
+    }
+
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return key_ == other.key_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return key_ != other.key_;
+    }
+
+   private:
+    uint64_t key_;
+  };
+
+  class UpsertContext;
+  class ReadContext;
+
+  class Value {
+   public:
+    Value()
+      : size_{ 0 }
+      , length_{ 0 } {
+    }
+
+    inline uint32_t size() const {
+      return size_;
+    }
+
+    friend class UpsertContext;
+    friend class ReadContext;
+
+   private:
+    uint32_t size_;
+    uint32_t length_;
+
+    inline const uint8_t* buffer() const {
+      return reinterpret_cast<const uint8_t*>(this + 1);
+    }
+    inline uint8_t* buffer() {
+      return reinterpret_cast<uint8_t*>(this + 1);
+    }
+  };
+
+  class UpsertContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    UpsertContext(uint64_t key, uint32_t length)
+      : key_{ key }
+      , length_{ length } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    UpsertContext(const UpsertContext& other)
+      : key_{ other.key_ }
+      , length_{ other.length_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline uint32_t value_size() const {
+      return sizeof(Value) + length_;
+    }
+    /// Non-atomic and atomic Put() methods.
+    inline void Put(Value& value) {
+      value.size_ = sizeof(Value) + length_;
+      value.length_ = length_;
+      std::memset(value.buffer(), static_cast<uint8_t>(length_), length_);
+    }
+    inline bool PutAtomic(Value& value) {
+      // All upserts go to the tail of the log.
+      return false;
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    uint32_t length_;
+  };
+
+  class ReadContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    ReadContext(uint64_t key, uint32_t expected)
+      : key_{ key }
+      , expected_{ expected } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    ReadContext(const ReadContext& other)
+      : key_{ other.key_ }
+      , expected_{ other.expected_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+
+    inline void Get(const Value& value) {
+      ASSERT_EQ(expected_, value.length_);
+      ASSERT_EQ(static_cast<uint8_t>(expected_), value.buffer()[expected_ - 1]);
+    }
+    inline void GetAtomic(const Value& value) {
+      Get(value);
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    uint32_t expected_;
+  };
+
+  std::experimental::filesystem::create_directories("logs");
+
+  // 8 pages!
+  FasterKv<Key, Value, disk_t> store{ 262144, 268435456, "logs", 0.5 };
+
+  Guid session_id = store.StartSession();
+
+  constexpr size_t kNumRecords = 250000;
+
+  // Insert values of about 1 KB, each a little different in size.
+  for(size_t idx = 0; idx < kNumRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // Upserts don't go to disk.
+      ASSERT_TRUE(false);
+    };
+
+    if(idx % 256 == 0) {
+      store.Refresh();
+    }
+
+    UpsertContext context{ idx, static_cast<uint32_t>(1000 + idx % 16) };
+    Status result = store.Upsert(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  // Read.
+  static std::atomic<uint64_t> records_read{ 0 };
+  for(size_t idx = 0; idx < kNumRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      CallbackContext<ReadContext> context{ ctxt };
+      ASSERT_EQ(Status::Ok, result);
+      ++records_read;
+    };
+
+    if(idx % 256 == 0) {
+      store.Refresh();
+    }
+
+    ReadContext context{ idx, static_cast<uint32_t>(1000 + idx % 16) };
+    Status result = store.Read(context, callback, 1);
+    if(result == Status::Ok) {
+      ++records_read;
+    } else {
+      ASSERT_EQ(Status::Pending, result);
+    }
+  }
+
+  ASSERT_LT(records_read.load(), kNumRecords);
+  bool result = store.CompletePending(true);
+  ASSERT_TRUE(result);
+  ASSERT_EQ(kNumRecords, records_read.load());
+
+  // Once the store has seen a few records' sizes, it reads each record in a single read.
+  Statistics stats = store.GetStatistics();
+  ASSERT_GT(stats.ops.pending, 0);
+  ASSERT_LT(stats.ops.io_reads, stats.ops.pending + stats.ops.pending / 10);
+
+  store.StopSession();
+}
+
+TEST(CLASS, ReadAbsent_Serial) {
+  class Key {
+   public:
+    Key(uint64_t key)
+      : key_{ key } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      // Put the keys into 4096 hash chains (all with tag 0), so that a key that isn't in the
+      // store shares its chain with many keys that are.
+      uint64_t hash = Utility::GetHashCode(key_);
+      return KeyHash{ (hash & 0x0000FFFFFFFC0000ULL) | (key_ % 4096) };
+    }
+
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return key_ == other.key_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return key_ != other.key_;
+    }
+
+   private:
+    uint64_t key_;
+  };
+
+  class UpsertContext;
+  class ReadContext;
+
+  class Value {
+   public:
+    Value()
+      : value_{ 0 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Value));
+    }
+
+    friend class UpsertContext;
+    friend class ReadContext;
+
+   private:
+    uint64_t value_;
+    uint8_t padding_[1016];
+  };
+
+  class UpsertContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    UpsertContext(uint64_t key)
+      : key_{ key }
+      , value_{ key } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    UpsertContext(const UpsertContext& other)
+      : key_{ other.key_ }
+      , value_{ other.value_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    /// Non-atomic and atomic Put() methods.
+    inline void Put(Value& value) {
+      value.value_ = value_;
+    }
+    inline bool PutAtomic(Value& value) {
+      value.value_ = value_;
+      return true;
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    uint64_t value_;
+  };
+
+  class ReadContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    ReadContext(uint64_t key)
+      : key_{ key }
+      , expected_{ key } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    ReadContext(const ReadContext& other)
+      : key_{ other.key_ }
+      , expected_{ other.expected_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+
+    inline void Get(const Value& value) {
+      ASSERT_EQ(expected_, value.value_);
+    }
+    inline void GetAtomic(const Value& value) {
+      ASSERT_EQ(expected_, value.value_);
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    uint64_t expected_;
+  };
+
+  std::experimental::filesystem::create_directories("logs");
+
+  // 8 pages!
+  FasterKv<Key, Value, disk_t> store{ 262144, 268435456, "logs", 0.5 };
+
+  Guid session_id = store.StartSession();
+
+  constexpr size_t kNumRecords = 500000;
+  constexpr size_t kNumChains = 4096;
+
+  // Insert.
+  for(size_t idx = 0; idx < kNumRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // Upserts don't go to disk.
+      ASSERT_TRUE(false);
+    };
+
+    if(idx % 256 == 0) {
+      store.Refresh();
+    }
+
+    UpsertContext context{ idx };
+    Status result = store.Upsert(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+
+  // Read some keys that are on disk, at the bottom of their chains.
+  static std::atomic<uint64_t> records_read{ 0 };
+  for(size_t idx = 0; idx < 256; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      CallbackContext<ReadContext> context{ ctxt };
+      ASSERT_EQ(Status::Ok, result);
+      ++records_read;
+    };
+
+    ReadContext context{ idx };
+    Status result = store.Read(context, callback, 1);
+    ASSERT_EQ(Status::Pending, result);
+  }
+  bool result = store.CompletePending(true);
+  ASSERT_TRUE(result);
+  ASSERT_EQ(256, records_read.load());
+
+  // Read keys that aren't in the store, one per chain. Without the log's filters, each of these
+  // would walk its chain's records on disk, one read at a time.
+  Statistics before = store.GetStatistics();
+  static std::atomic<uint64_t> records_not_found{ 0 };
+  for(size_t idx = kNumRecords; idx < kNumRecords + kNumChains; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      CallbackContext<ReadContext> context{ ctxt };
+      ASSERT_EQ(Status::NotFound, result);
+      ++records_not_found;
+    };
+
+    if(idx % 256 == 0) {
+      store.Refresh();
+    }
+
+    ReadContext context{ idx };
+    Status result = store.Read(context, callback, 1);
+    if(result == Status::NotFound) {
+      ++records_not_found;
+    } else {
+      ASSERT_EQ(Status::Pending, result);
+    }
+  }
+  result = store.CompletePending(true);
+  ASSERT_TRUE(result);
+  ASSERT_EQ(kNumChains, records_not_found.load());
+
+  Statistics after = store.GetStatistics();
+  uint64_t pending = after.ops.pending - before.ops.pending;
+  uint64_t io_reads = after.ops.io_reads - before.ops.io_reads;
+  ASSERT_GT(pending, kNumChains / 2);
+  ASSERT_LT(io_reads, pending);
+
+  store.StopSession();
+}
+
+TEST(CLASS, UpsertDeleteRead_Serial) {
+  class Key {
+   public:
+    Key(uint64_t pt1, uint64_t pt2)
+      : pt1_{ pt1 }
+      , pt2_{ pt2 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      std::hash<uint64_t> hash_fn;
+      return KeyHash{ hash_fn(pt1_) };
+    }
+
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return pt1_ == other.pt1_ &&
+             pt2_ == other.pt2_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return pt1_ != other.pt1_ ||
+             pt2_ != other.pt2_;
+    }
+
+   private:
+    uint64_t pt1_;
+    uint64_t pt2_;
+  };
+
+  class UpsertContext;
+  class ReadContext;
+  class DeleteContext;
+
+  class Value {
+   public:
+    Value()
+      : gen_{ 0 }
+      , value_{ 0 }
+      , length_{ 0 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Value));
+    }
+
+    friend class UpsertContext;
+    friend class ReadContext;
+    friend class DeleteContext;
+
+   private:
+    std::atomic<uint64_t> gen_;
+    uint8_t value_[1014];
+    uint16_t length_;
+  };
+  static_assert(sizeof(Value) == 1024, "sizeof(Value) != 1024");
+  static_assert(alignof(Value) == 8, "alignof(Value) != 8");
+
+  class UpsertContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    UpsertContext(const Key& key, uint8_t val)
+      : key_{ key }
+      , val_{ val } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    UpsertContext(const UpsertContext& other)
+      : key_{ other.key_ }
+      , val_{ other.val_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    inline static constexpr uint32_t value_size(const Value& old_value) {
+      return sizeof(value_t);
+    }
+    /// Non-atomic and atomic Put() methods.
+    inline void Put(Value& value) {
+      value.gen_ = 0;
+      std::memset(value.value_, val_, val_);
+      value.length_ = val_;
+    }
+    inline bool PutAtomic(Value& value) {
+      // Get the lock on the value.
+      uint64_t expected_gen;
+      bool success;
+      do {
+        do {
+          // Spin until other the thread releases the lock.
+          expected_gen = value.gen_.load();
+        } while(expected_gen == UINT64_MAX);
+        // Try to get the lock.
+        success = value.gen_.compare_exchange_weak(expected_gen, UINT64_MAX);
+      } while(!success);
+
+      std::memset(value.value_, val_, val_);
+      value.length_ = val_;
+      // Increment the value's generation number.
+      value.gen_.store(expected_gen + 1);
+      return true;
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    uint8_t val_;
+  };
+
+  class ReadContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    ReadContext(Key key, uint8_t expected)
+      : key_{ key }
+      , expected_{ expected } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    ReadContext(const ReadContext& other)
+      : key_{ other.key_ }
+      , expected_{ other.expected_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+
+    inline void Get(const Value& value) {
+      // This is a paging test, so we expect to read stuff from disk.
+      ASSERT_EQ(expected_, value.length_);
+      ASSERT_EQ(expected_, value.value_[expected_ - 5]);
+    }
+    inline void GetAtomic(const Value& value) {
+      uint64_t post_gen = value.gen_.load();
+      uint64_t pre_gen;
+      uint16_t len;
+      uint8_t val;
+      do {
+        // Pre- gen # for this read is last read's post- gen #.
+        pre_gen = post_gen;
+        len = value.length_;
+        val = value.value_[len - 5];
+        post_gen = value.gen_.load();
+      } while(pre_gen != post_gen);
+      ASSERT_EQ(expected_, static_cast<uint8_t>(len));
+      ASSERT_EQ(expected_, val);
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    uint8_t expected_;
+  };
+
+  class DeleteContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    DeleteContext(const Key& key)
+      : key_{ key } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    DeleteContext(const DeleteContext& other)
+      : key_{ other.key_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+  };
+
+  std::experimental::filesystem::create_directories("logs");
+
+  // 8 pages!
+  FasterKv<Key, Value, disk_t> store{ 262144, 268435456, "logs", 0.5 };
+
+  Guid session_id = store.StartSession();
+
+  constexpr size_t kNumRecords = 250000;
+
+  // Insert.
+  for(size_t idx = 0; idx < kNumRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // Upserts don't go to disk.
+      ASSERT_TRUE(false);
+    };
+
+    if(idx % 256 == 0) {
+      store.Refresh();
+    }
+
+    UpsertContext context{ Key{idx, idx}, 25 };
+    Status result = store.Upsert(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  // Delete every other record. Most of them are no longer mutable (or even in memory), so this
+  // appends tombstones, and pushes the older tombstones out to disk.
+  for(size_t idx = 1; idx < kNumRecords; idx += 2) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // Deletes don't go to disk.
+      ASSERT_TRUE(false);
+    };
+
+    if(idx % 256 == 1) {
+      store.Refresh();
+    }
+
+    DeleteContext context{ Key{ idx, idx } };
+    Status result = store.Delete(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  // Read.
+  static std::atomic<uint64_t> records_read{ 0 };
+  static std::atomic<uint64_t> records_not_found{ 0 };
+  for(size_t idx = 0; idx < kNumRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      CallbackContext<ReadContext> context{ ctxt };
+      if(result == Status::Ok) {
+        ++records_read;
+      } else {
+        ASSERT_EQ(Status::NotFound, result);
+        ++records_not_found;
+      }
+    };
+
+    if(idx % 256 == 0) {
+      store.Refresh();
+    }
+
+    ReadContext context{ Key{ idx, idx}, 25 };
+    Status result = store.Read(context, callback, 1);
+    if(result == Status::Ok) {
+      ASSERT_EQ(0, idx % 2);
+      ++records_read;
+    } else if(result == Status::NotFound) {
+      ASSERT_EQ(1, idx % 2);
+      ++records_not_found;
+    } else {
+      ASSERT_EQ(Status::Pending, result);
+    }
+  }
+
+  bool result = store.CompletePending(true);
+  ASSERT_TRUE(result);
+  ASSERT_EQ(kNumRecords / 2, records_read.load());
+  ASSERT_EQ(kNumRecords / 2, records_not_found.load());
+
+  store.StopSession();
+}
+
+TEST(CLASS, UpsertRead_CopyReadsToTail) {
+  class Key {
+   public:
+    Key(uint64_t pt1, uint64_t pt2)
+      : pt1_{ pt1 }
+      , pt2_{ pt2 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      std::hash<uint64_t> hash_fn;
+      return KeyHash{ hash_fn(pt1_) };
+    }
+
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return pt1_ == other.pt1_ &&
+             pt2_ == other.pt2_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return pt1_ != other.pt1_ ||
+             pt2_ != other.pt2_;
+    }
+
+   private:
+    uint64_t pt1_;
+    uint64_t pt2_;
+  };
+
+  class UpsertContext;
+  class ReadContext;
+
+  class Value {
+   public:
+    Value()
+      : gen_{ 0 }
+      , value_{ 0 }
+      , length_{ 0 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Value));
+    }
+
+    friend class UpsertContext;
+    friend class ReadContext;
+
+   private:
+    std::atomic<uint64_t> gen_;
+    uint8_t value_[1014];
+    uint16_t length_;
+  };
+  static_assert(sizeof(Value) == 1024, "sizeof(Value) != 1024");
+  static_assert(alignof(Value) == 8, "alignof(Value) != 8");
+
+  class UpsertContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    UpsertContext(const Key& key, uint8_t val)
+      : key_{ key }
+      , val_{ val } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    UpsertContext(const UpsertContext& other)
+      : key_{ other.key_ }
+      , val_{ other.val_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    inline static constexpr uint32_t value_size(const Value& old_value) {
+      return sizeof(value_t);
+    }
+    /// Non-atomic and atomic Put() methods.
+    inline void Put(Value& value) {
+      value.gen_ = 0;
+      std::memset(value.value_, val_, val_);
+      value.length_ = val_;
+    }
+    inline bool PutAtomic(Value& value) {
+      // Get the lock on the value.
+      uint64_t expected_gen;
+      bool success;
+      do {
+        do {
+          // Spin until other the thread releases the lock.
+          expected_gen = value.gen_.load();
+        } while(expected_gen == UINT64_MAX);
+        // Try to get the lock.
+        success = value.gen_.compare_exchange_weak(expected_gen, UINT64_MAX);
+      } while(!success);
+
+      std::memset(value.value_, val_, val_);
+      value.length_ = val_;
+      // Increment the value's generation number.
+      value.gen_.store(expected_gen + 1);
+      return true;
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    uint8_t val_;
+  };
+
+  class ReadContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    ReadContext(Key key, uint8_t expected)
+      : key_{ key }
+      , expected_{ expected } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    ReadContext(const ReadContext& other)
+      : key_{ other.key_ }
+      , expected_{ other.expected_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+
+    inline void Get(const Value& value) {
+      // This is a paging test, so we expect to read stuff from disk.
+      ASSERT_EQ(expected_, value.length_);
+      ASSERT_EQ(expected_, value.value_[expected_ - 5]);
+    }
+    inline void GetAtomic(const Value& value) {
+      uint64_t post_gen = value.gen_.load();
+      uint64_t pre_gen;
+      uint16_t len;
+      uint8_t val;
+      do {
+        // Pre- gen # for this read is last read's post- gen #.
+        pre_gen = post_gen;
+        len = value.length_;
+        val = value.value_[len - 5];
+        post_gen = value.gen_.load();
+      } while(pre_gen != post_gen);
+      ASSERT_EQ(expected_, static_cast<uint8_t>(len));
+      ASSERT_EQ(expected_, val);
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    uint8_t expected_;
+  };
+
+  std::experimental::filesystem::create_directories("logs");
+
+  // 8 pages! Copy records read from disk to the tail of the log.
+  FasterKv<Key, Value, disk_t> store{ 262144, 268435456, "logs", 0.5, true };
+
+  Guid session_id = store.StartSession();
+
+  constexpr size_t kNumRecords = 250000;
+  constexpr size_t kNumHotRecords = 1000;
+
+  // Insert.
+  for(size_t idx = 0; idx < kNumRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // Upserts don't go to disk.
+      ASSERT_TRUE(false);
+    };
+
+    if(idx % 256 == 0) {
+      store.Refresh();
+    }
+
+    UpsertContext context{ Key{idx, idx}, 25 };
+    Status result = store.Upsert(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  // Read the oldest records, which have been evicted to disk.
+  static std::atomic<uint64_t> records_read{ 0 };
+  for(size_t idx = 0; idx < kNumHotRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      CallbackContext<ReadContext> context{ ctxt };
+      ASSERT_EQ(Status::Ok, result);
+      ++records_read;
+    };
+
+    ReadContext context{ Key{ idx, idx}, 25 };
+    Status result = store.Read(context, callback, 1);
+    ASSERT_EQ(Status::Pending, result);
+  }
+
+  bool result = store.CompletePending(true);
+  ASSERT_TRUE(result);
+  ASSERT_EQ(kNumHotRecords, records_read.load());
+
+  // Read them again; now they're served from the tail of the log.
+  for(size_t idx = 0; idx < kNumHotRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // The records were copied to memory.
+      ASSERT_TRUE(false);
+    };
+
+    ReadContext context{ Key{ idx, idx}, 25 };
+    Status result = store.Read(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+
+  store.StopSession();
+}
+
+TEST(CLASS, UpsertDeleteCompact_Serial) {
+  class Key {
+   public:
+    Key(uint64_t pt1, uint64_t pt2)
+      : pt1_{ pt1 }
+      , pt2_{ pt2 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      std::hash<uint64_t> hash_fn;
+      return KeyHash{ hash_fn(pt1_) };
+    }
+
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return pt1_ == other.pt1_ &&
+             pt2_ == other.pt2_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return pt1_ != other.pt1_ ||
+             pt2_ != other.pt2_;
+    }
+
+   private:
+    uint64_t pt1_;
+    uint64_t pt2_;
+  };
+
+  class UpsertContext;
+  class ReadContext;
+  class DeleteContext;
+
+  class Value {
+   public:
+    Value()
+      : gen_{ 0 }
+      , value_{ 0 }
+      , length_{ 0 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Value));
+    }
+
+    friend class UpsertContext;
+    friend class ReadContext;
+    friend class DeleteContext;
+
+   private:
+    std::atomic<uint64_t> gen_;
+    uint8_t value_[1014];
+    uint16_t length_;
+  };
+  static_assert(sizeof(Value) == 1024, "sizeof(Value) != 1024");
+  static_assert(alignof(Value) == 8, "alignof(Value) != 8");
+
+  class UpsertContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    UpsertContext(const Key& key, uint8_t val)
+      : key_{ key }
+      , val_{ val } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    UpsertContext(const UpsertContext& other)
+      : key_{ other.key_ }
+      , val_{ other.val_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    inline static constexpr uint32_t value_size(const Value& old_value) {
+      return sizeof(value_t);
+    }
+    /// Non-atomic and atomic Put() methods.
+    inline void Put(Value& value) {
+      value.gen_ = 0;
+      std::memset(value.value_, val_, val_);
+      value.length_ = val_;
+    }
+    inline bool PutAtomic(Value& value) {
+      // Get the lock on the value.
+      uint64_t expected_gen;
+      bool success;
+      do {
+        do {
+          // Spin until other the thread releases the lock.
+          expected_gen = value.gen_.load();
+        } while(expected_gen == UINT64_MAX);
+        // Try to get the lock.
+        success = value.gen_.compare_exchange_weak(expected_gen, UINT64_MAX);
+      } while(!success);
+
+      std::memset(value.value_, val_, val_);
+      value.length_ = val_;
+      // Increment the value's generation number.
+      value.gen_.store(expected_gen + 1);
+      return true;
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    uint8_t val_;
+  };
+
+  class ReadContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    ReadContext(Key key, uint8_t expected)
+      : key_{ key }
+      , expected_{ expected } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    ReadContext(const ReadContext& other)
+      : key_{ other.key_ }
+      , expected_{ other.expected_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+
+    inline void Get(const Value& value) {
+      // This is a paging test, so we expect to read stuff from disk.
+      ASSERT_EQ(expected_, value.length_);
+      ASSERT_EQ(expected_, value.value_[expected_ - 5]);
+    }
+    inline void GetAtomic(const Value& value) {
+      uint64_t post_gen = value.gen_.load();
+      uint64_t pre_gen;
+      uint16_t len;
+      uint8_t val;
+      do {
+        // Pre- gen # for this read is last read's post- gen #.
+        pre_gen = post_gen;
+        len = value.length_;
+        val = value.value_[len - 5];
+        post_gen = value.gen_.load();
+      } while(pre_gen != post_gen);
+      ASSERT_EQ(expected_, static_cast<uint8_t>(len));
+      ASSERT_EQ(expected_, val);
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    uint8_t expected_;
+  };
+
+  class DeleteContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    DeleteContext(const Key& key)
+      : key_{ key } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    DeleteContext(const DeleteContext& other)
+      : key_{ other.key_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+  };
+
+  std::experimental::filesystem::create_directories("logs");
+
+  // 8 pages!
+  FasterKv<Key, Value, disk_t> store{ 262144, 268435456, "logs", 0.5 };
+
+  Guid session_id = store.StartSession();
+
+  constexpr size_t kNumRecords = 250000;
+
+  // Insert.
+  for(size_t idx = 0; idx < kNumRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // Upserts don't go to disk.
+      ASSERT_TRUE(false);
+    };
+
+    if(idx % 256 == 0) {
+      store.Refresh();
+    }
+
+    UpsertContext context{ Key{idx, idx}, 25 };
+    Status result = store.Upsert(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  Address until_address{ store.Size() };
+
+  // Update every other record, and delete every third; so the log below the until address holds
+  // a mix of live and dead records.
+  for(size_t idx = 0; idx < kNumRecords; idx += 2) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // Upserts don't go to disk.
+      ASSERT_TRUE(false);
+    };
+
+    if(idx % 256 == 0) {
+      store.Refresh();
+    }
+
+    UpsertContext context{ Key{ idx, idx }, 87 };
+    Status result = store.Upsert(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  for(size_t idx = 0; idx < kNumRecords; idx += 3) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // Deletes don't go to disk.
+      ASSERT_TRUE(false);
+    };
+
+    if(idx % 256 == 0) {
+      store.Refresh();
+    }
+
+    DeleteContext context{ Key{ idx, idx } };
+    Status result = store.Delete(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+
+  // Compact, and wait for the log to be truncated.
+  static std::atomic<bool> compacted{ false };
+  auto complete_callback = []() {
+    compacted = true;
+  };
+  ASSERT_TRUE(store.Compact(until_address, nullptr, complete_callback));
+  while(!compacted) {
+    store.CompletePending(false);
+  }
+  ASSERT_EQ(until_address, store.hlog.begin_address.load());
+
+  // Read.
+  static std::atomic<uint64_t> records_read{ 0 };
+  static std::atomic<uint64_t> records_not_found{ 0 };
+  for(size_t idx = 0; idx < kNumRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      CallbackContext<ReadContext> context{ ctxt };
+      if(result == Status::Ok) {
+        ++records_read;
+      } else {
+        ASSERT_EQ(Status::NotFound, result);
+        ++records_not_found;
+      }
+    };
+
+    if(idx % 256 == 0) {
+      store.Refresh();
+    }
+
+    ReadContext context{ Key{ idx, idx}, static_cast<uint8_t>(idx % 2 == 0 ? 87 : 25) };
+    Status result = store.Read(context, callback, 1);
+    if(result == Status::Ok) {
+      ++records_read;
+    } else if(result == Status::NotFound) {
+      ++records_not_found;
+    } else {
+      ASSERT_EQ(Status::Pending, result);
+    }
+  }
+
+  bool result = store.CompletePending(true);
+  ASSERT_TRUE(result);
+  constexpr size_t kNumDeleted = (kNumRecords + 2) / 3;
+  ASSERT_EQ(kNumRecords - kNumDeleted, records_read.load());
+  ASSERT_EQ(kNumDeleted, records_not_found.load());
+
+  store.StopSession();
+}
+
+TEST(CLASS, UpsertShrinkIndexRead_Serial) {
+  class Key {
+   public:
+    Key(uint64_t pt1, uint64_t pt2)
+      : pt1_{ pt1 }
+      , pt2_{ pt2 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      // Use only a few distinct tags, so that buckets that get merged hold chains with the same
+      // tag.
+      return KeyHash{ (Utility::GetHashCode(pt1_) & (((uint64_t)1 << 48) - 1)) |
+                      ((pt1_ % 5) << 48) };
+    }
+
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return pt1_ == other.pt1_ &&
+             pt2_ == other.pt2_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return pt1_ != other.pt1_ ||
+             pt2_ != other.pt2_;
+    }
+
+   private:
+    uint64_t pt1_;
+    uint64_t pt2_;
+  };
+
+  class UpsertContext;
+  class ReadContext;
+
+  class Value {
+   public:
+    Value()
+      : gen_{ 0 }
+      , value_{ 0 }
+      , length_{ 0 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Value));
+    }
+
+    friend class UpsertContext;
+    friend class ReadContext;
+
+   private:
+    std::atomic<uint64_t> gen_;
+    uint8_t value_[1014];
+    uint16_t length_;
+  };
+  static_assert(sizeof(Value) == 1024, "sizeof(Value) != 1024");
+  static_assert(alignof(Value) == 8, "alignof(Value) != 8");
+
+  class UpsertContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    UpsertContext(const Key& key, uint8_t val)
+      : key_{ key }
+      , val_{ val } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    UpsertContext(const UpsertContext& other)
+      : key_{ other.key_ }
+      , val_{ other.val_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    inline static constexpr uint32_t value_size(const Value& old_value) {
+      return sizeof(value_t);
+    }
+    /// Non-atomic and atomic Put() methods.
+    inline void Put(Value& value) {
+      value.gen_ = 0;
+      std::memset(value.value_, val_, val_);
+      value.length_ = val_;
+    }
+    inline bool PutAtomic(Value& value) {
+      // Get the lock on the value.
+      uint64_t expected_gen;
+      bool success;
+      do {
+        do {
+          // Spin until other the thread releases the lock.
+          expected_gen = value.gen_.load();
+        } while(expected_gen == UINT64_MAX);
+        // Try to get the lock.
+        success = value.gen_.compare_exchange_weak(expected_gen, UINT64_MAX);
+      } while(!success);
+
+      std::memset(value.value_, val_, val_);
+      value.length_ = val_;
+      // Increment the value's generation number.
+      value.gen_.store(expected_gen + 1);
+      return true;
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    uint8_t val_;
+  };
+
+  class ReadContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    ReadContext(Key key, uint8_t expected)
+      : key_{ key }
+      , expected_{ expected } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    ReadContext(const ReadContext& other)
+      : key_{ other.key_ }
+      , expected_{ other.expected_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+
+    inline void Get(const Value& value) {
+      // This is a paging test, so we expect to read stuff from disk.
+      ASSERT_EQ(expected_, value.length_);
+      ASSERT_EQ(expected_, value.value_[expected_ - 5]);
+    }
+    inline void GetAtomic(const Value& value) {
+      uint64_t post_gen = value.gen_.load();
+      uint64_t pre_gen;
+      uint16_t len;
+      uint8_t val;
+      do {
+        // Pre- gen # for this read is last read's post- gen #.
+        pre_gen = post_gen;
+        len = value.length_;
+        val = value.value_[len - 5];
+        post_gen = value.gen_.load();
+      } while(pre_gen != post_gen);
+      ASSERT_EQ(expected_, static_cast<uint8_t>(len));
+      ASSERT_EQ(expected_, val);
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    uint8_t expected_;
+  };
+
+  std::experimental::filesystem::create_directories("logs");
+
+  // 8 pages!
+  FasterKv<Key, Value, disk_t> store{ 2048, 268435456, "logs", 0.5 };
+
+  Guid session_id = store.StartSession();
+
+  constexpr size_t kNumRecords = 250000;
+
+  // Insert.
+  for(size_t idx = 0; idx < kNumRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // Upserts don't go to disk.
+      ASSERT_TRUE(false);
+    };
+
+    if(idx % 256 == 0) {
+      store.Refresh();
+    }
+
+    UpsertContext context{ Key{ idx, idx }, 25 };
+    Status result = store.Upsert(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  // Update every other record, so that some chains have records both in memory and on disk.
+  for(size_t idx = 0; idx < kNumRecords; idx += 2) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // Upserts don't go to disk.
+      ASSERT_TRUE(false);
+    };
+
+    if(idx % 256 == 0) {
+      store.Refresh();
+    }
+
+    UpsertContext context{ Key{ idx, idx }, 87 };
+    Status result = store.Upsert(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+
+  // Shrink the index; chains with the same tag are merged by copying records (some of them read
+  // from disk) to the tail of the log.
+  static std::atomic<bool> shrink_done{ false };
+  static std::atomic<uint64_t> table_size{ 0 };
+  auto shrink_callback = [](uint64_t new_size) {
+    table_size = new_size;
+    shrink_done = true;
+  };
+  ASSERT_TRUE(store.ShrinkIndex(shrink_callback));
+  while(!shrink_done) {
+    store.Refresh();
+    std::this_thread::yield();
+  }
+  ASSERT_EQ(1024, table_size.load());
+
+  // Read.
+  static std::atomic<uint64_t> records_read{ 0 };
+  for(size_t idx = 0; idx < kNumRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      CallbackContext<ReadContext> context{ ctxt };
+      ASSERT_EQ(Status::Ok, result);
+      ++records_read;
+    };
+
+    if(idx % 256 == 0) {
+      store.Refresh();
+    }
+
+    ReadContext context{ Key{ idx, idx}, static_cast<uint8_t>(idx % 2 == 0 ? 87 : 25) };
+    Status result = store.Read(context, callback, 1);
+    if(result == Status::Ok) {
+      ++records_read;
+    } else {
+      ASSERT_EQ(Status::Pending, result) << idx;
+    }
+  }
+
+  bool result = store.CompletePending(true);
+  ASSERT_TRUE(result);
+  ASSERT_EQ(kNumRecords, records_read.load());
+
+  store.StopSession();
+}
+
+TEST(CLASS, UpsertScan_Serial) {
+  class Key {
+   public:
+    Key(uint64_t pt1, uint64_t pt2)
+      : pt1_{ pt1 }
+      , pt2_{ pt2 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      std::hash<uint64_t> hash_fn;
+      return KeyHash{ hash_fn(pt1_) };
+    }
+
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return pt1_ == other.pt1_ &&
+             pt2_ == other.pt2_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return pt1_ != other.pt1_ ||
+             pt2_ != other.pt2_;
+    }
+
+    inline uint64_t pt1() const {
+      return pt1_;
+    }
+    inline uint64_t pt2() const {
+      return pt2_;
+    }
+
+   private:
+    uint64_t pt1_;
+    uint64_t pt2_;
+  };
+
+  class UpsertContext;
+
+  class Value {
+   public:
+    Value()
+      : gen_{ 0 }
+      , value_{ 0 }
+      , length_{ 0 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Value));
+    }
+
+    inline uint16_t length() const {
+      return length_;
+    }
+    inline uint8_t last() const {
+      return value_[length_ - 5];
+    }
+
+    friend class UpsertContext;
+
+   private:
+    std::atomic<uint64_t> gen_;
+    uint8_t value_[1014];
+    uint16_t length_;
+  };
+  static_assert(sizeof(Value) == 1024, "sizeof(Value) != 1024");
+  static_assert(alignof(Value) == 8, "alignof(Value) != 8");
+
+  class UpsertContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    UpsertContext(const Key& key, uint8_t val)
+      : key_{ key }
+      , val_{ val } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    UpsertContext(const UpsertContext& other)
+      : key_{ other.key_ }
+      , val_{ other.val_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    inline static constexpr uint32_t value_size(const Value& old_value) {
+      return sizeof(value_t);
+    }
+    /// Non-atomic and atomic Put() methods.
+    inline void Put(Value& value) {
+      value.gen_ = 0;
+      std::memset(value.value_, val_, val_);
+      value.length_ = val_;
+    }
+    inline bool PutAtomic(Value& value) {
+      // No concurrent updates in this test.
+      Put(value);
+      return true;
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    uint8_t val_;
+  };
+
+  typedef FasterKv<Key, Value, disk_t> store_t;
+
+  std::experimental::filesystem::create_directories("logs");
+
+  // 8 pages!
+  store_t store{ 262144, 268435456, "logs", 0.5 };
+
+  Guid session_id = store.StartSession();
+
+  constexpr size_t kNumRecords = 250000;
+
+  // Insert.
+  for(size_t idx = 0; idx < kNumRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // Upserts don't go to disk.
+      ASSERT_TRUE(false);
+    };
+
+    if(idx % 256 == 0) {
+      store.Refresh();
+    }
+
+    UpsertContext context{ Key{ idx, idx }, static_cast<uint8_t>(25 + idx % 64) };
+    Status result = store.Upsert(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  // Some of the log has been evicted to disk; the rest is still in memory.
+  ASSERT_LT(store.hlog.begin_address.load(), store.hlog.head_address.load());
+
+  // The scan stops at the safe read-only address, so make the whole log read-only first.
+  Address tail_address = store.hlog.ShiftReadOnlyToTail();
+  while(store.hlog.safe_read_only_address.load() < tail_address) {
+    store.Refresh();
+  }
+
+  // Scan the whole log, from the begin address to the tail; the records come back in insertion
+  // order.
+  {
+    store_t::scan_iterator_t iterator{ store.hlog, store.disk,
+                                       store.hlog.begin_address.load() };
+    Address address;
+    size_t idx = 0;
+    for(const auto* record = iterator.GetNext(address); record;
+        record = iterator.GetNext(address)) {
+      ASSERT_EQ(idx, record->key().pt1());
+      ASSERT_EQ(idx, record->key().pt2());
+      uint8_t expected = static_cast<uint8_t>(25 + idx % 64);
+      ASSERT_EQ(expected, record->value().length());
+      ASSERT_EQ(expected, record->value().last());
+      ++idx;
+    }
+    ASSERT_EQ(Status::Ok, iterator.status());
+    ASSERT_EQ(kNumRecords, idx);
+  }
+
+  // Scan a sub-range that starts in the middle of a page on disk, and ends in memory.
+  {
+    Address begin_address{ 2, 12345 };
+    Address end_address = store.hlog.read_only_address.load();
+    store_t::scan_iterator_t iterator{ store.hlog, store.disk, begin_address, end_address };
+    Address address;
+    Address prev_address = Address::kInvalidAddress;
+    size_t num_records = 0;
+    for(const auto* record = iterator.GetNext(address); record;
+        record = iterator.GetNext(address)) {
+      ASSERT_GE(address, begin_address);
+      ASSERT_LT(address, end_address);
+      ASSERT_GT(address, prev_address);
+      if(prev_address != Address::kInvalidAddress && address.page() == prev_address.page()) {
+        // Records are packed contiguously within a page.
+        ASSERT_EQ(prev_address.control() + record->size(), address.control());
+      }
+      prev_address = address;
+      ++num_records;
+    }
+    ASSERT_EQ(Status::Ok, iterator.status());
+    ASSERT_GT(num_records, 0);
+  }
+
+  store.StopSession();
+}
+
+TEST(CLASS, UpsertScan_Concurrent) {
+  class Key {
+   public:
+    Key(uint64_t pt1, uint64_t pt2)
+      : pt1_{ pt1 }
+      , pt2_{ pt2 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      std::hash<uint64_t> hash_fn;
+      return KeyHash{ hash_fn(pt1_) };
+    }
+
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return pt1_ == other.pt1_ &&
+             pt2_ == other.pt2_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return pt1_ != other.pt1_ ||
+             pt2_ != other.pt2_;
+    }
+
+    inline uint64_t pt1() const {
+      return pt1_;
+    }
+    inline uint64_t pt2() const {
+      return pt2_;
+    }
+
+   private:
+    uint64_t pt1_;
+    uint64_t pt2_;
+  };
+
+  class UpsertContext;
+
+  class Value {
+   public:
+    Value()
+      : gen_{ 0 }
+      , value_{ 0 }
+      , length_{ 0 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Value));
+    }
+
+    inline uint16_t length() const {
+      return length_;
+    }
+    inline uint8_t last() const {
+      return value_[length_ - 5];
+    }
+
+    friend class UpsertContext;
+
+   private:
+    std::atomic<uint64_t> gen_;
+    uint8_t value_[1014];
+    uint16_t length_;
+  };
+  static_assert(sizeof(Value) == 1024, "sizeof(Value) != 1024");
+  static_assert(alignof(Value) == 8, "alignof(Value) != 8");
+
+  class UpsertContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    UpsertContext(const Key& key, uint8_t val)
+      : key_{ key }
+      , val_{ val } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    UpsertContext(const UpsertContext& other)
+      : key_{ other.key_ }
+      , val_{ other.val_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    inline static constexpr uint32_t value_size(const Value& old_value) {
+      return sizeof(value_t);
+    }
+    /// Non-atomic and atomic Put() methods.
+    inline void Put(Value& value) {
+      value.gen_ = 0;
+      std::memset(value.value_, val_, val_);
+      value.length_ = val_;
+    }
+    inline bool PutAtomic(Value& value) {
+      // Each key is written once.
+      Put(value);
+      return true;
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    uint8_t val_;
+  };
+
+  typedef FasterKv<Key, Value, disk_t> store_t;
+
+  std::experimental::filesystem::create_directories("logs");
+
+  // 8 pages!
+  store_t store{ 262144, 268435456, "logs", 0.5 };
+
+  static constexpr size_t kNumRecords = 250000;
+  static constexpr size_t kNumThreads = 4;
+  static std::atomic<size_t> num_done{ 0 };
+  num_done = 0;
+
+  auto upsert_worker = [](store_t* store_, size_t thread_idx) {
+    Guid session_id = store_->StartSession();
+    for(size_t idx = 0; idx < kNumRecords / kNumThreads; ++idx) {
+      auto callback = [](IAsyncContext* ctxt, Status result) {
+        // Upserts don't go to disk.
+        ASSERT_TRUE(false);
+      };
+
+      if(idx % 256 == 0) {
+        store_->Refresh();
+      }
+
+      size_t key = thread_idx * (kNumRecords / kNumThreads) + idx;
+      UpsertContext context{ Key{ key, key }, static_cast<uint8_t>(25 + key % 64) };
+      Status result = store_->Upsert(context, callback, 1);
+      ASSERT_EQ(Status::Ok, result);
+    }
+    store_->StopSession();
+    ++num_done;
+  };
+
+  // Scans the log while it's being appended to; every record returned must be whole.
+  auto scan = [](store_t& store_, Address begin_address) {
+    store_t::scan_iterator_t iterator{ store_.hlog, store_.disk, begin_address };
+    Address address;
+    size_t num_records = 0;
+    for(const auto* record = iterator.GetNext(address); record;
+        record = iterator.GetNext(address)) {
+      uint64_t key = record->key().pt1();
+      EXPECT_EQ(key, record->key().pt2());
+      uint8_t expected = static_cast<uint8_t>(25 + key % 64);
+      EXPECT_EQ(expected, record->value().length());
+      if(record->value().length() != expected || record->key().pt2() != key) {
+        break;
+      }
+      EXPECT_EQ(expected, record->value().last());
+      if(++num_records % 256 == 0) {
+        // Let the writers' epoch actions (and page evictions) proceed.
+        store_.Refresh();
+      }
+    }
+    EXPECT_EQ(Status::Ok, iterator.status());
+    return num_records;
+  };
+
+  std::deque<std::thread> threads{};
+  for(size_t idx = 0; idx < kNumThreads; ++idx) {
+    threads.emplace_back(upsert_worker, &store, idx);
+  }
+
+  Guid session_id = store.StartSession();
+  size_t num_scans = 0;
+  while(num_done < kNumThreads) {
+    // Scan the tail page, where records are still being written.
+    scan(store, Address{ store.hlog.GetTailAddress().page(), 0 });
+    store.Refresh();
+    ++num_scans;
+  }
+  for(auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_GT(num_scans, 0);
+
+  // Once the whole log is read-only, a scan returns every record.
+  Address tail_address = store.hlog.ShiftReadOnlyToTail();
+  while(store.hlog.safe_read_only_address.load() < tail_address) {
+    store.Refresh();
+  }
+  ASSERT_EQ(kNumRecords, scan(store, store.hlog.begin_address.load()));
+
+  store.StopSession();
+}
+
+TEST(CLASS, UpsertShiftReadOnly_Serial) {
+  class Key {
+   public:
+    Key(uint64_t pt1, uint64_t pt2)
+      : pt1_{ pt1 }
+      , pt2_{ pt2 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Key));
+    }
+    inline KeyHash GetHash() const {
+      std::hash<uint64_t> hash_fn;
+      return KeyHash{ hash_fn(pt1_) };
+    }
+
+    /// Comparison operators.
+    inline bool operator==(const Key& other) const {
+      return pt1_ == other.pt1_ &&
+             pt2_ == other.pt2_;
+    }
+    inline bool operator!=(const Key& other) const {
+      return pt1_ != other.pt1_ ||
+             pt2_ != other.pt2_;
+    }
+
+    inline uint64_t pt1() const {
+      return pt1_;
+    }
+    inline uint64_t pt2() const {
+      return pt2_;
+    }
+
+   private:
+    uint64_t pt1_;
+    uint64_t pt2_;
+  };
+
+  class UpsertContext;
+
+  class Value {
+   public:
+    Value()
+      : gen_{ 0 }
+      , value_{ 0 }
+      , length_{ 0 } {
+    }
+
+    inline static constexpr uint32_t size() {
+      return static_cast<uint32_t>(sizeof(Value));
+    }
+
+    inline uint16_t length() const {
+      return length_;
+    }
+    inline uint8_t last() const {
+      return value_[length_ - 5];
+    }
+
+    friend class UpsertContext;
+
+   private:
+    std::atomic<uint64_t> gen_;
+    uint8_t value_[1014];
+    uint16_t length_;
+  };
+  static_assert(sizeof(Value) == 1024, "sizeof(Value) != 1024");
+  static_assert(alignof(Value) == 8, "alignof(Value) != 8");
+
+  class UpsertContext : public IAsyncContext {
+   public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    UpsertContext(const Key& key, uint8_t val)
+      : key_{ key }
+      , val_{ val } {
+    }
+
+    /// Copy (and deep-copy) constructor.
+    UpsertContext(const UpsertContext& other)
+      : key_{ other.key_ }
+      , val_{ other.val_ } {
+    }
+
+    /// The implicit and explicit interfaces require a key() accessor.
+    inline const Key& key() const {
+      return key_;
+    }
+    inline static constexpr uint32_t value_size() {
+      return sizeof(value_t);
+    }
+    inline static constexpr uint32_t value_size(const Value& old_value) {
+      return sizeof(value_t);
+    }
+    /// Non-atomic and atomic Put() methods.
+    inline void Put(Value& value) {
+      value.gen_ = 0;
+      std::memset(value.value_, val_, val_);
+      value.length_ = val_;
+    }
+    inline bool PutAtomic(Value& value) {
+      // No concurrent updates in this test.
+      Put(value);
+      return true;
+    }
+
+   protected:
+    /// The explicit interface requires a DeepCopy_Internal() implementation.
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   private:
+    Key key_;
+    uint8_t val_;
+  };
+
+  typedef FasterKv<Key, Value, disk_t> store_t;
+  typedef Record<Key, Value> record_t;
+
+  std::experimental::filesystem::create_directories("logs");
+
+  // 8 pages, of which 7 are mutable: nothing is flushed until we shift the read-only address.
+  store_t store{ 262144, 268435456, "logs", 0.9 };
+
+  Guid session_id = store.StartSession();
+
+  // About 4 pages' worth.
+  constexpr size_t kNumRecords = 120000;
+
+  for(size_t idx = 0; idx < kNumRecords; ++idx) {
+    auto callback = [](IAsyncContext* ctxt, Status result) {
+      // Upserts don't go to disk.
+      ASSERT_TRUE(false);
+    };
+
+    if(idx % 256 == 0) {
+      store.Refresh();
+    }
+
+    UpsertContext context{ Key{ idx, idx }, static_cast<uint8_t>(25 + idx % 64) };
+    Status result = store.Upsert(context, callback, 1);
+    ASSERT_EQ(Status::Ok, result);
+  }
+  ASSERT_EQ(0, store.hlog.flushed_until_address.load().page());
+
+  // Flush all the pages at once; contiguous pages are written together.
+  Address tail_address = store.hlog.ShiftReadOnlyToTail();
+  ASSERT_GE(tail_address.page(), 3u);
+  while(store.hlog.flushed_until_address.load() < tail_address) {
+    store.CompletePending(false);
+  }
+
+  // Every record on disk matches the record in memory.
+  LogFileReader<disk_t> reader{ store.disk, store.disk.log() };
+  store_t::scan_iterator_t iterator{ store.hlog, store.disk, store.hlog.begin_address.load(),
+                                     tail_address };
+  Address address;
+  size_t idx = 0;
+  for(const record_t* record = iterator.GetNext(address); record;
+      record = iterator.GetNext(address)) {
+    const record_t* disk_record = reader.ReadFullRecord<record_t>(address);
+    ASSERT_NE(nullptr, disk_record);
+    ASSERT_EQ(idx, disk_record->key().pt1());
+    ASSERT_EQ(idx, disk_record->key().pt2());
+    uint8_t expected = static_cast<uint8_t>(25 + idx % 64);
+    ASSERT_EQ(expected, disk_record->value().length());
+    ASSERT_EQ(expected, disk_record->value().last());
+    ++idx;
+  }
+  ASSERT_EQ(kNumRecords, idx);
+
+  store.StopSession();
+}
+
 TEST(CLASS, UpsertRead_Concurrent) {
   class UpsertContext;
   class ReadContext;
@@ -0,0 +1,106 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <thread>
+#include "gtest/gtest.h"
+#include "core/faster.h"
+#include "core/alloc.h"
+#include "device/file_system_disk.h"
+
+using namespace FASTER::core;
+
+typedef FASTER::environment::UringIoHandler handler_t;
+
+#define CLASS PagingTest_Uring
+
+#include "paging_test.h"
+
+#undef CLASS
+
+TEST(UringIoHandler, RegisteredBuffers) {
+  class Context : public IAsyncContext {
+   public:
+    Context(std::atomic<uint32_t>& completed_)
+      : completed{ &completed_ } {
+    }
+    /// The deep-copy constructor
+    Context(const Context& other)
+      : completed{ other.completed } {
+    }
+   protected:
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) final {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+   public:
+    std::atomic<uint32_t>* completed;
+  };
+
+  auto callback = [](IAsyncContext* ctxt, Status result, size_t bytes_transferred) {
+    CallbackContext<Context> context{ ctxt };
+    ASSERT_EQ(Status::Ok, result);
+    ASSERT_EQ(4096, bytes_transferred);
+    ++*context->completed;
+  };
+
+  static constexpr uint32_t kNumBlocks = 64;
+  static constexpr uint32_t kBlockSize = 4096;
+
+  handler_t handler{ 16 };
+  FASTER::environment::UringFile file{ "logs/uring_registered_buffers.dat" };
+  ASSERT_EQ(Status::Ok, file.Open(FASTER::environment::FileCreateDisposition::CreateOrTruncate,
+                                  FASTER::environment::FileOptions{ true, false }, &handler));
+
+  // The first half of the blocks go through a registered buffer, the second half don't.
+  uint8_t* registered = reinterpret_cast<uint8_t*>(FASTER::core::aligned_alloc(kBlockSize,
+                        kNumBlocks / 2 * kBlockSize));
+  uint8_t* unregistered = reinterpret_cast<uint8_t*>(FASTER::core::aligned_alloc(kBlockSize,
+                          kNumBlocks / 2 * kBlockSize));
+  ASSERT_EQ(Status::Ok, handler.RegisterBuffer(registered, kNumBlocks / 2 * kBlockSize));
+
+  auto block = [&](uint32_t idx) {
+    return idx < kNumBlocks / 2 ? registered + idx * kBlockSize :
+           unregistered + (idx - kNumBlocks / 2) * kBlockSize;
+  };
+
+  std::atomic<uint32_t> completed{ 0 };
+  Context context{ completed };
+  for(uint32_t idx = 0; idx < kNumBlocks; ++idx) {
+    std::memset(block(idx), idx + 1, kBlockSize);
+    ASSERT_EQ(Status::Ok, file.Write(idx * kBlockSize, kBlockSize, block(idx), context, callback));
+  }
+  while(completed.load() < kNumBlocks) {
+    handler.TryComplete();
+  }
+
+  // Read the blocks back, in reverse order, so that registered buffers read unregistered blocks.
+  std::memset(registered, 0, kNumBlocks / 2 * kBlockSize);
+  std::memset(unregistered, 0, kNumBlocks / 2 * kBlockSize);
+  completed = 0;
+  for(uint32_t idx = 0; idx < kNumBlocks; ++idx) {
+    ASSERT_EQ(Status::Ok, file.Read((kNumBlocks - 1 - idx) * kBlockSize, kBlockSize, block(idx),
+                                    context, callback));
+  }
+  while(completed.load() < kNumBlocks) {
+    handler.TryComplete();
+  }
+  for(uint32_t idx = 0; idx < kNumBlocks; ++idx) {
+    for(uint32_t offset = 0; offset < kBlockSize; ++offset) {
+      ASSERT_EQ(static_cast<uint8_t>(kNumBlocks - idx), block(idx)[offset]);
+    }
+  }
+
+  ASSERT_EQ(Status::Ok, file.Close());
+  ASSERT_EQ(Status::Ok, file.Delete());
+  aligned_free(registered);
+  aligned_free(unregistered);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
\ No newline at end of file
@@ -2,9 +2,24 @@
 // Licensed under the MIT license.
 
 #include <cstdint>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include "gtest/gtest.h"
 
 #include "core/auto_ptr.h"
+#include "core/checkpoint_state.h"
+#include "core/hash_bucket.h"
+#include "core/key_hash.h"
+#include "core/light_epoch.h"
+#include "core/log_filters.h"
+#include "core/memory_policy.h"
+#include "core/pending_queues.h"
+#include "core/record_size_predictor.h"
 
 using namespace FASTER::core;
 
@@ -19,6 +34,457 @@ TEST(UtilityTest, NextPowerOfTwo) {
   EXPECT_EQ(8, next_power_of_two(8));
 }
 
+TEST(UtilityTest, HashBucketProbe) {
+  HashBucket bucket;
+  EXPECT_EQ(0x7F, bucket.FreeEntries());
+  EXPECT_EQ(0, bucket.TagEntries(0, true));
+  EXPECT_EQ(0, bucket.TagEntries(5, true));
+
+  bucket.entries[1].store(HashBucketEntry{ Address{ 1000 }, 5, false });
+  bucket.entries[3].store(HashBucketEntry{ Address{ 2000 }, 0x3FFF, false });
+  bucket.entries[4].store(HashBucketEntry{ Address{ 3000 }, 5, true });
+  bucket.entries[6].store(HashBucketEntry{ Address{ 4000 }, 0, false });
+  // The overflow entry is never part of a probe's result.
+  bucket.overflow_entry.store(HashBucketOverflowEntry{ FixedPageAddress{ 0 } });
+
+  EXPECT_EQ(0x25, bucket.FreeEntries());
+  EXPECT_EQ(0x02, bucket.TagEntries(5, false));
+  EXPECT_EQ(0x12, bucket.TagEntries(5, true));
+  EXPECT_EQ(0x08, bucket.TagEntries(0x3FFF, false));
+  EXPECT_EQ(0x40, bucket.TagEntries(0, true));
+  EXPECT_EQ(0, bucket.TagEntries(6, true));
+
+  for(uint32_t idx = 0; idx < HashBucket::kNumEntries; ++idx) {
+    bucket.entries[idx].store(HashBucketEntry{ Address{ idx + 1 }, 7, false });
+  }
+  EXPECT_EQ(0, bucket.FreeEntries());
+  EXPECT_EQ(0x7F, bucket.TagEntries(7, false));
+}
+
+TEST(UtilityTest, Crc32c) {
+  // Standard check value.
+  const char* check = "123456789";
+  EXPECT_EQ(0xE3069283, Utility::Crc32c(reinterpret_cast<const uint8_t*>(check),
+                                        std::strlen(check)));
+  EXPECT_EQ(0, Utility::Crc32c(nullptr, 0));
+
+  // Whichever implementation runs, it must match a bitwise CRC, at every length and alignment.
+  uint8_t bytes[64];
+  for(uint32_t idx = 0; idx < sizeof(bytes); ++idx) {
+    bytes[idx] = static_cast<uint8_t>(idx * 37 + 11);
+  }
+  for(uint32_t offset = 0; offset < 8; ++offset) {
+    for(uint32_t len = 0; offset + len <= sizeof(bytes); ++len) {
+      uint32_t crc = UINT32_MAX;
+      for(uint32_t idx = offset; idx < offset + len; ++idx) {
+        crc ^= bytes[idx];
+        for(uint32_t bit = 0; bit < 8; ++bit) {
+          crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+        }
+      }
+      EXPECT_EQ(~crc, Utility::Crc32c(bytes + offset, len));
+    }
+  }
+  // The key hash is part of the checkpointed index, so it mustn't depend on the CPU either.
+  EXPECT_EQ(0xE4925BFE18A2B92B, Utility::HashBytesCrc32c(bytes, 61));
+}
+
+template <class H>
+void TestKeyHashDistribution() {
+  // Keys that differ only in a few bytes, at the start or the end of a long key, must still
+  // spread across the tags and bucket indexes.
+  constexpr uint32_t kNumKeys = 1 << 16;
+  uint8_t key[100];
+  std::memset(key, 'x', sizeof(key));
+  for(uint32_t offset : { 0u, 49u, 96u }) {
+    std::unordered_set<uint16_t> tags;
+    std::unordered_set<uint64_t> buckets;
+    for(uint32_t idx = 0; idx < kNumKeys; ++idx) {
+      std::memcpy(key + offset, &idx, sizeof(idx));
+      KeyHash hash{ H::Hash(key, sizeof(key)) };
+      tags.insert(hash.tag());
+      buckets.insert(hash.idx(1 << 14));
+    }
+    // With 4 keys per slot, a uniform hash leaves ~2% of the 16384 slots empty.
+    EXPECT_GT(tags.size(), 15500);
+    EXPECT_GT(buckets.size(), 15500);
+  }
+  // Length matters, too.
+  EXPECT_NE(H::Hash(key, 10), H::Hash(key, 11));
+}
+
+TEST(UtilityTest, KeyHashDistribution) {
+  TestKeyHashDistribution<WordHash>();
+  TestKeyHashDistribution<Crc32cHash>();
+}
+
+TEST(UtilityTest, LogFilters) {
+  static constexpr uint32_t kKeysPerPage = 100;
+  static constexpr uint32_t kNumPages = 4 * LogFilters::kSegmentPages;
+  static_assert(kNumPages > LogFilters::kMaxProbes, "too few pages to reach the probe limit");
+  auto build = [](LogFilters& filters, uint32_t page) {
+    std::vector<KeyHash> hashes;
+    for(uint32_t key = 0; key < kKeysPerPage; ++key) {
+      hashes.push_back(KeyHash{ page * 1000 + key });
+    }
+    filters.Build(page, hashes);
+  };
+  // How many of 1000 absent keys the filters fail to rule out, in [begin_page, end_page].
+  auto false_positives = [](const LogFilters& filters, uint32_t begin_page, uint32_t end_page) {
+    uint32_t count = 0;
+    for(uint64_t key = 0; key < 1000; ++key) {
+      count += filters.MayContain(KeyHash{ 100000000 + key }, begin_page, end_page) ? 1 : 0;
+    }
+    return count;
+  };
+
+  // Every segment is complete, so a lookup checks one filter per segment.
+  LogFilters filters;
+  for(uint32_t page = 0; page < kNumPages; ++page) {
+    build(filters, page);
+  }
+  for(uint32_t page = 0; page < kNumPages; page += 7) {
+    ASSERT_TRUE(filters.MayContain(KeyHash{ page * 1000 + page % kKeysPerPage }, 0,
+                                   kNumPages - 1));
+  }
+  ASSERT_LT(false_positives(filters, 0, kNumPages - 1), 20);
+
+  // A page without a filter may hold any key.
+  ASSERT_EQ(1000, false_positives(filters, 0, kNumPages));
+
+  // Checkpoint and recover the filters; segments past the end of the recovered log are dropped.
+  std::FILE* file = std::tmpfile();
+  ASSERT_NE(nullptr, file);
+  ASSERT_EQ(Status::Ok, filters.Write(file));
+  std::rewind(file);
+  LogFilters recovered;
+  ASSERT_EQ(Status::Ok, recovered.Read(file, 0, kNumPages - 1));
+  std::fclose(file);
+  ASSERT_TRUE(recovered.MayContain(KeyHash{ 5 * 1000 + 5 }, 0, kNumPages - 2));
+  ASSERT_LT(false_positives(recovered, 0, kNumPages - 2), 100);
+
+  // Without segment filters, a lookup checks at most kMaxProbes pages' filters.
+  LogFilters pages_only;
+  for(uint32_t page = 0; page < kNumPages; ++page) {
+    BloomFilter* filter = new BloomFilter{ BloomFilter::NumBlocks(kKeysPerPage) };
+    for(uint32_t key = 0; key < kKeysPerPage; ++key) {
+      filter->Add(KeyHash{ page * 1000 + key });
+    }
+    ASSERT_TRUE(pages_only.Set(page, filter));
+  }
+  ASSERT_LT(false_positives(pages_only, 0, LogFilters::kMaxProbes - 1), 300);
+  ASSERT_EQ(1000, false_positives(pages_only, 0, LogFilters::kMaxProbes));
+
+  // Truncating frees segments' filters, along with their pages'.
+  filters.Truncate(2 * LogFilters::kSegmentPages);
+  ASSERT_EQ(1000, false_positives(filters, 0, kNumPages - 1));
+  ASSERT_LT(false_positives(filters, 2 * LogFilters::kSegmentPages, kNumPages - 1), 20);
+
+  // A segment whose first page is sparse would get an overfull filter; its pages' filters are
+  // checked instead.
+  LogFilters sparse;
+  sparse.Build(0, std::vector<KeyHash>{ KeyHash{ 0 } });
+  for(uint32_t page = 1; page < LogFilters::kSegmentPages; ++page) {
+    build(sparse, page);
+  }
+  ASSERT_TRUE(sparse.MayContain(KeyHash{ 0 }, 0, LogFilters::kSegmentPages - 1));
+  ASSERT_TRUE(sparse.MayContain(KeyHash{ 9 * 1000 + 9 }, 0, LogFilters::kSegmentPages - 1));
+  ASSERT_LT(false_positives(sparse, 0, LogFilters::kSegmentPages - 1), 300);
+}
+
+TEST(UtilityTest, LogMetadata) {
+  LogMetadata metadata{ 128 };
+  metadata.Initialize(true, 7, Address{ 3, 64 });
+  metadata.num_threads = 2;
+  metadata.final_address = Address{ 5, 128 };
+  metadata.monotonic_serial_nums[100] = 42;
+  metadata.guids[100] = Guid::Create();
+
+  // A store with room for fewer threads grows to fit the checkpoint's entries.
+  std::FILE* file = std::tmpfile();
+  ASSERT_NE(nullptr, file);
+  ASSERT_EQ(Status::Ok, metadata.Write(file));
+  std::rewind(file);
+  LogMetadata recovered{ 96 };
+  ASSERT_EQ(Status::Ok, recovered.Read(file));
+  ASSERT_TRUE(recovered.use_snapshot_file);
+  ASSERT_EQ(7, recovered.version);
+  ASSERT_EQ(2, recovered.num_threads.load());
+  ASSERT_EQ(Address(3, 64), recovered.flushed_address);
+  ASSERT_EQ(Address(5, 128), recovered.final_address);
+  ASSERT_EQ(128, recovered.guids.size());
+  ASSERT_EQ(42, recovered.monotonic_serial_nums[100]);
+  ASSERT_EQ(metadata.guids[100], recovered.guids[100]);
+  std::fclose(file);
+
+  // Checkpoints written before the format had a version: a 32-byte header, then 96 entries.
+  file = std::tmpfile();
+  ASSERT_NE(nullptr, file);
+  uint8_t header[32] = {};
+  header[0] = 1;
+  uint32_t version = 9;
+  uint32_t num_threads = 3;
+  uint64_t flushed_address = Address{ 4, 0 }.control();
+  uint64_t final_address = Address{ 6, 0 }.control();
+  std::memcpy(header + 4, &version, sizeof(version));
+  std::memcpy(header + 8, &num_threads, sizeof(num_threads));
+  std::memcpy(header + 16, &flushed_address, sizeof(flushed_address));
+  std::memcpy(header + 24, &final_address, sizeof(final_address));
+  std::vector<uint64_t> serial_nums(LogMetadata::kUnversionedNumThreads);
+  serial_nums[95] = 11;
+  std::vector<Guid> guids(LogMetadata::kUnversionedNumThreads);
+  guids[95] = Guid::Create();
+  ASSERT_EQ(1, std::fwrite(header, sizeof(header), 1, file));
+  ASSERT_EQ(serial_nums.size(), std::fwrite(serial_nums.data(), sizeof(uint64_t),
+                                            serial_nums.size(), file));
+  ASSERT_EQ(guids.size(), std::fwrite(guids.data(), sizeof(Guid), guids.size(), file));
+  std::rewind(file);
+  LogMetadata unversioned{ 64 };
+  ASSERT_EQ(Status::Ok, unversioned.Read(file));
+  ASSERT_TRUE(unversioned.use_snapshot_file);
+  ASSERT_EQ(9, unversioned.version);
+  ASSERT_EQ(3, unversioned.num_threads.load());
+  ASSERT_EQ(Address(4, 0), unversioned.flushed_address);
+  ASSERT_EQ(Address(6, 0), unversioned.final_address);
+  ASSERT_EQ(96, unversioned.guids.size());
+  ASSERT_EQ(11, unversioned.monotonic_serial_nums[95]);
+  ASSERT_EQ(guids[95], unversioned.guids[95]);
+  std::fclose(file);
+
+  // A newer format is rejected.
+  file = std::tmpfile();
+  ASSERT_NE(nullptr, file);
+  uint32_t newer[2] = { LogMetadata::kMagic, LogMetadata::kFormatVersion + 1 };
+  ASSERT_EQ(1, std::fwrite(newer, sizeof(newer), 1, file));
+  ASSERT_EQ(1, std::fwrite(header, sizeof(header), 1, file));
+  std::rewind(file);
+  ASSERT_EQ(Status::Corruption, recovered.Read(file));
+  std::fclose(file);
+}
+
+TEST(UtilityTest, EpochDrainOverflow) {
+  class CountContext : public IAsyncContext {
+   public:
+    CountContext(uint64_t* count_)
+      : count{ count_ } {
+    }
+
+   protected:
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) final {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+   public:
+    uint64_t* count;
+  };
+
+  auto callback = [](IAsyncContext* ctxt) {
+    ++*static_cast<CountContext*>(ctxt)->count;
+  };
+
+  // While this thread holds its epoch, no action is safe to perform; so after the drain list
+  // fills, actions go to the overflow list, instead of waiting.
+  static constexpr uint32_t kNumActions = 4 * LightEpoch::kDrainListSize;
+  LightEpoch epoch;
+  uint64_t count = 0;
+  CountContext context{ &count };
+  epoch.Protect();
+  for(uint32_t idx = 0; idx < kNumActions; ++idx) {
+    epoch.BumpCurrentEpoch(callback, &context);
+  }
+  EXPECT_EQ(0, count);
+  EXPECT_EQ(kNumActions, epoch.num_pending_actions());
+  EXPECT_EQ(kNumActions - LightEpoch::kDrainListSize, epoch.num_overflows());
+
+  // Once the thread moves to the current epoch, every action is performed.
+  epoch.ProtectAndDrain();
+  EXPECT_EQ(kNumActions, count);
+  EXPECT_EQ(0, epoch.num_pending_actions());
+  epoch.Unprotect();
+}
+
+TEST(UtilityTest, EpochSafeToReclaim) {
+  static constexpr uint32_t kNumThreads = 8;
+  LightEpoch epoch;
+  std::atomic<uint32_t> num_protected{ 0 };
+  std::atomic<uint32_t> num_released{ 0 };
+  uint64_t protected_epochs[kNumThreads];
+
+  // Thread i enters the epoch at epoch i + 1, and leaves it in the same order.
+  std::vector<std::thread> threads;
+  for(uint32_t idx = 0; idx < kNumThreads; ++idx) {
+    threads.emplace_back([&](uint32_t thread_idx) {
+      protected_epochs[thread_idx] = epoch.Protect();
+      ++num_protected;
+      while(num_released.load() <= thread_idx) {
+        std::this_thread::yield();
+      }
+      epoch.Unprotect();
+      ++num_protected;
+    }, idx);
+    while(num_protected.load() <= idx) {
+      std::this_thread::yield();
+    }
+    epoch.BumpCurrentEpoch();
+  }
+
+  for(uint32_t idx = 0; idx < kNumThreads; ++idx) {
+    ASSERT_EQ(idx + 1, protected_epochs[idx]);
+    ASSERT_EQ(idx, epoch.ComputeNewSafeToReclaimEpoch(epoch.current_epoch.load()));
+    ++num_released;
+    while(num_protected.load() <= kNumThreads + idx) {
+      std::this_thread::yield();
+    }
+  }
+  ASSERT_EQ(kNumThreads, epoch.ComputeNewSafeToReclaimEpoch(epoch.current_epoch.load()));
+
+  for(auto& thread : threads) {
+    thread.join();
+  }
+}
+
+TEST(UtilityTest, PendingIoTable) {
+  // I/Os complete out of order; a few stay pending for a long time, so that their IDs collide
+  // with later IDs.
+  PendingIoTable table;
+  std::unordered_map<uint64_t, uint64_t> expected;
+  std::mt19937_64 rng{ 7 };
+  uint64_t next_io_id = 0;
+  for(uint32_t round = 0; round < 100000; ++round) {
+    if(expected.size() < 300 && rng() % 2 == 0) {
+      table.Insert(next_io_id, KeyHash{ next_io_id * 3 });
+      expected[next_io_id] = next_io_id * 3;
+      ++next_io_id;
+    } else if(!expected.empty()) {
+      uint64_t io_id = next_io_id - 1 - rng() % (next_io_id < 400 ? next_io_id : 400);
+      ASSERT_EQ(expected.erase(io_id) == 1, table.Erase(io_id));
+    }
+    ASSERT_EQ(expected.size(), table.size());
+  }
+  uint32_t num_entries = 0;
+  for(const auto& entry : table) {
+    ASSERT_EQ(1, expected.count(entry.io_id));
+    ASSERT_EQ(expected[entry.io_id], entry.hash.control());
+    ++num_entries;
+  }
+  ASSERT_EQ(expected.size(), num_entries);
+  table.clear();
+  ASSERT_TRUE(table.empty());
+  ASSERT_FALSE(table.Erase(0));
+}
+
+TEST(UtilityTest, RetryQueue) {
+  class Context : public IAsyncContext {
+   protected:
+    Status DeepCopy_Internal(IAsyncContext*& context_copy) final {
+      return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+  };
+
+  std::vector<Context> contexts(1000);
+  RetryQueue queue;
+  std::deque<IAsyncContext*> expected;
+  std::mt19937_64 rng{ 11 };
+  for(uint32_t round = 0; round < 100000; ++round) {
+    if(rng() % 3 != 0) {
+      IAsyncContext* context = &contexts[rng() % contexts.size()];
+      queue.push_back(context);
+      expected.push_back(context);
+    } else if(!expected.empty()) {
+      ASSERT_EQ(expected.front(), queue.front());
+      queue.pop_front();
+      expected.pop_front();
+    }
+    ASSERT_EQ(expected.size(), queue.size());
+  }
+  for(uint32_t idx = 0; idx < queue.size(); ++idx) {
+    ASSERT_EQ(expected[idx], queue[idx]);
+  }
+  queue.clear();
+  ASSERT_TRUE(queue.empty());
+}
+
+TEST(UtilityTest, MemoryPolicy) {
+  // Huge pages and NUMA placement are best effort; every policy must yield zeroed, aligned,
+  // writable memory, and clear it for reuse, whatever the machine supports.
+  MemoryPolicy policies[] = {
+    MemoryPolicy{},
+    MemoryPolicy{ MemoryPolicy::PageSize::Default, MemoryPolicy::Numa::Default, 0, true },
+    MemoryPolicy{ MemoryPolicy::PageSize::Transparent },
+    MemoryPolicy{ MemoryPolicy::PageSize::Huge2MB, MemoryPolicy::Numa::Interleave },
+    MemoryPolicy{ MemoryPolicy::PageSize::Huge1GB, MemoryPolicy::Numa::Bind, 0, true },
+  };
+  size_t sizes[] = { 4096, 3 * 1048576 + 64, 33554432 };
+  for(const MemoryPolicy& policy : policies) {
+    for(size_t size : sizes) {
+      uint8_t* buffer = reinterpret_cast<uint8_t*>(policy.Allocate(512, size));
+      ASSERT_NE(nullptr, buffer);
+      ASSERT_EQ(0, reinterpret_cast<uintptr_t>(buffer) % 512);
+      for(size_t offset = 0; offset < size; offset += 4093) {
+        ASSERT_EQ(0, buffer[offset]);
+      }
+      ASSERT_EQ(0, buffer[size - 1]);
+      std::memset(buffer, 0xAB, size);
+      // A cleared buffer reads as zeroes again, and stays writable.
+      policy.Clear(buffer, size);
+      for(size_t offset = 0; offset < size; offset += 4093) {
+        ASSERT_EQ(0, buffer[offset]);
+      }
+      ASSERT_EQ(0, buffer[size - 1]);
+      buffer[size - 1] = 1;
+      policy.Free(buffer, size);
+    }
+  }
+
+  // An aligned_alloc() buffer's whole pages are handed back to the OS; the bytes that share its
+  // end pages with other allocations are zeroed, and nothing past its ends is touched.
+  MemoryPolicy policy{};
+  size_t size = 3 * 1048576;
+  uint8_t* buffer = reinterpret_cast<uint8_t*>(policy.Allocate(512, size));
+  ASSERT_NE(nullptr, buffer);
+  std::memset(buffer, 0xAB, size);
+  policy.Clear(buffer + 512, size - 1024);
+  for(size_t offset = 0; offset < size; ++offset) {
+    ASSERT_EQ(offset < 512 || offset >= size - 512 ? 0xAB : 0, buffer[offset]);
+  }
+  policy.Free(buffer, size);
+}
+
+TEST(UtilityTest, RecordSizePredictor) {
+  static constexpr uint32_t kNumThreads = 4;
+  RecordSizePredictor predictor;
+  ASSERT_EQ(0, predictor.prediction());
+
+  auto record_worker = [&predictor](uint32_t count, uint32_t small, uint32_t large) {
+    for(uint32_t idx = 0; idx < count; ++idx) {
+      predictor.Record(idx % 25 == 0 ? large : small);
+    }
+  };
+  // Each thread keeps its own histogram; the prediction merges all of them. Fewer than 5% of the
+  // records are large, so the prediction covers only the small ones.
+  std::deque<std::thread> threads;
+  for(uint32_t idx = 0; idx < kNumThreads; ++idx) {
+    threads.emplace_back(record_worker, 1024, 300, 5000);
+  }
+  for(auto& thread : threads) {
+    thread.join();
+  }
+  // Recompute the prediction once every thread has finished.
+  record_worker(RecordSizePredictor::kUpdateInterval, 300, 300);
+  ASSERT_EQ(512, predictor.prediction());
+
+  // Most records are now larger.
+  threads.clear();
+  for(uint32_t idx = 0; idx < kNumThreads; ++idx) {
+    threads.emplace_back(record_worker, 2048, 1500, 1500);
+  }
+  for(auto& thread : threads) {
+    thread.join();
+  }
+  record_worker(RecordSizePredictor::kUpdateInterval, 1500, 1500);
+  ASSERT_EQ(1536, predictor.prediction());
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();